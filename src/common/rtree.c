@@ -544,6 +544,173 @@ static int _RTreeSearchMbr(RTreeNode *node, const RTREE_MBR *mbr, int (*searchCa
 }
 
 
+/* center of mbr along dimension dim, doubled (no need to divide) */
+#define RTREE_CENTER2(m, dim)  ((m)->bound[dim] + (m)->bound[(dim) + RTREE_DIMS])
+
+
+static int _RTreeCmpCenterX(const void *a, const void *b)
+{
+    RTREE_REAL ca = RTREE_CENTER2(&((const RTREE_BRANCH *) a)->mbr, 0);
+    RTREE_REAL cb = RTREE_CENTER2(&((const RTREE_BRANCH *) b)->mbr, 0);
+    return (ca < cb ? -1 : (ca > cb ? 1 : 0));
+}
+
+
+static int _RTreeCmpCenterY(const void *a, const void *b)
+{
+    RTREE_REAL ca = RTREE_CENTER2(&((const RTREE_BRANCH *) a)->mbr, 1 % RTREE_DIMS);
+    RTREE_REAL cb = RTREE_CENTER2(&((const RTREE_BRANCH *) b)->mbr, 1 % RTREE_DIMS);
+    return (ca < cb ? -1 : (ca > cb ? 1 : 0));
+}
+
+
+/**
+ * Sort-Tile-Recursive: order by x into vertical slices of S*M entries,
+ * then each slice by y, so consecutive runs of M make tiles.
+ */
+static void _RTreeSortSTR(RTREE_BRANCH *branches, int count, int fanout)
+{
+    int nodes, slices, slicesize, i;
+
+    nodes = (count + fanout - 1) / fanout;
+    slices = (int) ceil(sqrt((double) nodes));
+    slicesize = slices * fanout;
+
+    qsort(branches, count, sizeof(RTREE_BRANCH), _RTreeCmpCenterX);
+
+    for (i = 0; i < count; i += slicesize) {
+        qsort(branches + i, RTREE_MIN2(slicesize, count - i), sizeof(RTREE_BRANCH), _RTreeCmpCenterY);
+    }
+}
+
+
+typedef struct
+{
+    uint32_t key;
+    int      index;
+} RTreeHilbertKey;
+
+
+static int _RTreeCmpHilbertKey(const void *a, const void *b)
+{
+    uint32_t ka = ((const RTreeHilbertKey *) a)->key;
+    uint32_t kb = ((const RTreeHilbertKey *) b)->key;
+    return (ka < kb ? -1 : (ka > kb ? 1 : 0));
+}
+
+
+/* spread the low 16 bits of v to the even bits */
+#define RTREE_HILBERT_SPREAD(v)  do { \
+        v = (v | (v << 8)) & 0x00FF00FF; \
+        v = (v | (v << 4)) & 0x0F0F0F0F; \
+        v = (v | (v << 2)) & 0x33333333; \
+        v = (v | (v << 1)) & 0x55555555; \
+    } while (0)
+
+/**
+ * Same curve as stepping the quadrants from the top bit down, rotating
+ *   x and y as it goes, but the rotations of all levels are composed by a
+ *   prefix scan over bit masks: no branches and 4 rounds instead of 16.
+ */
+uint32_t RTreeHilbertXY2D(uint32_t x, uint32_t y)
+{
+    uint32_t A, B, C, D, a, b, c, d, i0, i1;
+
+    x &= 0xFFFF;
+    y &= 0xFFFF;
+
+    a = x ^ y;
+    b = 0xFFFF ^ a;
+    c = 0xFFFF ^ (x | y);
+    d = x & (y ^ 0xFFFF);
+
+    A = a | (b >> 1);
+    B = (a >> 1) ^ a;
+    C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+    a = A; b = B; c = C; d = D;
+    A = (a & (a >> 2)) ^ (b & (b >> 2));
+    B = (a & (b >> 2)) ^ (b & ((a ^ b) >> 2));
+    C ^= (a & (c >> 2)) ^ (b & (d >> 2));
+    D ^= (b & (c >> 2)) ^ ((a ^ b) & (d >> 2));
+
+    a = A; b = B; c = C; d = D;
+    A = (a & (a >> 4)) ^ (b & (b >> 4));
+    B = (a & (b >> 4)) ^ (b & ((a ^ b) >> 4));
+    C ^= (a & (c >> 4)) ^ (b & (d >> 4));
+    D ^= (b & (c >> 4)) ^ ((a ^ b) & (d >> 4));
+
+    a = A; b = B; c = C; d = D;
+    C ^= (a & (c >> 8)) ^ (b & (d >> 8));
+    D ^= (b & (c >> 8)) ^ ((a ^ b) & (d >> 8));
+
+    a = C ^ (C >> 1);
+    b = D ^ (D >> 1);
+
+    i0 = x ^ y;
+    i1 = b | (0xFFFF ^ (i0 | a));
+
+    RTREE_HILBERT_SPREAD(i0);
+    RTREE_HILBERT_SPREAD(i1);
+
+    return (i1 << 1) | i0;
+}
+
+
+/**
+ * Order branches by the Hilbert index of their mbr centers
+ */
+static void _RTreeSortHilbert(RTREE_BRANCH *branches, int count)
+{
+    int i;
+    RTREE_REAL minx, miny, maxx, maxy, sx, sy;
+    RTreeHilbertKey *keys;
+    RTREE_BRANCH *sorted;
+    const int ydim = 1 % RTREE_DIMS;
+
+    if (count < 2) {
+        return;
+    }
+
+    minx = maxx = RTREE_CENTER2(&branches[0].mbr, 0);
+    miny = maxy = RTREE_CENTER2(&branches[0].mbr, ydim);
+
+    for (i = 1; i < count; i++) {
+        RTREE_REAL cx = RTREE_CENTER2(&branches[i].mbr, 0);
+        RTREE_REAL cy = RTREE_CENTER2(&branches[i].mbr, ydim);
+        minx = RTREE_MIN2(minx, cx);
+        maxx = RTREE_MAX2(maxx, cx);
+        miny = RTREE_MIN2(miny, cy);
+        maxy = RTREE_MAX2(maxy, cy);
+    }
+
+    sx = (maxx > minx) ? 65535.0 / (maxx - minx) : 0;
+    sy = (maxy > miny) ? 65535.0 / (maxy - miny) : 0;
+
+    keys = (RTreeHilbertKey *) malloc(sizeof(RTreeHilbertKey) * count);
+    sorted = (RTREE_BRANCH *) malloc(sizeof(RTREE_BRANCH) * count);
+    RTREE_ASSERT(keys && sorted);
+
+    for (i = 0; i < count; i++) {
+        uint32_t hx = (uint32_t) ((RTREE_CENTER2(&branches[i].mbr, 0) - minx) * sx);
+        uint32_t hy = (uint32_t) ((RTREE_CENTER2(&branches[i].mbr, ydim) - miny) * sy);
+        keys[i].key = RTreeHilbertXY2D(hx, hy);
+        keys[i].index = i;
+    }
+
+    qsort(keys, count, sizeof(RTreeHilbertKey), _RTreeCmpHilbertKey);
+
+    for (i = 0; i < count; i++) {
+        sorted[i] = branches[keys[i].index];
+    }
+    memcpy(branches, sorted, sizeof(RTREE_BRANCH) * count);
+
+    free(sorted);
+    free(keys);
+}
+
+
 /**********************************************************************
  *								Public functions:                     *
  **********************************************************************/
@@ -1003,6 +1170,116 @@ int RTreeSearchMbr(RTREE_ROOT root, const RTREE_MBR *mbr, int (*searchCallback)(
 }
 
 
+/**
+ * Build a packed rtree bottom-up: order the entries of one level, cut them
+ * into full nodes, then repeat on the node covers until they fit the root.
+ */
+RTREE_ROOT RTreeBulkLoad(RTREE_BRANCH *branches, int count, int method, int (*RTreeSearchCallback)(void*, void*))
+{
+    int i, k, level = 0;
+    RTREE_BRANCH *entries = branches;
+    RTreeRoot *root = (RTreeRoot*) RTreeCreate(RTreeSearchCallback);
+
+    if (method == RTREE_BULK_HILBERT) {
+        /* parents are created in curve order, so upper levels stay ordered */
+        _RTreeSortHilbert(entries, count);
+    }
+
+    while (count > RTREE_MAXCARD) {
+        int nodes = (count + RTREE_MAXCARD - 1) / RTREE_MAXCARD;
+        RTREE_BRANCH *parents = (RTREE_BRANCH *) malloc(sizeof(RTREE_BRANCH) * nodes);
+        RTREE_ASSERT(parents);
+
+        if (method != RTREE_BULK_HILBERT) {
+            _RTreeSortSTR(entries, count, RTREE_MAXCARD);
+        }
+
+        for (k = 0; k < nodes; k++) {
+            RTreeNode *node = RTreeNewNode();
+            int first = k * RTREE_MAXCARD;
+            int n = RTREE_MIN2(RTREE_MAXCARD, count - first);
+
+            node->level = level;
+            for (i = 0; i < n; i++) {
+                node->branch[i] = entries[first + i];
+            }
+            node->count = n;
+
+            parents[k].mbr = RTreeNodeCover(node);
+            parents[k].child = node;
+        }
+
+        if (entries != branches) {
+            free(entries);
+        }
+
+        entries = parents;
+        count = nodes;
+        level++;
+    }
+
+    root->rootNode->level = level;
+    for (i = 0; i < count; i++) {
+        root->rootNode->branch[i] = entries[i];
+    }
+    root->rootNode->count = count;
+
+    if (entries != branches) {
+        free(entries);
+    }
+
+    return root;
+}
+
+
+/**
+ * Walk the tree breadth first. Children of the nodes are numbered in visit
+ * order, so a node array written in this order needs no pointer fixups.
+ */
+int RTreeFlatten(RTREE_ROOT root, RTreeFlattenCallback flattenCallback, void *arg)
+{
+    int i, head = 0, tail = 1, capacity = 64;
+    RTREE_BRANCH branches[RTREE_MAXCARD];
+    RTreeNode **queue = (RTreeNode **) malloc(sizeof(RTreeNode *) * capacity);
+    RTREE_ASSERT(queue);
+
+    queue[0] = root->rootNode;
+
+    while (head < tail) {
+        RTreeNode *node = queue[head++];
+        int count = 0, firstChild = -1;
+
+        /* branches may have holes after deletes */
+        for (i = 0; i < RTREE_MAXKIDS(node); i++) {
+            if (node->branch[i].child) {
+                branches[count++] = node->branch[i];
+            }
+        }
+
+        if (node->level > 0) {
+            firstChild = tail;
+
+            if (tail + count > capacity) {
+                capacity = (tail + count) * 2;
+                queue = (RTreeNode **) realloc(queue, sizeof(RTreeNode *) * capacity);
+                RTREE_ASSERT(queue);
+            }
+            for (i = 0; i < count; i++) {
+                queue[tail++] = (RTreeNode *) branches[i].child;
+            }
+        }
+
+        if (! flattenCallback(arg, node->level, count, branches, firstChild)) {
+            free(queue);
+            return -1;
+        }
+    }
+
+    free(queue);
+    return tail;
+}
+
+
 /**
  * Insert a data rectangle into an index structure.
  * RTreeInsertRect provides for splitting the root;
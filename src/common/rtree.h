@@ -252,6 +252,46 @@ int RTreeSearchMbr(RTREE_ROOT root, const RTREE_MBR *mbr, int (*searchCallback)(
 int RTreeInsertMbr(RTREE_ROOT root, RTREE_MBR *data_mbr, void* data_id, int level);
 
 
+/**
+ * Bulk load methods for RTreeBulkLoad
+ */
+#define RTREE_BULK_STR      0   /* Sort-Tile-Recursive */
+#define RTREE_BULK_HILBERT  1   /* Hilbert curve order of mbr centers */
+
+
+/**
+ * Distance of cell (x, y) along the Hilbert curve on a 65536 x 65536 grid
+ */
+uint32_t RTreeHilbertXY2D(uint32_t x, uint32_t y);
+
+
+/**
+ * Build a packed rtree from count data rectangles in one pass.
+ * Each branches[i] holds a data mbr and its non-null data id (child).
+ * Nodes are filled to RTREE_MAXCARD, so the tree has far fewer nodes than
+ * one built by RTreeInsertMbr. Only the first two dimensions are used to
+ * order the rectangles. branches is reordered in place, not kept.
+ * Returns a new root which can be updated later by RTreeInsertMbr.
+ */
+RTREE_ROOT RTreeBulkLoad(RTREE_BRANCH *branches, int count, int method, int (*RTreeSearchCallback)(void*, void*));
+
+
+/**
+ * Callback of RTreeFlatten, called once per node in breadth first order.
+ * branches holds the count used branches of the node. For an internal node
+ * (level > 0) the child of branches[k] is visited as node firstChild + k.
+ * Return 0 to stop the walk.
+ */
+typedef int (*RTreeFlattenCallback)(void *arg, int level, int count, const RTREE_BRANCH *branches, int firstChild);
+
+
+/**
+ * Walk the tree breadth first so it can be stored as a flat node array.
+ * Returns the number of nodes visited, or -1 if the callback stopped it.
+ */
+int RTreeFlatten(RTREE_ROOT root, RTreeFlattenCallback flattenCallback, void *arg);
+
+
 /**
  * Delete a data rectangle from an index structure.
  * Pass in a pointer to a RTREE_MBR, the tid of the record, ptr to ptr to root node.
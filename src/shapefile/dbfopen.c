@@ -37,6 +37,9 @@
  *****************************************************************************/
 #include "shapefile_i.h"
 
+#include <ctype.h>
+#include <locale.h>
+
 
 static void StringToUpper (char *str, int len)
 {
@@ -98,19 +101,51 @@ static void DBFWriteHeader (DBFHandle psDBF)
 
 
 /**
- * Write out the current record if there is one.
+ * Write out the rows buffered by DBFAppendRow(), they are the last ones.
+ *  On error the rows stay buffered, so a later flush tries again.
+ */
+static int DBFWritePendingRows (DBFHandle psDBF)
+{
+    int nRows = psDBF->nAppendRows;
+
+    if (nRows == 0) {
+        return SHAPEFILE_TRUE;
+    }
+
+    if (fseek(psDBF->fp, (long) psDBF->nRecordLength * (psDBF->nRecords - nRows) + psDBF->nHeaderLength, SEEK_SET) != 0 ||
+        fwrite(psDBF->pszAppendRecords, psDBF->nRecordLength, nRows, psDBF->fp) != (size_t) nRows) {
+        return SHAPEFILE_FALSE;
+    }
+
+    psDBF->nAppendRows = 0;
+    return SHAPEFILE_TRUE;
+}
+
+
+/**
+ * Write out the appended rows and the current record if there is one.
+ *  Returns SHAPEFILE_FALSE if either could not be written: it is kept
+ *  pending, and records must not be reloaded over it.
  */
-static void DBFFlushRecord (DBFHandle psDBF)
+static int DBFFlushRecord (DBFHandle psDBF)
 {
-    int nRecordOffset;
+    long nRecordOffset;
+
+    if (!DBFWritePendingRows (psDBF)) {
+        return SHAPEFILE_FALSE;
+    }
+
     if (psDBF->bCurrentRecordModified && psDBF->nCurrentRecord > -1) {
-        psDBF->bCurrentRecordModified = SHAPEFILE_FALSE;
+        nRecordOffset = (long) psDBF->nRecordLength * psDBF->nCurrentRecord + psDBF->nHeaderLength;
 
-        nRecordOffset = psDBF->nRecordLength * psDBF->nCurrentRecord + psDBF->nHeaderLength;
+        if (fseek(psDBF->fp, nRecordOffset, 0) != 0 ||
+            fwrite(psDBF->pszCurrentRecord, psDBF->nRecordLength, 1, psDBF->fp) != 1) {
+            return SHAPEFILE_FALSE;
+        }
 
-        fseek(psDBF->fp, nRecordOffset, 0);
-        fwrite(psDBF->pszCurrentRecord, psDBF->nRecordLength, 1, psDBF->fp);
+        psDBF->bCurrentRecordModified = SHAPEFILE_FALSE;
     }
+    return SHAPEFILE_TRUE;
 }
 
 
@@ -263,6 +298,32 @@ DBFHandle DBFOpen (const char * pszFilename, const char * pszAccess)
 }
 
 
+/**
+ * Open a .dbf file read-only and map it into memory.
+ *  Records are then addressed in the mapping instead of fseek + fread.
+ */
+DBFHandle DBFOpenMapped (const char * pszFilename, int nFlags)
+{
+    DBFHandle psDBF = DBFOpen(pszFilename, "rb");
+    if (!psDBF) {
+        return (0);
+    }
+
+    psDBF->pszMap = (char *) SfMapFile(psDBF->fp, &psDBF->nMapSize, nFlags);
+    if (!psDBF->pszMap || psDBF->nMapSize < (size_t) psDBF->nHeaderLength || psDBF->nRecordLength <= 0) {
+        DBFClose(psDBF);
+        return (0);
+    }
+
+    /* never address records beyond the end of a truncated file */
+    if ((size_t) psDBF->nRecords > (psDBF->nMapSize - psDBF->nHeaderLength) / psDBF->nRecordLength) {
+        psDBF->nRecords = (int) ((psDBF->nMapSize - psDBF->nHeaderLength) / psDBF->nRecordLength);
+    }
+
+    return (psDBF);
+}
+
+
 void DBFClose (DBFHandle psDBF)
 {
     if (psDBF==0) {
@@ -280,6 +341,10 @@ void DBFClose (DBFHandle psDBF)
         DBFUpdateHeader (psDBF);
     }
 
+    if (psDBF->pszMap) {
+        SfUnmapFile(psDBF->pszMap, psDBF->nMapSize);
+    }
+
     fclose(psDBF->fp);
 
     if (psDBF->panFieldOffset != 0) {
@@ -291,6 +356,11 @@ void DBFClose (DBFHandle psDBF)
 
     free(psDBF->pszHeader);
     free(psDBF->pszCurrentRecord);
+
+    SafeFree(psDBF->pReturnTuple);
+    SafeFree(psDBF->pszBatchRecords);
+    SafeFree(psDBF->pszAppendRecords);
+
     free(psDBF);
 }
 
@@ -446,54 +516,295 @@ int DBFAddField (DBFHandle psDBF, const char * pszFieldName, DBFFieldType eType,
 
 
 /**
- * Read one of the attribute fields of a record
+ * Same rules as DBFIsAttributeNULL() on the raw cell text: the cell is
+ *  tested as DBFReadStringAttribute() would return it, so leading blanks
+ *  are skipped only when TRIM_DBF_WHITESPACE is defined.
  */
-static void *DBFReadAttribute (DBFHandle psDBF, int hEntity, int iField, char chReqType)
+static int DBFIsCellNULL (char chType, const char *pszCell, int nWidth)
 {
-    int           nRecordOffset;
-    unsigned char *pabyRec;
-    void          *pReturnField = 0;
+    int i = 0;
 
-    if (hEntity < 0 || hEntity >= psDBF->nRecords) {
-        return (0);
+#ifdef TRIM_DBF_WHITESPACE
+    while (i < nWidth && pszCell[i] == ' ') {
+        i++;
     }
+#endif
 
-    if (iField < 0 || iField >= psDBF->nFields) {
-        return (0);
+    switch (chType) {
+    case 'N':
+    case 'F':
+        /* We accept all asterisks or all blanks as 0 */
+        if (i < nWidth && pszCell[i] == '*') {
+            return SHAPEFILE_TRUE;
+        }
+        while (i < nWidth && pszCell[i] == ' ') {
+            i++;
+        }
+        return (i == nWidth || pszCell[i] == '\0');
+
+    case 'D':
+        /* 0 date fields have value "00000000" */
+        return (nWidth - i >= 8 && strncmp(pszCell + i, "00000000", 8) == 0);
+
+    case 'L':
+        /* 0 boolean fields have value "?" */
+        return (i < nWidth && pszCell[i] == '?');
+
+    default:
+        /* empty string fields are considered 0 */
+        return (i == nWidth || pszCell[i] == '\0');
+    }
+}
+
+
+/* powers of ten exactly representable as doubles */
+static const double DBFPow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* largest integer such that all smaller ones are exact doubles */
+#define DBF_EXACT_MANTISSA  ((uint64_t) 1 << 53)
+
+
+/**
+ * Slow path of DBFParseDouble(): strtod() on a copy of the cell, with
+ *  the '.' of the file swapped for the decimal point of the C locale.
+ */
+static double DBFParseDoubleSlow (const char *pszCell, int nWidth)
+{
+    char szNumber[257];
+    char chPoint = localeconv()->decimal_point[0];
+
+    nWidth = MIN_V2(nWidth, 256);
+    memcpy(szNumber, pszCell, nWidth);
+    szNumber[nWidth] = '\0';
+
+    if (chPoint != '.') {
+        char *pch = strchr(szNumber, '.');
+        if (pch) {
+            *pch = chPoint;
+        }
+    }
+
+    return strtod(szNumber, 0);
+}
+
+
+/**
+ * Decode a fixed width N/F cell ("  -123.4500", "1.5E+03") without copying
+ *  it and independently of the locale. Decimals with up to 15-16 significant
+ *  digits and a small exponent are converted exactly as one multiply or
+ *  divide by an exact power of ten; anything else goes to strtod().
+ *  Like atof(), trailing garbage is ignored and blanks give 0.
+ */
+static double DBFParseDouble (const char *pszCell, int nWidth)
+{
+    const char *pch = pszCell, *pchEnd = pszCell + nWidth;
+    uint64_t nMantissa = 0;
+    int nExp10 = 0, bNegative = 0, bDigits = 0, bInexact = 0;
+    double dValue;
+
+    while (pch < pchEnd && *pch == ' ') {
+        pch++;
+    }
+
+    if (pch < pchEnd && (*pch == '-' || *pch == '+')) {
+        bNegative = (*pch++ == '-');
+    }
+
+    for (; pch < pchEnd && *pch >= '0' && *pch <= '9'; pch++) {
+        bDigits = 1;
+        if (nMantissa < DBF_EXACT_MANTISSA / 10) {
+            nMantissa = nMantissa * 10 + (*pch - '0');
+        } else {
+            bInexact = 1;
+            break;
+        }
+    }
+
+    if (!bInexact && pch < pchEnd && *pch == '.') {
+        for (pch++; pch < pchEnd && *pch >= '0' && *pch <= '9'; pch++) {
+            bDigits = 1;
+            if (nMantissa < DBF_EXACT_MANTISSA / 10) {
+                nMantissa = nMantissa * 10 + (*pch - '0');
+                nExp10--;
+            } else if (*pch != '0') {
+                bInexact = 1;
+                break;
+            }
+        }
+    }
+
+    if (!bDigits || bInexact) {
+        /* nan, inf, hex or too many digits */
+        return DBFParseDoubleSlow(pszCell, nWidth);
+    }
+
+    if (pch < pchEnd && (*pch == 'e' || *pch == 'E')) {
+        const char *pchExp = pch + 1;
+        int bNegExp = 0, nExp = 0;
+
+        if (pchExp < pchEnd && (*pchExp == '-' || *pchExp == '+')) {
+            bNegExp = (*pchExp++ == '-');
+        }
+
+        if (pchExp < pchEnd && *pchExp >= '0' && *pchExp <= '9') {
+            for (; pchExp < pchEnd && *pchExp >= '0' && *pchExp <= '9'; pchExp++) {
+                if (nExp < 10000) {
+                    nExp = nExp * 10 + (*pchExp - '0');
+                }
+            }
+            nExp10 += bNegExp ? -nExp : nExp;
+        }
+    }
+
+    if (nMantissa == 0) {
+        dValue = 0.0;
+    } else if (nExp10 == 0) {
+        dValue = (double) nMantissa;
+    } else if (nExp10 > 0 && nExp10 <= 22) {
+        dValue = (double) nMantissa * DBFPow10[nExp10];
+    } else if (nExp10 < 0 && nExp10 >= -22) {
+        dValue = (double) nMantissa / DBFPow10[-nExp10];
+    } else {
+        return DBFParseDoubleSlow(pszCell, nWidth);
+    }
+
+    return bNegative ? -dValue : dValue;
+}
+
+
+/**
+ * Decode an integer cell: plain digits directly, anything else via DBFParseDouble()
+ */
+static int64_t DBFParseInt64 (const char *pszCell, int nWidth)
+{
+    int i = 0, bNegative = 0;
+    int64_t nValue = 0;
+
+    while (i < nWidth && pszCell[i] == ' ') {
+        i++;
+    }
+
+    if (i < nWidth && (pszCell[i] == '-' || pszCell[i] == '+')) {
+        bNegative = (pszCell[i++] == '-');
+    }
+
+    for (; i < nWidth && pszCell[i] >= '0' && pszCell[i] <= '9'; i++) {
+        int nDigit = pszCell[i] - '0';
+        if (nValue > (INT64_MAX - nDigit) / 10) {
+            break;
+        }
+        nValue = nValue * 10 + nDigit;
+    }
+
+    while (i < nWidth && pszCell[i] == ' ') {
+        i++;
     }
 
+    if (i < nWidth && pszCell[i] != '\0') {
+        /* decimals, exponent or overflow */
+        double dValue = DBFParseDouble(pszCell, nWidth);
+
+        if (dValue >= 9223372036854775807.0) {
+            return INT64_MAX;
+        }
+        if (dValue <= -9223372036854775807.0) {
+            return -INT64_MAX;
+        }
+        return (int64_t) dValue;
+    }
+
+    return bNegative ? -nValue : nValue;
+}
+
+
+/**
+ * Make hEntity the current record
+ */
+static int DBFLoadRecord (DBFHandle psDBF, int hEntity)
+{
+    long nRecordOffset;
+
     if (psDBF->nCurrentRecord != hEntity) {
-        DBFFlushRecord (psDBF);
-        nRecordOffset = psDBF->nRecordLength * hEntity + psDBF->nHeaderLength;
+        if (!DBFFlushRecord (psDBF)) {
+            return SHAPEFILE_FALSE;
+        }
+        nRecordOffset = (long) psDBF->nRecordLength * hEntity + psDBF->nHeaderLength;
 
         if (fseek(psDBF->fp, nRecordOffset, 0) != 0) {
             /* fseek failed on DBF file */
-            return 0;
+            return SHAPEFILE_FALSE;
         }
 
         if (fread(psDBF->pszCurrentRecord, psDBF->nRecordLength, 1, psDBF->fp) != 1) {
             /* fread failed on DBF file */
-            return 0;
+            return SHAPEFILE_FALSE;
         }
 
         psDBF->nCurrentRecord = hEntity;
     }
+    return SHAPEFILE_TRUE;
+}
 
-    pabyRec = (unsigned char *) psDBF->pszCurrentRecord;
 
-    strncpy(psDBF->szStringField, ((const char *) pabyRec) + psDBF->panFieldOffset[iField],
-        psDBF->panFieldSize[iField]);
-    psDBF->szStringField[ psDBF->panFieldSize[iField] ] = '\0';
+/**
+ * Get the bytes of record hEntity: a pointer into the mapping for handles
+ *  from DBFOpenMapped(), else the current record loaded from file.
+ */
+static const char * DBFGetRecord (DBFHandle psDBF, int hEntity)
+{
+    if (psDBF->pszMap) {
+        return psDBF->pszMap + psDBF->nHeaderLength + (size_t) psDBF->nRecordLength * hEntity;
+    }
 
-    pReturnField = psDBF->szStringField;
+    if (!DBFLoadRecord (psDBF, hEntity)) {
+        return 0;
+    }
+    return psDBF->pszCurrentRecord;
+}
+
+
+/**
+ * Read one of the attribute fields of a record
+ */
+static void *DBFReadAttribute (DBFHandle psDBF, int hEntity, int iField, char chReqType)
+{
+    const unsigned char *pabyRec;
+    void          *pReturnField = 0;
+    int           nWidth;
+
+    if (hEntity < 0 || hEntity >= psDBF->nRecords) {
+        return (0);
+    }
+
+    if (iField < 0 || iField >= psDBF->nFields) {
+        return (0);
+    }
+
+    pabyRec = (const unsigned char *) DBFGetRecord (psDBF, hEntity);
+    if (!pabyRec) {
+        return 0;
+    }
 
     if (chReqType == 'N') {
-        psDBF->dDoubleField = atof (psDBF->szStringField);
-        pReturnField = &psDBF->dDoubleField;
+        /* numbers are decoded in place, no copy to szStringField */
+        psDBF->dDoubleField = DBFParseDouble(((const char *) pabyRec) + psDBF->panFieldOffset[iField],
+            psDBF->panFieldSize[iField]);
+        return &psDBF->dDoubleField;
     }
+
+    /* szStringField holds 256 chars, use DBFReadFieldSlice() for wider fields */
+    nWidth = MIN_V2(psDBF->panFieldSize[iField], (int) sizeof(psDBF->szStringField) - 1);
+    strncpy(psDBF->szStringField, ((const char *) pabyRec) + psDBF->panFieldOffset[iField], nWidth);
+    psDBF->szStringField[nWidth] = '\0';
+
+    pReturnField = psDBF->szStringField;
+
 #ifdef TRIM_DBF_WHITESPACE
     /* Should we trim white space off the string attribute value? */
-    else {
+    {
         char *pchSrc, *pchDst;
 
         pchDst = pchSrc = psDBF->szStringField;
@@ -587,41 +898,363 @@ const char * DBFReadLogicalAttribute (DBFHandle psDBF, int iRecord, int iField)
  */
 int DBFIsAttributeNULL (DBFHandle psDBF, int iRecord, int iField)
 {
-    int i;
-    const char  *pszValue = DBFReadStringAttribute (psDBF, iRecord, iField);
-    if (pszValue == 0) {
+    const char *pszRec;
+
+    if (iRecord < 0 || iRecord >= psDBF->nRecords || iField < 0 || iField >= psDBF->nFields) {
         return SHAPEFILE_TRUE;
     }
 
-    switch (psDBF->pachFieldType[iField]) {
-    case 'N':
-    case 'F':
-        /* We accept all asterisks or all blanks as 0 though according to the spec
-     * I think it should be all asterisks
-     */
-        if (pszValue[0] == '*') {
-            return SHAPEFILE_TRUE;
+    pszRec = DBFGetRecord (psDBF, iRecord);
+    if (!pszRec) {
+        return SHAPEFILE_TRUE;
+    }
+
+    return DBFIsCellNULL(psDBF->pachFieldType[iField],
+        pszRec + psDBF->panFieldOffset[iField], psDBF->panFieldSize[iField]);
+}
+
+
+/**
+ * Get the raw bytes of one field without copying.
+ */
+const char * DBFReadFieldSlice (DBFHandle psDBF, int iRecord, int iField, int bTrim, int *pnLen)
+{
+    const char *pszRec, *pchBegin, *pchEnd;
+
+    if (iRecord < 0 || iRecord >= psDBF->nRecords || iField < 0 || iField >= psDBF->nFields) {
+        return (0);
+    }
+
+    pszRec = DBFGetRecord (psDBF, iRecord);
+    if (!pszRec) {
+        return (0);
+    }
+
+    pchBegin = pszRec + psDBF->panFieldOffset[iField];
+    pchEnd = pchBegin + psDBF->panFieldSize[iField];
+
+    if (bTrim) {
+        const char *pch = (const char *) memchr(pchBegin, '\0', pchEnd - pchBegin);
+        if (pch) {
+            pchEnd = pch;
+        }
+        while (pchBegin < pchEnd && *pchBegin == ' ') {
+            pchBegin++;
+        }
+        while (pchEnd > pchBegin && pchEnd[-1] == ' ') {
+            pchEnd--;
+        }
+    }
+
+    if (pnLen) {
+        *pnLen = (int) (pchEnd - pchBegin);
+    }
+    return pchBegin;
+}
+
+
+/**
+ * Get up to nCount consecutive records starting at iFirst with one read,
+ *  or all of them in place if mapped.
+ *  Returns the first record and the number of records in *pnGot.
+ */
+static const char * DBFFetchRecords (DBFHandle psDBF, int iFirst, int nCount, int *pnGot)
+{
+    int nRecs = MAX_V2(DBF_BATCH_WINDOW / psDBF->nRecordLength, 1);
+
+    if (psDBF->pszMap) {
+        *pnGot = nCount;
+        return psDBF->pszMap + psDBF->nHeaderLength + (size_t) psDBF->nRecordLength * iFirst;
+    }
+
+    nRecs = MIN_V2(nRecs, nCount);
+
+    if (psDBF->nBatchSize < nRecs * psDBF->nRecordLength) {
+        psDBF->nBatchSize = nRecs * psDBF->nRecordLength;
+        psDBF->pszBatchRecords = (char *) SfRealloc(psDBF->pszBatchRecords, psDBF->nBatchSize);
+    }
+
+    if (fseek(psDBF->fp, (long) psDBF->nRecordLength * iFirst + psDBF->nHeaderLength, SEEK_SET) != 0) {
+        return 0;
+    }
+
+    if (fread(psDBF->pszBatchRecords, psDBF->nRecordLength, nRecs, psDBF->fp) != (size_t) nRecs) {
+        return 0;
+    }
+
+    *pnGot = nRecs;
+    return psDBF->pszBatchRecords;
+}
+
+
+/**
+ * Decode YYYYMMDD or YYYY-MM-DD to the integer YYYYMMDD, 0 if not a date
+ */
+static int32_t DBFParseDate (const char *pszCell, int nWidth)
+{
+    int i, n = 0, nDigits = 0;
+
+    for (i = 0; i < nWidth && nDigits < 8; i++) {
+        if (pszCell[i] >= '0' && pszCell[i] <= '9') {
+            n = n * 10 + (pszCell[i] - '0');
+            nDigits++;
+        } else if (pszCell[i] != '-' && pszCell[i] != '/' && !(pszCell[i] == ' ' && nDigits == 0)) {
+            return 0;
+        }
+    }
+
+    if (nDigits != 8 || n % 100 == 0 || n % 100 > 31 || (n / 100) % 100 == 0 || (n / 100) % 100 > 12) {
+        return 0;
+    }
+    return n;
+}
+
+
+/**
+ * Copy a cell trimmed of blanks, truncated to nStride-1 chars.
+ *  Returns the string length.
+ */
+static int DBFCopyTrimmed (char *pszDst, int nStride, const char *pszCell, int nWidth)
+{
+    int nLen;
+
+    while (nWidth > 0 && *pszCell == ' ') {
+        pszCell++;
+        nWidth--;
+    }
+
+    nLen = (int) strnlen(pszCell, nWidth);
+    while (nLen > 0 && pszCell[nLen - 1] == ' ') {
+        nLen--;
+    }
+
+    nLen = MIN_V2(nLen, nStride - 1);
+    memcpy(pszDst, pszCell, nLen);
+    pszDst[nLen] = '\0';
+
+    return nLen;
+}
+
+
+/**
+ * Decode selected fields of records [iFirst, iFirst+nCount) into the
+ *  arrays of pColumns. Records are read in batches, and each batch is
+ *  decoded column by column.
+ *
+ * Returns number of records decoded, clipped to the record count, or -1
+ *  on a bad field or an I/O error.
+ */
+int DBFReadColumns (DBFHandle psDBF, int iFirst, int nCount, DBFColumn *pColumns, int nColumns)
+{
+    int iCol, nDone = 0;
+
+    if (iFirst < 0 || nCount < 0 || nColumns < 0 || iFirst > psDBF->nRecords) {
+        return (-1);
+    }
+
+    nCount = MIN_V2(nCount, psDBF->nRecords - iFirst);
+
+    for (iCol = 0; iCol < nColumns; iCol++) {
+        const DBFColumn *pCol = &pColumns[iCol];
+
+        if (pCol->iField < 0 || pCol->iField >= psDBF->nFields || !pCol->pValues) {
+            return (-1);
+        }
+        if (pCol->eType == DBFColString && pCol->nStride < 1) {
+            return (-1);
+        }
+    }
+
+    /* pending edits of the current record must be in the file */
+    if (!DBFFlushRecord(psDBF)) {
+        return (-1);
+    }
+
+    while (nDone < nCount) {
+        int nGot = 0;
+        const char *pszRecords = DBFFetchRecords(psDBF, iFirst + nDone, nCount - nDone, &nGot);
+
+        if (!pszRecords) {
+            return (-1);
         }
 
-        for (i = 0; pszValue[i] != '\0'; i++) {
-            if (pszValue[i] != ' ') {
-                return SHAPEFILE_FALSE;
+        for (iCol = 0; iCol < nColumns; iCol++) {
+            const DBFColumn *pCol = &pColumns[iCol];
+
+            const int nRecLen = psDBF->nRecordLength;
+            const int nWidth = psDBF->panFieldSize[pCol->iField];
+            const char chType = psDBF->pachFieldType[pCol->iField];
+            const char *pszCell = pszRecords + psDBF->panFieldOffset[pCol->iField];
+
+            uint8_t *pabyNulls = pCol->pabyNulls ? pCol->pabyNulls + nDone : 0;
+            int i, bNull;
+
+            switch (pCol->eType) {
+            case DBFColDouble: {
+                double *padfValues = (double *) pCol->pValues + nDone;
+                for (i = 0; i < nGot; i++, pszCell += nRecLen) {
+                    bNull = DBFIsCellNULL(chType, pszCell, nWidth);
+                    padfValues[i] = bNull ? 0.0 : DBFParseDouble(pszCell, nWidth);
+                    if (pabyNulls) {
+                        pabyNulls[i] = (uint8_t) bNull;
+                    }
+                }
+                break;
+            }
+
+            case DBFColInt64: {
+                int64_t *panValues = (int64_t *) pCol->pValues + nDone;
+                for (i = 0; i < nGot; i++, pszCell += nRecLen) {
+                    bNull = DBFIsCellNULL(chType, pszCell, nWidth);
+                    panValues[i] = bNull ? 0 : DBFParseInt64(pszCell, nWidth);
+                    if (pabyNulls) {
+                        pabyNulls[i] = (uint8_t) bNull;
+                    }
+                }
+                break;
+            }
+
+            case DBFColString: {
+                char *pszValues = (char *) pCol->pValues + (size_t) nDone * pCol->nStride;
+                for (i = 0; i < nGot; i++, pszCell += nRecLen, pszValues += pCol->nStride) {
+                    bNull = DBFIsCellNULL(chType, pszCell, nWidth);
+                    if (bNull) {
+                        pszValues[0] = '\0';
+                    } else {
+                        DBFCopyTrimmed(pszValues, pCol->nStride, pszCell, nWidth);
+                    }
+                    if (pabyNulls) {
+                        pabyNulls[i] = (uint8_t) bNull;
+                    }
+                }
+                break;
+            }
+
+            case DBFColDate: {
+                int32_t *panValues = (int32_t *) pCol->pValues + nDone;
+                for (i = 0; i < nGot; i++, pszCell += nRecLen) {
+                    panValues[i] = DBFParseDate(pszCell, nWidth);
+                    if (pabyNulls) {
+                        pabyNulls[i] = (uint8_t) (panValues[i] == 0);
+                    }
+                }
+                break;
+            }
+
+            default:
+                return (-1);
             }
         }
-        return SHAPEFILE_TRUE;
 
-    case 'D':
-        /* 0 date fields have value "00000000" */
-        return strncmp (pszValue,"00000000",8) == 0;
+        nDone += nGot;
+    }
 
-    case 'L':
-        /* 0 boolean fields have value "?" */
-        return pszValue[0] == '?';
+    return nDone;
+}
+
+
+/**
+ * Set up pColumn to decode field iField of up to nBatch records by its
+ *  type: N and F without decimals up to 18 digits as int64, other N and
+ *  F as double, D and S as dates, L as its first non-blank char and any
+ *  other field as a trimmed string. Free with DBFBatchColumnsFree().
+ */
+int DBFBatchColumnInit (DBFHandle psDBF, int iField, DBFColumn *pColumn, int nBatch)
+{
+    int nWidth = 0, nDecimals = 0, nValueSize;
+
+    DBFGetFieldInfo(psDBF, iField, NULL, &nWidth, &nDecimals);
+
+    memset(pColumn, 0, sizeof(DBFColumn));
+    pColumn->iField = iField;
 
+    switch (DBFGetNativeFieldType(psDBF, iField)) {
+    case 'N':
+    case 'F':
+        if (nDecimals > 0 || nWidth > 18) {
+            pColumn->eType = DBFColDouble;
+            nValueSize = sizeof(double);
+        } else {
+            pColumn->eType = DBFColInt64;
+            nValueSize = sizeof(int64_t);
+        }
+        break;
+    case 'D':
+    case 'S':   /* FTDateS: YYYY-MM-DD */
+        pColumn->eType = DBFColDate;
+        nValueSize = sizeof(int32_t);
+        break;
+    case 'L':
+        pColumn->eType = DBFColString;
+        pColumn->nStride = 2;
+        nValueSize = 2;
+        break;
     default:
-        /* empty string fields are considered 0 */
-        return strlen (pszValue) == 0;
+        pColumn->eType = DBFColString;
+        pColumn->nStride = nWidth + 1;
+        nValueSize = nWidth + 1;
+        break;
+    }
+
+    pColumn->pValues = malloc((size_t) nValueSize * nBatch);
+    pColumn->pabyNulls = (uint8_t *) malloc(nBatch);
+
+    if (!pColumn->pValues || !pColumn->pabyNulls) {
+        SafeFree(pColumn->pValues);
+        SafeFree(pColumn->pabyNulls);
+        return SHAPEFILE_FALSE;
     }
+    return SHAPEFILE_TRUE;
+}
+
+
+void DBFBatchColumnsFree (DBFColumn *pColumns, int nColumns)
+{
+    int i;
+
+    for (i = 0; i < nColumns; i++) {
+        SafeFree(pColumns[i].pValues);
+        SafeFree(pColumns[i].pabyNulls);
+    }
+}
+
+
+static int DBFReadColumn (DBFHandle psDBF, int iField, DBFColumnType eType, int nStride,
+    int iFirst, int nCount, void *pValues, uint8_t *pabyNulls)
+{
+    DBFColumn column;
+
+    column.iField = iField;
+    column.eType = eType;
+    column.pValues = pValues;
+    column.nStride = nStride;
+    column.pabyNulls = pabyNulls;
+
+    return DBFReadColumns(psDBF, iFirst, nCount, &column, 1);
+}
+
+
+int DBFReadColumnDouble (DBFHandle psDBF, int iField, int iFirst, int nCount, double *padfValues, uint8_t *pabyNulls)
+{
+    return DBFReadColumn(psDBF, iField, DBFColDouble, 0, iFirst, nCount, padfValues, pabyNulls);
+}
+
+
+int DBFReadColumnInt64 (DBFHandle psDBF, int iField, int iFirst, int nCount, int64_t *panValues, uint8_t *pabyNulls)
+{
+    return DBFReadColumn(psDBF, iField, DBFColInt64, 0, iFirst, nCount, panValues, pabyNulls);
+}
+
+
+int DBFReadColumnString (DBFHandle psDBF, int iField, int iFirst, int nCount, char *pszValues, int nStride, uint8_t *pabyNulls)
+{
+    return DBFReadColumn(psDBF, iField, DBFColString, nStride, iFirst, nCount, pszValues, pabyNulls);
+}
+
+
+int DBFReadColumnDate (DBFHandle psDBF, int iField, int iFirst, int nCount, int32_t *panValues, uint8_t *pabyNulls)
+{
+    return DBFReadColumn(psDBF, iField, DBFColDate, 0, iFirst, nCount, panValues, pabyNulls);
 }
 
 
@@ -728,6 +1361,33 @@ void DBFGetFieldInfo2 (DBFHandle psDBF,  int iField, DBFFieldInfo *pFieldInfo)
 /**
  * Write an attribute record to the file
  */
+/**
+ * Fill a cell with the NULL representation of its field type
+ */
+static void DBFSetCellNULL (char chType, char *pszCell, int nWidth)
+{
+    switch (chType) {
+    case 'N':
+    case 'F':
+        /* 0 numeric fields have value "****************" */
+        memset(pszCell, '*', nWidth);
+        break;
+    case 'D':
+        /* 0 date fields have value "00000000" */
+        memset(pszCell, '0', nWidth);
+        break;
+    case 'L':
+        /* 0 boolean fields have value "?" */
+        memset(pszCell, '?', nWidth);
+        break;
+    default:
+        /* empty string fields are considered 0 */
+        memset(pszCell, '\0', nWidth);
+        break;
+    }
+}
+
+
 static int DBFWriteAttribute (DBFHandle psDBF, int hEntity, int iField, void * pValue)
 {
     int nRecordOffset, i, j, nWidth, SFieldLen, nRetResult = SHAPEFILE_TRUE;
@@ -735,7 +1395,7 @@ static int DBFWriteAttribute (DBFHandle psDBF, int hEntity, int iField, void * p
     char      szSField[400], szFormat[20];
 
     /* Is this a valid record?  */
-    if (hEntity < 0 || hEntity > psDBF->nRecords) {
+    if (hEntity < 0 || hEntity > psDBF->nRecords || psDBF->pszMap) {
         return (SHAPEFILE_FALSE);
     }
 
@@ -745,7 +1405,9 @@ static int DBFWriteAttribute (DBFHandle psDBF, int hEntity, int iField, void * p
 
     /* Is this a brand new record? */
     if (hEntity == psDBF->nRecords) {
-        DBFFlushRecord (psDBF);
+        if (!DBFFlushRecord (psDBF)) {
+            return (SHAPEFILE_FALSE);
+        }
         psDBF->nRecords++;
         for (i = 0; i < psDBF->nRecordLength; i++) {
             psDBF->pszCurrentRecord[i] = ' ';
@@ -755,7 +1417,9 @@ static int DBFWriteAttribute (DBFHandle psDBF, int hEntity, int iField, void * p
 
     /* Is this an existing record, but different than the last one  we accessed? */
     if (psDBF->nCurrentRecord != hEntity) {
-        DBFFlushRecord (psDBF);
+        if (!DBFFlushRecord (psDBF)) {
+            return (SHAPEFILE_FALSE);
+        }
         nRecordOffset = psDBF->nRecordLength * hEntity + psDBF->nHeaderLength;
         fseek(psDBF->fp, nRecordOffset, 0);
         fread(psDBF->pszCurrentRecord, psDBF->nRecordLength, 1, psDBF->fp);
@@ -771,25 +1435,8 @@ static int DBFWriteAttribute (DBFHandle psDBF, int hEntity, int iField, void * p
    *  Contributed by Jim Matthews.
    */
     if (!pValue) {
-        switch (psDBF->pachFieldType[iField]) {
-        case 'N':
-        case 'F':
-            /* 0 numeric fields have value "****************" */
-            memset((char *) (pabyRec+psDBF->panFieldOffset[iField]), '*', psDBF->panFieldSize[iField]);
-            break;
-        case 'D':
-            /* 0 date fields have value "00000000" */
-            memset((char *) (pabyRec+psDBF->panFieldOffset[iField]), '0', psDBF->panFieldSize[iField]);
-            break;
-        case 'L':
-            /* 0 boolean fields have value "?" */
-            memset((char *) (pabyRec+psDBF->panFieldOffset[iField]), '?', psDBF->panFieldSize[iField]);
-            break;
-        default:
-            /* empty string fields are considered 0 */
-            memset((char *) (pabyRec+psDBF->panFieldOffset[iField]), '\0', psDBF->panFieldSize[iField]);
-            break;
-        }
+        DBFSetCellNULL (psDBF->pachFieldType[iField], (char *) (pabyRec+psDBF->panFieldOffset[iField]),
+            psDBF->panFieldSize[iField]);
         return SHAPEFILE_TRUE;
     }
 
@@ -810,7 +1457,8 @@ static int DBFWriteAttribute (DBFHandle psDBF, int hEntity, int iField, void * p
 
             SFieldLen = (int)strnlen(szSField, sizeof(szSField));
             if (SFieldLen > psDBF->panFieldSize[iField]) {
-                szSField[psDBF->panFieldSize[iField]] = '\0';
+                SFieldLen = psDBF->panFieldSize[iField];
+                szSField[SFieldLen] = '\0';
                 nRetResult = SHAPEFILE_FALSE;
             }
             memcpy((char *) (pabyRec+psDBF->panFieldOffset[iField]), szSField, SFieldLen);
@@ -826,7 +1474,8 @@ static int DBFWriteAttribute (DBFHandle psDBF, int hEntity, int iField, void * p
 
             SFieldLen = (int)strnlen(szSField, sizeof(szSField));
             if (SFieldLen > psDBF->panFieldSize[iField]) {
-                szSField[psDBF->panFieldSize[iField]] = '\0';
+                SFieldLen = psDBF->panFieldSize[iField];
+                szSField[SFieldLen] = '\0';
                 nRetResult = SHAPEFILE_FALSE;
             }
             memcpy((char *)(pabyRec + psDBF->panFieldOffset[iField]), szSField, SFieldLen);
@@ -865,7 +1514,7 @@ int DBFWriteAttributeDirectly (DBFHandle psDBF, int hEntity, int iField, void *
     unsigned char *pabyRec;
 
     /* Is this a valid record? */
-    if (hEntity < 0 || hEntity > psDBF->nRecords) {
+    if (hEntity < 0 || hEntity > psDBF->nRecords || psDBF->pszMap) {
         return (SHAPEFILE_FALSE);
     }
 
@@ -875,7 +1524,9 @@ int DBFWriteAttributeDirectly (DBFHandle psDBF, int hEntity, int iField, void *
 
     /* Is this a brand new record? */
     if (hEntity == psDBF->nRecords) {
-        DBFFlushRecord (psDBF);
+        if (!DBFFlushRecord (psDBF)) {
+            return (SHAPEFILE_FALSE);
+        }
         psDBF->nRecords++;
         for (i = 0; i < psDBF->nRecordLength; i++) {
             psDBF->pszCurrentRecord[i] = ' ';
@@ -885,7 +1536,9 @@ int DBFWriteAttributeDirectly (DBFHandle psDBF, int hEntity, int iField, void *
 
     /* Is this an existing record, but different than the last one we accessed? */
     if (psDBF->nCurrentRecord != hEntity) {
-        DBFFlushRecord (psDBF);
+        if (!DBFFlushRecord (psDBF)) {
+            return (SHAPEFILE_FALSE);
+        }
         nRecordOffset = psDBF->nRecordLength * hEntity + psDBF->nHeaderLength;
         fseek(psDBF->fp, nRecordOffset, 0);
         fread(psDBF->pszCurrentRecord, psDBF->nRecordLength, 1, psDBF->fp);
@@ -952,7 +1605,7 @@ int DBFWriteTuple (DBFHandle psDBF, int hEntity, void * pRawTuple)
     unsigned char *pabyRec;
 
     /* Is this a valid record? */
-    if (hEntity < 0 || hEntity > psDBF->nRecords) {
+    if (hEntity < 0 || hEntity > psDBF->nRecords || psDBF->pszMap) {
         return (SHAPEFILE_FALSE);
     }
 
@@ -962,7 +1615,9 @@ int DBFWriteTuple (DBFHandle psDBF, int hEntity, void * pRawTuple)
 
     /* Is this a brand new record? */
     if (hEntity == psDBF->nRecords) {
-        DBFFlushRecord (psDBF);
+        if (!DBFFlushRecord (psDBF)) {
+            return (SHAPEFILE_FALSE);
+        }
         psDBF->nRecords++;
         for (i = 0; i < psDBF->nRecordLength; i++) {
             psDBF->pszCurrentRecord[i] = ' ';
@@ -972,7 +1627,9 @@ int DBFWriteTuple (DBFHandle psDBF, int hEntity, void * pRawTuple)
 
     /* Is this an existing record, but different than the last one we accessed? */
     if (psDBF->nCurrentRecord != hEntity) {
-        DBFFlushRecord (psDBF);
+        if (!DBFFlushRecord (psDBF)) {
+            return (SHAPEFILE_FALSE);
+        }
         nRecordOffset = psDBF->nRecordLength * hEntity + psDBF->nHeaderLength;
         fseek(psDBF->fp, nRecordOffset, 0);
         fread(psDBF->pszCurrentRecord, psDBF->nRecordLength, 1, psDBF->fp);
@@ -987,29 +1644,262 @@ int DBFWriteTuple (DBFHandle psDBF, int hEntity, void * pRawTuple)
 }
 
 
+/**
+ * Right-align nLen chars of pszText in a cell of nWidth. Longer text is
+ *  cut to its first nWidth chars and SHAPEFILE_FALSE returned.
+ */
+static int DBFPutRight (char *pszCell, int nWidth, const char *pszText, int nLen)
+{
+    if (nLen > nWidth) {
+        memcpy(pszCell, pszText, nWidth);
+        return SHAPEFILE_FALSE;
+    }
+
+    memset(pszCell, ' ', nWidth - nLen);
+    memcpy(pszCell + nWidth - nLen, pszText, nLen);
+    return SHAPEFILE_TRUE;
+}
+
+
+/**
+ * Write nValue to a cell like DBFWriteAttribute() does with "%*.*f"
+ */
+static int DBFFormatInt64 (char *pszCell, int nWidth, int64_t nValue, int nDecimals)
+{
+    char   szBuf[320], *pch = szBuf + sizeof(szBuf);
+    int    i;
+
+    /* integral values keep all their digits, only the zeros follow */
+    for (i = 0; i < nDecimals; i++) {
+        *--pch = '0';
+    }
+    if (nDecimals > 0) {
+        *--pch = '.';
+    }
+
+    pch = SHPFormatDigits(pch, nValue < 0 ? 0 - (uint64_t) nValue : (uint64_t) nValue, 0);
+    if (nValue < 0) {
+        *--pch = '-';
+    }
+
+    return DBFPutRight(pszCell, nWidth, pch, (int) (szBuf + sizeof(szBuf) - pch));
+}
+
+
+/**
+ * Write dValue to a cell like DBFWriteAttribute() does with "%*.*f",
+ *  through SHPFormatDouble() so that the point is '.' in any locale.
+ */
+static int DBFFormatDouble (char *pszCell, int nWidth, double dValue, int nDecimals)
+{
+    char   szBuf[400];
+    int    nLen;
+
+    if (nDecimals <= SHP_DECIMALS_MAX) {
+        nLen = SHPFormatDouble(szBuf, dValue, nDecimals);
+    } else {
+        nLen = snprintf(szBuf, sizeof(szBuf), "%.*f", nDecimals, dValue);
+        if (nLen < 0) {
+            return SHAPEFILE_FALSE;
+        }
+    }
+    return DBFPutRight(pszCell, nWidth, szBuf, MIN_V2(nLen, (int) sizeof(szBuf) - 1));
+}
+
+
+/**
+ * Get the cell of iField in the row opened by DBFAppendRow()
+ */
+static char * DBFRowCell (DBFHandle psDBF, int iField)
+{
+    if (psDBF->nAppendRows == 0 || iField < 0 || iField >= psDBF->nFields) {
+        return 0;
+    }
+
+    return psDBF->pszAppendRecords + (size_t) (psDBF->nAppendRows - 1) * psDBF->nRecordLength
+        + psDBF->panFieldOffset[iField];
+}
+
+
+/**
+ * Start a new blank record at the end of the table
+ */
+int DBFAppendRow (DBFHandle psDBF)
+{
+    int nRows;
+
+    if (psDBF->pszMap || psDBF->nRecords == INT_MAX) {
+        return (-1);
+    }
+
+    if (psDBF->bNoHeader) {
+        DBFWriteHeader (psDBF);
+    }
+
+    if (psDBF->nAppendRows == 0) {
+        /* the record being edited goes out first, then is reloaded on access */
+        if (!DBFFlushRecord (psDBF)) {
+            return (-1);
+        }
+        psDBF->nCurrentRecord = -1;
+    }
+
+    nRows = MAX_V2(DBF_APPEND_WINDOW / psDBF->nRecordLength, 1);
+
+    if (psDBF->nAppendRows == nRows) {
+        if (!DBFWritePendingRows (psDBF)) {
+            return (-1);
+        }
+    }
+
+    if (psDBF->nAppendSize < nRows * psDBF->nRecordLength) {
+        char *pszRecords = (char *) SfRealloc(psDBF->pszAppendRecords, nRows * psDBF->nRecordLength);
+        if (!pszRecords) {
+            return (-1);
+        }
+        psDBF->pszAppendRecords = pszRecords;
+        psDBF->nAppendSize = nRows * psDBF->nRecordLength;
+    }
+
+    memset(psDBF->pszAppendRecords + (size_t) psDBF->nAppendRows * psDBF->nRecordLength, ' ', psDBF->nRecordLength);
+    psDBF->nAppendRows++;
+    psDBF->bUpdated = SHAPEFILE_TRUE;
+
+    return psDBF->nRecords++;
+}
+
+
+/**
+ * Set a numeric field of the appended row
+ */
+int DBFSetRowDouble (DBFHandle psDBF, int iField, double dValue)
+{
+    char *pszCell = DBFRowCell (psDBF, iField);
+
+    if (!pszCell) {
+        return SHAPEFILE_FALSE;
+    }
+
+    if (psDBF->panFieldDecimals[iField] == 0) {
+        /* same as DBFWriteDoubleAttribute(): integral part only */
+        if (dValue > -9223372036854775808.0 && dValue < 9223372036854775808.0) {
+            return DBFFormatInt64(pszCell, psDBF->panFieldSize[iField], (int64_t) dValue, 0);
+        }
+        return DBFFormatDouble(pszCell, psDBF->panFieldSize[iField], trunc(dValue), 0);
+    }
+
+    return DBFFormatDouble(pszCell, psDBF->panFieldSize[iField], dValue, psDBF->panFieldDecimals[iField]);
+}
+
+
+/**
+ * Set an integer field of the appended row
+ */
+int DBFSetRowInteger (DBFHandle psDBF, int iField, int64_t nValue)
+{
+    char *pszCell = DBFRowCell (psDBF, iField);
+
+    if (!pszCell) {
+        return SHAPEFILE_FALSE;
+    }
+
+    return DBFFormatInt64(pszCell, psDBF->panFieldSize[iField], nValue, psDBF->panFieldDecimals[iField]);
+}
+
+
+/**
+ * Set a string field of the appended row
+ */
+int DBFSetRowString (DBFHandle psDBF, int iField, const char *pszValue)
+{
+    char *pszCell = DBFRowCell (psDBF, iField);
+    int   nLen;
+
+    if (!pszCell || !pszValue) {
+        return SHAPEFILE_FALSE;
+    }
+
+    /* the row is blank already, longer strings are cut to the width */
+    nLen = (int) strnlen(pszValue, psDBF->panFieldSize[iField] + 1);
+    if (nLen > psDBF->panFieldSize[iField]) {
+        memcpy(pszCell, pszValue, psDBF->panFieldSize[iField]);
+        return SHAPEFILE_FALSE;
+    }
+
+    memcpy(pszCell, pszValue, nLen);
+    return SHAPEFILE_TRUE;
+}
+
+
+/**
+ * Set a logical field of the appended row to 'T' or 'F'
+ */
+int DBFSetRowLogical (DBFHandle psDBF, int iField, char lValue)
+{
+    char *pszCell = DBFRowCell (psDBF, iField);
+
+    if (!pszCell || psDBF->panFieldSize[iField] < 1 || (lValue != 'T' && lValue != 'F')) {
+        return SHAPEFILE_FALSE;
+    }
+
+    *pszCell = lValue;
+    return SHAPEFILE_TRUE;
+}
+
+
+/**
+ * Set a field of the appended row to NULL
+ */
+int DBFSetRowNULL (DBFHandle psDBF, int iField)
+{
+    char *pszCell = DBFRowCell (psDBF, iField);
+
+    if (!pszCell) {
+        return SHAPEFILE_FALSE;
+    }
+
+    DBFSetCellNULL (psDBF->pachFieldType[iField], pszCell, psDBF->panFieldSize[iField]);
+    return SHAPEFILE_TRUE;
+}
+
+
+/**
+ * Write the appended rows and the record count in the header
+ */
+int DBFFlushRows (DBFHandle psDBF)
+{
+    int bSuccess;
+
+    if (psDBF->bNoHeader) {
+        DBFWriteHeader (psDBF);
+    }
+
+    bSuccess = DBFWritePendingRows (psDBF);
+
+    DBFUpdateHeader (psDBF);
+
+    return bSuccess;
+}
+
+
 /**
  * Read one of the attribute fields of a record
  */
 const char * DBFReadTuple (DBFHandle psDBF, int hEntity)
 {
-    int  nRecordOffset;
-    unsigned char  *pabyRec;
+    const char  *pabyRec;
 
     /* Have we read the record? */
     if (hEntity < 0 || hEntity >= psDBF->nRecords) {
         return (0);
     }
 
-    if (psDBF->nCurrentRecord != hEntity) {
-        DBFFlushRecord (psDBF);
-        nRecordOffset = psDBF->nRecordLength * hEntity + psDBF->nHeaderLength;
-        fseek(psDBF->fp, nRecordOffset, 0);
-        fread(psDBF->pszCurrentRecord, psDBF->nRecordLength, 1, psDBF->fp);
-        psDBF->nCurrentRecord = hEntity;
+    pabyRec = DBFGetRecord (psDBF, hEntity);
+    if (!pabyRec || psDBF->pszMap) {
+        /* mapped records are returned in place */
+        return pabyRec;
     }
 
-    pabyRec = (unsigned char *) psDBF->pszCurrentRecord;
-
     if (psDBF->nTupleLen < psDBF->nRecordLength) {
         psDBF->nTupleLen = psDBF->nRecordLength;
         psDBF->pReturnTuple = (char *) SfRealloc (psDBF->pReturnTuple, psDBF->nRecordLength);
@@ -0,0 +1,758 @@
+/******************************************************************************
+ * sbnsearch.c
+ *
+ * v 1.0 2025/12/22
+ *
+ * Project:  Shapelib
+ * Purpose:  Search in ESRI SBN spatial index (.sbn/.sbx)
+ * Author:   Even Rouault, even dot rouault at spatialys.com
+ *
+ ** Last modified: cheungmine
+ *
+ * Copyright (c) 2012-2024, Even Rouault
+ *
+ * This software is available under the following "MIT Style" license,
+ * or at the option of the licensee under the LGPL (see LICENSE.LGPL).  This
+ * option is discussed in more detail in shapelib.html.
+ *
+ * --
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+ * The .sbn file is a binary tree of depth nMaxDepth over the layer extent
+ *  scaled to [0,255]x[0,255], split alternately on x and y. After a 100 byte
+ *  header come the node descriptors (first bin id, shape count) and then the
+ *  bins: each bin holds up to 100 shapes as 8 bytes (minx, miny, maxx, maxy
+ *  in the 0..255 space, and a 1-based big-endian shape id). All ints are MSB.
+ *
+ * Only the .sbn file is needed; the .sbx just lists the bin offsets, which
+ *  are recomputed here when the tree is opened.
+ */
+#include "shapefile_i.h"
+
+
+/* shapes of nodes above this depth are kept in memory once read */
+#define SBN_CACHED_DEPTH_LIMIT  8
+
+/* bins are always limited to 100 shapes */
+#define SBN_BIN_MAX_SHAPES      100
+
+
+typedef struct
+{
+    /* cache of (nShapeCount * 8) bytes of the bins. May be NULL */
+    ub1        *pabyShapeDesc;
+
+    /* index of first bin for this node */
+    int         nBinStart;
+
+    /* number of shapes attached to this node */
+    int         nShapeCount;
+
+    /* number of bins for this node. May be 0 if node is empty */
+    int         nBinCount;
+
+    /* offset in file of the start of the first bin. May be 0 if node is empty */
+    long        nBinOffset;
+
+    /* bounding box of the shapes directly attached to this node once computed.
+     *  This is *not* the theoretical footprint of the node */
+    int         bBBoxInit;
+    int         bMinX;
+    int         bMinY;
+    int         bMaxX;
+    int         bMaxY;
+} SBNNodeDescriptor;
+
+
+typedef struct SBNSearchInfo
+{
+    FILE       *fpSBN;
+    SBNNodeDescriptor *pasNodeDescriptor;
+
+    /* total number of shapes */
+    int         nShapeCount;
+
+    /* tree depth */
+    int         nMaxDepth;
+
+    /* bounding box of all shapes */
+    double      dfMinX;
+    double      dfMaxX;
+    double      dfMinY;
+    double      dfMaxY;
+} SBNSearchInfo;
+
+
+typedef struct
+{
+    SBNSearchHandle hSBN;
+
+    /* search bounding box */
+    int         bMinX;
+    int         bMinY;
+    int         bMaxX;
+    int         bMaxY;
+
+    /* results go either to panShapeId (0 based) or to onSearchShape */
+    int         bCollectIds;
+    int (*onSearchShape)(void *shapeData, void *userParam);
+    void       *userParam;
+    int         bStop;
+
+    int         nShapeCount;
+    int         nShapeAlloc;
+    int        *panShapeId;
+
+    ub1         abyBinShape[8 * SBN_BIN_MAX_SHAPES];
+} SBNSearchStruct;
+
+
+/* associates a node id with the index of its first bin */
+typedef struct
+{
+    int nNodeId;
+    int nBinStart;
+} SBNNodeIdBinStartPair;
+
+
+static int SBNGetMSB32 (const ub1 *p)
+{
+    return (int) (((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3]);
+}
+
+
+/* qsort helper to sort SBNNodeIdBinStartPair by increasing nBinStart */
+static int SBNCompareNodeIdBinStartPairs (const void *a, const void *b)
+{
+    return ((const SBNNodeIdBinStartPair *) a)->nBinStart - ((const SBNNodeIdBinStartPair *) b)->nBinStart;
+}
+
+
+static int SBNCompareInts (const void *a, const void *b)
+{
+    return (*(const int *) a) - (*(const int *) b);
+}
+
+
+/**
+ * Open a .sbn file and read its node descriptors. Bin contents are read
+ *  lazily by the searches.
+ */
+SBNSearchHandle SBNOpenDiskTree (const char *pszSBNFilename)
+{
+    SBNSearchHandle hSBN;
+    ub1 abyHeader[108];
+    ub1 abyBinHeader[8];
+    ub1 *pabyData = 0;
+    SBNNodeIdBinStartPair *pasPairs = 0;
+    int i, nShapeCount, nMaxDepth, nMaxNodes, nNodeDescSize, nNodeDescCount;
+    int nPairs, nExpectedBinId, nIdxInPair, nCurNode;
+
+    hSBN = (SBNSearchHandle) calloc(1, sizeof(SBNSearchInfo));
+    if (!hSBN) {
+        return 0;
+    }
+
+    hSBN->fpSBN = fopen(pszSBNFilename, "rb");
+    if (!hSBN->fpSBN) {
+        free(hSBN);
+        return 0;
+    }
+
+    /* Check file header signature */
+    if (fread(abyHeader, 108, 1, hSBN->fpSBN) != 1 ||
+        abyHeader[0] != 0 || abyHeader[1] != 0 || abyHeader[2] != 0x27 ||
+        (abyHeader[3] != 0x0A && abyHeader[3] != 0x0D) ||
+        abyHeader[4] != 0xFF || abyHeader[5] != 0xFF || abyHeader[6] != 0xFE ||
+        abyHeader[7] != 0x70) {
+        goto error_exit;
+    }
+
+    /* Read shapes bounding box */
+    memcpy(&hSBN->dfMinX, abyHeader + 32, 8);
+    memcpy(&hSBN->dfMinY, abyHeader + 40, 8);
+    memcpy(&hSBN->dfMaxX, abyHeader + 48, 8);
+    memcpy(&hSBN->dfMaxY, abyHeader + 56, 8);
+
+    BO_betoh64_buf(&hSBN->dfMinX);
+    BO_betoh64_buf(&hSBN->dfMinY);
+    BO_betoh64_buf(&hSBN->dfMaxX);
+    BO_betoh64_buf(&hSBN->dfMaxY);
+
+    if (hSBN->dfMinX > hSBN->dfMaxX || hSBN->dfMinY > hSBN->dfMaxY) {
+        goto error_exit;
+    }
+
+    /* Read and check number of shapes */
+    nShapeCount = SBNGetMSB32(abyHeader + 28);
+    hSBN->nShapeCount = nShapeCount;
+    if (nShapeCount < 0 || nShapeCount > 256000000) {
+        goto error_exit;
+    }
+
+    /* Empty spatial index */
+    if (nShapeCount == 0) {
+        return hSBN;
+    }
+
+    /* Tree depth is chosen so that there are not more than 8 shapes per
+     *  node in average, with a minimum depth of 2 and a maximum of 24 */
+    nMaxDepth = 2;
+    while (nMaxDepth < 24 && nShapeCount > ((1 << nMaxDepth) - 1) * 8) {
+        nMaxDepth++;
+    }
+    hSBN->nMaxDepth = nMaxDepth;
+    nMaxNodes = (1 << nMaxDepth) - 1;
+
+    /* Check that the first bin id is 1 */
+    if (SBNGetMSB32(abyHeader + 100) != 1) {
+        goto error_exit;
+    }
+
+    /* Read and check number of node descriptors to be read. There are at
+     *  most (2^nMaxDepth) - 1, but all are not necessary described.
+     *  Non described nodes are empty. Each descriptor is made of 2 ints */
+    nNodeDescSize = SBNGetMSB32(abyHeader + 104);    /* 16-bit words */
+    nNodeDescCount = nNodeDescSize / 4;
+
+    if ((nNodeDescSize % 4) != 0 || nNodeDescCount < 0 || nNodeDescCount > nMaxNodes) {
+        goto error_exit;
+    }
+
+    pabyData = (ub1 *) malloc(nNodeDescCount * 8 + 1);
+    hSBN->pasNodeDescriptor = (SBNNodeDescriptor *) calloc(nMaxNodes, sizeof(SBNNodeDescriptor));
+    pasPairs = (SBNNodeIdBinStartPair *) malloc(nNodeDescCount * sizeof(SBNNodeIdBinStartPair) + 1);
+
+    if (!pabyData || !hSBN->pasNodeDescriptor || !pasPairs) {
+        goto error_exit;
+    }
+
+    /* Read node descriptors */
+    if (nNodeDescCount > 0 && fread(pabyData, nNodeDescCount * 8, 1, hSBN->fpSBN) != 1) {
+        goto error_exit;
+    }
+
+    nPairs = 0;
+
+    for (i = 0; i < nNodeDescCount; i++) {
+        /* Each node descriptor contains the index of the first bin that
+         *  described it, and the number of shapes in this first bin and
+         *  the following bins (in the relevant case) */
+        int nBinStart = SBNGetMSB32(pabyData + 8 * i);
+        int nNodeShapeCount = SBNGetMSB32(pabyData + 8 * i + 4);
+
+        hSBN->pasNodeDescriptor[i].nBinStart = nBinStart > 0 ? nBinStart : 0;
+        hSBN->pasNodeDescriptor[i].nShapeCount = nNodeShapeCount;
+
+        if ((nBinStart > 0 && nNodeShapeCount == 0) || nNodeShapeCount < 0 || nNodeShapeCount > nShapeCount) {
+            goto error_exit;
+        }
+
+        if (nBinStart > 0) {
+            pasPairs[nPairs].nNodeId = i;
+            pasPairs[nPairs].nBinStart = nBinStart;
+            ++nPairs;
+        }
+    }
+
+    SafeFree(pabyData);
+
+    /* All nodes are empty */
+    if (nPairs == 0) {
+        goto error_exit;
+    }
+
+    /* Sort node descriptors by increasing nBinStart. In most cases they
+     *  already are, but not for https://github.com/OSGeo/gdal/issues/9430 */
+    qsort(pasPairs, nPairs, sizeof(SBNNodeIdBinStartPair), SBNCompareNodeIdBinStartPairs);
+
+    /* The first referenced nBinStart should be 2, and all should be distinct */
+    if (pasPairs[0].nBinStart != 2) {
+        goto error_exit;
+    }
+    for (i = 1; i < nPairs; ++i) {
+        if (pasPairs[i].nBinStart == pasPairs[i - 1].nBinStart) {
+            goto error_exit;
+        }
+    }
+
+    nExpectedBinId = 1;
+    nIdxInPair = 0;
+    nCurNode = pasPairs[0].nNodeId;
+
+    hSBN->pasNodeDescriptor[nCurNode].nBinOffset = ftell(hSBN->fpSBN);
+
+    /* Traverse bins to compute the offset of the first bin of each node.
+     *  We could use the .sbx file to compute the offsets instead */
+    while (fread(abyBinHeader, 8, 1, hSBN->fpSBN) == 1) {
+        int nBinId, nBinSize;
+
+        nExpectedBinId++;
+
+        nBinId = SBNGetMSB32(abyBinHeader);
+        nBinSize = SBNGetMSB32(abyBinHeader + 4);    /* 16-bit words */
+
+        if (nBinId != nExpectedBinId) {
+            goto error_exit;
+        }
+
+        /* If there are more than 100 shapes, then they are located in continuous bins */
+        if ((nBinSize % 4) != 0 || nBinSize <= 0 || nBinSize > SBN_BIN_MAX_SHAPES * 4) {
+            goto error_exit;
+        }
+
+        if (nIdxInPair + 1 < nPairs && nBinId == pasPairs[nIdxInPair + 1].nBinStart) {
+            ++nIdxInPair;
+            nCurNode = pasPairs[nIdxInPair].nNodeId;
+            hSBN->pasNodeDescriptor[nCurNode].nBinOffset = ftell(hSBN->fpSBN) - 8;
+        }
+
+        hSBN->pasNodeDescriptor[nCurNode].nBinCount++;
+
+        /* Skip shape description */
+        if (fseek(hSBN->fpSBN, nBinSize * 2, SEEK_CUR) != 0) {
+            goto error_exit;
+        }
+    }
+
+    /* Could not determine nBinOffset / nBinCount for all non-empty nodes */
+    if (nIdxInPair + 1 != nPairs) {
+        goto error_exit;
+    }
+
+    free(pasPairs);
+    return hSBN;
+
+error_exit:
+    SafeFree(pabyData);
+    SafeFree(pasPairs);
+    SBNCloseDiskTree(hSBN);
+    return 0;
+}
+
+
+/**
+ * Close a tree opened by SBNOpenDiskTree()
+ */
+void SBNCloseDiskTree (SBNSearchHandle hSBN)
+{
+    if (!hSBN) {
+        return;
+    }
+
+    if (hSBN->pasNodeDescriptor) {
+        int i, nMaxNodes = (1 << hSBN->nMaxDepth) - 1;
+        for (i = 0; i < nMaxNodes; i++) {
+            SafeFree(hSBN->pasNodeDescriptor[i].pabyShapeDesc);
+        }
+        free(hSBN->pasNodeDescriptor);
+    }
+
+    fclose(hSBN->fpSBN);
+    free(hSBN);
+}
+
+
+/**
+ * Get shape count and extent recorded in the .sbn header
+ */
+void SBNGetInfo (SBNSearchHandle hSBN, int *pnShapeCount, SHPEnvelope *pEnvelope)
+{
+    if (pnShapeCount) {
+        *pnShapeCount = hSBN->nShapeCount;
+    }
+    if (pEnvelope) {
+        pEnvelope->XMin = hSBN->dfMinX;
+        pEnvelope->YMin = hSBN->dfMinY;
+        pEnvelope->XMax = hSBN->dfMaxX;
+        pEnvelope->YMax = hSBN->dfMaxY;
+    }
+}
+
+
+static int SBNAddShapeId (SBNSearchStruct *psSearch, int nShapeId)
+{
+    if (!psSearch->bCollectIds) {
+        psSearch->nShapeCount++;
+        if (psSearch->onSearchShape && ! psSearch->onSearchShape(SHPMBRTreeShapeIdToData(nShapeId), psSearch->userParam)) {
+            psSearch->bStop = SHAPEFILE_TRUE;
+        }
+        return SHAPEFILE_TRUE;
+    }
+
+    if (psSearch->nShapeCount == psSearch->nShapeAlloc) {
+        psSearch->nShapeAlloc = (psSearch->nShapeCount + 100) * 5 / 4;
+        psSearch->panShapeId = (int *) SfRealloc(psSearch->panShapeId, psSearch->nShapeAlloc * sizeof(int));
+    }
+
+    psSearch->panShapeId[psSearch->nShapeCount++] = nShapeId;
+    return SHAPEFILE_TRUE;
+}
+
+
+/* Due to the way integer coordinates are rounded, we can use a strict
+ *  intersection test, except when the node bounding box or the search
+ *  bounding box is degenerated.
+ */
+#define SBN_BB_INTERSECTS(_bMinX, _bMinY, _bMaxX, _bMaxY) \
+    (((bSearchMinX < _bMaxX && bSearchMaxX > _bMinX) || \
+      ((_bMinX == _bMaxX || bSearchMinX == bSearchMaxX) && \
+       bSearchMinX <= _bMaxX && bSearchMaxX >= _bMinX)) && \
+     ((bSearchMinY < _bMaxY && bSearchMaxY > _bMinY) || \
+      ((_bMinY == _bMaxY || bSearchMinY == bSearchMaxY) && \
+       bSearchMinY <= _bMaxY && bSearchMaxY >= _bMinY)))
+
+
+/**
+ * Report the shapes of nShapes 8-byte descriptors that intersect the search box
+ */
+static int SBNSearchShapeDesc (SBNSearchStruct *psSearch, const ub1 *pabyShapeDesc, int nShapes)
+{
+    const int bSearchMinX = psSearch->bMinX;
+    const int bSearchMinY = psSearch->bMinY;
+    const int bSearchMaxX = psSearch->bMaxX;
+    const int bSearchMaxY = psSearch->bMaxY;
+
+    int j;
+
+    for (j = 0; j < nShapes && !psSearch->bStop; j++, pabyShapeDesc += 8) {
+        const int bMinX = pabyShapeDesc[0];
+        const int bMinY = pabyShapeDesc[1];
+        const int bMaxX = pabyShapeDesc[2];
+        const int bMaxY = pabyShapeDesc[3];
+
+        if (SBN_BB_INTERSECTS(bMinX, bMinY, bMaxX, bMaxY)) {
+            /* Caution : we count shape id starting from 0, and not 1 */
+            if (! SBNAddShapeId(psSearch, SBNGetMSB32(pabyShapeDesc + 4) - 1)) {
+                return SHAPEFILE_FALSE;
+            }
+        }
+    }
+    return SHAPEFILE_TRUE;
+}
+
+
+/**
+ * Read the bins of a node from disk (caching them for shallow nodes),
+ *  computing the node bounding box on the way.
+ */
+static int SBNReadNodeBins (SBNSearchStruct *psSearch, SBNNodeDescriptor *psNode, int nDepth)
+{
+    SBNSearchHandle hSBN = psSearch->hSBN;
+    ub1 abyBinHeader[8];
+    int i, j, nShapeCountAcc = 0;
+
+    if (fseek(hSBN->fpSBN, psNode->nBinOffset, SEEK_SET) != 0) {
+        return SHAPEFILE_FALSE;
+    }
+
+    if (nDepth < SBN_CACHED_DEPTH_LIMIT) {
+        psNode->pabyShapeDesc = (ub1 *) malloc(psNode->nShapeCount * 8);
+    }
+
+    for (i = 0; i < psNode->nBinCount; i++) {
+        int nBinSize, nShapes;
+        ub1 *pabyBinShape;
+
+        if (fread(abyBinHeader, 8, 1, hSBN->fpSBN) != 1 ||
+            SBNGetMSB32(abyBinHeader) != psNode->nBinStart + i) {
+            goto error_exit;
+        }
+
+        /* 16-bit words */
+        nBinSize = SBNGetMSB32(abyBinHeader + 4);
+        nShapes = nBinSize / 4;
+
+        if ((nBinSize % 4) != 0 || nShapes <= 0 || nShapes > SBN_BIN_MAX_SHAPES ||
+            nShapeCountAcc + nShapes > psNode->nShapeCount) {
+            goto error_exit;
+        }
+
+        if (psNode->pabyShapeDesc) {
+            pabyBinShape = psNode->pabyShapeDesc + nShapeCountAcc * 8;
+        } else {
+            pabyBinShape = psSearch->abyBinShape;
+        }
+
+        if (fread(pabyBinShape, nBinSize * 2, 1, hSBN->fpSBN) != 1) {
+            goto error_exit;
+        }
+
+        nShapeCountAcc += nShapes;
+
+        if (!psNode->bBBoxInit) {
+            if (i == 0) {
+                psNode->bMinX = pabyBinShape[0];
+                psNode->bMinY = pabyBinShape[1];
+                psNode->bMaxX = pabyBinShape[2];
+                psNode->bMaxY = pabyBinShape[3];
+            }
+
+            for (j = 0; j < nShapes; j++) {
+                const ub1 *p = pabyBinShape + j * 8;
+                psNode->bMinX = MIN_V2(psNode->bMinX, p[0]);
+                psNode->bMinY = MIN_V2(psNode->bMinY, p[1]);
+                psNode->bMaxX = MAX_V2(psNode->bMaxX, p[2]);
+                psNode->bMaxY = MAX_V2(psNode->bMaxY, p[3]);
+            }
+        }
+
+        if (!SBNSearchShapeDesc(psSearch, pabyBinShape, nShapes)) {
+            goto error_exit;
+        }
+
+        if (psSearch->bStop) {
+            /* the rest of the bins is not read, so nothing can be cached */
+            SafeFree(psNode->pabyShapeDesc);
+            return SHAPEFILE_TRUE;
+        }
+    }
+
+    if (nShapeCountAcc != psNode->nShapeCount) {
+        goto error_exit;
+    }
+
+    psNode->bBBoxInit = SHAPEFILE_TRUE;
+    return SHAPEFILE_TRUE;
+
+error_exit:
+    SafeFree(psNode->pabyShapeDesc);
+    return SHAPEFILE_FALSE;
+}
+
+
+static int SBNSearchDiskInternal (SBNSearchStruct *psSearch, int nDepth, int nNodeId,
+    int bNodeMinX, int bNodeMinY, int bNodeMaxX, int bNodeMaxY)
+{
+    const int bSearchMinX = psSearch->bMinX;
+    const int bSearchMinY = psSearch->bMinY;
+    const int bSearchMaxX = psSearch->bMaxX;
+    const int bSearchMaxY = psSearch->bMaxY;
+
+    SBNSearchHandle hSBN = psSearch->hSBN;
+    SBNNodeDescriptor *psNode = &hSBN->pasNodeDescriptor[nNodeId];
+
+    if (psNode->bBBoxInit && !SBN_BB_INTERSECTS(psNode->bMinX, psNode->bMinY, psNode->bMaxX, psNode->bMaxY)) {
+        /* No intersection, then don't try to read the shapes attached to this node */
+    } else if (psNode->pabyShapeDesc) {
+        /* This node contains shapes that are cached */
+        if (!SBNSearchShapeDesc(psSearch, psNode->pabyShapeDesc, psNode->nShapeCount)) {
+            return SHAPEFILE_FALSE;
+        }
+    } else if (psNode->nBinCount > 0) {
+        /* The node has attached shapes that are not (yet) cached */
+        if (!SBNReadNodeBins(psSearch, psNode, nDepth)) {
+            return SHAPEFILE_FALSE;
+        }
+    }
+
+    if (psSearch->bStop) {
+        return SHAPEFILE_TRUE;
+    }
+
+    /* Look up in child nodes */
+    if (nDepth + 1 < hSBN->nMaxDepth) {
+        nNodeId = nNodeId * 2 + 1;
+
+        if ((nDepth % 2) == 0) {
+            /* x split */
+            const int bMid = 1 + (bNodeMinX + bNodeMaxX) / 2;
+
+            if (bSearchMinX <= bMid - 1 &&
+                !SBNSearchDiskInternal(psSearch, nDepth + 1, nNodeId + 1, bNodeMinX, bNodeMinY, bMid - 1, bNodeMaxY)) {
+                return SHAPEFILE_FALSE;
+            }
+            if (!psSearch->bStop && bSearchMaxX >= bMid &&
+                !SBNSearchDiskInternal(psSearch, nDepth + 1, nNodeId, bMid, bNodeMinY, bNodeMaxX, bNodeMaxY)) {
+                return SHAPEFILE_FALSE;
+            }
+        } else {
+            /* y split */
+            const int bMid = 1 + (bNodeMinY + bNodeMaxY) / 2;
+
+            if (bSearchMinY <= bMid - 1 &&
+                !SBNSearchDiskInternal(psSearch, nDepth + 1, nNodeId + 1, bNodeMinX, bNodeMinY, bNodeMaxX, bMid - 1)) {
+                return SHAPEFILE_FALSE;
+            }
+            if (!psSearch->bStop && bSearchMaxY >= bMid &&
+                !SBNSearchDiskInternal(psSearch, nDepth + 1, nNodeId, bNodeMinX, bMid, bNodeMaxX, bNodeMaxY)) {
+                return SHAPEFILE_FALSE;
+            }
+        }
+    }
+
+    return SHAPEFILE_TRUE;
+}
+
+
+/**
+ * Run a search in the [0,255]x[0,255] coordinate space
+ */
+static int SBNSearchRun (SBNSearchStruct *psSearch, int bMinX, int bMinY, int bMaxX, int bMaxY)
+{
+    if (bMinX > bMaxX || bMinY > bMaxY) {
+        return SHAPEFILE_TRUE;
+    }
+
+    if (bMaxX < 0 || bMaxY < 0 || bMinX > 255 || bMinY > 255) {
+        return SHAPEFILE_TRUE;
+    }
+
+    if (psSearch->hSBN->nShapeCount == 0) {
+        return SHAPEFILE_TRUE;
+    }
+
+    psSearch->bMinX = MAX_V2(bMinX, 0);
+    psSearch->bMinY = MAX_V2(bMinY, 0);
+    psSearch->bMaxX = MIN_V2(bMaxX, 255);
+    psSearch->bMaxY = MIN_V2(bMaxY, 255);
+
+    return SBNSearchDiskInternal(psSearch, 0, 0, 0, 0, 255, 255);
+}
+
+
+/**
+ * Scale one search range to the [0,255] coordinate space of the tree
+ */
+static void SBNScaleRange (double dfMin, double dfMax, double dfDiskMin, double dfDiskMax, int *pbMin, int *pbMax)
+{
+    const double dfDiskExtent = dfDiskMax - dfDiskMin;
+
+    if (dfDiskExtent == 0.0) {
+        *pbMin = 0;
+        *pbMax = 255;
+        return;
+    }
+
+    if (dfMin < dfDiskMin) {
+        *pbMin = 0;
+    } else {
+        *pbMin = (int) floor((dfMin - dfDiskMin) / dfDiskExtent * 255.0 - 0.005);
+        *pbMin = MAX_V2(*pbMin, 0);
+    }
+
+    if (dfMax > dfDiskMax) {
+        *pbMax = 255;
+    } else {
+        *pbMax = (int) ceil((dfMax - dfDiskMin) / dfDiskExtent * 255.0 + 0.005);
+        *pbMax = MIN_V2(*pbMax, 255);
+    }
+}
+
+
+/**
+ * Run a search for a real world bounding box. Returns SHAPEFILE_TRUE with
+ *  nothing reported when the box misses the layer extent.
+ */
+static int SBNSearchBounds (SBNSearchStruct *psSearch, double dfMinX, double dfMinY, double dfMaxX, double dfMaxY)
+{
+    SBNSearchHandle hSBN = psSearch->hSBN;
+    int bMinX, bMinY, bMaxX, bMaxY;
+
+    if (dfMinX > dfMaxX || dfMinY > dfMaxY) {
+        return SHAPEFILE_TRUE;
+    }
+
+    if (dfMaxX < hSBN->dfMinX || dfMaxY < hSBN->dfMinY || dfMinX > hSBN->dfMaxX || dfMinY > hSBN->dfMaxY) {
+        return SHAPEFILE_TRUE;
+    }
+
+    SBNScaleRange(dfMinX, dfMaxX, hSBN->dfMinX, hSBN->dfMaxX, &bMinX, &bMaxX);
+    SBNScaleRange(dfMinY, dfMaxY, hSBN->dfMinY, hSBN->dfMaxY, &bMinY, &bMaxY);
+
+    return SBNSearchRun(psSearch, bMinX, bMinY, bMaxX, bMaxY);
+}
+
+
+/**
+ * Finish a list search: sort the ids or drop them on error
+ */
+static int* SBNSearchResult (SBNSearchStruct *psSearch, int bOk, int *pnShapeCount)
+{
+    if (!bOk) {
+        SafeFree(psSearch->panShapeId);
+        *pnShapeCount = 0;
+        return 0;
+    }
+
+    *pnShapeCount = psSearch->nShapeCount;
+
+    if (!psSearch->panShapeId) {
+        /* to distinguish between empty intersection from error case */
+        psSearch->panShapeId = (int *) calloc(1, sizeof(int));
+    } else {
+        qsort(psSearch->panShapeId, psSearch->nShapeCount, sizeof(int), SBNCompareInts);
+    }
+    return psSearch->panShapeId;
+}
+
+
+int* SBNSearchDiskTree (SBNSearchHandle hSBN, const double *padfBoundsMin, const double *padfBoundsMax, int *pnShapeCount)
+{
+    SBNSearchStruct search;
+    int bOk;
+
+    memset(&search, 0, sizeof(search));
+    search.hSBN = hSBN;
+    search.bCollectIds = SHAPEFILE_TRUE;
+
+    bOk = SBNSearchBounds(&search, padfBoundsMin[0], padfBoundsMin[1], padfBoundsMax[0], padfBoundsMax[1]);
+
+    return SBNSearchResult(&search, bOk, pnShapeCount);
+}
+
+
+int* SBNSearchDiskTreeInteger (SBNSearchHandle hSBN, int bMinX, int bMinY, int bMaxX, int bMaxY, int *pnShapeCount)
+{
+    SBNSearchStruct search;
+    int bOk;
+
+    memset(&search, 0, sizeof(search));
+    search.hSBN = hSBN;
+    search.bCollectIds = SHAPEFILE_TRUE;
+
+    bOk = SBNSearchRun(&search, bMinX, bMinY, bMaxX, bMaxY);
+
+    return SBNSearchResult(&search, bOk, pnShapeCount);
+}
+
+
+void SBNSearchFreeIds (int *panShapeId)
+{
+    free(panShapeId);
+}
+
+
+int SBNSearch (SBNSearchHandle hSBN, const SHPEnvelope *searchEnv, int(* onSearchShape)(void * shapeData,  void *userParam), void *userParam)
+{
+    SBNSearchStruct search;
+
+    memset(&search, 0, sizeof(search));
+    search.hSBN = hSBN;
+    search.onSearchShape = onSearchShape;
+    search.userParam = userParam;
+
+    if (!SBNSearchBounds(&search, searchEnv->XMin, searchEnv->YMin, searchEnv->XMax, searchEnv->YMax)) {
+        return (-1);
+    }
+    return search.nShapeCount;
+}
@@ -37,6 +37,13 @@
  *****************************************************************************/
 #include "shapefile_i.h"
 
+#if defined(PLATFORM_WINDOWS)
+# include <io.h>
+#else
+# include <sys/stat.h>
+# include <sys/mman.h>
+#endif
+
 // Shapefile使用大端字节序。小端主机需要字节交换
 
 /**
@@ -60,22 +67,109 @@ void * SfRealloc (void * pMem, int nNewSize)
     }
 }
 
-static void SwapDouble(double *a, double *b)
+
+/**
+ * Map the whole file read-only. Returns NULL if mapping is not possible
+ *   (empty file, no support), caller then keeps using stdio.
+ */
+void * SfMapFile(FILE *fp, size_t *pnSize, int nFlags)
 {
-    double t = *a;
-    *a = *b;
-    *b = t;
+    void *pMap;
+
+#if defined(PLATFORM_WINDOWS)
+    HANDLE hFile, hMapping;
+    LARGE_INTEGER liSize;
+
+    (void) nFlags;
+
+    hFile = (HANDLE) _get_osfhandle(_fileno(fp));
+    if (hFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(hFile, &liSize) || liSize.QuadPart <= 0 ||
+        (ULONGLONG) liSize.QuadPart > (ULONGLONG) SIZE_MAX) {
+        return NULL;
+    }
+
+    hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!hMapping) {
+        return NULL;
+    }
+
+    pMap = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+
+    /* the view holds its own reference to the section */
+    CloseHandle(hMapping);
+    if (!pMap) {
+        return NULL;
+    }
+
+    *pnSize = (size_t) liSize.QuadPart;
+#else
+    struct stat st;
+    int mapFlags = MAP_SHARED;
+
+    if (fstat(fileno(fp), &st) != 0 || st.st_size <= 0 || (uint64_t) st.st_size > (uint64_t) SIZE_MAX) {
+        return NULL;
+    }
+
+# ifdef MAP_POPULATE
+    if (nFlags & SHP_MAP_POPULATE) {
+        mapFlags |= MAP_POPULATE;
+    }
+# endif
+
+    pMap = mmap(NULL, (size_t) st.st_size, PROT_READ, mapFlags, fileno(fp), 0);
+    if (pMap == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (nFlags & SHP_MAP_RANDOM) {
+        posix_madvise(pMap, (size_t) st.st_size, POSIX_MADV_RANDOM);
+    } else if (nFlags & SHP_MAP_SEQUENTIAL) {
+        posix_madvise(pMap, (size_t) st.st_size, POSIX_MADV_SEQUENTIAL);
+    }
+# ifndef MAP_POPULATE
+    if (nFlags & SHP_MAP_POPULATE) {
+        posix_madvise(pMap, (size_t) st.st_size, POSIX_MADV_WILLNEED);
+    }
+# endif
+
+    *pnSize = (size_t) st.st_size;
+#endif
+
+    return pMap;
 }
 
-static void SwapPointType(SHPPointType *p, SHPPointType *q)
+
+/**
+ * Release a mapping created by SfMapFile
+ */
+void SfUnmapFile(void *pMap, size_t nSize)
 {
-    double t = p->x;
-    p->x = q->x;
-    q->x = t;
+    if (pMap) {
+#if defined(PLATFORM_WINDOWS)
+        (void) nSize;
+        UnmapViewOfFile(pMap);
+#else
+        munmap(pMap, nSize);
+#endif
+    }
+}
 
-    t = p->y;
-    p->y = q->y;
-    q->y = t;
+
+/**
+ * Size in bytes of an open file, 0 on error.
+ */
+static uint64_t SfFileSize(FILE *fp)
+{
+#if defined(PLATFORM_WINDOWS)
+    __int64 nSize = _filelengthi64(_fileno(fp));
+    return (nSize > 0) ? (uint64_t) nSize : 0;
+#else
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0 || st.st_size <= 0) {
+        return 0;
+    }
+    return (uint64_t) st.st_size;
+#endif
 }
 
 static int SHPTypeHasParts(int nSHPType)
@@ -236,6 +330,40 @@ static void SHPHasZM(int nSHPType, int *bHasZ, int *bHasM)
 }
 
 
+void SHPCoordSeqOfObject(SHPCoordSeq *psSeq, const SHPObject *psObject)
+{
+    int HasZ, HasM;
+    SHPHasZM(psObject->nSHPType, &HasZ, &HasM);
+
+    psSeq->nSHPType = psObject->nSHPType;
+    psSeq->nParts = psObject->nParts;
+    psSeq->panPartStart = psObject->panPartStart;
+    psSeq->nVertices = psObject->nVertices;
+    psSeq->padfX = psObject->padfX;
+    psSeq->padfY = psObject->padfY;
+    psSeq->nStride = SHPCOORDS_SOA;
+    psSeq->padfZ = HasZ ? psObject->padfZ : NULL;
+    psSeq->padfM = HasM ? psObject->padfM : NULL;
+}
+
+
+void SHPCoordSeqOfObjectEx(SHPCoordSeq *psSeq, const SHPObjectEx *psObject)
+{
+    int HasZ, HasM;
+    SHPHasZM(psObject->nSHPType, &HasZ, &HasM);
+
+    psSeq->nSHPType = psObject->nSHPType;
+    psSeq->nParts = psObject->nParts;
+    psSeq->panPartStart = psObject->panPartStart;
+    psSeq->nVertices = psObject->nVertices;
+    psSeq->padfX = SHPPointsX(psObject);
+    psSeq->padfY = SHPPointsY(psObject);
+    psSeq->nStride = SHPCOORDS_AOS;
+    psSeq->padfZ = HasZ ? psObject->padfZ : NULL;
+    psSeq->padfM = HasM ? psObject->padfM : NULL;
+}
+
+
 /**
  * Open the .shp and .shx files based on the basename of the files or either file name
  */
@@ -245,7 +373,9 @@ SHPHandle SHPOpen(const char * pszLayer, const char * pszAccess)
     SHPHandle  psSHP;
 
     ub1       *pabyBuf;
-    int        i, nOffset, nLength;
+    int        i;
+    uint32_t   nOffset, nLength;
+    uint64_t   nSHPSize;
     double     dValue;
 
     /* Ensure the access string is one of the legal ones.
@@ -399,6 +529,8 @@ SHPHandle SHPOpen(const char * pszLayer, const char * pszAccess)
         return (0);
     }
 
+    nSHPSize = SfFileSize(psSHP->fpSHP);
+
     for (i = 0; i < psSHP->nRecords; i++) {
         memcpy(&nOffset, pabyBuf + i * 8, 4);
         BO_betoh32_buf(&nOffset);  // be
@@ -406,6 +538,17 @@ SHPHandle SHPOpen(const char * pszLayer, const char * pszAccess)
         memcpy(&nLength, pabyBuf + i * 8 + 4, 4);
         BO_betoh32_buf(&nLength);  // be
 
+        /* record buffers are sized from these: refuse records past the .shp */
+        if ((uint64_t) nOffset * 2 + (uint64_t) nLength * 2 + 8 > nSHPSize) {
+            fclose(psSHP->fpSHP);
+            fclose(psSHP->fpSHX);
+            SafeFree(psSHP->panRecOffset);
+            SafeFree(psSHP->panRecSize);
+            SafeFree(pabyBuf);
+            SafeFree(psSHP);
+            return (0);
+        }
+
         psSHP->panRecOffset[i] = nOffset * 2;
         psSHP->panRecSize[i] = nLength * 2;
     }
@@ -415,6 +558,28 @@ SHPHandle SHPOpen(const char * pszLayer, const char * pszAccess)
 }
 
 
+/**
+ * Open the shapefile read-only and map the .shp into memory.
+ *   The .shx is decoded into panRecOffset/panRecSize by SHPOpen() as usual,
+ *   all record reads are then served from the mapping without copying.
+ */
+SHPHandle SHPOpenMapped(const char * pszLayer, int nFlags)
+{
+    SHPHandle psSHP = SHPOpen(pszLayer, "rb");
+    if (!psSHP) {
+        return (0);
+    }
+
+    psSHP->pabySHPMap = (ub1 *) SfMapFile(psSHP->fpSHP, &psSHP->nSHPMapSize, nFlags);
+    if (!psSHP->pabySHPMap) {
+        SHPClose(psSHP);
+        return (0);
+    }
+
+    return(psSHP);
+}
+
+
 /**
  * Close the .shp and .shx files
  */
@@ -430,6 +595,7 @@ void SHPClose(SHPHandle psSHP)
     /* Free all resources, and close files */
     SafeFree(psSHP->panRecOffset);
     SafeFree(psSHP->panRecSize);
+    SfUnmapFile(psSHP->pabySHPMap, psSHP->nSHPMapSize);
     fclose(psSHP->fpSHX);
     fclose(psSHP->fpSHP);
 
@@ -660,41 +826,53 @@ static void _SHPSetBounds(ub1 * pabyRec, SHPObject * psShape)
  */
 void SHPComputeExtents(SHPObject * psObject)
 {
+    SHPCoordSeq seq;
+    double adfMin[2], adfMax[2];
+
     /* A shape with no vertices has no meaningful extents. */
     if (psObject->nVertices < 1) {
         return;
     }
 
-    /* Initialize extents with the first vertex */
-    psObject->dfXMin = psObject->dfXMax = psObject->padfX[0];
-    psObject->dfYMin = psObject->dfYMax = psObject->padfY[0];
+    SHPCoordSeqOfObject(&seq, psObject);
+    SHPSimdBoundsOf(&seq, 0, seq.nVertices, adfMin, adfMax);
 
-    /* Initialize Z and M extents only if the respective arrays exist */
+    psObject->dfXMin = adfMin[0];
+    psObject->dfYMin = adfMin[1];
+    psObject->dfXMax = adfMax[0];
+    psObject->dfYMax = adfMax[1];
+
+    /* Z and M extents only if the respective arrays exist */
     if (psObject->padfZ) {
-        psObject->dfZMin = psObject->dfZMax = psObject->padfZ[0];
+        SHPSimdRangeOf(psObject->padfZ, psObject->nVertices, &psObject->dfZMin, &psObject->dfZMax);
     }
     if (psObject->padfM) {
-        psObject->dfMMin = psObject->dfMMax = psObject->padfM[0];
+        SHPSimdRangeOf(psObject->padfM, psObject->nVertices, &psObject->dfMMin, &psObject->dfMMax);
+    }
+}
+
+void SHPComputeExtentsEx(SHPObjectEx * psObject)
+{
+    SHPCoordSeq seq;
+    double adfMin[2], adfMax[2];
+
+    if (psObject->nVertices < 1) {
+        return;
     }
 
-    /* Loop from the second vertex to find the true min/max */
-    for (int i = 1; i < psObject->nVertices; i++) {
-        psObject->dfXMin = MIN_V2(psObject->dfXMin, psObject->padfX[i]);
-        psObject->dfYMin = MIN_V2(psObject->dfYMin, psObject->padfY[i]);
-        psObject->dfXMax = MAX_V2(psObject->dfXMax, psObject->padfX[i]);
-        psObject->dfYMax = MAX_V2(psObject->dfYMax, psObject->padfY[i]);
+    SHPCoordSeqOfObjectEx(&seq, psObject);
+    SHPSimdBoundsOf(&seq, 0, seq.nVertices, adfMin, adfMax);
 
-        /* Update Z extents only if Z values are present */
-        if (psObject->padfZ) {
-            psObject->dfZMin = MIN_V2(psObject->dfZMin, psObject->padfZ[i]);
-            psObject->dfZMax = MAX_V2(psObject->dfZMax, psObject->padfZ[i]);
-        }
+    psObject->dfXMin = adfMin[0];
+    psObject->dfYMin = adfMin[1];
+    psObject->dfXMax = adfMax[0];
+    psObject->dfYMax = adfMax[1];
 
-        /* Update M extents only if M values are present */
-        if (psObject->padfM) {
-            psObject->dfMMin = MIN_V2(psObject->dfMMin, psObject->padfM[i]);
-            psObject->dfMMax = MAX_V2(psObject->dfMMax, psObject->padfM[i]);
-        }
+    if (psObject->padfZ) {
+        SHPSimdRangeOf(psObject->padfZ, psObject->nVertices, &psObject->dfZMin, &psObject->dfZMax);
+    }
+    if (psObject->padfM) {
+        SHPSimdRangeOf(psObject->padfM, psObject->nVertices, &psObject->dfMMin, &psObject->dfMMax);
     }
 }
 
@@ -965,216 +1143,267 @@ SHPObject * SHPCreateSimpleObject (
 }
 
 /**
- * Write out the vertices of a new structure
- *  Note that it is only possible to write vertices at the end of the file
+ * Size in bytes of the .shp record (8 byte header included) for psObject,
+ *  or -1 if it does not fit in a record.
  */
-int SHPWriteObject(SHPHandle psSHP, int nShapeId, SHPObject * psObject)
+static int SHPObjectRecordSize(const SHPObject * psObject)
 {
-    ub1   *pabyRec;
-    int    i32;
-    int    nRecordOffset, i, nRecordSize = 0;
+    int64_t nSize, nParts = psObject->nParts, nPoints = psObject->nVertices;
 
-    psSHP->bUpdated = SHAPEFILE_TRUE;
+    switch (psObject->nSHPType) {
+    case SHPT_POLYGON:
+    case SHPT_ARC:
+        nSize = 52 + 4 * nParts + 16 * nPoints;
+        break;
 
-    /* Ensure that shape object matches the type of the file it is being written to */
-    SHAPEFILE_ASSERT(psObject->nSHPType == psSHP->nShapeType || psObject->nSHPType == SHPT_NULL);
+    case SHPT_POLYGONM:
+    case SHPT_ARCM:
+        nSize = 52 + 4 * nParts + 16 * nPoints + 16 + 8 * nPoints;
+        break;
 
-    /* Either blow an assertion, or if they are disabled, set the shapeid to -1 for appends */
-    SHAPEFILE_ASSERT(nShapeId == -1 || (nShapeId >= 0 && nShapeId < psSHP->nRecords));
+    case SHPT_POLYGONZ:
+    case SHPT_ARCZ:
+        nSize = 52 + 4 * nParts + 16 * nPoints + 2 * (16 + 8 * nPoints);
+        break;
 
-    if (nShapeId != -1 && nShapeId >= psSHP->nRecords) {
-        nShapeId = -1;
+    case SHPT_MULTIPATCH:
+        nSize = 52 + 8 * nParts + 16 * nPoints + 16 + 8 * nPoints;
+#ifndef DISABLE_MULTIPATCH_MEASURE
+        nSize += 16 + 8 * nPoints;
+#endif
+        break;
+
+    case SHPT_MULTIPOINT:
+        nSize = 48 + 16 * nPoints;
+        break;
+
+    case SHPT_MULTIPOINTM:
+        nSize = 48 + 16 * nPoints + 16 + 8 * nPoints;
+        break;
+
+    case SHPT_MULTIPOINTZ:
+        nSize = 48 + 16 * nPoints + 2 * (16 + 8 * nPoints);
+        break;
+
+    case SHPT_POINT:
+        nSize = 28;
+        break;
+
+    case SHPT_POINTM:
+        nSize = 36;
+        break;
+
+    case SHPT_POINTZ:
+        nSize = 44;
+        break;
+
+    case SHPT_NULL:
+        nSize = 12;
+        break;
+
+    default:
+        /* unknown type */
+        return -1;
     }
 
-    /* Add the new entity to the in memory index */
-    if (nShapeId == -1 && psSHP->nRecords+1 > psSHP->nMaxRecords) {
-        psSHP->nMaxRecords =(uint32_t) (psSHP->nMaxRecords * 1.3 + 100);
-        psSHP->panRecOffset = (uint32_t *) SfRealloc(psSHP->panRecOffset, sizeof(uint32_t) * psSHP->nMaxRecords);
-        psSHP->panRecSize = (uint32_t *) SfRealloc(psSHP->panRecSize, sizeof(uint32_t) * psSHP->nMaxRecords);
+    if (nParts < 0 || nPoints < 0 || nSize > INT_MAX) {
+        return -1;
     }
+    return (int) nSize;
+}
 
-    /* Initialize record */
-    pabyRec = (ub1 *) malloc(psObject->nVertices * 4 * sizeof(double) + psObject->nParts * 8 + 128);
 
-    /* Extract vertices for a Polygon or Arc */
-    if (psObject->nSHPType == SHPT_POLYGON ||
-        psObject->nSHPType == SHPT_POLYGONZ ||
-        psObject->nSHPType == SHPT_POLYGONM ||
-        psObject->nSHPType == SHPT_ARC ||
-        psObject->nSHPType == SHPT_ARCZ ||
-        psObject->nSHPType == SHPT_ARCM ||
-        psObject->nSHPType == SHPT_MULTIPATCH) {
-        int32_t  i, nPoints, nParts;
-        nPoints = psObject->nVertices;
-        nParts = psObject->nParts;
+/**
+ * Copy nCount doubles little-endian to pabyDst
+ */
+static ub1 * SHPPutDoubles(ub1 *pabyDst, const double *padfSrc, int nCount)
+{
+    int i;
 
-        _SHPSetBounds(pabyRec + 12, psObject);
+    ByteCopy(padfSrc, pabyDst, 8 * nCount);
+    for (i = 0; i < nCount; i++) {
+        BO_htole64_buf(pabyDst + 8 * i);
+    }
+    return pabyDst + 8 * nCount;
+}
 
-        BO_htole32_buf(&nPoints);
-        BO_htole32_buf(&nParts);
 
-        ByteCopy(&nPoints, pabyRec + 40 + 8, 4);
-        ByteCopy(&nParts, pabyRec + 36 + 8, 4);
+/**
+ * Copy x,y of nCount vertices interleaved little-endian to pabyDst
+ */
+static ub1 * SHPPutXYs(ub1 *pabyDst, const double *padfX, const double *padfY, int nCount)
+{
+    int i;
 
-        nRecordSize = 52;
+    for (i = 0; i < nCount; i++) {
+        ByteCopy(padfX + i, pabyDst, 8);
+        ByteCopy(padfY + i, pabyDst + 8, 8);
+        BO_htole64_buf(pabyDst);
+        BO_htole64_buf(pabyDst + 8);
+        pabyDst += 16;
+    }
+    return pabyDst;
+}
 
-        /* Write part start positions */
-        ByteCopy(psObject->panPartStart, pabyRec + 44 + 8, 4 * psObject->nParts);
 
-        for (int i = 0; i < psObject->nParts; i++) {
-            BO_htole32_buf(pabyRec + 44 + 8 + 4*i);
-            nRecordSize += 4;
-        }
+/**
+ * Copy nCount ints little-endian to pabyDst
+ */
+static ub1 * SHPPutInts(ub1 *pabyDst, const int *panSrc, int nCount)
+{
+    int i;
 
-        /* Write part types */
-        ByteCopy(psObject->panPartType, pabyRec + 44 + 8 + 4 * psObject->nParts, 4 * psObject->nParts);
+    ByteCopy(panSrc, pabyDst, 4 * nCount);
+    for (i = 0; i < nCount; i++) {
+        BO_htole32_buf(pabyDst + 4 * i);
+    }
+    return pabyDst + 4 * nCount;
+}
 
-        /* Write multipatch part types if needed */
-        if (psObject->nSHPType == SHPT_MULTIPATCH) {
-            memcpy(pabyRec + nRecordSize, psObject->panPartType, 4*psObject->nParts);
 
-            for (i = 0; i < psObject->nParts; i++) {
-                BO_htole32_buf(pabyRec + nRecordSize);
-                nRecordSize += 4;
-            }
-        }
+/**
+ * Copy min, max and the nCount values of one measure (z or m) to pabyDst
+ */
+static ub1 * SHPPutRange(ub1 *pabyDst, double dfMin, double dfMax, const double *padfSrc, int nCount)
+{
+    pabyDst = SHPPutDoubles(pabyDst, &dfMin, 1);
+    pabyDst = SHPPutDoubles(pabyDst, &dfMax, 1);
+    return SHPPutDoubles(pabyDst, padfSrc, nCount);
+}
 
-        /* Write the (x,y) vertex values */
-        for (i = 0; i < psObject->nVertices; i++) {
-            ByteCopy(psObject->padfX + i, pabyRec + nRecordSize, 8);
-            ByteCopy(psObject->padfY + i, pabyRec + nRecordSize + 8, 8);
-            BO_htole64_buf(pabyRec + nRecordSize);
-            BO_htole64_buf(pabyRec + nRecordSize + 8);
-            nRecordSize += 2 * 8;
-        }
 
-        /* Write the Z coordinates (if any) */
-        if (psObject->nSHPType == SHPT_POLYGONZ ||
-            psObject->nSHPType == SHPT_ARCZ ||
-            psObject->nSHPType == SHPT_MULTIPATCH) {
-            ByteCopy(&(psObject->dfZMin), pabyRec + nRecordSize, 8);
-            BO_htole64_buf(pabyRec + nRecordSize);
+/**
+ * Encode psObject as record nShapeId into pabyRec, which must hold
+ *  SHPObjectRecordSize() bytes. Returns the record size.
+ */
+static int SHPSerializeObject(const SHPObject * psObject, int nShapeId, ub1 * pabyRec)
+{
+    int32_t  i32;
+    int      nType = psObject->nSHPType, nPoints = psObject->nVertices;
+    ub1     *pabyOut = pabyRec + 12;
 
-            nRecordSize += 8;
+    if (nType == SHPT_POLYGON || nType == SHPT_POLYGONZ || nType == SHPT_POLYGONM ||
+        nType == SHPT_ARC || nType == SHPT_ARCZ || nType == SHPT_ARCM || nType == SHPT_MULTIPATCH) {
+        /* bounds, part and vertex counts, part starts (and types) then x,y */
+        _SHPSetBounds(pabyOut, (SHPObject *) psObject);
 
-            ByteCopy(&(psObject->dfZMax), pabyRec + nRecordSize, 8);
-            BO_htole64_buf(pabyRec + nRecordSize);
+        pabyOut = SHPPutInts(pabyOut + 32, &psObject->nParts, 1);
+        pabyOut = SHPPutInts(pabyOut, &nPoints, 1);
+        pabyOut = SHPPutInts(pabyOut, psObject->panPartStart, psObject->nParts);
 
-            nRecordSize += 8;
+        if (nType == SHPT_MULTIPATCH) {
+            pabyOut = SHPPutInts(pabyOut, psObject->panPartType, psObject->nParts);
+        }
 
-            for (i = 0; i < psObject->nVertices; i++) {
-                ByteCopy(psObject->padfZ + i, pabyRec + nRecordSize, 8);
-                BO_htole64_buf(pabyRec + nRecordSize);
-                nRecordSize += 8;
-            }
+        pabyOut = SHPPutXYs(pabyOut, psObject->padfX, psObject->padfY, nPoints);
+
+        if (nType == SHPT_POLYGONZ || nType == SHPT_ARCZ || nType == SHPT_MULTIPATCH) {
+            pabyOut = SHPPutRange(pabyOut, psObject->dfZMin, psObject->dfZMax, psObject->padfZ, nPoints);
         }
 
-        /* Write the M values, if any */
-        if (psObject->nSHPType == SHPT_POLYGONM || psObject->nSHPType == SHPT_ARCM
+        if (nType == SHPT_POLYGONM || nType == SHPT_ARCM
 #ifndef DISABLE_MULTIPATCH_MEASURE
-            || psObject->nSHPType == SHPT_MULTIPATCH
+            || nType == SHPT_MULTIPATCH
 #endif
-            || psObject->nSHPType == SHPT_POLYGONZ || psObject->nSHPType == SHPT_ARCZ) {
+            || nType == SHPT_POLYGONZ || nType == SHPT_ARCZ) {
+            pabyOut = SHPPutRange(pabyOut, psObject->dfMMin, psObject->dfMMax, psObject->padfM, nPoints);
+        }
+    } else if (nType == SHPT_MULTIPOINT || nType == SHPT_MULTIPOINTZ || nType == SHPT_MULTIPOINTM) {
+        _SHPSetBounds(pabyOut, (SHPObject *) psObject);
 
-            ByteCopy(&(psObject->dfMMin), pabyRec + nRecordSize, 8);
-            BO_htole64_buf(pabyRec + nRecordSize);
+        pabyOut = SHPPutInts(pabyOut + 32, &nPoints, 1);
+        pabyOut = SHPPutXYs(pabyOut, psObject->padfX, psObject->padfY, nPoints);
 
-            nRecordSize += 8;
+        if (nType == SHPT_MULTIPOINTZ) {
+            pabyOut = SHPPutRange(pabyOut, psObject->dfZMin, psObject->dfZMax, psObject->padfZ, nPoints);
+        }
 
-            ByteCopy(&(psObject->dfMMax), pabyRec + nRecordSize, 8);
-            BO_htole64_buf(pabyRec + nRecordSize);
+        if (nType == SHPT_MULTIPOINTZ || nType == SHPT_MULTIPOINTM) {
+            pabyOut = SHPPutRange(pabyOut, psObject->dfMMin, psObject->dfMMax, psObject->padfM, nPoints);
+        }
+    } else if (nType == SHPT_POINT || nType == SHPT_POINTZ || nType == SHPT_POINTM) {
+        pabyOut = SHPPutXYs(pabyOut, psObject->padfX, psObject->padfY, 1);
 
-            nRecordSize += 8;
+        if (nType == SHPT_POINTZ) {
+            pabyOut = SHPPutDoubles(pabyOut, psObject->padfZ, 1);
+        }
 
-            for (i = 0; i < psObject->nVertices; i++) {
-                ByteCopy(psObject->padfM + i, pabyRec + nRecordSize, 8);
-                BO_htole64_buf(pabyRec + nRecordSize);
-                nRecordSize += 8;
-            }
+        if (nType == SHPT_POINTZ || nType == SHPT_POINTM) {
+            pabyOut = SHPPutDoubles(pabyOut, psObject->padfM, 1);
         }
-    } else if (psObject->nSHPType == SHPT_MULTIPOINT ||
-        psObject->nSHPType == SHPT_MULTIPOINTZ ||
-        psObject->nSHPType == SHPT_MULTIPOINTM) {
-        /* Extract vertices for a MultiPoint */
-        int i, nPoints;
+    }
 
-        nPoints = psObject->nVertices;
+    /* record number and content length (16-bit words) are big-endian */
+    i32 = nShapeId + 1;
+    ByteCopy(&i32, pabyRec, 4);
+    BO_htobe32_buf(pabyRec);
 
-        _SHPSetBounds(pabyRec + 12, psObject);
+    i32 = (int32_t) ((pabyOut - pabyRec - 8) / 2);
+    ByteCopy(&i32, pabyRec + 4, 4);
+    BO_htobe32_buf(pabyRec + 4);
 
-        BO_htole32_buf(&nPoints);
-        ByteCopy(&nPoints, pabyRec + 44, 4);
+    /* shape type is little-endian */
+    ByteCopy(&nType, pabyRec + 8, 4);
+    BO_htole32_buf(pabyRec + 8);
 
-        for (i = 0; i < psObject->nVertices; i++) {
-            ByteCopy(psObject->padfX + i, pabyRec + 48 + i*16, 8);
-            ByteCopy(psObject->padfY + i, pabyRec + 48 + i*16 + 8, 8);
-            BO_htole64_buf(pabyRec + 48 + i*16);
-            BO_htole64_buf(pabyRec + 48 + i*16 + 8);
-        }
+    return (int) (pabyOut - pabyRec);
+}
 
-        nRecordSize = 48 + 16 * psObject->nVertices;
 
-        if (psObject->nSHPType == SHPT_MULTIPOINTZ) {
+/**
+ * Write out the vertices of a new structure
+ *  Note that it is only possible to write vertices at the end of the file
+ */
+int SHPWriteObject(SHPHandle psSHP, int nShapeId, SHPObject * psObject)
+{
+    int    nRecordOffset, i, nRecordSize;
 
-            ByteCopy(&(psObject->dfZMin), pabyRec + nRecordSize, 8);
-            BO_htole64_buf(pabyRec + nRecordSize);
-            nRecordSize += 8;
+    psSHP->bUpdated = SHAPEFILE_TRUE;
 
-            ByteCopy(&(psObject->dfZMax), pabyRec + nRecordSize, 8);
-            BO_htole64_buf(pabyRec + nRecordSize);
-            nRecordSize += 8;
+    /* Ensure that shape object matches the type of the file it is being written to */
+    SHAPEFILE_ASSERT(psObject->nSHPType == psSHP->nShapeType || psObject->nSHPType == SHPT_NULL);
 
-            for (i = 0; i < psObject->nVertices; i++) {
-                ByteCopy(psObject->padfZ + i, pabyRec + nRecordSize, 8);
-                BO_htole64_buf(pabyRec + nRecordSize);
-                nRecordSize += 8;
-            }
-        }
+    /* Either blow an assertion, or if they are disabled, set the shapeid to -1 for appends */
+    SHAPEFILE_ASSERT(nShapeId == -1 || (nShapeId >= 0 && nShapeId < psSHP->nRecords));
 
-        if (psObject->nSHPType == SHPT_MULTIPOINTZ || psObject->nSHPType == SHPT_MULTIPOINTM) {
-            ByteCopy(&(psObject->dfMMin), pabyRec + nRecordSize, 8);
-            BO_htole64_buf(pabyRec + nRecordSize);
-            nRecordSize += 8;
+    if (nShapeId != -1 && nShapeId >= psSHP->nRecords) {
+        nShapeId = -1;
+    }
 
-            ByteCopy(&(psObject->dfMMax), pabyRec + nRecordSize, 8);
-            BO_htole64_buf(pabyRec + nRecordSize);
-            nRecordSize += 8;
+    nRecordSize = SHPObjectRecordSize(psObject);
+    if (nRecordSize < 0) {
+        /* unknown type */
+        SHAPEFILE_ASSERT(SHAPEFILE_FALSE);
+        return -1;
+    }
 
-            for (i = 0; i < psObject->nVertices; i++) {
-                ByteCopy(psObject->padfM + i, pabyRec + nRecordSize, 8);
-                BO_htole64_buf(pabyRec + nRecordSize);
-                nRecordSize += 8;
-            }
+    /* Grow the reusable record buffer before anything is changed */
+    if (nRecordSize > psSHP->nBufSize) {
+        ub1 *pabyRec = (ub1 *) realloc(psSHP->pabyRec, (size_t) nRecordSize);
+        if (!pabyRec) {
+            return -1;
         }
-    } else if (psObject->nSHPType == SHPT_POINT ||
-        psObject->nSHPType == SHPT_POINTZ ||
-        psObject->nSHPType == SHPT_POINTM) {
-        /* Write point */
-        ByteCopy(psObject->padfX, pabyRec + 12, 8);
-        ByteCopy(psObject->padfY, pabyRec + 20, 8);
-
-        BO_htole64_buf(pabyRec + 12);
-        BO_htole64_buf(pabyRec + 20);
+        psSHP->pabyRec = pabyRec;
+        psSHP->nBufSize = nRecordSize;
+    }
 
-        nRecordSize = 28;
+    /* Add the new entity to the in memory index */
+    if (nShapeId == -1 && psSHP->nRecords+1 > psSHP->nMaxRecords) {
+        uint32_t nMaxRecords = (uint32_t) (psSHP->nMaxRecords * 1.3 + 100);
+        uint32_t *panRecOffset, *panRecSize;
 
-        if (psObject->nSHPType == SHPT_POINTZ) {
-            ByteCopy(psObject->padfZ, pabyRec + nRecordSize, 8);
-            BO_htole64_buf(pabyRec + nRecordSize);
-            nRecordSize += 8;
+        panRecOffset = (uint32_t *) realloc(psSHP->panRecOffset, sizeof(uint32_t) * nMaxRecords);
+        if (!panRecOffset) {
+            return -1;
         }
+        psSHP->panRecOffset = panRecOffset;
 
-        if (psObject->nSHPType == SHPT_POINTZ || psObject->nSHPType == SHPT_POINTM) {
-            ByteCopy(psObject->padfM, pabyRec + nRecordSize, 8);
-            BO_htole64_buf(pabyRec + nRecordSize);
-            nRecordSize += 8;
+        panRecSize = (uint32_t *) realloc(psSHP->panRecSize, sizeof(uint32_t) * nMaxRecords);
+        if (!panRecSize) {
+            return -1;
         }
-    } else if (psObject->nSHPType == SHPT_NULL) {
-        /* Not much to do for null geometries */
-        nRecordSize = 12;
-    } else {
-        /* unknown type */
-        SHAPEFILE_ASSERT(SHAPEFILE_FALSE);
+        psSHP->panRecSize = panRecSize;
+        psSHP->nMaxRecords = nMaxRecords;
     }
 
     /* Establish where we are going to put this record. If we are
@@ -1192,27 +1421,14 @@ int SHPWriteObject(SHPHandle psSHP, int nShapeId, SHPObject * psObject)
         nRecordOffset = psSHP->panRecOffset[nShapeId];
     }
 
-    /* Set the shape type, record number, and record size */
-    i32 = nShapeId+1;                                   /* record # */
-    BO_htole32_buf(&i32);
-    ByteCopy(&i32, pabyRec, 4);
-
-    i32 = (nRecordSize-8)/2;                            /* record size */
-    BO_htole32_buf(&i32);
-    ByteCopy(&i32, pabyRec + 4, 4);
-
-    i32 = psObject->nSHPType;                           /* shape type */
-    BO_htole32_buf(&i32);
-    ByteCopy(&i32, pabyRec + 8, 4);
+    /* Encode the record into the reusable record buffer */
+    SHPSerializeObject(psObject, nShapeId, psSHP->pabyRec);
 
     /* Write out record */
-    if (fseek(psSHP->fpSHP, nRecordOffset, 0) != 0 || fwrite(pabyRec, nRecordSize, 1, psSHP->fpSHP) < 1) {
-        SafeFree(pabyRec);
+    if (fseek(psSHP->fpSHP, nRecordOffset, 0) != 0 || fwrite(psSHP->pabyRec, nRecordSize, 1, psSHP->fpSHP) < 1) {
         return -1;
     }
 
-    SafeFree(pabyRec);
-
     /* Expand file wide bounds based on this shape */
     if (psSHP->adBoundsMin[0] == 0.0 && psSHP->adBoundsMax[0] == 0.0 &&
         psSHP->adBoundsMin[1] == 0.0 && psSHP->adBoundsMax[1] == 0.0) {
@@ -1243,82 +1459,618 @@ int SHPWriteObject(SHPHandle psSHP, int nShapeId, SHPObject * psObject)
     return(nShapeId );
 }
 
-/**
- * Read the vertices, parts, and other non-attribute information for one shape
- */
-SHPObject * SHPReadObject(SHPHandle psSHP, int hEntity)
+
+/* -------------------------------------------------------------------- */
+/*      Streaming append writer: records are encoded into one large     */
+/*      output buffer and .shx entries are written in blocks. Bounds    */
+/*      are accumulated per record and both headers are patched once   */
+/*      when the writer is closed.                                      */
+/* -------------------------------------------------------------------- */
+struct SHPWriterInfo
 {
-    SHPObject *psShape;
-    /* Validate the record/entity number */
-    if (hEntity < 0 || hEntity >= psSHP->nRecords) {
-        return NULL;;
-    }
-    /* Ensure our record buffer is large enough */
-    if (psSHP->panRecSize[hEntity] + 8 > psSHP->nBufSize) {
-        psSHP->nBufSize = psSHP->panRecSize[hEntity] + 8;
-        psSHP->pabyRec = (ub1 *) SfRealloc(psSHP->pabyRec, psSHP->nBufSize);
-        if (!psSHP->pabyRec) {
-            return NULL;
-        }
-    }
-    /* Read the record */
-    if (fseek(psSHP->fpSHP, psSHP->panRecOffset[hEntity], 0) != 0 ||
-        fread(psSHP->pabyRec, psSHP->panRecSize[hEntity] + 8, 1, psSHP->fpSHP) != 1) {
-        return 0;
-    }
-    /* Allocate and minimally initialize the object */
-    psShape = (SHPObject *) calloc(1,sizeof(SHPObject));
-    if (!psShape) {
-        return 0;
-    }
+    FILE       *fpSHP;
+    FILE       *fpSHX;
 
-    psShape->nShapeId = hEntity;
-    memcpy(&psShape->nSHPType, psSHP->pabyRec + 8, 4);
-    BO_letoh32_buf(&(psShape->nSHPType));
+    int         nShapeType;
+    uint32_t    nFileSize;      /* .shp bytes including pending records */
+    int         nRecords;
 
-    /* Extract vertices for a Polygon or Arc */
-    if (SHPTypeHasParts(psShape->nSHPType)) {
-        int nPoints, nParts, i, nOffset;
+    ub1        *pabyBuf;        /* pending .shp records */
+    int         nBufSize;
+    int         nBufUsed;
 
-        /* Extract part/point count, and build vertex and part arrays to proper size */
-        memcpy(&nPoints, psSHP->pabyRec + 40 + 8, 4);
-        memcpy(&nParts, psSHP->pabyRec + 36 + 8, 4);
+    ub1        *pabySHX;        /* pending .shx entries */
+    int         nSHXUsed;
 
-        BO_letoh32_buf(&nPoints);
-        BO_letoh32_buf(&nParts);
+    int         bHasBounds;
+    double      adBoundsMin[4];
+    double      adBoundsMax[4];
 
-        if (nPoints==0) {
-            free(psShape);
-            return 0;
-        }
+    int         bFailed;
+};
 
-        /* Get the X/Y bounds */
-        memcpy(&(psShape->dfXMin), psSHP->pabyRec + 8 +  4, 8);
-        memcpy(&(psShape->dfYMin), psSHP->pabyRec + 8 + 12, 8);
-        memcpy(&(psShape->dfXMax), psSHP->pabyRec + 8 + 20, 8);
-        memcpy(&(psShape->dfYMax), psSHP->pabyRec + 8 + 28, 8);
 
-        BO_letoh64_buf(&(psShape->dfXMin));
-        BO_letoh64_buf(&(psShape->dfYMin));
-        BO_letoh64_buf(&(psShape->dfXMax));
-        BO_letoh64_buf(&(psShape->dfYMax));
+/**
+ * Encode the 100 bytes main file header shared by .shp and .shx
+ */
+static void SHPPackHeader(ub1 *abyHeader, int nShapeType, uint32_t nFileSize, const double *padfMin, const double *padfMax)
+{
+    int32_t i32;
+    int     i;
 
-        psShape->nVertices = nPoints;
-        psShape->padfX = (double *) calloc(nPoints, sizeof(double));
-        psShape->padfY = (double *) calloc(nPoints, sizeof(double));
-        psShape->padfZ = (double *) calloc(nPoints, sizeof(double));
-        psShape->padfM = (double *) calloc(nPoints, sizeof(double));
+    memset(abyHeader, 0, 100);
 
-        psShape->nParts = nParts;
-        psShape->panPartStart = (int *) calloc(nParts+1, sizeof(int));
-        psShape->panPartType = (int *) calloc(nParts, sizeof(int));
+    abyHeader[2] = 0x27;                                /* magic cookie */
+    abyHeader[3] = 0x0a;
 
-        for (i = 0; i < nParts; i++) {
-            psShape->panPartType[i] = SHPP_RING;
+    i32 = (int32_t) (nFileSize / 2);                    /* file size: big-endian */
+    ByteCopy(&i32, abyHeader+24, 4);
+    BO_htobe32_buf(abyHeader+24);
+
+    i32 = 1000;                                         /* version: little-endian */
+    ByteCopy(&i32, abyHeader+28, 4);
+    BO_htole32_buf(abyHeader+28);
+
+    i32 = nShapeType;                                   /* shape type: little-endian */
+    ByteCopy(&i32, abyHeader+32, 4);
+    BO_htole32_buf(abyHeader+32);
+
+    /* bounds: xmin, ymin, xmax, ymax, zmin, zmax, mmin, mmax */
+    SHPPutDoubles(abyHeader+36, padfMin, 2);
+    SHPPutDoubles(abyHeader+52, padfMax, 2);
+
+    for (i = 2; i < 4; i++) {
+        SHPPutDoubles(abyHeader+68+(i-2)*16, padfMin+i, 1);
+        SHPPutDoubles(abyHeader+76+(i-2)*16, padfMax+i, 1);
+    }
+}
+
+
+/**
+ * Write the pending records and .shx entries
+ */
+static int SHPWriterFlush(SHPWriterHandle hWriter)
+{
+    if (hWriter->nBufUsed > 0) {
+        if (fwrite(hWriter->pabyBuf, hWriter->nBufUsed, 1, hWriter->fpSHP) != 1) {
+            hWriter->bFailed = SHAPEFILE_TRUE;
+        }
+        hWriter->nBufUsed = 0;
+    }
+
+    if (hWriter->nSHXUsed > 0) {
+        if (fwrite(hWriter->pabySHX, 8, hWriter->nSHXUsed, hWriter->fpSHX) != (size_t) hWriter->nSHXUsed) {
+            hWriter->bFailed = SHAPEFILE_TRUE;
+        }
+        hWriter->nSHXUsed = 0;
+    }
+
+    return (! hWriter->bFailed);
+}
+
+
+/**
+ * Create a new shape file for appending only
+ */
+SHPWriterHandle SHPWriterOpen(const char * pszLayer, int nShapeType, int nBufferSize)
+{
+    SHPWriterHandle hWriter;
+    char   *pszBasename, *pszFullname;
+    ub1     abyHeader[100];
+    double  adZero[4] = {0, 0, 0, 0};
+    int     i;
+
+    /* Compute the base (layer) name. */
+    pszBasename = (char *) malloc(strlen(pszLayer) + 5);
+    if (!pszBasename) {
+        return NULL;
+    }
+    strcpy(pszBasename, pszLayer);
+    for (i = (int) strlen(pszBasename) - 1;
+        i > 0 && pszBasename[i] != '.' && pszBasename[i] != '/' && pszBasename[i] != '\\';
+        i--) {
+        /* do nothing */
+    }
+    if (pszBasename[i] == '.') {
+        pszBasename[i] = '\0';
+    }
+
+    pszFullname = (char *) malloc(strlen(pszBasename) + 5);
+    hWriter = (SHPWriterHandle) calloc(1, sizeof(struct SHPWriterInfo));
+
+    if (!pszFullname || !hWriter) {
+        SafeFree(pszFullname);
+        SafeFree(pszBasename);
+        SafeFree(hWriter);
+        return NULL;
+    }
+
+    hWriter->nShapeType = nShapeType;
+    hWriter->nFileSize = 100;
+
+    sprintf(pszFullname, "%s.shp", pszBasename);
+    hWriter->fpSHP = fopen(pszFullname, "wb");
+
+    sprintf(pszFullname, "%s.shx", pszBasename);
+    hWriter->fpSHX = hWriter->fpSHP? fopen(pszFullname, "wb") : NULL;
+
+    SafeFree(pszFullname);
+    SafeFree(pszBasename);
+
+    /* headers are rewritten by SHPWriterClose() */
+    SHPPackHeader(abyHeader, nShapeType, 100, adZero, adZero);
+
+    if (! hWriter->fpSHX ||
+        fwrite(abyHeader, 100, 1, hWriter->fpSHP) != 1 ||
+        fwrite(abyHeader, 100, 1, hWriter->fpSHX) != 1) {
+        hWriter->bFailed = SHAPEFILE_TRUE;
+        SHPWriterClose(hWriter);
+        return NULL;
+    }
+
+    hWriter->nBufSize = nBufferSize > 0? nBufferSize : SHP_WRITER_BUFSIZE;
+    hWriter->pabyBuf = (ub1 *) malloc((size_t) hWriter->nBufSize);
+    hWriter->pabySHX = (ub1 *) malloc(8 * SHP_WRITER_SHX_BLOCK);
+
+    if (!hWriter->pabyBuf || !hWriter->pabySHX) {
+        hWriter->bFailed = SHAPEFILE_TRUE;
+        SHPWriterClose(hWriter);
+        return NULL;
+    }
+
+    return hWriter;
+}
+
+
+/**
+ * Append psObject as the next record
+ */
+int SHPWriterAppend(SHPWriterHandle hWriter, const SHPObject * psObject)
+{
+    int       nRecordSize, i;
+    int32_t   i32;
+    ub1      *pabyEntry;
+
+    if (hWriter->bFailed) {
+        return -1;
+    }
+
+    if (psObject->nSHPType != hWriter->nShapeType && psObject->nSHPType != SHPT_NULL) {
+        return -1;
+    }
+
+    nRecordSize = SHPObjectRecordSize(psObject);
+    if (nRecordSize < 0 || hWriter->nRecords == INT_MAX ||
+        (uint64_t) hWriter->nFileSize + nRecordSize > UINT32_MAX) {
+        return -1;
+    }
+
+    if (hWriter->nBufUsed + nRecordSize > hWriter->nBufSize || hWriter->nSHXUsed == SHP_WRITER_SHX_BLOCK) {
+        if (! SHPWriterFlush(hWriter)) {
+            return -1;
+        }
+
+        if (nRecordSize > hWriter->nBufSize) {
+            ub1 *pabyBuf = (ub1 *) realloc(hWriter->pabyBuf, (size_t) nRecordSize);
+            if (!pabyBuf) {
+                return -1;
+            }
+            hWriter->pabyBuf = pabyBuf;
+            hWriter->nBufSize = nRecordSize;
+        }
+    }
+
+    SHPSerializeObject(psObject, hWriter->nRecords, hWriter->pabyBuf + hWriter->nBufUsed);
+    hWriter->nBufUsed += nRecordSize;
+
+    /* .shx entry: record offset and content length in 16-bit words */
+    pabyEntry = hWriter->pabySHX + 8 * hWriter->nSHXUsed++;
+
+    i32 = (int32_t) (hWriter->nFileSize / 2);
+    ByteCopy(&i32, pabyEntry, 4);
+    BO_htobe32_buf(pabyEntry);
+
+    i32 = (nRecordSize - 8) / 2;
+    ByteCopy(&i32, pabyEntry + 4, 4);
+    BO_htobe32_buf(pabyEntry + 4);
+
+    hWriter->nFileSize += nRecordSize;
+
+    /* Expand file wide bounds by the extents of this shape */
+    if (psObject->nSHPType != SHPT_NULL && psObject->nVertices > 0) {
+        const double adMin[4] = {psObject->dfXMin, psObject->dfYMin, psObject->dfZMin, psObject->dfMMin};
+        const double adMax[4] = {psObject->dfXMax, psObject->dfYMax, psObject->dfZMax, psObject->dfMMax};
+
+        for (i = 0; i < 4; i++) {
+            if (hWriter->bHasBounds) {
+                hWriter->adBoundsMin[i] = MIN_V2(hWriter->adBoundsMin[i], adMin[i]);
+                hWriter->adBoundsMax[i] = MAX_V2(hWriter->adBoundsMax[i], adMax[i]);
+            } else {
+                hWriter->adBoundsMin[i] = adMin[i];
+                hWriter->adBoundsMax[i] = adMax[i];
+            }
+        }
+        hWriter->bHasBounds = SHAPEFILE_TRUE;
+    }
+
+    return hWriter->nRecords++;
+}
+
+
+/**
+ * Flush pending records, patch both headers and close the files
+ */
+int SHPWriterClose(SHPWriterHandle hWriter)
+{
+    ub1  abyHeader[100];
+    int  bSuccess;
+
+    if (! hWriter) {
+        return SHAPEFILE_FALSE;
+    }
+
+    if (hWriter->fpSHP && hWriter->fpSHX && SHPWriterFlush(hWriter)) {
+        SHPPackHeader(abyHeader, hWriter->nShapeType, hWriter->nFileSize, hWriter->adBoundsMin, hWriter->adBoundsMax);
+
+        if (fseek(hWriter->fpSHP, 0, SEEK_SET) != 0 || fwrite(abyHeader, 100, 1, hWriter->fpSHP) != 1) {
+            hWriter->bFailed = SHAPEFILE_TRUE;
+        }
+
+        SHPPackHeader(abyHeader, hWriter->nShapeType, 100 + 8 * (uint32_t) hWriter->nRecords,
+            hWriter->adBoundsMin, hWriter->adBoundsMax);
+
+        if (fseek(hWriter->fpSHX, 0, SEEK_SET) != 0 || fwrite(abyHeader, 100, 1, hWriter->fpSHX) != 1) {
+            hWriter->bFailed = SHAPEFILE_TRUE;
+        }
+    }
+
+    if (hWriter->fpSHP && fclose(hWriter->fpSHP) != 0) {
+        hWriter->bFailed = SHAPEFILE_TRUE;
+    }
+
+    if (hWriter->fpSHX && fclose(hWriter->fpSHX) != 0) {
+        hWriter->bFailed = SHAPEFILE_TRUE;
+    }
+
+    bSuccess = ! hWriter->bFailed;
+
+    SafeFree(hWriter->pabyBuf);
+    SafeFree(hWriter->pabySHX);
+    free(hWriter);
+
+    return bSuccess;
+}
+
+
+/**
+ * Read nSize bytes at nOffset without touching the shared file position.
+ *   Returns 1 on success, 0 on short read or error.
+ */
+static int SfPread(FILE *fp, void *pBuf, size_t nSize, uint64_t nOffset)
+{
+#if defined(PLATFORM_WINDOWS)
+    HANDLE hFile = (HANDLE) _get_osfhandle(_fileno(fp));
+    OVERLAPPED ov;
+    DWORD nRead = 0;
+
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD) (nOffset & 0xFFFFFFFF);
+    ov.OffsetHigh = (DWORD) (nOffset >> 32);
+
+    if (!ReadFile(hFile, pBuf, (DWORD) nSize, &nRead, &ov) || nRead != (DWORD) nSize) {
+        return 0;
+    }
+    return 1;
+#else
+    ub1 *pabyBuf = (ub1 *) pBuf;
+
+    while (nSize > 0) {
+        ssize_t nRead = pread(fileno(fp), pabyBuf, nSize, (off_t) nOffset);
+        if (nRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (nRead <= 0) {
+            return 0;
+        }
+        pabyBuf += nRead;
+        nOffset += (uint64_t) nRead;
+        nSize -= (size_t) nRead;
+    }
+    return 1;
+#endif
+}
+
+
+/**
+ * Free the record buffer owned by caller, buffer can be reused after
+ */
+void SHPReadBufferFree(SHPReadBuffer *psBuf)
+{
+    if (psBuf) {
+        SafeFree(psBuf->pabyRec);
+        psBuf->nBufSize = 0;
+    }
+}
+
+
+/**
+ * Fetch nLen bytes at nStart of one record (offsets count the 8 bytes record
+ *   header). Served straight from the mapping when opened by SHPOpenMapped().
+ *   With a caller buffer the bytes are read by position into it, so threads
+ *   sharing the handle never touch the FILE cursor or psSHP->pabyRec.
+ *   Otherwise they are read into psSHP->pabyRec. Returns NULL on error.
+ */
+static const ub1 * SHPFetchRecordBytes(SHPHandle psSHP, int hEntity, uint32_t nStart, uint32_t nLen, SHPReadBuffer *psBuf)
+{
+    uint64_t nFileOffset;
+
+    if (hEntity < 0 || (uint32_t) hEntity >= psSHP->nRecords) {
+        return NULL;
+    }
+
+    if ((uint64_t) nStart + nLen > (uint64_t) psSHP->panRecSize[hEntity] + 8) {
+        return NULL;
+    }
+
+    nFileOffset = (uint64_t) psSHP->panRecOffset[hEntity] + nStart;
+
+    if (psSHP->pabySHPMap) {
+        if (nFileOffset + nLen > (uint64_t) psSHP->nSHPMapSize) {
+            return NULL;
+        }
+        return psSHP->pabySHPMap + nFileOffset;
+    }
+
+    if (psBuf) {
+        /* buffer sizes are int: a longer record is corrupt */
+        if (nLen > (uint32_t) INT_MAX) {
+            return NULL;
+        }
+        if (nLen > (uint32_t) psBuf->nBufSize) {
+            psBuf->pabyRec = (ub1 *) SfRealloc(psBuf->pabyRec, (int) nLen);
+            psBuf->nBufSize = (int) nLen;
+        }
+
+        if (! SfPread(psSHP->fpSHP, psBuf->pabyRec, nLen, nFileOffset)) {
+            return NULL;
+        }
+        return psBuf->pabyRec;
+    }
+
+    /* Ensure our record buffer is large enough */
+    if (nLen > (uint32_t) INT_MAX) {
+        return NULL;
+    }
+    if (nLen > (uint32_t) psSHP->nBufSize) {
+        psSHP->pabyRec = (ub1 *) SfRealloc(psSHP->pabyRec, (int) nLen);
+        psSHP->nBufSize = (int) nLen;
+    }
+
+    if (fseek(psSHP->fpSHP, (long) nFileOffset, 0) != 0 ||
+        fread(psSHP->pabyRec, nLen, 1, psSHP->fpSHP) != 1) {
+        return NULL;
+    }
+    return psSHP->pabyRec;
+}
+
+
+/**
+ * Fetch the raw bytes of one whole record (including the 8 bytes record header)
+ */
+static const ub1 * SHPFetchRecord(SHPHandle psSHP, int hEntity, SHPReadBuffer *psBuf)
+{
+    if (hEntity < 0 || (uint32_t) hEntity >= psSHP->nRecords) {
+        return NULL;
+    }
+    return SHPFetchRecordBytes(psSHP, hEntity, 0, psSHP->panRecSize[hEntity] + 8, psBuf);
+}
+
+
+/**
+ * Fetch the leading bytes of one record: enough to decode type, bbox and
+ *   part/point counts. *pnHeadLen gets min(record size, SHP_RECORD_HEAD_SIZE).
+ */
+static const ub1 * SHPFetchRecordHead(SHPHandle psSHP, int hEntity, SHPReadBuffer *psBuf, uint32_t *pnHeadLen)
+{
+    if (hEntity < 0 || (uint32_t) hEntity >= psSHP->nRecords) {
+        return NULL;
+    }
+    *pnHeadLen = MIN_V2(psSHP->panRecSize[hEntity] + 8, SHP_RECORD_HEAD_SIZE);
+    return SHPFetchRecordBytes(psSHP, hEntity, 0, *pnHeadLen, psBuf);
+}
+
+
+/**
+ * Decode shape type and 2D envelope from the leading bytes of a record.
+ *   returns SHPT_NULL for null, empty or truncated shapes.
+ */
+static int SHPDecodeEnvelope(const ub1 *pabyHead, uint32_t nHeadLen, SHPEnvelope *env, double *pointEpsilon)
+{
+    int nSHPType, nPoints;
+
+    if (nHeadLen < 12) {
+        return (SHPT_NULL);
+    }
+
+    memcpy(&nSHPType, pabyHead + 8, 4);
+    BO_letoh32_buf(&nSHPType);
+
+    if (SHPTypeHasParts(nSHPType)) {
+        if (nHeadLen < 52) {
+            return (SHPT_NULL);
+        }
+        memcpy(&nPoints, pabyHead + 40 + 8, 4);
+    } else if (nSHPType == SHPT_MULTIPOINT ||
+        nSHPType == SHPT_MULTIPOINTM ||
+        nSHPType == SHPT_MULTIPOINTZ) {
+        if (nHeadLen < 48) {
+            return (SHPT_NULL);
+        }
+        memcpy(&nPoints, pabyHead + 44, 4);
+    } else if (nSHPType == SHPT_POINT ||
+        nSHPType == SHPT_POINTM ||
+        nSHPType == SHPT_POINTZ) {
+        if (nHeadLen < 28) {
+            return (SHPT_NULL);
+        }
+
+        memcpy(&env->XMin, pabyHead + 12, 8);
+        memcpy(&env->YMin, pabyHead + 20, 8);
+
+        BO_letoh64_buf(&env->XMin);
+        BO_letoh64_buf(&env->YMin);
+
+        if (pointEpsilon) {
+            double Epsilon = *pointEpsilon;
+            env->XMax = env->XMin + Epsilon;
+            env->YMax = env->YMin + Epsilon;
+        } else {
+            env->XMax = env->XMin;
+            env->YMax = env->YMin;
+        }
+        return (nSHPType);
+    } else {
+        return (SHPT_NULL);
+    }
+
+    BO_letoh32_buf(&nPoints);
+    if (nPoints <= 0) {
+        return (SHPT_NULL);
+    }
+
+    memcpy(&(env->XMin), pabyHead + 8 +  4, 8);
+    memcpy(&(env->YMin), pabyHead + 8 + 12, 8);
+    memcpy(&(env->XMax), pabyHead + 8 + 20, 8);
+    memcpy(&(env->YMax), pabyHead + 8 + 28, 8);
+
+    BO_letoh64_buf(&(env->XMin));
+    BO_letoh64_buf(&(env->YMin));
+    BO_letoh64_buf(&(env->XMax));
+    BO_letoh64_buf(&(env->YMax));
+
+    return (nSHPType);
+}
+
+/**
+ * Object memory from hArena, or from the heap if hArena is NULL.
+ */
+static void * SHPObjectAlloc(SHPArenaHandle hArena, size_t nBytes, int bZero)
+{
+    void *pv;
+
+    if (!hArena) {
+        return bZero ? calloc(1, nBytes) : malloc(nBytes);
+    }
+
+    pv = SHPArenaAlloc(hArena, nBytes);
+    if (pv && bZero) {
+        memset(pv, 0, nBytes);
+    }
+    return pv;
+}
+
+
+/**
+ * Allocate the arrays of psShape: X/Y to be filled, Z/M zeroed, and
+ *   the part arrays unless nParts < 0.
+ */
+static int SHPObjectAllocArrays(SHPObject *psShape, SHPArenaHandle hArena, int nPoints, int nParts)
+{
+    psShape->padfX = (double *) SHPObjectAlloc(hArena, sizeof(double) * nPoints, SHAPEFILE_FALSE);
+    psShape->padfY = (double *) SHPObjectAlloc(hArena, sizeof(double) * nPoints, SHAPEFILE_FALSE);
+    psShape->padfZ = (double *) SHPObjectAlloc(hArena, sizeof(double) * nPoints, SHAPEFILE_TRUE);
+    psShape->padfM = (double *) SHPObjectAlloc(hArena, sizeof(double) * nPoints, SHAPEFILE_TRUE);
+
+    if (!psShape->padfX || !psShape->padfY || !psShape->padfZ || !psShape->padfM) {
+        return SHAPEFILE_FALSE;
+    }
+
+    if (nParts >= 0) {
+        psShape->panPartStart = (int *) SHPObjectAlloc(hArena, sizeof(int) * (nParts+1), SHAPEFILE_FALSE);
+        psShape->panPartType = (int *) SHPObjectAlloc(hArena, sizeof(int) * MAX_V2(nParts, 1), SHAPEFILE_FALSE);
+
+        if (!psShape->panPartStart || !psShape->panPartType) {
+            return SHAPEFILE_FALSE;
+        }
+    }
+    return SHAPEFILE_TRUE;
+}
+
+
+/**
+ * Free what SHPDecodeObject() got from the heap. Arena memory waits
+ *   for SHPArenaReset().
+ */
+static SHPObject * SHPDecodeFailed(SHPObject *psShape, SHPArenaHandle hArena)
+{
+    if (!hArena) {
+        SHPDestroyObject(psShape);
+    }
+    return NULL;
+}
+
+
+/**
+ * Read the vertices, parts, and other non-attribute information for one shape
+ */
+static SHPObject * SHPDecodeObject(SHPHandle psSHP, int hEntity, SHPReadBuffer *psBuf, SHPArenaHandle hArena)
+{
+    SHPObject *psShape;
+    const ub1 *pabyRec;
+
+    /* Validate the record/entity number and fetch the record */
+    pabyRec = SHPFetchRecord(psSHP, hEntity, psBuf);
+    if (!pabyRec) {
+        return NULL;
+    }
+    /* Allocate and minimally initialize the object */
+    psShape = (SHPObject *) SHPObjectAlloc(hArena, sizeof(SHPObject), SHAPEFILE_TRUE);
+    if (!psShape) {
+        return 0;
+    }
+
+    psShape->nShapeId = hEntity;
+    memcpy(&psShape->nSHPType, pabyRec + 8, 4);
+    BO_letoh32_buf(&(psShape->nSHPType));
+
+    /* Extract vertices for a Polygon or Arc */
+    if (SHPTypeHasParts(psShape->nSHPType)) {
+        int nPoints, nParts, i, nOffset;
+
+        /* Extract part/point count, and build vertex and part arrays to proper size */
+        memcpy(&nPoints, pabyRec + 40 + 8, 4);
+        memcpy(&nParts, pabyRec + 36 + 8, 4);
+
+        BO_letoh32_buf(&nPoints);
+        BO_letoh32_buf(&nParts);
+
+        if (nPoints==0 || nParts < 0) {
+            return SHPDecodeFailed(psShape, hArena);
+        }
+
+        /* Get the X/Y bounds */
+        memcpy(&(psShape->dfXMin), pabyRec + 8 +  4, 8);
+        memcpy(&(psShape->dfYMin), pabyRec + 8 + 12, 8);
+        memcpy(&(psShape->dfXMax), pabyRec + 8 + 20, 8);
+        memcpy(&(psShape->dfYMax), pabyRec + 8 + 28, 8);
+
+        BO_letoh64_buf(&(psShape->dfXMin));
+        BO_letoh64_buf(&(psShape->dfYMin));
+        BO_letoh64_buf(&(psShape->dfXMax));
+        BO_letoh64_buf(&(psShape->dfYMax));
+
+        psShape->nVertices = nPoints;
+        psShape->nParts = nParts;
+        if (!SHPObjectAllocArrays(psShape, hArena, nPoints, nParts)) {
+            return SHPDecodeFailed(psShape, hArena);
+        }
+
+        for (i = 0; i < nParts; i++) {
+            psShape->panPartType[i] = SHPP_RING;
         }
 
         /* Copy out the part array from the record */
-        memcpy(psShape->panPartStart, psSHP->pabyRec + 44 + 8, 4 * nParts);
+        memcpy(psShape->panPartStart, pabyRec + 44 + 8, 4 * nParts);
 
         for (i = 0; i < nParts; i++) {
             BO_letoh32_buf(psShape->panPartStart+i);
@@ -1329,7 +2081,7 @@ SHPObject * SHPReadObject(SHPHandle psSHP, int hEntity)
 
         /* If this is a multipatch, we will also have parts types */
         if (psShape->nSHPType == SHPT_MULTIPATCH) {
-            memcpy(psShape->panPartType, psSHP->pabyRec + nOffset, 4*nParts);
+            memcpy(psShape->panPartType, pabyRec + nOffset, 4*nParts);
 
             for (i = 0; i < nParts; i++) {
                 BO_letoh32_buf(psShape->panPartType+i);
@@ -1340,8 +2092,8 @@ SHPObject * SHPReadObject(SHPHandle psSHP, int hEntity)
 
         /* Copy out the vertices from the record */
         for (i = 0; i < nPoints; i++) {
-            memcpy(psShape->padfX + i, psSHP->pabyRec + nOffset + i * 16, 8);
-            memcpy(psShape->padfY + i, psSHP->pabyRec + nOffset + i * 16 + 8, 8);
+            memcpy(psShape->padfX + i, pabyRec + nOffset + i * 16, 8);
+            memcpy(psShape->padfY + i, pabyRec + nOffset + i * 16 + 8, 8);
 
             BO_letoh64_buf(psShape->padfX + i);
             BO_letoh64_buf(psShape->padfY + i);
@@ -1351,14 +2103,14 @@ SHPObject * SHPReadObject(SHPHandle psSHP, int hEntity)
 
         /* If we have a Z coordinate, collect that now */
         if (psShape->nSHPType == SHPT_POLYGONZ || psShape->nSHPType == SHPT_ARCZ || psShape->nSHPType == SHPT_MULTIPATCH) {
-            memcpy(&(psShape->dfZMin), psSHP->pabyRec + nOffset, 8);
-            memcpy(&(psShape->dfZMax), psSHP->pabyRec + nOffset + 8, 8);
+            memcpy(&(psShape->dfZMin), pabyRec + nOffset, 8);
+            memcpy(&(psShape->dfZMax), pabyRec + nOffset + 8, 8);
 
             BO_letoh64_buf(&(psShape->dfZMin));
             BO_letoh64_buf(&(psShape->dfZMax));
 
             for (i = 0; i < nPoints; i++) {
-                memcpy(psShape->padfZ + i, psSHP->pabyRec + nOffset + 16 + i*8, 8);
+                memcpy(psShape->padfZ + i, pabyRec + nOffset + 16 + i*8, 8);
                 BO_letoh64_buf(psShape->padfZ + i);
             }
 
@@ -1369,14 +2121,14 @@ SHPObject * SHPReadObject(SHPHandle psSHP, int hEntity)
         * We assume that the measure can be present for any shape if the size is
         *  big enough, but really it will only occur for the Z shapes (options), and the M shapes */
         if (psSHP->panRecSize[hEntity]+8 >= nOffset + 16 + 8*nPoints) {
-            memcpy(&(psShape->dfMMin), psSHP->pabyRec + nOffset, 8);
-            memcpy(&(psShape->dfMMax), psSHP->pabyRec + nOffset + 8, 8);
+            memcpy(&(psShape->dfMMin), pabyRec + nOffset, 8);
+            memcpy(&(psShape->dfMMax), pabyRec + nOffset + 8, 8);
 
             BO_letoh64_buf(&(psShape->dfMMin));
             BO_letoh64_buf(&(psShape->dfMMax));
 
             for (i = 0; i < nPoints; i++) {
-                memcpy(psShape->padfM + i, psSHP->pabyRec + nOffset + 16 + i*8, 8);
+                memcpy(psShape->padfM + i, pabyRec + nOffset + 16 + i*8, 8);
                 BO_letoh64_buf(psShape->padfM + i);
             }
         }
@@ -1386,24 +2138,22 @@ SHPObject * SHPReadObject(SHPHandle psSHP, int hEntity)
         /* Extract vertices for a MultiPoint */
         int nPoints, i, nOffset;
 
-        memcpy(&nPoints, psSHP->pabyRec + 44, 4);
+        memcpy(&nPoints, pabyRec + 44, 4);
 
         BO_letoh32_buf(&nPoints);
 
         if (nPoints==0) {
-            free(psShape);
-            return 0;
+            return SHPDecodeFailed(psShape, hArena);
         }
 
         psShape->nVertices = nPoints;
-        psShape->padfX = (double *) calloc(nPoints,sizeof(double));
-        psShape->padfY = (double *) calloc(nPoints,sizeof(double));
-        psShape->padfZ = (double *) calloc(nPoints,sizeof(double));
-        psShape->padfM = (double *) calloc(nPoints,sizeof(double));
+        if (!SHPObjectAllocArrays(psShape, hArena, nPoints, -1)) {
+            return SHPDecodeFailed(psShape, hArena);
+        }
 
         for (i = 0; i < nPoints; i++) {
-            memcpy(psShape->padfX+i, psSHP->pabyRec + 48 + 16 * i, 8);
-            memcpy(psShape->padfY+i, psSHP->pabyRec + 48 + 16 * i + 8, 8);
+            memcpy(psShape->padfX+i, pabyRec + 48 + 16 * i, 8);
+            memcpy(psShape->padfY+i, pabyRec + 48 + 16 * i + 8, 8);
 
             BO_letoh64_buf(psShape->padfX + i);
             BO_letoh64_buf(psShape->padfY + i);
@@ -1412,10 +2162,10 @@ SHPObject * SHPReadObject(SHPHandle psSHP, int hEntity)
         nOffset = 48 + 16*nPoints;
 
         /* Get the X/Y bounds */
-        memcpy(&(psShape->dfXMin), psSHP->pabyRec + 8 +  4, 8);
-        memcpy(&(psShape->dfYMin), psSHP->pabyRec + 8 + 12, 8);
-        memcpy(&(psShape->dfXMax), psSHP->pabyRec + 8 + 20, 8);
-        memcpy(&(psShape->dfYMax), psSHP->pabyRec + 8 + 28, 8);
+        memcpy(&(psShape->dfXMin), pabyRec + 8 +  4, 8);
+        memcpy(&(psShape->dfYMin), pabyRec + 8 + 12, 8);
+        memcpy(&(psShape->dfXMax), pabyRec + 8 + 20, 8);
+        memcpy(&(psShape->dfYMax), pabyRec + 8 + 28, 8);
 
         BO_letoh64_buf(&(psShape->dfXMin));
         BO_letoh64_buf(&(psShape->dfYMin));
@@ -1424,14 +2174,14 @@ SHPObject * SHPReadObject(SHPHandle psSHP, int hEntity)
 
         /* If we have a Z coordinate, collect that now */
         if (psShape->nSHPType == SHPT_MULTIPOINTZ) {
-            memcpy(&(psShape->dfZMin), psSHP->pabyRec + nOffset, 8);
-            memcpy(&(psShape->dfZMax), psSHP->pabyRec + nOffset + 8, 8);
+            memcpy(&(psShape->dfZMin), pabyRec + nOffset, 8);
+            memcpy(&(psShape->dfZMax), pabyRec + nOffset + 8, 8);
 
             BO_letoh64_buf(&(psShape->dfZMin));
             BO_letoh64_buf(&(psShape->dfZMax));
 
             for (i = 0; i < nPoints; i++) {
-                memcpy(psShape->padfZ + i, psSHP->pabyRec + nOffset + 16 + i*8, 8);
+                memcpy(psShape->padfZ + i, pabyRec + nOffset + 16 + i*8, 8);
                 BO_letoh64_buf(psShape->padfZ + i);
             }
 
@@ -1444,14 +2194,14 @@ SHPObject * SHPReadObject(SHPHandle psSHP, int hEntity)
         * (options), and the M shapes
         */
         if (psSHP->panRecSize[hEntity]+8 >= nOffset + 16 + 8*nPoints) {
-            memcpy(&(psShape->dfMMin), psSHP->pabyRec + nOffset, 8);
-            memcpy(&(psShape->dfMMax), psSHP->pabyRec + nOffset + 8, 8);
+            memcpy(&(psShape->dfMMin), pabyRec + nOffset, 8);
+            memcpy(&(psShape->dfMMax), pabyRec + nOffset + 8, 8);
 
             BO_letoh64_buf(&(psShape->dfMMin));
             BO_letoh64_buf(&(psShape->dfMMax));
 
             for (i = 0; i < nPoints; i++) {
-                memcpy(psShape->padfM + i, psSHP->pabyRec + nOffset + 16 + i*8, 8);
+                memcpy(psShape->padfM + i, pabyRec + nOffset + 16 + i*8, 8);
                 BO_letoh64_buf(psShape->padfM + i);
             }
         }
@@ -1462,13 +2212,12 @@ SHPObject * SHPReadObject(SHPHandle psSHP, int hEntity)
         int nOffset;
 
         psShape->nVertices = 1;
-        psShape->padfX = (double *) calloc(1,sizeof(double));
-        psShape->padfY = (double *) calloc(1,sizeof(double));
-        psShape->padfZ = (double *) calloc(1,sizeof(double));
-        psShape->padfM = (double *) calloc(1,sizeof(double));
+        if (!SHPObjectAllocArrays(psShape, hArena, 1, -1)) {
+            return SHPDecodeFailed(psShape, hArena);
+        }
 
-        memcpy(psShape->padfX, psSHP->pabyRec + 12, 8);
-        memcpy(psShape->padfY, psSHP->pabyRec + 20, 8);
+        memcpy(psShape->padfX, pabyRec + 12, 8);
+        memcpy(psShape->padfY, pabyRec + 20, 8);
 
         BO_letoh64_buf(psShape->padfX);
         BO_letoh64_buf(psShape->padfY);
@@ -1477,7 +2226,7 @@ SHPObject * SHPReadObject(SHPHandle psSHP, int hEntity)
 
         /* If we have a Z coordinate, collect that now */
         if (psShape->nSHPType == SHPT_POINTZ) {
-            memcpy(psShape->padfZ, psSHP->pabyRec + nOffset, 8);
+            memcpy(psShape->padfZ, pabyRec + nOffset, 8);
             BO_letoh64_buf(psShape->padfZ);
             nOffset += 8;
         }
@@ -1488,7 +2237,7 @@ SHPObject * SHPReadObject(SHPHandle psSHP, int hEntity)
      * (options), and the M shapes.
      */
         if (psSHP->panRecSize[hEntity]+8 >= nOffset + 8) {
-            memcpy(psShape->padfM, psSHP->pabyRec + nOffset, 8);
+            memcpy(psShape->padfM, pabyRec + nOffset, 8);
             BO_letoh64_buf(psShape->padfM);
         }
 
@@ -1498,262 +2247,238 @@ SHPObject * SHPReadObject(SHPHandle psSHP, int hEntity)
         psShape->dfZMin = psShape->dfZMax = psShape->padfZ[0];
         psShape->dfMMin = psShape->dfMMax = psShape->padfM[0];
     } else {
-        free(psShape);
-        return 0;
+        return SHPDecodeFailed(psShape, hArena);
     }
 
     return(psShape);
-}
-
-/**
- * return SHPType
- */
-int SHPReadObjectBounds(SHPHandle psSHP, int hEntity, SHPBounds *Bounds, double *pointEpsilon)
-{
-    int nSHPType;
-
-    if (psSHP->panRecSize[hEntity]+8 > psSHP->nBufSize) {
-        psSHP->nBufSize = psSHP->panRecSize[hEntity]+8;
-        psSHP->pabyRec = (ub1 *) SfRealloc(psSHP->pabyRec,psSHP->nBufSize);
-    }
-
-    if (fseek(psSHP->fpSHP, psSHP->panRecOffset[hEntity], 0) != 0 ||
-        fread(psSHP->pabyRec, psSHP->panRecSize[hEntity]+8, 1, psSHP->fpSHP) != 1) {
-        return (SHPT_NULL);
-    }
-
-    memcpy(&nSHPType, psSHP->pabyRec + 8, 4);
-    BO_letoh32_buf(&(nSHPType));
-
-    if (nSHPType == SHPT_POLYGON ||
-        nSHPType == SHPT_ARC ||
-        nSHPType == SHPT_POLYGONZ ||
-        nSHPType == SHPT_POLYGONM ||
-        nSHPType == SHPT_ARCZ ||
-        nSHPType == SHPT_ARCM ||
-        nSHPType == SHPT_MULTIPATCH) {
-        int nPoints, nParts, nOffset;
-
-        memcpy(&nPoints, psSHP->pabyRec + 40 + 8, 4);
-        memcpy(&nParts, psSHP->pabyRec + 36 + 8, 4);
+}
 
-        BO_letoh32_buf(&nPoints);
-        BO_letoh32_buf(&nParts);
 
-        if (nPoints <= 0) {
-            return (SHPT_NULL);
-        }
+SHPObject * SHPReadObjectR(SHPHandle psSHP, int hEntity, SHPReadBuffer *psBuf)
+{
+    return SHPDecodeObject(psSHP, hEntity, psBuf, NULL);
+}
 
-        memcpy(&(Bounds->XMin), psSHP->pabyRec + 8 +  4, 8);
-        memcpy(&(Bounds->YMin), psSHP->pabyRec + 8 + 12, 8);
-        memcpy(&(Bounds->XMax), psSHP->pabyRec + 8 + 20, 8);
-        memcpy(&(Bounds->YMax), psSHP->pabyRec + 8 + 28, 8);
 
-        BO_letoh64_buf(&(Bounds->XMin));
-        BO_letoh64_buf(&(Bounds->YMin));
-        BO_letoh64_buf(&(Bounds->XMax));
-        BO_letoh64_buf(&(Bounds->YMax));
+SHPObject * SHPReadObjectArena(SHPHandle psSHP, int hEntity, SHPArenaHandle hArena)
+{
+    return SHPDecodeObject(psSHP, hEntity, SHPArenaReadBuffer(hArena), hArena);
+}
 
-        nOffset = 44 + 8 + 4*nParts;
 
-        if (nSHPType == SHPT_MULTIPATCH) {
-            nOffset += 4*nParts;
-        }
+SHPObject * SHPReadObject(SHPHandle psSHP, int hEntity)
+{
+    return SHPReadObjectR(psSHP, hEntity, NULL);
+}
 
-        nOffset += 16*nPoints;
+/**
+ * return SHPType. Reads the record head once; points carry Z/M inside it,
+ *   other types need one more read for their Z/M ranges. Z/M are zero for
+ *   types without them.
+ */
+int SHPReadObjectBoundsR(SHPHandle psSHP, int hEntity, SHPBounds *Bounds, double *pointEpsilon, SHPReadBuffer *psBuf)
+{
+    int nSHPType, nPoints = 0, nParts = 0, bZ, bM;
+    uint32_t nHeadLen, nRecLen;
+    uint64_t nOffset, nTail;
+    const ub1 *pabyHead, *pabyTail;
 
-        if (nSHPType == SHPT_POLYGONZ ||
-            nSHPType == SHPT_ARCZ ||
-            nSHPType == SHPT_MULTIPATCH) {
-            memcpy(&(Bounds->ZMin), psSHP->pabyRec + nOffset, 8);
-            memcpy(&(Bounds->ZMax), psSHP->pabyRec + nOffset + 8, 8);
+    Bounds->ZMin = Bounds->ZMax = 0;
+    Bounds->MMin = Bounds->MMax = 0;
 
-            BO_letoh64_buf(&(Bounds->ZMin));
-            BO_letoh64_buf(&(Bounds->ZMax));
+    /* only the record head plus the Z/M ranges are read, never the vertices */
+    pabyHead = SHPFetchRecordHead(psSHP, hEntity, psBuf, &nHeadLen);
+    if (!pabyHead) {
+        return (SHPT_NULL);
+    }
 
-            nOffset += 16 + 8*nPoints;
-        }
+    nSHPType = SHPDecodeEnvelope(pabyHead, nHeadLen, &Bounds->_Env, pointEpsilon);
+    if (nSHPType == SHPT_NULL) {
+        return (SHPT_NULL);
+    }
 
-        if (psSHP->panRecSize[hEntity]+8 >= nOffset + 16 + 8*nPoints) {
-            memcpy(&(Bounds->MMin), psSHP->pabyRec + nOffset, 8);
-            memcpy(&(Bounds->MMax), psSHP->pabyRec + nOffset + 8, 8);
+    nRecLen = psSHP->panRecSize[hEntity] + 8;
 
-            BO_letoh64_buf(&(Bounds->MMin));
-            BO_letoh64_buf(&(Bounds->MMax));
-        }
-    } else if (nSHPType == SHPT_MULTIPOINT ||
-        nSHPType == SHPT_MULTIPOINTM ||
-        nSHPType == SHPT_MULTIPOINTZ) {
-        int nPoints, nOffset;
-        memcpy(&nPoints, psSHP->pabyRec + 44, 4);
+    if (nSHPType == SHPT_POINT ||
+        nSHPType == SHPT_POINTM ||
+        nSHPType == SHPT_POINTZ) {
+        /* whole point record fits in the head */
+        double Epsilon = pointEpsilon ? *pointEpsilon : 0;
 
-        BO_letoh32_buf(&nPoints);
+        nOffset = 20 + 8;
 
-        if (nPoints <= 0) {
-            return (SHPT_NULL);
+        if (nSHPType == SHPT_POINTZ && nHeadLen >= nOffset + 8) {
+            memcpy(&Bounds->ZMin, pabyHead + nOffset, 8);
+            BO_letoh64_buf(&Bounds->ZMin);
+            nOffset += 8;
         }
 
-        nOffset = 48 + 16*nPoints;
-
-        memcpy(&(Bounds->XMin), psSHP->pabyRec + 8 +  4, 8);
-        memcpy(&(Bounds->YMin), psSHP->pabyRec + 8 + 12, 8);
-        memcpy(&(Bounds->XMax), psSHP->pabyRec + 8 + 20, 8);
-        memcpy(&(Bounds->YMax), psSHP->pabyRec + 8 + 28, 8);
+        if (nSHPType != SHPT_POINT && nHeadLen >= nOffset + 8) {
+            memcpy(&Bounds->MMin, pabyHead + nOffset, 8);
+            BO_letoh64_buf(&Bounds->MMin);
+        }
 
-        BO_letoh64_buf(&(Bounds->XMin));
-        BO_letoh64_buf(&(Bounds->YMin));
-        BO_letoh64_buf(&(Bounds->XMax));
-        BO_letoh64_buf(&(Bounds->YMax));
+        Bounds->ZMax = Bounds->ZMin + Epsilon;
+        Bounds->MMax = Bounds->MMin + Epsilon;
+        return (nSHPType);
+    }
 
-        if (nSHPType == SHPT_MULTIPOINTZ) {
-            memcpy(&(Bounds->ZMin), psSHP->pabyRec + nOffset, 8);
-            memcpy(&(Bounds->ZMax), psSHP->pabyRec + nOffset + 8, 8);
+    if (SHPTypeHasParts(nSHPType)) {
+        memcpy(&nPoints, pabyHead + 40 + 8, 4);
+        memcpy(&nParts, pabyHead + 36 + 8, 4);
 
-            BO_letoh64_buf(&(Bounds->ZMin));
-            BO_letoh64_buf(&(Bounds->ZMax));
+        BO_letoh32_buf(&nPoints);
+        BO_letoh32_buf(&nParts);
 
-            nOffset += 16 + 8*nPoints;
+        if (nParts < 0) {
+            return (nSHPType);
         }
 
-        if (psSHP->panRecSize[hEntity]+8 >= nOffset + 16 + 8*nPoints) {
-            memcpy(&(Bounds->MMin), psSHP->pabyRec + nOffset, 8);
-            memcpy(&(Bounds->MMax), psSHP->pabyRec + nOffset + 8, 8);
+        nOffset = 44 + 8 + (uint64_t) 4 * nParts;
 
-            BO_letoh64_buf(&(Bounds->MMin));
-            BO_letoh64_buf(&(Bounds->MMax));
+        if (nSHPType == SHPT_MULTIPATCH) {
+            nOffset += (uint64_t) 4 * nParts;
         }
-    } else if (nSHPType == SHPT_POINT ||
-        nSHPType == SHPT_POINTM ||
-        nSHPType == SHPT_POINTZ) {
-        int nOffset;
-
-        memcpy(&Bounds->XMin, psSHP->pabyRec + 12, 8);
-        memcpy(&Bounds->YMin, psSHP->pabyRec + 20, 8);
+    } else {
+        memcpy(&nPoints, pabyHead + 44, 4);
+        BO_letoh32_buf(&nPoints);
 
-        BO_letoh64_buf(&Bounds->XMin);
-        BO_letoh64_buf(&Bounds->YMin);
+        nOffset = 48;
+    }
 
-        nOffset = 20 + 8;
+    nOffset += (uint64_t) 16 * nPoints;
 
-        if (nSHPType == SHPT_POINTZ) {
-            memcpy(&Bounds->ZMin, psSHP->pabyRec + nOffset, 8);
-            BO_letoh64_buf(&Bounds->ZMin);
-            nOffset += 8;
-        }
+    bZ = (nSHPType == SHPT_POLYGONZ ||
+        nSHPType == SHPT_ARCZ ||
+        nSHPType == SHPT_MULTIPATCH ||
+        nSHPType == SHPT_MULTIPOINTZ);
 
-        if (psSHP->panRecSize[hEntity]+8 >= nOffset + 8) {
-            memcpy(&Bounds->MMin, psSHP->pabyRec + nOffset, 8);
-            BO_letoh64_buf(&Bounds->MMin);
-        }
+    /* Z range, Z values, M range in one read; skip the Z values when long */
+    nTail = bZ ? 16 + (uint64_t) 8 * nPoints : 0;
+    bM = (nRecLen >= nOffset + nTail + 16);
 
-        if (pointEpsilon) {
-            double Epsilon = *pointEpsilon;
-            Bounds->XMax = Bounds->XMin + Epsilon;
-            Bounds->YMax = Bounds->YMin + Epsilon;
-            Bounds->ZMax = Bounds->ZMin + Epsilon;
-            Bounds->MMax = Bounds->MMin + Epsilon;
-        } else {
-            Bounds->XMax = Bounds->XMin;
-            Bounds->YMax = Bounds->YMin;
-            Bounds->ZMax = Bounds->ZMin;
-            Bounds->MMax = Bounds->MMin;
+    if (bZ && bM && nTail <= SHP_ENVELOPE_WINDOW) {
+        pabyTail = SHPFetchRecordBytes(psSHP, hEntity, (uint32_t) nOffset, (uint32_t) (nTail + 16), psBuf);
+        if (pabyTail) {
+            memcpy(&Bounds->ZMin, pabyTail, 16);
+            memcpy(&Bounds->MMin, pabyTail + nTail, 8);
+            memcpy(&Bounds->MMax, pabyTail + nTail + 8, 8);
         }
     } else {
-        return(SHPT_NULL);
+        if (bZ && nRecLen >= nOffset + 16) {
+            pabyTail = SHPFetchRecordBytes(psSHP, hEntity, (uint32_t) nOffset, 16, psBuf);
+            if (pabyTail) {
+                memcpy(&Bounds->ZMin, pabyTail, 16);
+            }
+        }
+        if (bM) {
+            pabyTail = SHPFetchRecordBytes(psSHP, hEntity, (uint32_t) (nOffset + nTail), 16, psBuf);
+            if (pabyTail) {
+                memcpy(&Bounds->MMin, pabyTail, 8);
+                memcpy(&Bounds->MMax, pabyTail + 8, 8);
+            }
+        }
     }
 
+    BO_letoh64_buf(&Bounds->ZMin);
+    BO_letoh64_buf(&Bounds->ZMax);
+    BO_letoh64_buf(&Bounds->MMin);
+    BO_letoh64_buf(&Bounds->MMax);
+
     return(nSHPType);
 }
 
 
-SHAPEFILE_API int SHPReadObjectEnvelope(SHPHandle psSHP, int hEntity, SHPEnvelope *env, double *pointEpsilon)
+int SHPReadObjectBounds(SHPHandle psSHP, int hEntity, SHPBounds *Bounds, double *pointEpsilon)
 {
-    int nSHPType;
+    return SHPReadObjectBoundsR(psSHP, hEntity, Bounds, pointEpsilon, NULL);
+}
 
-    if (psSHP->panRecSize[hEntity]+8 > psSHP->nBufSize) {
-        psSHP->nBufSize = psSHP->panRecSize[hEntity]+8;
-        psSHP->pabyRec = (ub1 *) SfRealloc(psSHP->pabyRec,psSHP->nBufSize);
-    }
 
-    if (fseek(psSHP->fpSHP, psSHP->panRecOffset[hEntity], 0) != 0 ||
-        fread(psSHP->pabyRec, psSHP->panRecSize[hEntity]+8, 1, psSHP->fpSHP) != 1) {
+int SHPReadObjectEnvelopeR(SHPHandle psSHP, int hEntity, SHPEnvelope *env, double *pointEpsilon, SHPReadBuffer *psBuf)
+{
+    uint32_t nHeadLen;
+    const ub1 *pabyHead = SHPFetchRecordHead(psSHP, hEntity, psBuf, &nHeadLen);
+    if (!pabyHead) {
         return (SHPT_NULL);
     }
+    return SHPDecodeEnvelope(pabyHead, nHeadLen, env, pointEpsilon);
+}
 
-    memcpy(&nSHPType, psSHP->pabyRec + 8, 4);
-    BO_letoh32_buf(&(nSHPType));
-
-    if (nSHPType == SHPT_POLYGON ||
-        nSHPType == SHPT_ARC ||
-        nSHPType == SHPT_POLYGONZ ||
-        nSHPType == SHPT_POLYGONM ||
-        nSHPType == SHPT_ARCZ ||
-        nSHPType == SHPT_ARCM ||
-        nSHPType == SHPT_MULTIPATCH) {
-        int nPoints, nParts;
-
-        memcpy(&nPoints, psSHP->pabyRec + 40 + 8, 4);
-        memcpy(&nParts, psSHP->pabyRec + 36 + 8, 4);
-
-        BO_letoh32_buf(&nPoints);
-        BO_letoh32_buf(&nParts);
 
-        if (nPoints <= 0) {
-            return (SHPT_NULL);
-        }
+int SHPReadObjectEnvelope(SHPHandle psSHP, int hEntity, SHPEnvelope *env, double *pointEpsilon)
+{
+    return SHPReadObjectEnvelopeR(psSHP, hEntity, env, pointEpsilon, NULL);
+}
 
-        memcpy(&(env->XMin), psSHP->pabyRec + 8 +  4, 8);
-        memcpy(&(env->YMin), psSHP->pabyRec + 8 + 12, 8);
-        memcpy(&(env->XMax), psSHP->pabyRec + 8 + 20, 8);
-        memcpy(&(env->YMax), psSHP->pabyRec + 8 + 28, 8);
 
-        BO_letoh64_buf(&(env->XMin));
-        BO_letoh64_buf(&(env->YMin));
-        BO_letoh64_buf(&(env->XMax));
-        BO_letoh64_buf(&(env->YMax));
-    } else if (nSHPType == SHPT_MULTIPOINT ||
-        nSHPType == SHPT_MULTIPOINTM ||
-        nSHPType == SHPT_MULTIPOINTZ) {
-        int nPoints;
-        memcpy(&nPoints, psSHP->pabyRec + 44, 4);
+/**
+ * Read envelopes of shapes [iFirst, iFirst+nCount) into envs. Only record
+ *   heads are touched. Records laid out in file order are served from one
+ *   read window (SHP_ENVELOPE_WINDOW bytes), so a full scan costs a few
+ *   large reads instead of one seek per record. The window is private and
+ *   filled by position, so threads may share the handle.
+ *   Null or empty shapes get an inverted envelope (XMin > XMax).
+ *   Returns count of non-null envelopes, or -1 for bad range.
+ */
+int SHPReadEnvelopes(SHPHandle psSHP, int iFirst, int nCount, SHPEnvelope *envs)
+{
+    int i, nValid = 0;
+    uint64_t nWinStart = 0, nWinLen = 0;
+    ub1 *pabyWin = NULL;
 
-        BO_letoh32_buf(&nPoints);
+    if (iFirst < 0 || nCount < 0 || (uint64_t) iFirst + nCount > (uint64_t) psSHP->nRecords) {
+        return (-1);
+    }
 
-        if (nPoints <= 0) {
-            return (SHPT_NULL);
+    if (!psSHP->pabySHPMap && nCount > 0) {
+        pabyWin = (ub1 *) SfRealloc(NULL, SHP_ENVELOPE_WINDOW);
+        if (!pabyWin) {
+            return (-1);
         }
+    }
 
-        memcpy(&(env->XMin), psSHP->pabyRec + 8 +  4, 8);
-        memcpy(&(env->YMin), psSHP->pabyRec + 8 + 12, 8);
-        memcpy(&(env->XMax), psSHP->pabyRec + 8 + 20, 8);
-        memcpy(&(env->YMax), psSHP->pabyRec + 8 + 28, 8);
-
-        BO_letoh64_buf(&(env->XMin));
-        BO_letoh64_buf(&(env->YMin));
-        BO_letoh64_buf(&(env->XMax));
-        BO_letoh64_buf(&(env->YMax));
-    } else if (nSHPType == SHPT_POINT ||
-        nSHPType == SHPT_POINTM ||
-        nSHPType == SHPT_POINTZ) {
-        memcpy(&env->XMin, psSHP->pabyRec + 12, 8);
-        memcpy(&env->YMin, psSHP->pabyRec + 20, 8);
+    for (i = 0; i < nCount; i++) {
+        int hEntity = iFirst + i;
+        uint64_t nOffset = psSHP->panRecOffset[hEntity];
+        uint32_t nHeadLen = MIN_V2(psSHP->panRecSize[hEntity] + 8, SHP_RECORD_HEAD_SIZE);
+        const ub1 *pabyHead = NULL;
 
-        BO_letoh64_buf(&env->XMin);
-        BO_letoh64_buf(&env->YMin);
+        if (psSHP->pabySHPMap) {
+            if (nOffset + nHeadLen <= (uint64_t) psSHP->nSHPMapSize) {
+                pabyHead = psSHP->pabySHPMap + nOffset;
+            }
+        } else {
+            if (nOffset < nWinStart || nOffset + nHeadLen > nWinStart + nWinLen) {
+                /* slide the window to this record, never past the end of file */
+                uint64_t nAvail = (uint64_t) psSHP->nFileSize > nOffset ? (uint64_t) psSHP->nFileSize - nOffset : 0;
+
+                nWinStart = nOffset;
+                nWinLen = MAX_V2(MIN_V2(nAvail, SHP_ENVELOPE_WINDOW), nHeadLen);
+
+                if (! SfPread(psSHP->fpSHP, pabyWin, (size_t) nWinLen, nOffset)) {
+                    /* file size in header may lie: fall back to the head */
+                    nWinLen = nHeadLen;
+                    if (! SfPread(psSHP->fpSHP, pabyWin, nHeadLen, nOffset)) {
+                        nWinLen = 0;
+                    }
+                }
+            }
+            if (nOffset + nHeadLen <= nWinStart + nWinLen) {
+                pabyHead = pabyWin + (nOffset - nWinStart);
+            }
+        }
 
-        if (pointEpsilon) {
-            double Epsilon = *pointEpsilon;
-            env->XMax = env->XMin + Epsilon;
-            env->YMax = env->YMin + Epsilon;
+        if (pabyHead && SHPDecodeEnvelope(pabyHead, nHeadLen, &envs[i], NULL) != SHPT_NULL) {
+            nValid++;
         } else {
-            env->XMax = env->XMin;
-            env->YMax = env->YMin;
+            envs[i].XMin = envs[i].YMin = DBL_MAX;
+            envs[i].XMax = envs[i].YMax = -DBL_MAX;
         }
-    } else {
-        return(SHPT_NULL);
     }
 
-    return(nSHPType);
+    SafeFree(pabyWin);
+    return nValid;
 }
 
 
@@ -1761,31 +2486,19 @@ SHAPEFILE_API int SHPReadObjectEnvelope(SHPHandle psSHP, int hEntity, SHPEnvelop
  * Read the vertices, parts, and other non-attribute information for one shape
  *   cheungmine 2008-12
  */
-int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
+int SHPReadObjectExR(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape, SHPReadBuffer *psBuf)
 {
-    /* Validate the record/entity number */
-    if (hEntity < 0 || hEntity >= psSHP->nRecords) {
-        return (SHAPEFILE_FALSE);
-    }
-
-    /* Ensure our record buffer is large enough */
-    if (psSHP->panRecSize[hEntity] + 8 > psSHP->nBufSize) {
-        psSHP->nBufSize = psSHP->panRecSize[hEntity] + 8;
-        psSHP->pabyRec = (ub1 *) SfRealloc(psSHP->pabyRec, psSHP->nBufSize);
-        if (!psSHP->pabyRec) {
-            return (SHAPEFILE_FALSE);
-        }
-    }
+    const ub1 *pabyRec;
 
-    /* Read the record */
-    if (fseek(psSHP->fpSHP, psSHP->panRecOffset[hEntity], 0) != 0 ||
-        fread(psSHP->pabyRec, psSHP->panRecSize[hEntity]+8, 1, psSHP->fpSHP) != 1) {
-        return(SHAPEFILE_FALSE);
+    /* Validate the record/entity number and fetch the record */
+    pabyRec = SHPFetchRecord(psSHP, hEntity, psBuf);
+    if (!pabyRec) {
+        return (SHAPEFILE_FALSE);
     }
 
     /* Allocate and minimally initialize the object */
     psShape->nShapeId = hEntity;
-    memcpy(&psShape->nSHPType, psSHP->pabyRec + 8, 4);
+    memcpy(&psShape->nSHPType, pabyRec + 8, 4);
     BO_letoh32_buf(&(psShape->nSHPType));
 
     /* Extract vertices for a Polygon or Arc */
@@ -1799,8 +2512,8 @@ int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
         int nPoints, nParts, i, nOffset;
 
         /* Extract part/point count, and build vertex and part arrays to proper size */
-        memcpy(&nPoints, psSHP->pabyRec + 40 + 8, 4);
-        memcpy(&nParts, psSHP->pabyRec + 36 + 8, 4);
+        memcpy(&nPoints, pabyRec + 40 + 8, 4);
+        memcpy(&nParts, pabyRec + 36 + 8, 4);
 
         BO_letoh32_buf(&nPoints);
         BO_letoh32_buf(&nParts);
@@ -1810,10 +2523,10 @@ int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
         }
 
         /* Get the X/Y bounds */
-        memcpy(&(psShape->dfXMin), psSHP->pabyRec + 8 +  4, 8);
-        memcpy(&(psShape->dfYMin), psSHP->pabyRec + 8 + 12, 8);
-        memcpy(&(psShape->dfXMax), psSHP->pabyRec + 8 + 20, 8);
-        memcpy(&(psShape->dfYMax), psSHP->pabyRec + 8 + 28, 8);
+        memcpy(&(psShape->dfXMin), pabyRec + 8 +  4, 8);
+        memcpy(&(psShape->dfYMin), pabyRec + 8 + 12, 8);
+        memcpy(&(psShape->dfXMax), pabyRec + 8 + 20, 8);
+        memcpy(&(psShape->dfYMax), pabyRec + 8 + 28, 8);
 
         BO_letoh64_buf(&(psShape->dfXMin));
         BO_letoh64_buf(&(psShape->dfYMin));
@@ -1842,7 +2555,7 @@ int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
         }
 
         /* Copy out the part array from the record */
-        memcpy(psShape->panPartStart, psSHP->pabyRec + 44 + 8, 4 * nParts);
+        memcpy(psShape->panPartStart, pabyRec + 44 + 8, 4 * nParts);
 
         for (i = 0; i < nParts; i++) {
             BO_letoh32_buf(psShape->panPartStart+i);
@@ -1854,7 +2567,7 @@ int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
 
         /* If this is a multipatch, we will also have parts types */
         if (psShape->nSHPType == SHPT_MULTIPATCH) {
-            memcpy(psShape->panPartType, psSHP->pabyRec + nOffset, 4*nParts);
+            memcpy(psShape->panPartType, pabyRec + nOffset, 4*nParts);
 
             for (i = 0; i < nParts; i++) {
                 BO_letoh32_buf(psShape->panPartType+i);
@@ -1865,8 +2578,8 @@ int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
 
         /* Copy out the vertices from the record */
         for (i = 0; i < nPoints; i++) {
-            memcpy(&psShape->pPoints[i].x, psSHP->pabyRec + nOffset + i * 16, 8);
-            memcpy(&psShape->pPoints[i].y, psSHP->pabyRec + nOffset + i * 16 + 8, 8);
+            memcpy(&psShape->pPoints[i].x, pabyRec + nOffset + i * 16, 8);
+            memcpy(&psShape->pPoints[i].y, pabyRec + nOffset + i * 16 + 8, 8);
         }
 
         for (i = 0; i < nPoints; i++) {
@@ -1878,14 +2591,14 @@ int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
 
         /* If we have a Z coordinate, collect that now */
         if (psShape->nSHPType == SHPT_POLYGONZ || psShape->nSHPType == SHPT_ARCZ || psShape->nSHPType == SHPT_MULTIPATCH) {
-            memcpy(&(psShape->dfZMin), psSHP->pabyRec + nOffset, 8);
-            memcpy(&(psShape->dfZMax), psSHP->pabyRec + nOffset + 8, 8);
+            memcpy(&(psShape->dfZMin), pabyRec + nOffset, 8);
+            memcpy(&(psShape->dfZMax), pabyRec + nOffset + 8, 8);
 
             BO_letoh64_buf(&(psShape->dfZMin));
             BO_letoh64_buf(&(psShape->dfZMax));
 
             for (i = 0; i < nPoints; i++) {
-                memcpy(psShape->padfZ + i, psSHP->pabyRec + nOffset + 16 + i*8, 8);
+                memcpy(psShape->padfZ + i, pabyRec + nOffset + 16 + i*8, 8);
             }
             for (i = 0; i < nPoints; i++) {
                 BO_letoh64_buf(psShape->padfZ + i);
@@ -1899,14 +2612,14 @@ int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
          *  (options), and the M shapes.
          */
         if (psSHP->panRecSize[hEntity]+8 >= nOffset + 16 + 8*nPoints) {
-            memcpy(&(psShape->dfMMin), psSHP->pabyRec + nOffset, 8);
-            memcpy(&(psShape->dfMMax), psSHP->pabyRec + nOffset + 8, 8);
+            memcpy(&(psShape->dfMMin), pabyRec + nOffset, 8);
+            memcpy(&(psShape->dfMMax), pabyRec + nOffset + 8, 8);
 
             BO_letoh64_buf(&(psShape->dfMMin));
             BO_letoh64_buf(&(psShape->dfMMax));
 
             for (i = 0; i < nPoints; i++) {
-                memcpy(psShape->padfM + i, psSHP->pabyRec + nOffset + 16 + i*8, 8);
+                memcpy(psShape->padfM + i, pabyRec + nOffset + 16 + i*8, 8);
                 BO_letoh64_buf(psShape->padfM + i);
             }
         }
@@ -1916,7 +2629,7 @@ int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
         /* Extract vertices for a MultiPoint */
         int nPoints, i, nOffset;
 
-        memcpy(&nPoints, psSHP->pabyRec + 44, 4);
+        memcpy(&nPoints, pabyRec + 44, 4);
         BO_letoh32_buf(&nPoints);
         if (! nPoints) {
             return SHAPEFILE_FALSE;
@@ -1929,8 +2642,8 @@ int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
             psShape->padfM = (double *) realloc(psShape->padfM, psShape->nPointsSize*sizeof(double));
         }
         for (i = 0; i < nPoints; i++) {
-            memcpy(&psShape->pPoints[i].x, psSHP->pabyRec + 48 + 16 * i, 8);
-            memcpy(&psShape->pPoints[i].y, psSHP->pabyRec + 48 + 16 * i + 8, 8);
+            memcpy(&psShape->pPoints[i].x, pabyRec + 48 + 16 * i, 8);
+            memcpy(&psShape->pPoints[i].y, pabyRec + 48 + 16 * i + 8, 8);
 
             BO_letoh64_buf(&psShape->pPoints[i].x);
             BO_letoh64_buf(&psShape->pPoints[i].y);
@@ -1938,10 +2651,10 @@ int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
         nOffset = 48 + 16*nPoints;
 
         /* Get the X/Y bounds */
-        memcpy(&(psShape->dfXMin), psSHP->pabyRec + 8 +  4, 8);
-        memcpy(&(psShape->dfYMin), psSHP->pabyRec + 8 + 12, 8);
-        memcpy(&(psShape->dfXMax), psSHP->pabyRec + 8 + 20, 8);
-        memcpy(&(psShape->dfYMax), psSHP->pabyRec + 8 + 28, 8);
+        memcpy(&(psShape->dfXMin), pabyRec + 8 +  4, 8);
+        memcpy(&(psShape->dfYMin), pabyRec + 8 + 12, 8);
+        memcpy(&(psShape->dfXMax), pabyRec + 8 + 20, 8);
+        memcpy(&(psShape->dfYMax), pabyRec + 8 + 28, 8);
 
         BO_letoh64_buf(&(psShape->dfXMin));
         BO_letoh64_buf(&(psShape->dfYMin));
@@ -1950,14 +2663,14 @@ int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
 
         /* If we have a Z coordinate, collect that now */
         if (psShape->nSHPType == SHPT_MULTIPOINTZ) {
-            memcpy(&(psShape->dfZMin), psSHP->pabyRec + nOffset, 8);
-            memcpy(&(psShape->dfZMax), psSHP->pabyRec + nOffset + 8, 8);
+            memcpy(&(psShape->dfZMin), pabyRec + nOffset, 8);
+            memcpy(&(psShape->dfZMax), pabyRec + nOffset + 8, 8);
 
             BO_letoh64_buf(&(psShape->dfZMin));
             BO_letoh64_buf(&(psShape->dfZMax));
 
             for (i = 0; i < nPoints; i++) {
-                memcpy(psShape->padfZ + i, psSHP->pabyRec + nOffset + 16 + i*8, 8);
+                memcpy(psShape->padfZ + i, pabyRec + nOffset + 16 + i*8, 8);
                 BO_letoh64_buf(psShape->padfZ + i);
             }
 
@@ -1970,14 +2683,14 @@ int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
          * (options), and the M shapes
          */
         if (psSHP->panRecSize[hEntity]+8 >= nOffset + 16 + 8*nPoints) {
-            memcpy(&(psShape->dfMMin), psSHP->pabyRec + nOffset, 8);
-            memcpy(&(psShape->dfMMax), psSHP->pabyRec + nOffset + 8, 8);
+            memcpy(&(psShape->dfMMin), pabyRec + nOffset, 8);
+            memcpy(&(psShape->dfMMax), pabyRec + nOffset + 8, 8);
 
             BO_letoh64_buf(&(psShape->dfMMin));
             BO_letoh64_buf(&(psShape->dfMMax));
 
             for (i = 0; i < nPoints; i++) {
-                memcpy(psShape->padfM + i, psSHP->pabyRec + nOffset + 16 + i*8, 8);
+                memcpy(psShape->padfM + i, pabyRec + nOffset + 16 + i*8, 8);
                 BO_letoh64_buf(psShape->padfM + i);
             }
         }
@@ -1993,8 +2706,8 @@ int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
             psShape->padfZ = (double *) realloc(psShape->padfZ, psShape->nPointsSize*sizeof(double));
             psShape->padfM = (double *) realloc(psShape->padfM, psShape->nPointsSize*sizeof(double));
         }
-        memcpy(&psShape->pPoints[0].x, psSHP->pabyRec + 12, 8);
-        memcpy(&psShape->pPoints[0].y, psSHP->pabyRec + 20, 8);
+        memcpy(&psShape->pPoints[0].x, pabyRec + 12, 8);
+        memcpy(&psShape->pPoints[0].y, pabyRec + 20, 8);
 
         BO_letoh64_buf(&psShape->pPoints[0].x);
         BO_letoh64_buf(&psShape->pPoints[0].y);
@@ -2003,32 +2716,270 @@ int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
 
         /* If we have a Z coordinate, collect that now */
         if (psShape->nSHPType == SHPT_POINTZ) {
-            memcpy(psShape->padfZ, psSHP->pabyRec + nOffset, 8);
+            memcpy(psShape->padfZ, pabyRec + nOffset, 8);
             BO_letoh64_buf(psShape->padfZ);
             nOffset += 8;
         }
 
-        /* If we have a M measure value, then read it now.  We assume
-         *  that the measure can be present for any shape if the size is
-         *  big enough, but really it will only occur for the Z shapes
-         *  (options), and the M shapes
-         */
-        if (psSHP->panRecSize[hEntity]+8 >= nOffset + 8) {
-            memcpy(psShape->padfM, psSHP->pabyRec + nOffset, 8);
-            BO_letoh64_buf(psShape->padfM);
-        }
+        /* If we have a M measure value, then read it now.  We assume
+         *  that the measure can be present for any shape if the size is
+         *  big enough, but really it will only occur for the Z shapes
+         *  (options), and the M shapes
+         */
+        if (psSHP->panRecSize[hEntity]+8 >= nOffset + 8) {
+            memcpy(psShape->padfM, pabyRec + nOffset, 8);
+            BO_letoh64_buf(psShape->padfM);
+        }
+
+        /* Since no extents are supplied in the record, apply them from the single vertex */
+        psShape->dfXMin = psShape->dfXMax = psShape->pPoints[0].x;
+        psShape->dfYMin = psShape->dfYMax = psShape->pPoints[0].y;
+        psShape->dfZMin = psShape->dfZMax = psShape->padfZ[0];
+        psShape->dfMMin = psShape->dfMMax = psShape->padfM[0];
+    } else {
+        return (SHAPEFILE_FALSE);
+    }
+    return (SHAPEFILE_TRUE);
+}
+
+
+int SHPReadObjectEx(SHPHandle psSHP, int hEntity, SHPObjectEx *psShape)
+{
+    return SHPReadObjectExR(psSHP, hEntity, psShape, NULL);
+}
+
+/**
+ * Fill view with pointers into the raw record bytes, cheap path for readers
+ *   which only scan coordinates. Counts are validated against the record
+ *   size so that a corrupt record never points past the buffer.
+ */
+int SHPReadObjectViewR(SHPHandle psSHP, int hEntity, SHPObjectView *psView, SHPReadBuffer *psBuf)
+{
+    const ub1 *pabyRec;
+    uint32_t nRecLen;
+    int nPoints, nParts, nOffset, bPoint = SHAPEFILE_FALSE;
+
+    pabyRec = SHPFetchRecord(psSHP, hEntity, psBuf);
+    if (!pabyRec) {
+        return (SHAPEFILE_FALSE);
+    }
+    nRecLen = psSHP->panRecSize[hEntity] + 8;
+
+    memset(psView, 0, sizeof(*psView));
+    psView->nShapeId = hEntity;
+
+    /* offsets below are int: records past INT_MAX are refused outright */
+    if (nRecLen < 12 || nRecLen > (uint32_t) INT_MAX) {
+        return (SHAPEFILE_FALSE);
+    }
+
+    memcpy(&psView->nSHPType, pabyRec + 8, 4);
+    BO_letoh32_buf(&psView->nSHPType);
+
+    if (SHPTypeHasParts(psView->nSHPType)) {
+        if (nRecLen < 52) {
+            return (SHAPEFILE_FALSE);
+        }
+
+        memcpy(&nPoints, pabyRec + 40 + 8, 4);
+        memcpy(&nParts, pabyRec + 36 + 8, 4);
+
+        BO_letoh32_buf(&nPoints);
+        BO_letoh32_buf(&nParts);
+
+        if (nPoints <= 0 || nParts < 0) {
+            return (SHAPEFILE_FALSE);
+        }
+
+        /* bound the counts before any offset is computed from them */
+        if (52 + (int64_t) 4 * nParts * (psView->nSHPType == SHPT_MULTIPATCH ? 2 : 1) +
+            (int64_t) 16 * nPoints > (int64_t) nRecLen) {
+            return (SHAPEFILE_FALSE);
+        }
+
+        nOffset = 44 + 8;
+        psView->pPartStart = pabyRec + nOffset;
+        nOffset += 4*nParts;
+
+        if (psView->nSHPType == SHPT_MULTIPATCH) {
+            psView->pPartType = pabyRec + nOffset;
+            nOffset += 4*nParts;
+        }
+
+        memcpy(&psView->bounds.XMin, pabyRec + 8 +  4, 8);
+        memcpy(&psView->bounds.YMin, pabyRec + 8 + 12, 8);
+        memcpy(&psView->bounds.XMax, pabyRec + 8 + 20, 8);
+        memcpy(&psView->bounds.YMax, pabyRec + 8 + 28, 8);
+    } else if (psView->nSHPType == SHPT_MULTIPOINT ||
+        psView->nSHPType == SHPT_MULTIPOINTM ||
+        psView->nSHPType == SHPT_MULTIPOINTZ) {
+        if (nRecLen < 48) {
+            return (SHAPEFILE_FALSE);
+        }
+
+        memcpy(&nPoints, pabyRec + 44, 4);
+        BO_letoh32_buf(&nPoints);
+
+        if (nPoints <= 0) {
+            return (SHAPEFILE_FALSE);
+        }
+
+        nParts = 0;
+        nOffset = 48;
+
+        memcpy(&psView->bounds.XMin, pabyRec + 8 +  4, 8);
+        memcpy(&psView->bounds.YMin, pabyRec + 8 + 12, 8);
+        memcpy(&psView->bounds.XMax, pabyRec + 8 + 20, 8);
+        memcpy(&psView->bounds.YMax, pabyRec + 8 + 28, 8);
+    } else if (psView->nSHPType == SHPT_POINT ||
+        psView->nSHPType == SHPT_POINTM ||
+        psView->nSHPType == SHPT_POINTZ) {
+        if (nRecLen < 28) {
+            return (SHAPEFILE_FALSE);
+        }
+
+        nPoints = 1;
+        nParts = 0;
+        nOffset = 12;
+        bPoint = SHAPEFILE_TRUE;
+
+        memcpy(&psView->bounds.XMin, pabyRec + 12, 8);
+        memcpy(&psView->bounds.YMin, pabyRec + 20, 8);
+    } else {
+        return (SHAPEFILE_FALSE);
+    }
+
+    /* counts come from the file: reject anything not fitting the record */
+    if ((int64_t) nOffset + (int64_t) 16 * nPoints > (int64_t) nRecLen) {
+        return (SHAPEFILE_FALSE);
+    }
+
+    BO_letoh64_buf(&psView->bounds.XMin);
+    BO_letoh64_buf(&psView->bounds.YMin);
+
+    psView->nParts = nParts;
+    psView->nVertices = nPoints;
+    psView->pXY = pabyRec + nOffset;
+    nOffset += 16*nPoints;
+
+#if BO_LITTLE_ENDIAN
+    if (((uintptr_t) psView->pXY % sizeof(double)) == 0) {
+        psView->pPoints = (const SHPPointType *) psView->pXY;
+    }
+#endif
+
+    if (bPoint) {
+        /* point: z and m follow xy without range */
+        psView->bounds.XMax = psView->bounds.XMin;
+        psView->bounds.YMax = psView->bounds.YMin;
+
+        if (psView->nSHPType == SHPT_POINTZ && nRecLen >= (uint32_t) nOffset + 8) {
+            psView->pZ = pabyRec + nOffset;
+            memcpy(&psView->bounds.ZMin, psView->pZ, 8);
+            BO_letoh64_buf(&psView->bounds.ZMin);
+            psView->bounds.ZMax = psView->bounds.ZMin;
+            nOffset += 8;
+        }
+
+        if (psView->nSHPType != SHPT_POINT && nRecLen >= (uint32_t) nOffset + 8) {
+            psView->pM = pabyRec + nOffset;
+            memcpy(&psView->bounds.MMin, psView->pM, 8);
+            BO_letoh64_buf(&psView->bounds.MMin);
+            psView->bounds.MMax = psView->bounds.MMin;
+        }
+        return (SHAPEFILE_TRUE);
+    }
+
+    BO_letoh64_buf(&psView->bounds.XMax);
+    BO_letoh64_buf(&psView->bounds.YMax);
+
+    if (psView->nSHPType == SHPT_POLYGONZ ||
+        psView->nSHPType == SHPT_ARCZ ||
+        psView->nSHPType == SHPT_MULTIPATCH ||
+        psView->nSHPType == SHPT_MULTIPOINTZ) {
+        if ((int64_t) nOffset + 16 + (int64_t) 8 * nPoints > (int64_t) nRecLen) {
+            return (SHAPEFILE_FALSE);
+        }
+
+        memcpy(&psView->bounds.ZMin, pabyRec + nOffset, 8);
+        memcpy(&psView->bounds.ZMax, pabyRec + nOffset + 8, 8);
+        BO_letoh64_buf(&psView->bounds.ZMin);
+        BO_letoh64_buf(&psView->bounds.ZMax);
+
+        psView->pZ = pabyRec + nOffset + 16;
+        nOffset += 16 + 8*nPoints;
+    }
+
+    /* measures are optional, present only if the record is big enough */
+    if ((int64_t) nRecLen >= (int64_t) nOffset + 16 + (int64_t) 8 * nPoints) {
+        memcpy(&psView->bounds.MMin, pabyRec + nOffset, 8);
+        memcpy(&psView->bounds.MMax, pabyRec + nOffset + 8, 8);
+        BO_letoh64_buf(&psView->bounds.MMin);
+        BO_letoh64_buf(&psView->bounds.MMax);
+
+        psView->pM = pabyRec + nOffset + 16;
+    }
+
+    return (SHAPEFILE_TRUE);
+}
+
+
+int SHPReadObjectView(SHPHandle psSHP, int hEntity, SHPObjectView *psView)
+{
+    return SHPReadObjectViewR(psSHP, hEntity, psView, NULL);
+}
+
+
+void SHPObjectViewGetPoint(const SHPObjectView *psView, int iVertex, SHPPointType *pt)
+{
+    if (psView->pPoints) {
+        *pt = psView->pPoints[iVertex];
+    } else {
+        memcpy(pt, (const ub1 *) psView->pXY + 16 * iVertex, 16);
+        BO_letoh64_buf(&pt->x);
+        BO_letoh64_buf(&pt->y);
+    }
+}
+
+
+/**
+ * Start vertex of part iPart, iPart == nParts gives nVertices
+ */
+int SHPObjectViewGetPartStart(const SHPObjectView *psView, int iPart)
+{
+    int32_t nStart;
+
+    if (iPart >= psView->nParts) {
+        return psView->nVertices;
+    }
+    memcpy(&nStart, (const ub1 *) psView->pPartStart + 4 * iPart, 4);
+    BO_letoh32_buf(&nStart);
+    return nStart;
+}
+
 
-        /* Since no extents are supplied in the record, apply them from the single vertex */
-        psShape->dfXMin = psShape->dfXMax = psShape->pPoints[0].x;
-        psShape->dfYMin = psShape->dfYMax = psShape->pPoints[0].y;
-        psShape->dfZMin = psShape->dfZMax = psShape->padfZ[0];
-        psShape->dfMMin = psShape->dfMMax = psShape->padfM[0];
-    } else {
-        return (SHAPEFILE_FALSE);
+double SHPObjectViewGetZ(const SHPObjectView *psView, int iVertex)
+{
+    double z = 0.0;
+    if (psView->pZ) {
+        memcpy(&z, (const ub1 *) psView->pZ + 8 * iVertex, 8);
+        BO_letoh64_buf(&z);
     }
-    return (SHAPEFILE_TRUE);
+    return z;
+}
+
+
+double SHPObjectViewGetM(const SHPObjectView *psView, int iVertex)
+{
+    double m = 0.0;
+    if (psView->pM) {
+        memcpy(&m, (const ub1 *) psView->pM + 8 * iVertex, 8);
+        BO_letoh64_buf(&m);
+    }
+    return m;
 }
 
+
 /**
  * SHPTypeName
  */
@@ -2117,352 +3068,165 @@ void  SHPDestroyObjectEx(SHPObjectEx * psShape)
 }
 
 /**
- * Reset the winding of polygon objects to adhere to the specification
+ * Reset the winding of the polygon rings of psSeq to adhere to the
+ *  specification: outer rings CW, holes CCW.
  */
-int SHPRewindObject(SHPObject *psObject)
+STATIC_INLINE int SHPCoordsRewind (int nStride, SHPCoordSeq *psSeq)
 {
     int  iOpRing, bAltered = 0;
 
-    /* Do nothing if this is not a polygon object */
-    if (psObject->nSHPType != SHPT_POLYGON &&
-        psObject->nSHPType != SHPT_POLYGONZ &&
-        psObject->nSHPType != SHPT_POLYGONM) {
-        return 0;
-    }
-
-    if (psObject->nVertices == 0 || psObject->nParts == 0) {
-        return 0;
-    }
-
     /* Process each of the rings */
-    for (iOpRing = 0; iOpRing < psObject->nParts; iOpRing++) {
-        int      bInner, iVert, nVertCount, nVertStart, iCheckRing;
+    for (iOpRing = 0; iOpRing < psSeq->nParts; iOpRing++) {
+        int      bInner, iVert, nVertStart, nVertEnd, iCheckRing;
         double   dfSum, dfTestX, dfTestY;
 
+        SHPCoordsPartRange(psSeq, iOpRing, &nVertStart, &nVertEnd);
+        if (nVertEnd <= nVertStart) {
+            continue;
+        }
+
         /* Determine if this ring is an inner ring or an outer ring
         *  relative to all the other rings.  For now we assume the
         *  first ring is outer and all others are inner, but eventually
         *  we need to fix this to handle multiple island polygons and
         *  unordered sets of rings
         */
-        dfTestX = psObject->padfX[psObject->panPartStart[iOpRing]];
-        dfTestY = psObject->padfY[psObject->panPartStart[iOpRing]];
+        dfTestX = SHPCoordX(psSeq, nStride, nVertStart);
+        dfTestY = SHPCoordY(psSeq, nStride, nVertStart);
 
         bInner = SHAPEFILE_FALSE;
-        for (iCheckRing = 0; iCheckRing < psObject->nParts; iCheckRing++) {
-            int iEdge;
-
-            if (iCheckRing == iOpRing) {
-                continue;
-            }
-
-            nVertStart = psObject->panPartStart[iCheckRing];
-
-            nVertCount = psObject->panPartStart[iCheckRing+1] - psObject->panPartStart[iCheckRing];
-
-            for (iEdge = 0; iEdge < nVertCount; iEdge++) {
-                int iNext;
-
-                if (iEdge < nVertCount-1) {
-                    iNext = iEdge+1;
-                } else {
-                    iNext = 0;
-                }
+        for (iCheckRing = 0; iCheckRing < psSeq->nParts; iCheckRing++) {
+            int start, end;
 
-                if ((psObject->padfY[iEdge+nVertStart] < dfTestY && psObject->padfY[iNext+nVertStart] >= dfTestY) ||
-                    (psObject->padfY[iNext+nVertStart] < dfTestY && psObject->padfY[iEdge+nVertStart] >= dfTestY)) {
-                    if (psObject->padfX[iEdge+nVertStart] +
-                        (dfTestY - psObject->padfY[iEdge+nVertStart]) / (psObject->padfY[iNext+nVertStart] -
-                        psObject->padfY[iEdge+nVertStart]) *
-                        (psObject->padfX[iNext+nVertStart] - psObject->padfX[iEdge+nVertStart]) < dfTestX) {
-                        bInner = !bInner;
-                    }
+            if (iCheckRing != iOpRing) {
+                SHPCoordsPartRange(psSeq, iCheckRing, &start, &end);
+                if (SHPCoordsRingContains(nStride, psSeq, start, end, dfTestX, dfTestY)) {
+                    bInner = !bInner;
                 }
             }
         }
 
         /* Determine the current order of this ring so we will know if it has to be reversed */
-        nVertStart = psObject->panPartStart[iOpRing];
-
-        nVertCount = psObject->panPartStart[iOpRing+1] - psObject->panPartStart[iOpRing];
-
         dfSum = 0.0;
-        for (iVert = nVertStart; iVert < nVertStart+nVertCount-1; iVert++) {
-            dfSum += psObject->padfX[iVert] * psObject->padfY[iVert+1] - psObject->padfY[iVert] * psObject->padfX[iVert+1];
+        for (iVert = nVertStart; iVert < nVertEnd-1; iVert++) {
+            dfSum += SHPCoordX(psSeq, nStride, iVert) * SHPCoordY(psSeq, nStride, iVert+1) -
+                SHPCoordY(psSeq, nStride, iVert) * SHPCoordX(psSeq, nStride, iVert+1);
         }
-
-        dfSum += psObject->padfX[iVert] * psObject->padfY[nVertStart] - psObject->padfY[iVert] * psObject->padfX[nVertStart];
+        dfSum += SHPCoordX(psSeq, nStride, iVert) * SHPCoordY(psSeq, nStride, nVertStart) -
+            SHPCoordY(psSeq, nStride, iVert) * SHPCoordX(psSeq, nStride, nVertStart);
 
         /* Reverse if necessary */
         if ((dfSum < 0.0 && bInner) || (dfSum > 0.0 && !bInner)) {
-            int   i;
             bAltered++;
-
-            for (i = 0; i < nVertCount/2; i++) {
-                double dfSaved;
-
-                /* Swap X */
-                dfSaved = psObject->padfX[nVertStart+i];
-                psObject->padfX[nVertStart+i] =
-                psObject->padfX[nVertStart+nVertCount-i-1];
-                psObject->padfX[nVertStart+nVertCount-i-1] = dfSaved;
-
-                /* Swap Y */
-                dfSaved = psObject->padfY[nVertStart+i];
-                psObject->padfY[nVertStart+i] =
-                psObject->padfY[nVertStart+nVertCount-i-1];
-                psObject->padfY[nVertStart+nVertCount-i-1] = dfSaved;
-
-                /* Swap Z */
-                if (psObject->padfZ) {
-                    dfSaved = psObject->padfZ[nVertStart+i];
-                    psObject->padfZ[nVertStart+i] =
-                    psObject->padfZ[nVertStart+nVertCount-i-1];
-                    psObject->padfZ[nVertStart+nVertCount-i-1] = dfSaved;
-                }
-
-                /* Swap M */
-                if (psObject->padfM) {
-                    dfSaved = psObject->padfM[nVertStart+i];
-                    psObject->padfM[nVertStart+i] =
-                    psObject->padfM[nVertStart+nVertCount-i-1];
-                    psObject->padfM[nVertStart+nVertCount-i-1] = dfSaved;
-                }
-            }
+            SHPCoordsReverse(nStride, psSeq, nVertStart, nVertEnd);
         }
     }
     return bAltered;
 }
 
-int SHPRewindObjectEx(SHPObjectEx *psObject)
+static int SHPCoordSeqRewind(SHPCoordSeq *psSeq)
 {
- int  iOpRing, bAltered = 0;
-
     /* Do nothing if this is not a polygon object */
-    if (psObject->nSHPType != SHPT_POLYGON &&
-        psObject->nSHPType != SHPT_POLYGONZ &&
-        psObject->nSHPType != SHPT_POLYGONM) {
+    if (psSeq->nSHPType != SHPT_POLYGON &&
+        psSeq->nSHPType != SHPT_POLYGONZ &&
+        psSeq->nSHPType != SHPT_POLYGONM) {
         return 0;
     }
 
-    if (psObject->nVertices == 0 || psObject->nParts == 0) {
+    if (psSeq->nVertices == 0 || psSeq->nParts == 0) {
         return 0;
     }
 
-    /* Process each of the rings */
-    for (iOpRing = 0; iOpRing < psObject->nParts; iOpRing++) {
-        int      bInner, iVert, nVertCount, nVertStart, iCheckRing;
-        double   dfSum, dfTestX, dfTestY;
-
-        /* Determine if this ring is an inner ring or an outer ring
-        *  relative to all the other rings.  For now we assume the
-        *  first ring is outer and all others are inner, but eventually
-        *  we need to fix this to handle multiple island polygons and
-        *  unordered sets of rings
-        */
-        dfTestX = psObject->pPoints[psObject->panPartStart[iOpRing]].x;
-        dfTestY = psObject->pPoints[psObject->panPartStart[iOpRing]].y;
-
-        bInner = SHAPEFILE_FALSE;
-        for (iCheckRing = 0; iCheckRing < psObject->nParts; iCheckRing++) {
-            int iEdge;
-            if (iCheckRing == iOpRing) {
-                continue;
-            }
-            nVertStart = psObject->panPartStart[iCheckRing];
-            nVertCount = psObject->panPartStart[iCheckRing+1] - psObject->panPartStart[iCheckRing];
-            for (iEdge = 0; iEdge < nVertCount; iEdge++) {
-                int iNext;
-                if (iEdge < nVertCount-1) {
-                    iNext = iEdge+1;
-                } else {
-                    iNext = 0;
-                }
-                if ((psObject->pPoints[iEdge+nVertStart].y < dfTestY && psObject->pPoints[iNext+nVertStart].y >= dfTestY) ||
-                    (psObject->pPoints[iNext+nVertStart].y < dfTestY && psObject->pPoints[iEdge+nVertStart].y >= dfTestY)) {
-                    if (psObject->pPoints[iEdge+nVertStart].x + (dfTestY - psObject->pPoints[iEdge+nVertStart].y) /
-                        (psObject->pPoints[iNext+nVertStart].y - psObject->pPoints[iEdge+nVertStart].y) *
-                        (psObject->pPoints[iNext+nVertStart].x - psObject->pPoints[iEdge+nVertStart].x) < dfTestX) {
-                        bInner = !bInner;
-                    }
-                }
-            }
-        }
-
-        /* Determine the current order of this ring so we will know if it has to be reversed */
-        nVertStart = psObject->panPartStart[iOpRing];
-        nVertCount = psObject->panPartStart[iOpRing+1] - psObject->panPartStart[iOpRing];
-        dfSum = 0.0;
-        for (iVert = nVertStart; iVert < nVertStart+nVertCount-1; iVert++) {
-            dfSum += psObject->pPoints[iVert].x * psObject->pPoints[iVert+1].y - psObject->pPoints[iVert].y * psObject->pPoints[iVert+1].x;
-        }
-        dfSum += psObject->pPoints[iVert].x * psObject->pPoints[nVertStart].y - psObject->pPoints[iVert].y * psObject->pPoints[nVertStart].x;
+    return SHPCOORDS_CALL(psSeq, SHPCoordsRewind, psSeq);
+}
 
-        /* Reverse if necessary */
-        if ((dfSum < 0.0 && bInner) || (dfSum > 0.0 && !bInner)) {
-            int   i;
-            bAltered++;
-            for (i = 0; i < nVertCount/2; i++) {
-                double dfSaved;
-
-                /* Swap X */
-                dfSaved = psObject->pPoints[nVertStart+i].x;
-                psObject->pPoints[nVertStart+i].x = psObject->pPoints[nVertStart+nVertCount-i-1].x;
-                psObject->pPoints[nVertStart+nVertCount-i-1].x = dfSaved;
-
-                /* Swap Y */
-                dfSaved = psObject->pPoints[nVertStart+i].y;
-                psObject->pPoints[nVertStart+i].y = psObject->pPoints[nVertStart+nVertCount-i-1].y;
-                psObject->pPoints[nVertStart+nVertCount-i-1].y = dfSaved;
-
-                /* Swap Z */
-                if (psObject->padfZ) {
-                    dfSaved = psObject->padfZ[nVertStart+i];
-                    psObject->padfZ[nVertStart+i] = psObject->padfZ[nVertStart+nVertCount-i-1];
-                    psObject->padfZ[nVertStart+nVertCount-i-1] = dfSaved;
-                }
+int SHPRewindObject(SHPObject *psObject)
+{
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, psObject);
+    return SHPCoordSeqRewind(&seq);
+}
 
-                /* Swap M */
-                if (psObject->padfM) {
-                    dfSaved = psObject->padfM[nVertStart+i];
-                    psObject->padfM[nVertStart+i] = psObject->padfM[nVertStart+nVertCount-i-1];
-                    psObject->padfM[nVertStart+nVertCount-i-1] = dfSaved;
-                }
-            }
-        }
-    }
-    return bAltered;
+int SHPRewindObjectEx(SHPObjectEx *psObject)
+{
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, psObject);
+    return SHPCoordSeqRewind(&seq);
 }
 
 double SHPLengthOfXYs(double *padfX, double *padfY, int start, int end)
 {
-    int i;
-    double dx, dy;
-    double sum = 0;
-    int np = end - start - 1;
-    for (i = 0; i < np; i++) {
-        dx = padfX[start + i + 1] - padfX[start + i];
-        dy = padfY[start + i + 1] - padfY[start + i];
-        sum += sqrt(dx*dx + dy*dy);
-    }
-    return sum;
+    SHPCoordSeq seq = {0};
+    seq.padfX = padfX;
+    seq.padfY = padfY;
+    seq.nStride = SHPCOORDS_SOA;
+    return SHPSimdLengthOf(&seq, start, end);
 }
 
 double SHPLengthOfPoints(SHPPointType *pPoints, int start, int end)
 {
-    int i;
-    double dx, dy;
-    double sum = 0;
-    SHPPointType *pt = pPoints + start;
-    int np = end - start - 1;
-    for (i = 0; i < np; i++) {
-        dx = pt[i+1].x - pt[i].x;
-        dy = pt[i+1].y - pt[i].y;
-        sum += sqrt(dx*dx + dy*dy);
-    }
-    return sum;
+    SHPCoordSeq seq = {0};
+    seq.padfX = &pPoints->x;
+    seq.padfY = &pPoints->y;
+    seq.nStride = SHPCOORDS_AOS;
+    return SHPSimdLengthOf(&seq, start, end);
 }
 
 double SHPAreaOfXYs(double *padfX, double *padfY, int start, int end, int *CCW)
 {
-    int i;
-    double sum = 0;
-    double *pX = padfX + start;
-    double *pY = padfY + start;
-    int np = end - start - 1;
-    for (i = 1; i < np; i++) {
-        sum += (pX[i] - pX[0]) * (pY[i+1] - pY[i-1]);
-    }
+    SHPCoordSeq seq = {0};
+    double area;
+    seq.padfX = padfX;
+    seq.padfY = padfY;
+    seq.nStride = SHPCOORDS_SOA;
+    area = SHPSimdAreaOf(&seq, start, end);
     if (CCW) {
-        *CCW = SGNOF(sum);
+        *CCW = SGNOF(area);
     }
-    return sum/2;
+    return area;
 }
 
 double SHPAreaOfPoints(SHPPointType *pPoints, int start, int end, int *CCW)
 {
-    int i;
-    double sum = 0;
-    SHPPointType *pt = pPoints + start;
-    int np = end - start - 1;
-    for (i = 1; i < np; i++) {
-        sum += (pt[i].x - pt[0].x) * (pt[i+1].y - pt[i-1].y);
-    }
+    SHPCoordSeq seq = {0};
+    double area;
+    seq.padfX = &pPoints->x;
+    seq.padfY = &pPoints->y;
+    seq.nStride = SHPCOORDS_AOS;
+    area = SHPSimdAreaOf(&seq, start, end);
     if (CCW) {
-        *CCW = SGNOF(sum);
+        *CCW = SGNOF(area);
     }
-    return sum/2;
+    return area;
 }
 
-double SHPObjectExGetLength(const SHPObjectEx *psObject)
+static double SHPCoordSeqLength(const SHPCoordSeq *psSeq)
 {
-    int iPart;
     double len = 0;
-    switch (psObject->nSHPType) {
-    /* polygon */
-    case SHPT_POLYGON:
-    case SHPT_POLYGONZ:
-    case SHPT_POLYGONM:
-    /* patches */
-    case SHPT_MULTIPATCH:
-    /* line */
-    case SHPT_ARC:
-    case SHPT_ARCZ:
-    case SHPT_ARCM:
-        for (iPart = 0; iPart < psObject->nParts; iPart++) {
-            len += SHPLengthOfPoints(psObject->pPoints, psObject->panPartStart[iPart], psObject->panPartStart[iPart+1]);
-        }
-        break;
-    /* point */
-    case SHPT_NULL:
-    case SHPT_POINT:
-    case SHPT_POINTZ:
-    case SHPT_MULTIPOINT:
-    case SHPT_MULTIPOINTZ:
-    case SHPT_POINTM:
-    case SHPT_MULTIPOINTM:
-        return 0;
+    int iPart, start, end;
+
+    for (iPart = 0; iPart < psSeq->nParts; iPart++) {
+        SHPCoordsPartRange(psSeq, iPart, &start, &end);
+        len += SHPSimdLengthOf(psSeq, start, end);
     }
     return len;
 }
 
-double SHPObjectExGetArea(const SHPObjectEx *psObject)
+static double SHPCoordSeqArea(const SHPCoordSeq *psSeq)
 {
-    int iPart;
     double area = 0;
-    switch (psObject->nSHPType) {
-    /* polygon */
-    case SHPT_POLYGON:
-    case SHPT_POLYGONZ:
-    case SHPT_POLYGONM:
-    case SHPT_MULTIPATCH:
-        for (iPart = 0; iPart < psObject->nParts; iPart++) {
-            area += SHPAreaOfPoints(psObject->pPoints, psObject->panPartStart[iPart], psObject->panPartStart[iPart+1], 0);
-        }
-        break;
-    /* line */
-    case SHPT_ARC:
-    case SHPT_ARCZ:
-    case SHPT_ARCM:
-        return 0;
-    /* point */
-    case SHPT_NULL:
-    case SHPT_POINT:
-    case SHPT_POINTZ:
-    case SHPT_MULTIPOINT:
-    case SHPT_MULTIPOINTZ:
-    case SHPT_POINTM:
-    case SHPT_MULTIPOINTM:
-        return 0;
+    int iPart, start, end;
+
+    for (iPart = 0; iPart < psSeq->nParts; iPart++) {
+        SHPCoordsPartRange(psSeq, iPart, &start, &end);
+        area += SHPSimdAreaOf(psSeq, start, end);
     }
     return area;
 }
 
-double SHPObjectGetLength(const SHPObject *psObject)
+double SHPCoordSeqGetLength(const SHPCoordSeq *psSeq)
 {
-    int iPart;
-    double len = 0;
-    switch (psObject->nSHPType) {
+    switch (psSeq->nSHPType) {
     /* polygon */
     case SHPT_POLYGON:
     case SHPT_POLYGONZ:
@@ -2473,192 +3237,112 @@ double SHPObjectGetLength(const SHPObject *psObject)
     case SHPT_ARC:
     case SHPT_ARCZ:
     case SHPT_ARCM:
-        for (iPart = 0; iPart < psObject->nParts; iPart++) {
-            len += SHPLengthOfXYs(psObject->padfX, psObject->padfY, psObject->panPartStart[iPart], psObject->panPartStart[iPart+1]);
-        }
-        break;
-    /* point */
-    case SHPT_NULL:
-    case SHPT_POINT:
-    case SHPT_POINTZ:
-    case SHPT_MULTIPOINT:
-    case SHPT_MULTIPOINTZ:
-    case SHPT_POINTM:
-    case SHPT_MULTIPOINTM:
-        return 0;
+        return SHPCoordSeqLength(psSeq);
     }
-    return len;
+    /* point */
+    return 0;
 }
 
-double SHPObjectGetArea(const SHPObject *psObject)
+double SHPCoordSeqGetArea(const SHPCoordSeq *psSeq)
 {
-    int iPart;
-    double area = 0;
-    switch (psObject->nSHPType) {
+    switch (psSeq->nSHPType) {
     /* polygon */
     case SHPT_POLYGON:
     case SHPT_POLYGONZ:
     case SHPT_POLYGONM:
     case SHPT_MULTIPATCH:
-        for (iPart = 0; iPart < psObject->nParts; iPart++) {
-            area += SHPAreaOfXYs(psObject->padfX, psObject->padfY, psObject->panPartStart[iPart], psObject->panPartStart[iPart+1], 0);
-        }
-        break;
+        return SHPCoordSeqArea(psSeq);
+    }
+    /* line, point */
+    return 0;
+}
 
-    /* line */
-    case SHPT_ARC:
-    case SHPT_ARCZ:
-    case SHPT_ARCM:
+double SHPObjectExGetLength(const SHPObjectEx *psObject)
+{
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, psObject);
+    return SHPCoordSeqGetLength(&seq);
+}
 
-    /* point */
-    case SHPT_NULL:
-    case SHPT_POINT:
-    case SHPT_POINTZ:
-    case SHPT_MULTIPOINT:
-    case SHPT_MULTIPOINTZ:
-    case SHPT_POINTM:
-    case SHPT_MULTIPOINTM:
-        return 0;
-    }
-    return area;
+double SHPObjectExGetArea(const SHPObjectEx *psObject)
+{
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, psObject);
+    return SHPCoordSeqGetArea(&seq);
 }
 
-void SHPObjectReversePoints(SHPObject *psObject)
+double SHPObjectGetLength(const SHPObject *psObject)
 {
-    if (psObject->nVertices > 1) {
-        double *x0, *x1, *y0, *y1, *z0, *z1, *m0, *m1;
-        int HasZ, HasM, start, end, p;
-        z0 = z1 = m0 = m1 = 0;
-        SHPHasZM(psObject->nSHPType, &HasZ, &HasM);
-        for (p = 0; p < psObject->nParts; p++) {
-            start = psObject->panPartStart[p];
-            end = psObject->panPartStart[p+1] - 1;
-            if (end - start > 2) {
-                x0 =  psObject->padfX + start;
-                x1 =  psObject->padfX + end;
-                y0 =  psObject->padfY + start;
-                y1 =  psObject->padfY + end;
-                if (HasZ) {
-                    z0 =  psObject->padfZ + start;
-                    z1 =  psObject->padfZ + end;
-                }
-                if (HasM) {
-                    m0 =  psObject->padfM + start;
-                    m1 =  psObject->padfM + end;
-                }
-                while (x1 > x0) {
-                    SwapDouble(x0++, x1--);
-                    SwapDouble(y0++, y1--);
-                    if (HasZ) {
-                        SwapDouble(z0++, z1--);
-                    }
-                    if (HasM) {
-                        SwapDouble(m0++, m1--);
-                    }
-                }
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, psObject);
+    return SHPCoordSeqGetLength(&seq);
+}
+
+double SHPObjectGetArea(const SHPObject *psObject)
+{
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, psObject);
+    return SHPCoordSeqGetArea(&seq);
+}
+
+static void SHPCoordSeqReversePoints(SHPCoordSeq *psSeq)
+{
+    if (psSeq->nVertices > 1) {
+        int start, end, p;
+        for (p = 0; p < psSeq->nParts; p++) {
+            SHPCoordsPartRange(psSeq, p, &start, &end);
+            /* a closed ring has at least 4 vertices */
+            if (end - start > 3) {
+                SHPCOORDS_CALL(psSeq, SHPCoordsReverse, psSeq, start, end);
             }
         }
     }
 }
 
+void SHPObjectReversePoints(SHPObject *psObject)
+{
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, psObject);
+    SHPCoordSeqReversePoints(&seq);
+}
+
 void SHPObjectExReversePoints(SHPObjectEx *psObject)
 {
-    if (psObject->nVertices > 1) {
-        SHPPointType *p0, *p1;
-        double *z0, *z1, *m0, *m1;
-        int HasZ, HasM, start, end, p;
-        z0 = z1 = m0 = m1 = 0;
-        SHPHasZM(psObject->nSHPType, &HasZ, &HasM);
-        for (p = 0; p < psObject->nParts; p++) {
-            start = psObject->panPartStart[p];
-            end = psObject->panPartStart[p+1] - 1;
-            if (end - start > 2) {
-                p0 =  psObject->pPoints + start;
-                p1 =  psObject->pPoints + end;
-                if (HasZ) {
-                    z0 =  psObject->padfZ + start;
-                    z1 =  psObject->padfZ + end;
-                }
-                if (HasM) {
-                    m0 =  psObject->padfM + start;
-                    m1 =  psObject->padfM + end;
-                }
-                while (p1 > p0) {
-                    SwapPointType(p0++, p1--);
-                    if (HasZ) {
-                        SwapDouble(z0++, z1--);
-                    }
-                    if (HasM) {
-                        SwapDouble(m0++, m1--);
-                    }
-                }
-            }
-        }
-    }
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, psObject);
+    SHPCoordSeqReversePoints(&seq);
 }
 
-int SHPObjectValidatePolygon(SHPObject *psObject, int isCCW)
+int SHPCoordSeqValidatePolygon(SHPCoordSeq *psSeq, int isCCW)
 {
     int ret;
-    double flag;
     /* Do nothing if this is not a polygon object */
-    if (psObject->nSHPType != SHPT_POLYGON && psObject->nSHPType != SHPT_POLYGONZ && psObject->nSHPType != SHPT_POLYGONM) {
+    if (psSeq->nSHPType != SHPT_POLYGON && psSeq->nSHPType != SHPT_POLYGONZ && psSeq->nSHPType != SHPT_POLYGONM) {
         /* invalid type */
         return (-1);
     }
-    ret = SHPRewindObject(psObject);
-    flag = SHPObjectGetArea(psObject);
-    if (flag > 0) {
-        if (isCCW == 1) {
-            /* required CCW is fit */
-            return ret;
-        } else {
-            /* required CW not fit */
-            SHPObjectReversePoints(psObject);
-            return 1;
-        }
-    } else {
-        if (isCCW == 1) {
-            /* required CCW not fit */
-            SHPObjectReversePoints(psObject);
-            return 1;
-        } else {
-            /* required CW is fit */
-            return ret;
-        }
+    ret = SHPCoordSeqRewind(psSeq);
+    if ((SHPCoordSeqGetArea(psSeq) > 0) != (isCCW == 1)) {
+        /* required CCW or CW not fit */
+        SHPCoordSeqReversePoints(psSeq);
+        return 1;
     }
+    /* required CCW or CW is fit */
+    return ret;
+}
+
+int SHPObjectValidatePolygon(SHPObject *psObject, int isCCW)
+{
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, psObject);
+    return SHPCoordSeqValidatePolygon(&seq, isCCW);
 }
 
 int SHPObjectExValidatePolygon(SHPObjectEx *psObject, int isCCW)
 {
-    int ret;
-    double flag;
-    /* Do nothing if this is not a polygon object */
-    if (psObject->nSHPType != SHPT_POLYGON && psObject->nSHPType != SHPT_POLYGONZ && psObject->nSHPType != SHPT_POLYGONM) {
-        /* invalid type */
-        return (-1);
-    }
-    ret = SHPRewindObjectEx(psObject);
-    flag = SHPObjectExGetArea(psObject);
-    if (flag > 0) {
-        if (isCCW == 1) {
-            /* required CCW is fit */
-            return ret;
-        } else {
-            /* required CW not fit */
-            SHPObjectExReversePoints(psObject);
-            return 1;
-        }
-    } else {
-        if (isCCW == 1) {
-            /* required CCW not fit */
-            //SHPObjectExReversePoints(psObject);
-            return 1;
-        } else {
-            /* required CW is fit */
-            return ret;
-        }
-    }
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, psObject);
+    return SHPCoordSeqValidatePolygon(&seq, isCCW);
 }
 
 int SHPObject2WKB(const SHPObject *psObject, void *wkbBuffer, double offsetX, double offsetY, double offsetZ, double offsetM)
@@ -2828,5 +3512,50 @@ int SHPMBRTreeAddShape(SHPMBRTree rtree, const SHPEnvelope *shapeEnv, void *shap
 
 int SHPMBRTreeSearch(SHPMBRTree rtree, const SHPEnvelope *searchEnv, int(* onSearchShape)(void * shapeData,  void *userParam), void *userParam)
 {
-    return RTreeSearchMbr(rtree->rtRoot, (const RTREE_MBR *)searchEnv, onSearchShape, &userParam);
+    return RTreeSearchMbr(rtree->rtRoot, (const RTREE_MBR *)searchEnv, onSearchShape, userParam);
+}
+
+int SHPMBRTreeBulkLoadEnvelopes(SHPMBRTree rtree, const SHPEnvelope *shapeEnvs, void **shapeData, int nShapes, int nMethod)
+{
+    int i, nCount = 0;
+    RTREE_BRANCH *branches = (RTREE_BRANCH *) malloc(sizeof(RTREE_BRANCH) * MAX_V2(1, nShapes));
+    if (!branches) {
+        exit(EXIT_OUTMEMORY);
+    }
+
+    for (i = 0; i < nShapes; i++) {
+        if (shapeEnvs[i].XMin > shapeEnvs[i].XMax || shapeEnvs[i].YMin > shapeEnvs[i].YMax) {
+            continue;
+        }
+        memcpy(&branches[nCount].mbr, &shapeEnvs[i], sizeof(RTREE_MBR));
+        branches[nCount].child = shapeData ? shapeData[i] : SHPMBRTreeShapeIdToData(i);
+        nCount++;
+    }
+
+    if (rtree->rtRoot) {
+        RTreeDestroy(rtree->rtRoot);
+    }
+    rtree->rtRoot = RTreeBulkLoad(branches, nCount, (nMethod == SHP_MBRTREE_HILBERT ? RTREE_BULK_HILBERT : RTREE_BULK_STR), NULL);
+
+    free(branches);
+    return nCount;
+}
+
+int SHPMBRTreeBulkLoad(SHPHandle hSHP, int nMethod)
+{
+    int nCount;
+    SHPEnvelope *shapeEnvs = (SHPEnvelope *) malloc(sizeof(SHPEnvelope) * MAX_V2(1, hSHP->nRecords));
+    if (!shapeEnvs) {
+        exit(EXIT_OUTMEMORY);
+    }
+
+    if (SHPReadEnvelopes(hSHP, 0, (int) hSHP->nRecords, shapeEnvs) < 0) {
+        free(shapeEnvs);
+        return (-1);
+    }
+
+    nCount = SHPMBRTreeBulkLoadEnvelopes(&hSHP->MBRTree, shapeEnvs, NULL, (int) hSHP->nRecords, nMethod);
+
+    free(shapeEnvs);
+    return nCount;
 }
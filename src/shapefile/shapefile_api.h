@@ -62,6 +62,16 @@ SHAPEFILE_API const char * shapefile_lib_version(const char **_libname);
 /* -------------------------------------------------------------------- */
 SHAPEFILE_API SHPHandle SHPOpen (const char *pszShapeFile, const char *pszAccess);
 
+/**
+ * SHPOpenMapped
+ *   open shapefile read-only and map the whole .shp into memory. records
+ *   are decoded straight from the mapping instead of fseek + fread.
+ *   nFlags: SHP_MAP_DEFAULT or SHP_MAP_* bits.
+ * Returns:
+ *   handle to close with SHPClose(), or NULL on error.
+ */
+SHAPEFILE_API SHPHandle SHPOpenMapped (const char *pszShapeFile, int nFlags);
+
 SHAPEFILE_API SHPHandle SHPCreate (const char *pszShapeFile, int nShapeType);
 
 SHAPEFILE_API void SHPGetInfo (SHPHandle hSHP, int *pnEntities, int *pnShapeType, double *padfMinBound, double *padfMaxBound);
@@ -72,12 +82,189 @@ SHAPEFILE_API SHPObject* SHPReadObject (SHPHandle hSHP, int iShape);
 
 SHAPEFILE_API int SHPReadObjectEx (SHPHandle psSHP, int iShape, SHPObjectEx *psShape);
 
+/**
+ * SHPReadObjectView
+ *   fill view with pointers into the record bytes of shape iShape. nothing
+ *   is allocated or copied.
+ * Returns:
+ *   SHAPEFILE_TRUE on success, SHAPEFILE_FALSE for bad id, null or corrupt shape.
+ */
+SHAPEFILE_API int SHPReadObjectView (SHPHandle hSHP, int iShape, SHPObjectView *psView);
+
+SHAPEFILE_API void SHPObjectViewGetPoint (const SHPObjectView *psView, int iVertex, SHPPointType *pt);
+
+SHAPEFILE_API int SHPObjectViewGetPartStart (const SHPObjectView *psView, int iPart);
+
+SHAPEFILE_API double SHPObjectViewGetZ (const SHPObjectView *psView, int iVertex);
+
+SHAPEFILE_API double SHPObjectViewGetM (const SHPObjectView *psView, int iVertex);
+
 SHAPEFILE_API int SHPReadObjectBounds (SHPHandle hSHP, int iShape, SHPBounds *Bounds, double *pointEpsilon);
 
 SHAPEFILE_API int SHPReadObjectEnvelope (SHPHandle hSHP, int iShape, SHPEnvelope *rect, double *pointEpsilon);
 
+/**
+ * SHPReadEnvelopes
+ *   read 2D envelopes of nCount shapes starting at iFirst, touching only the
+ *   record heads. null shapes get an inverted envelope (XMin > XMax).
+ *   reentrant: reads by position into a private window.
+ * Returns:
+ *   number of non-null envelopes, -1 on bad range or out of memory.
+ */
+SHAPEFILE_API int SHPReadEnvelopes (SHPHandle hSHP, int iFirst, int nCount, SHPEnvelope *envs);
+
+/**
+ * SHPComputeLayerMetrics
+ *   fill the arrays of psOut picked by nFlags (SHP_METRIC_*) for nCount
+ *   shapes starting at iFirst, decoding each record in place: no
+ *   SHPObject is built. null and corrupt shapes get 0 and an inverted
+ *   envelope. reentrant: threads may share one read-only handle, each
+ *   passing its own range.
+ * Returns:
+ *   number of non-null shapes, -1 on bad range, missing array or out
+ *   of memory.
+ */
+SHAPEFILE_API int SHPComputeLayerMetrics (SHPHandle hSHP, int iFirst, int nCount, int nFlags, SHPLayerMetrics *psOut);
+
+/* -------------------------------------------------------------------- */
+/*      Reentrant readers: records are read into psBuf by position      */
+/*      (pread) and never through the handle's FILE cursor or scratch   */
+/*      buffer, so any number of threads can share one read-only handle */
+/*      and its SHX index, each passing its own SHPReadBuffer. psBuf is */
+/*      not used by handles from SHPOpenMapped(). NULL psBuf falls back */
+/*      to the non-reentrant shared buffer.                             */
+/* -------------------------------------------------------------------- */
+SHAPEFILE_API SHPObject* SHPReadObjectR (SHPHandle hSHP, int iShape, SHPReadBuffer *psBuf);
+
+SHAPEFILE_API int SHPReadObjectExR (SHPHandle hSHP, int iShape, SHPObjectEx *psShape, SHPReadBuffer *psBuf);
+
+SHAPEFILE_API int SHPReadObjectViewR (SHPHandle hSHP, int iShape, SHPObjectView *psView, SHPReadBuffer *psBuf);
+
+SHAPEFILE_API int SHPReadObjectBoundsR (SHPHandle hSHP, int iShape, SHPBounds *Bounds, double *pointEpsilon, SHPReadBuffer *psBuf);
+
+SHAPEFILE_API int SHPReadObjectEnvelopeR (SHPHandle hSHP, int iShape, SHPEnvelope *rect, double *pointEpsilon, SHPReadBuffer *psBuf);
+
+SHAPEFILE_API void SHPReadBufferFree (SHPReadBuffer *psBuf);
+
+/* -------------------------------------------------------------------- */
+/*      Arena: shapes read in a batch and dropped together. one arena   */
+/*      per thread, as it also holds the record buffer of its reads.    */
+/* -------------------------------------------------------------------- */
+
+/**
+ * SHPArenaCreate
+ *   create an empty arena growing by nBlockSize bytes (0 for default).
+ * Returns:
+ *   handle to destroy with SHPArenaDestroy(), NULL on out of memory.
+ */
+SHAPEFILE_API SHPArenaHandle SHPArenaCreate (size_t nBlockSize);
+
+/**
+ * SHPArenaAlloc
+ *   nBytes from hArena, 16-byte aligned and not zeroed, valid until
+ *   the next SHPArenaReset() or SHPArenaDestroy().
+ * Returns:
+ *   memory, NULL on out of memory.
+ */
+SHAPEFILE_API void * SHPArenaAlloc (SHPArenaHandle hArena, size_t nBytes);
+
+/**
+ * SHPArenaReset
+ *   release everything allocated from hArena at once, keeping its
+ *   memory for the next batch.
+ */
+SHAPEFILE_API void SHPArenaReset (SHPArenaHandle hArena);
+
+SHAPEFILE_API void SHPArenaDestroy (SHPArenaHandle hArena);
+
+/**
+ * SHPReadObjectArena
+ *   same as SHPReadObject, but the object and all its arrays come from
+ *   hArena. never pass it to SHPDestroyObject(): it lives until hArena
+ *   is reset or destroyed.
+ * Returns:
+ *   shape object, NULL for null shape or on error.
+ */
+SHAPEFILE_API SHPObject* SHPReadObjectArena (SHPHandle hSHP, int iShape, SHPArenaHandle hArena);
+
+/* -------------------------------------------------------------------- */
+/*      Prepared polygon: edges indexed by y band for repeated point    */
+/*      in polygon tests. read-only once built, so any number of        */
+/*      threads may test against one.                                   */
+/* -------------------------------------------------------------------- */
+
+/**
+ * SHPPreparePolygon
+ *   index the rings of a polygon shape. the object is not referenced
+ *   afterwards.
+ * Returns:
+ *   handle to free with SHPPreparedPolygonDestroy(), NULL if not a
+ *   polygon, empty, with a NaN or infinite coordinate or out of memory.
+ */
+SHAPEFILE_API SHPPreparedPolygonHandle SHPPreparePolygon (const SHPObject *psObject);
+
+SHAPEFILE_API SHPPreparedPolygonHandle SHPPreparePolygonEx (const SHPObjectEx *psObject);
+
+SHAPEFILE_API void SHPPreparedPolygonDestroy (SHPPreparedPolygonHandle hPrepared);
+
+SHAPEFILE_API void SHPPreparedPolygonGetEnvelope (SHPPreparedPolygonHandle hPrepared, SHPEnvelope *env);
+
+/**
+ * SHPPreparedPolygonContains
+ *   even-odd test of (x, y) over all rings, so holes are outside. same
+ *   answer as a plain crossing test of the rings; points right on the
+ *   boundary may fall either side.
+ * Returns:
+ *   SHAPEFILE_TRUE if inside.
+ */
+SHAPEFILE_API int SHPPreparedPolygonContains (SHPPreparedPolygonHandle hPrepared, double x, double y);
+
+/**
+ * SHPPreparedPolygonClassifyXYs
+ *   pabyInside[i] = 1 if point i is inside, 0 if not.
+ * Returns:
+ *   number of points inside.
+ */
+SHAPEFILE_API int SHPPreparedPolygonClassifyXYs (SHPPreparedPolygonHandle hPrepared,
+    const double *padfX, const double *padfY, int nPoints, unsigned char *pabyInside);
+
+SHAPEFILE_API int SHPPreparedPolygonClassifyPoints (SHPPreparedPolygonHandle hPrepared,
+    const SHPPointType *pPoints, int nPoints, unsigned char *pabyInside);
+
 SHAPEFILE_API int SHPWriteObject (SHPHandle hSHP, int iShape, SHPObject *psObject);
 
+/* -------------------------------------------------------------------- */
+/*      Streaming bulk writer: appends records to a new .shp/.shx pair  */
+/*      through one reusable output buffer, writes .shx entries in      */
+/*      blocks and patches both headers once at close.                 */
+/* -------------------------------------------------------------------- */
+
+/**
+ * SHPWriterOpen
+ *   create (truncate) the .shp and .shx of pszShapeFile for appending.
+ *   nBufferSize: bytes of records buffered per write, 0 for default.
+ * Returns:
+ *   handle to close with SHPWriterClose(), or NULL on error.
+ */
+SHAPEFILE_API SHPWriterHandle SHPWriterOpen (const char *pszShapeFile, int nShapeType, int nBufferSize);
+
+/**
+ * SHPWriterAppend
+ *   append psObject (of the writer's type or SHPT_NULL) as next record.
+ *   file bounds are taken from the object extents (SHPComputeExtents).
+ * Returns:
+ *   shape id of the record, or -1 on error.
+ */
+SHAPEFILE_API int SHPWriterAppend (SHPWriterHandle hWriter, const SHPObject *psObject);
+
+/**
+ * SHPWriterClose
+ *   flush the records, write the headers and close both files.
+ * Returns:
+ *   SHAPEFILE_TRUE if everything was written, SHAPEFILE_FALSE otherwise.
+ */
+SHAPEFILE_API int SHPWriterClose (SHPWriterHandle hWriter);
+
 SHAPEFILE_API void SHPDestroyObject (SHPObject * psObject);
 
 SHAPEFILE_API SHPObjectEx* SHPCreateObjectEx (SHPObjectEx ** ppsObject);
@@ -86,6 +273,8 @@ SHAPEFILE_API void SHPDestroyObjectEx (SHPObjectEx *psObject);
 
 SHAPEFILE_API void SHPComputeExtents (SHPObject *psObject);
 
+SHAPEFILE_API void SHPComputeExtentsEx (SHPObjectEx *psObject);
+
 SHAPEFILE_API SHPObject* SHPCreateObject (int nSHPType, int nShapeId,
     int nParts, const int *panPartStart, const int *panPartType,
     int nVertices, const double *padfX, const double *padfY, const double *padfZ, const double *padfM);
@@ -117,6 +306,23 @@ SHAPEFILE_API double SHPAreaOfXYs (double *padfX, double *padfY, int start, int
 
 SHAPEFILE_API double SHPAreaOfPoints (SHPPointType *pPoints, int start, int end, int *CCW);
 
+/**
+ * SHPGetSimdName
+ *   kernels used for length, area and extents: "avx2", "sse2", "neon" or
+ *   "scalar". the widest the CPU supports is picked at first use; all of
+ *   them give the same results.
+ */
+SHAPEFILE_API const char * SHPGetSimdName (void);
+
+/**
+ * SHPSetSimdName
+ *   force the kernels by name, NULL for the default. not thread safe:
+ *   call before any work starts.
+ * Returns:
+ *   SHAPEFILE_TRUE, SHAPEFILE_FALSE if not available on this CPU.
+ */
+SHAPEFILE_API int SHPSetSimdName (const char *pszName);
+
 SHAPEFILE_API double SHPObjectExGetLength (const SHPObjectEx *psObject);
 
 /**
@@ -167,9 +373,52 @@ SHAPEFILE_API int SHPObjectValidatePolygon (SHPObject *psObject, int isCCW);
  */
 SHAPEFILE_API int SHPObjectExValidatePolygon (SHPObjectEx *psObject, int isCCW);
 
+/**
+ * SHPObjectSimplify
+ *   drop the vertices of lines and polygon rings that matter less than
+ *   dfTolerance: a distance for SHP_SIMPLIFY_DP, an area for
+ *   SHP_SIMPLIFY_VW. part ends are kept and rings thinner than the
+ *   tolerance are dropped. with SHP_SIMPLIFY_TOPOLOGY no vertex is dropped
+ *   if that makes parts of the shape cross or touch, and rings keep at
+ *   least 3 corners. other types are copied as they are.
+ * Returns:
+ *   new object to free with SHPDestroyObject(), SHPT_NULL if nothing is
+ *   left. NULL if out of memory.
+ */
+SHAPEFILE_API SHPObject* SHPObjectSimplify (const SHPObject *psObject, double dfTolerance, int nFlags);
+
+/**
+ * SHPObjectExSimplify
+ *   same in place.
+ * Returns:
+ *   number of vertices left, -1 on error.
+ */
+SHAPEFILE_API int SHPObjectExSimplify (SHPObjectEx *psObject, double dfTolerance, int nFlags);
+
+/**
+ * SHPWriteSimplifiedLayers
+ *   write the layer simplified at each of nLevels ascending tolerances
+ *   (SHPObjectSimplify) as "<layer>_L1" to "<layer>_L<nLevels>", level i
+ *   simplified from level i - 1. shape ids stay the same, so .dbf, .prj
+ *   and .cpg are copied beside each level.
+ * Returns:
+ *   SHAPEFILE_SUCCESS or SHAPEFILE_ERROR
+ */
+SHAPEFILE_API int SHPWriteSimplifiedLayers (SHPHandle hSHP, const char *pszLayer,
+    const double *padfTolerances, int nLevels, int nFlags);
+
 SHAPEFILE_API int SHPObject2WKB (const SHPObject *psObject, void *wkbBuffer,
     double offsetX, double offsetY, double offsetZ, double offsetM);
 
+/**
+ * SHPObject2WKT
+ *   write psObject as WKT to wktBuffer, or only compute its exact length
+ *   if wktBuffer is NULL (as costly as writing it). each nDecimals* is either the fixed number of
+ *   decimals ("%.*f") or SHP_DECIMALS_SHORTEST.
+ * Returns:
+ *   length of WKT text without the terminating NUL, -1 for null shape
+ *   or if the text with its NUL would not fit in an int.
+ */
 SHAPEFILE_API int SHPObject2WKT (const SHPObject *psObject, char *wktBuffer,
     double offsetX, double offsetY, double offsetZ, double offsetM,
     int nDecimalsXY, int nDecimalsZ, int nDecimalsM);
@@ -177,10 +426,180 @@ SHAPEFILE_API int SHPObject2WKT (const SHPObject *psObject, char *wktBuffer,
 SHAPEFILE_API int SHPObjectEx2WKB (const SHPObjectEx *psObject, void *wkbBuffer,
     double offsetX, double offsetY, double offsetZ, double offsetM);
 
+/**
+ * SHPObject2WKBFormat
+ *   write psObject as WKB to wkbBuffer, or only compute its size if
+ *   wkbBuffer is NULL. nWkbFlags is SHP_WKB_XDR or SHP_WKB_NDR, with
+ *   SHP_WKB_EWKB for PostGIS extended WKB, which embeds nSRID if > 0.
+ *   NDR output of an SHPObjectEx without offsets copies its points as
+ *   they are on little-endian hosts.
+ * Returns:
+ *   size of WKB in bytes, -1 for null shape.
+ */
+SHAPEFILE_API int SHPObject2WKBFormat (const SHPObject *psObject, void *wkbBuffer,
+    int nWkbFlags, int nSRID,
+    double offsetX, double offsetY, double offsetZ, double offsetM);
+
+SHAPEFILE_API int SHPObjectEx2WKBFormat (const SHPObjectEx *psObject, void *wkbBuffer,
+    int nWkbFlags, int nSRID,
+    double offsetX, double offsetY, double offsetZ, double offsetM);
+
 SHAPEFILE_API int SHPObjectEx2WKT (const SHPObjectEx *psObject, char *wktBuffer,
     double offsetX, double offsetY, double offsetZ, double offsetM,
     int nDecimalsXY, int nDecimalsZ, int nDecimalsM);
 
+/**
+ * SHPObject2WKTn
+ *   same as SHPObject2WKT, but writes at most cbBuffer chars including
+ *   the terminating NUL, which is always written if cbBuffer > 0.
+ * Returns:
+ *   length of the whole WKT text without NUL as snprintf() does: the
+ *   text was cut if it is not less than cbBuffer. -1 for null shape or
+ *   if the whole text with its NUL would not fit in an int.
+ */
+SHAPEFILE_API int SHPObject2WKTn (const SHPObject *psObject, char *wktBuffer, int cbBuffer,
+    double offsetX, double offsetY, double offsetZ, double offsetM,
+    int nDecimalsXY, int nDecimalsZ, int nDecimalsM);
+
+SHAPEFILE_API int SHPObjectEx2WKTn (const SHPObjectEx *psObject, char *wktBuffer, int cbBuffer,
+    double offsetX, double offsetY, double offsetZ, double offsetM,
+    int nDecimalsXY, int nDecimalsZ, int nDecimalsM);
+
+/**
+ * SHPObject2WKTSize
+ *   upper bound of the WKT buffer size for psObject, got from the
+ *   magnitude of its coordinates without formatting any number. with
+ *   fixed decimals it is usually within a few percent of the text.
+ * Returns:
+ *   buffer size including the terminating NUL, -1 for null shape or
+ *   if the size does not fit in an int.
+ */
+SHAPEFILE_API int SHPObject2WKTSize (const SHPObject *psObject,
+    double offsetX, double offsetY, double offsetZ, double offsetM,
+    int nDecimalsXY, int nDecimalsZ, int nDecimalsM);
+
+SHAPEFILE_API int SHPObjectEx2WKTSize (const SHPObjectEx *psObject,
+    double offsetX, double offsetY, double offsetZ, double offsetM,
+    int nDecimalsXY, int nDecimalsZ, int nDecimalsM);
+
+/**
+ * SHPFormatDouble
+ *   write dValue to pszBuf, which holds SHP_DOUBLE_BUFSIZE chars, with
+ *   '.' as decimal point whatever the locale. nDecimals >= 0 gives the
+ *   same text as "%.*f" (at most SHP_DECIMALS_MAX decimals), and
+ *   SHP_DECIMALS_SHORTEST the shortest text that strtod() reads back
+ *   to dValue.
+ * Returns:
+ *   length of the text.
+ */
+SHAPEFILE_API int SHPFormatDouble (char *pszBuf, double dValue, int nDecimals);
+
+
+/* -------------------------------------------------------------------- */
+/*      PostgreSQL binary COPY stream                                   */
+/* -------------------------------------------------------------------- */
+
+/**
+ * SHPPgCopyOpen
+ *   start a COPY ... FROM STDIN (FORMAT binary) stream to pfnSink, one
+ *   tuple per record: the shape of hSHP as EWKB with nSRID (if > 0), then
+ *   the fields of hDBF. either handle may be NULL. text columns carry the
+ *   dbf bytes as they are, so client_encoding must match the dbf code page.
+ * Returns:
+ *   handle to close with SHPPgCopyClose(), NULL on error.
+ */
+SHAPEFILE_API SHPPgCopyHandle SHPPgCopyOpen (SHPHandle hSHP, DBFHandle hDBF, int nSRID,
+    SHPStreamSink pfnSink, void *pvSink);
+
+SHAPEFILE_API int SHPPgCopyGetColumnCount (SHPPgCopyHandle hCopy);
+
+/**
+ * SHPPgCopyGetColumnType
+ *   PostgreSQL type the table column iColumn must have: "geometry" for
+ *   the shape, then for each dbf field "int4" or "int8" (N without
+ *   decimals up to 9 or 18 digits), "float8", "bool", "date" or "text".
+ * Returns:
+ *   type name, NULL if iColumn is out of range.
+ */
+SHAPEFILE_API const char * SHPPgCopyGetColumnType (SHPPgCopyHandle hCopy, int iColumn);
+
+/**
+ * SHPPgCopyWriteRecords
+ *   append tuples of records [iFirst, iFirst+nCount), reading attributes
+ *   in batches.
+ * Returns:
+ *   number of tuples written (clipped to the record count), -1 on error
+ *   or if the sink failed.
+ */
+SHAPEFILE_API int SHPPgCopyWriteRecords (SHPPgCopyHandle hCopy, int iFirst, int nCount);
+
+/**
+ * SHPPgCopyClose
+ *   write the stream trailer, flush to the sink and free hCopy.
+ * Returns:
+ *   SHAPEFILE_TRUE if the whole stream went to the sink.
+ */
+SHAPEFILE_API int SHPPgCopyClose (SHPPgCopyHandle hCopy);
+
+
+/* -------------------------------------------------------------------- */
+/*      GeoJSON (RFC 7946)                                              */
+/* -------------------------------------------------------------------- */
+
+/**
+ * SHPObject2GeoJSON
+ *   write psObject as a GeoJSON geometry object to jsonBuffer, at most
+ *   cbBuffer chars including the terminating NUL, or only compute its
+ *   exact length if jsonBuffer is NULL. Z is kept and M dropped. rings
+ *   are told apart by their stored winding (CW exterior, CCW hole).
+ *   nFlags may be SHP_GEOJSON_RFC7946 to validate a copy of a polygon
+ *   as SHPObjectValidatePolygon(psObject, 0) does and then wind its
+ *   exteriors CCW and holes CW. psObject is not changed.
+ *   nDecimals is the fixed number of decimals or SHP_DECIMALS_SHORTEST.
+ * Returns:
+ *   length of the whole text without NUL as snprintf() does: the text
+ *   was cut if it is not less than cbBuffer. null shape gives "null".
+ *   -1 on out of memory or if the text does not fit in an int.
+ */
+SHAPEFILE_API int SHPObject2GeoJSON (const SHPObject *psObject, char *jsonBuffer, int cbBuffer,
+    int nFlags, int nDecimals);
+
+SHAPEFILE_API int SHPObjectEx2GeoJSON (const SHPObjectEx *psObject, char *jsonBuffer, int cbBuffer,
+    int nFlags, int nDecimals);
+
+/**
+ * SHPGeoJSONOpen
+ *   start a FeatureCollection stream to pfnSink, one Feature per record
+ *   with the record number as "id", the shape of hSHP as "geometry" and
+ *   the fields of hDBF as "properties". either handle may be NULL. with
+ *   SHP_GEOJSON_RFC7946 polygons are validated before they are written.
+ *   strings keep well-formed UTF-8 as it is and escape any other byte
+ *   from 0x80 as the Latin-1 char of that code, so the stream is valid
+ *   JSON whatever the code page of the dbf.
+ * Returns:
+ *   handle to close with SHPGeoJSONClose(), NULL on error.
+ */
+SHAPEFILE_API SHPGeoJSONHandle SHPGeoJSONOpen (SHPHandle hSHP, DBFHandle hDBF, int nFlags, int nDecimals,
+    SHPStreamSink pfnSink, void *pvSink);
+
+/**
+ * SHPGeoJSONWriteRecords
+ *   append features of records [iFirst, iFirst+nCount), reading
+ *   attributes in batches.
+ * Returns:
+ *   number of features written (clipped to the record count), -1 on
+ *   error or if the sink failed.
+ */
+SHAPEFILE_API int SHPGeoJSONWriteRecords (SHPGeoJSONHandle hJSON, int iFirst, int nCount);
+
+/**
+ * SHPGeoJSONClose
+ *   close the FeatureCollection, flush to the sink and free hJSON.
+ * Returns:
+ *   SHAPEFILE_TRUE if the whole stream went to the sink.
+ */
+SHAPEFILE_API int SHPGeoJSONClose (SHPGeoJSONHandle hJSON);
+
 
 /*************************************************************************
  *                             SHPTree Index API
@@ -192,12 +611,44 @@ SHAPEFILE_API void  SHPDestroyTree (SHPTreeHandle hTree);
 
 SHAPEFILE_API int SHPTreeAddShapeId (SHPTreeHandle hTree, SHPObject *psObject);
 
+SHAPEFILE_API int SHPTreeAddShapeBounds (SHPTreeHandle hTree, int nShapeId, const SHPBounds *psBounds);
+
 SHAPEFILE_API void  SHPTreeTrimExtraNodes (SHPTreeHandle hTree);
 
 SHAPEFILE_API int*  SHPTreeFindLikelyShapes (SHPTreeHandle hTree, double *padfBoundsMin, double *padfBoundsMax, int *pnShapeCount);
 
 SHAPEFILE_API int SHPCheckBoundsOverlap (double *padfBox1Min, double *padfBox1Max, double *padfBox2Min, double *padfBox2Max, int nDimension);
 
+/**
+ * SHPWriteTree
+ *   write the tree to a quadtree index file (.qix) readable by shapelib,
+ *   MapServer and GDAL.
+ * Returns:
+ *   SHAPEFILE_TRUE on success
+ */
+SHAPEFILE_API int SHPWriteTree (SHPTreeHandle hTree, const char *pszFilename);
+
+/**
+ * SHPOpenDiskTree
+ *   open a .qix file. searches read only the nodes overlapping the search
+ *   box from the file, the tree is never loaded into memory.
+ */
+SHAPEFILE_API SHPTreeDiskHandle SHPOpenDiskTree (const char *pszQIXFilename);
+
+SHAPEFILE_API void SHPCloseDiskTree (SHPTreeDiskHandle hDiskTree);
+
+SHAPEFILE_API void SHPDiskTreeGetInfo (SHPTreeDiskHandle hDiskTree, int *pnShapeCount, int *pnMaxDepth);
+
+/**
+ * SHPSearchDiskTreeEx
+ *   find candidate shapes as SHPTreeFindLikelyShapes() does.
+ * Returns:
+ *   sorted shapeids the caller must free(), NULL on a corrupt file
+ */
+SHAPEFILE_API int* SHPSearchDiskTreeEx (SHPTreeDiskHandle hDiskTree, double *padfBoundsMin, double *padfBoundsMax, int *pnShapeCount);
+
+SHAPEFILE_API int* SHPSearchDiskTree (FILE *fp, double *padfBoundsMin, double *padfBoundsMax, int *pnShapeCount);
+
 
 /*************************************************************************
  *                             SHAPES MBR Tree API
@@ -208,8 +659,125 @@ SHAPEFILE_API SHPMBRTree SHPGetMBRTree (SHPHandle hSHP);
 
 SHAPEFILE_API int SHPMBRTreeAddShape(SHPMBRTree rtree, const SHPEnvelope *shapeEnv, void *shapeData, int treeLevel);
 
+/**
+ * SHPMBRTreeBulkLoad
+ *   replace the MBR tree of hSHP by a packed tree over all non-null shapes,
+ *   built in one pass from bounds-only reads. shapeData passed to search
+ *   callbacks is SHPMBRTreeShapeIdToData(shapeId).
+ *   nMethod: SHP_MBRTREE_STR or SHP_MBRTREE_HILBERT
+ * Returns:
+ *   number of shapes indexed, -1 on error.
+ */
+SHAPEFILE_API int SHPMBRTreeBulkLoad (SHPHandle hSHP, int nMethod);
+
+/**
+ * SHPMBRTreeBulkLoadEnvelopes
+ *   replace the content of rtree by a packed tree over nShapes envelopes.
+ *   shapeData[i] must not be NULL; if shapeData is NULL then
+ *   SHPMBRTreeShapeIdToData(i) is used. envelopes with XMin > XMax are skipped.
+ * Returns:
+ *   number of envelopes indexed.
+ */
+SHAPEFILE_API int SHPMBRTreeBulkLoadEnvelopes (SHPMBRTree rtree, const SHPEnvelope *shapeEnvs, void **shapeData, int nShapes, int nMethod);
+
 SHAPEFILE_API int SHPMBRTreeSearch (SHPMBRTree rtree, const SHPEnvelope *searchEnv, int(* onSearchShape)(void * shapeData,  void *userParam), void *userParam);
 
+/*************************************************************************
+ *                   Point to polygon spatial join
+ ************************************************************************/
+/**
+ * SHPSpatialJoinXYs
+ *   find for each point (padfX[i], padfY[i]) the polygon of hPolygons
+ *   containing it: candidates from the MBR tree of hPolygons, which is
+ *   bulk loaded here if empty (it must hold SHPMBRTreeShapeIdToData ids),
+ *   then an exact test on prepared polygons. where polygons overlap the
+ *   lowest shape id wins.
+ *   points are taken in Hilbert order by nThreads threads (0: one per
+ *   cpu), so results come in batches of no particular order. onJoin is
+ *   called by one thread at a time. hPolygons must be opened read-only.
+ * Returns:
+ *   number of points inside a polygon, -1 on error.
+ */
+SHAPEFILE_API int SHPSpatialJoinXYs (SHPHandle hPolygons, const double *padfX, const double *padfY, int nPoints,
+    int nThreads, SHPJoinSink onJoin, void *pvSink);
+
+/**
+ * SHPSpatialJoinLayer
+ *   same for the shapes of a point layer, reported by shape id. null
+ *   shapes are skipped.
+ */
+SHAPEFILE_API int SHPSpatialJoinLayer (SHPHandle hPolygons, SHPHandle hPoints,
+    int nThreads, SHPJoinSink onJoin, void *pvSink);
+
+/*************************************************************************
+ *                   Packed RTree index file (.rtx) API
+ ************************************************************************/
+/**
+ * SHPWriteRTreeFile
+ *   build a packed rtree over hSHP (nMethod: SHP_MBRTREE_STR or
+ *   SHP_MBRTREE_HILBERT) and write it beside the layer as "<layer>.rtx".
+ * Returns:
+ *   SHAPEFILE_SUCCESS or SHAPEFILE_ERROR
+ */
+SHAPEFILE_API int SHPWriteRTreeFile (SHPHandle hSHP, const char *pszLayer, int nMethod);
+
+/**
+ * SHPOpenRTreeFile
+ *   map "<layer>.rtx" for searching, nothing is deserialized. if hSHP is
+ *   not NULL an index written for a different record count is rejected.
+ */
+SHAPEFILE_API SHPRTreeFile SHPOpenRTreeFile (const char *pszLayer, SHPHandle hSHP);
+
+SHAPEFILE_API void SHPCloseRTreeFile (SHPRTreeFile rtx);
+
+SHAPEFILE_API void SHPRTreeFileGetInfo (SHPRTreeFile rtx, int *pnShapes, int *pnNodes, int *pnHeight, SHPEnvelope *bounds);
+
+/**
+ * SHPRTreeFileSearch
+ *   same as SHPMBRTreeSearch on a tree from SHPMBRTreeBulkLoad(): shapeData
+ *   is SHPMBRTreeShapeIdToData(shapeId), returning 0 stops the search.
+ * Returns:
+ *   number of hits
+ */
+SHAPEFILE_API int SHPRTreeFileSearch (SHPRTreeFile rtx, const SHPEnvelope *searchEnv, int(* onSearchShape)(void * shapeData,  void *userParam), void *userParam);
+
+/*************************************************************************
+ *                   ESRI SBN spatial index (.sbn) API
+ ************************************************************************/
+/**
+ * SBNOpenDiskTree
+ *   open an .sbn file shipped with the layer. node descriptors are read
+ *   at once, bins are read by the searches on demand (and kept for the
+ *   upper levels of the tree), so a handle must not be shared by threads.
+ */
+SHAPEFILE_API SBNSearchHandle SBNOpenDiskTree (const char *pszSBNFilename);
+
+SHAPEFILE_API void SBNCloseDiskTree (SBNSearchHandle hSBN);
+
+SHAPEFILE_API void SBNGetInfo (SBNSearchHandle hSBN, int *pnShapeCount, SHPEnvelope *bounds);
+
+/**
+ * SBNSearchDiskTree
+ *   find candidate shapes whose (coarse) bounds intersect the box.
+ * Returns:
+ *   sorted shapeids to release by SBNSearchFreeIds(), NULL on error
+ */
+SHAPEFILE_API int* SBNSearchDiskTree (SBNSearchHandle hSBN, const double *padfBoundsMin, const double *padfBoundsMax, int *pnShapeCount);
+
+SHAPEFILE_API int* SBNSearchDiskTreeInteger (SBNSearchHandle hSBN, int bMinX, int bMinY, int bMaxX, int bMaxY, int *pnShapeCount);
+
+SHAPEFILE_API void SBNSearchFreeIds (int *panShapeId);
+
+/**
+ * SBNSearch
+ *   same as SHPMBRTreeSearch: shapeData passed to onSearchShape is
+ *   SHPMBRTreeShapeIdToData(shapeId), returning 0 stops the search.
+ *   shapes are reported in tree order, not sorted.
+ * Returns:
+ *   number of shapes reported, -1 on a corrupt file.
+ */
+SHAPEFILE_API int SBNSearch (SBNSearchHandle hSBN, const SHPEnvelope *searchEnv, int(* onSearchShape)(void * shapeData,  void *userParam), void *userParam);
+
 
 /*************************************************************************
  *                             DBF API
@@ -217,6 +785,17 @@ SHAPEFILE_API int SHPMBRTreeSearch (SHPMBRTree rtree, const SHPEnvelope *searchE
 
 SHAPEFILE_API DBFHandle DBFOpen (const char * pszDBFFile, const char * pszAccess);
 
+/**
+ * DBFOpenMapped
+ *   open .dbf read-only and map the whole file into memory. attributes
+ *   are read straight from the mapping, and DBFReadTuple() returns the
+ *   record in place. the DBFWrite* functions fail on mapped handles.
+ *   nFlags: SHP_MAP_DEFAULT or SHP_MAP_* bits.
+ * Returns:
+ *   handle to close with DBFClose(), or NULL on error.
+ */
+SHAPEFILE_API DBFHandle DBFOpenMapped (const char * pszDBFFile, int nFlags);
+
 SHAPEFILE_API DBFHandle DBFCreate (const char * pszDBFFile);
 
 SHAPEFILE_API int DBFGetFieldCount (DBFHandle psDBF);
@@ -231,6 +810,12 @@ SHAPEFILE_API void DBFGetFieldInfo2 (DBFHandle psDBF, int iField, DBFFieldInfo *
 
 SHAPEFILE_API int DBFGetFieldIndex (DBFHandle psDBF, const char *pszFieldName);
 
+/**
+ * DBFReadIntegerAttribute, DBFReadDoubleAttribute
+ *   decode the cell in place, independently of the locale. unlike older
+ *   releases they do not copy it to the string buffer, so a string got
+ *   from DBFReadStringAttribute() stays as it was.
+ */
 SHAPEFILE_API int DBFReadIntegerAttribute (DBFHandle hDBF, int iShape, int iField);
 
 SHAPEFILE_API double DBFReadDoubleAttribute (DBFHandle hDBF, int iShape, int iField);
@@ -239,10 +824,48 @@ SHAPEFILE_API const char* DBFReadStringAttribute (DBFHandle hDBF, int iShape, in
 
 SHAPEFILE_API int DBFReadCopyStringAttribute (DBFHandle hDBF, int iShape, int iField, char *buffer);
 
+/**
+ * DBFReadFieldSlice
+ *   get the raw bytes of field iField in record iShape without copying,
+ *   of any width. bTrim drops leading and trailing blanks by moving the
+ *   slice ends (and anything from a NUL on). the slice is NOT terminated.
+ * Returns:
+ *   first byte with its length in *pnLen, or NULL on error. the slice stays
+ *   valid until DBFClose() for handles from DBFOpenMapped(), otherwise until
+ *   the next record is read.
+ */
+SHAPEFILE_API const char* DBFReadFieldSlice (DBFHandle hDBF, int iShape, int iField, int bTrim, int *pnLen);
+
 SHAPEFILE_API const char* DBFReadLogicalAttribute (DBFHandle hDBF, int iShape, int iField);
 
+/**
+ * DBFIsAttributeNULL
+ *   test the raw cell as DBFReadStringAttribute() would return it: blank
+ *   or leading '*' for N/F, "00000000" for D, '?' for L, empty otherwise.
+ *   cells wider than 256 chars are tested whole, not truncated.
+ */
 SHAPEFILE_API int DBFIsAttributeNULL (DBFHandle hDBF, int iShape, int iField );
 
+/**
+ * DBFReadColumns
+ *   decode the fields given by pColumns of records [iFirst, iFirst+nCount)
+ *   into typed arrays, reading records in batches. a field may appear more
+ *   than once with different types.
+ * Returns:
+ *   number of records decoded (clipped to the record count), -1 on error.
+ */
+SHAPEFILE_API int DBFReadColumns (DBFHandle hDBF, int iFirst, int nCount, DBFColumn *pColumns, int nColumns);
+
+SHAPEFILE_API int DBFReadColumnDouble (DBFHandle hDBF, int iField, int iFirst, int nCount, double *padfValues, uint8_t *pabyNulls);
+
+SHAPEFILE_API int DBFReadColumnInt64 (DBFHandle hDBF, int iField, int iFirst, int nCount, int64_t *panValues, uint8_t *pabyNulls);
+
+/* pszValues holds nCount strings of nStride bytes each */
+SHAPEFILE_API int DBFReadColumnString (DBFHandle hDBF, int iField, int iFirst, int nCount, char *pszValues, int nStride, uint8_t *pabyNulls);
+
+/* dates as YYYYMMDD integers, 0 for null or invalid dates */
+SHAPEFILE_API int DBFReadColumnDate (DBFHandle hDBF, int iField, int iFirst, int nCount, int32_t *panValues, uint8_t *pabyNulls);
+
 SHAPEFILE_API int DBFWriteIntegerAttribute (DBFHandle hDBF, int iShape, int iField, int nFieldValue);
 
 SHAPEFILE_API int DBFWriteDoubleAttribute (DBFHandle hDBF, int iShape, int iField, double dFieldValue);
@@ -257,6 +880,51 @@ SHAPEFILE_API const char* DBFReadTuple (DBFHandle psDBF, int hEntity);
 
 SHAPEFILE_API int DBFWriteTuple (DBFHandle psDBF, int hEntity, void *pRawTuple);
 
+/* -------------------------------------------------------------------- */
+/*      Sequential row writer: rows are filled in place in a buffer,    */
+/*      written many per write and the header record count is only    */
+/*      updated by DBFFlushRows() and DBFClose(). Any other access to   */
+/*      the table writes the buffered rows first.                       */
+/* -------------------------------------------------------------------- */
+
+/**
+ * DBFAppendRow
+ *   start a new blank record at the end of the table. the DBFSetRow*
+ *   functions fill the fields of this row until the next DBFAppendRow.
+ * Returns:
+ *   index of the new record, or -1 on error.
+ */
+SHAPEFILE_API int DBFAppendRow (DBFHandle hDBF);
+
+/**
+ * DBFSetRowDouble, DBFSetRowInteger, DBFSetRowString, DBFSetRowLogical,
+ * DBFSetRowNULL
+ *   set field iField of the appended row, formatted as DBFWrite*Attribute
+ *   would do it.
+ * Returns:
+ *   SHAPEFILE_TRUE, or SHAPEFILE_FALSE if the value was truncated or no
+ *   row is open.
+ */
+SHAPEFILE_API int DBFSetRowDouble (DBFHandle hDBF, int iField, double dValue);
+
+SHAPEFILE_API int DBFSetRowInteger (DBFHandle hDBF, int iField, int64_t nValue);
+
+SHAPEFILE_API int DBFSetRowString (DBFHandle hDBF, int iField, const char *pszValue);
+
+SHAPEFILE_API int DBFSetRowLogical (DBFHandle hDBF, int iField, char lValue);
+
+SHAPEFILE_API int DBFSetRowNULL (DBFHandle hDBF, int iField);
+
+/**
+ * DBFFlushRows
+ *   write the appended rows and update the record count in the header.
+ *   rows that failed to write stay buffered and are tried again, and
+ *   reads and writes of other records fail until they are written.
+ * Returns:
+ *   SHAPEFILE_TRUE on success, SHAPEFILE_FALSE on a write error.
+ */
+SHAPEFILE_API int DBFFlushRows (DBFHandle hDBF);
+
 SHAPEFILE_API DBFHandle DBFCloneEmpty (DBFHandle psDBF, const char * pszFilename);
 
 SHAPEFILE_API void  DBFClose (DBFHandle hDBF);
@@ -75,6 +75,8 @@ extern "C" {
     # include <inttypes.h>
 #endif
 
+#include <stdio.h>
+
 #if defined(SHAPEFILE_DLL)
 /* win32 dynamic dll */
 # ifdef SHAPEFILE_EXPORTS
@@ -337,6 +339,23 @@ typedef struct {
     char   *pszVal;       /* nWidth+1 */
 } DBFFieldInfo;
 
+
+/* value types of DBFReadColumns() */
+typedef enum {
+    DBFColDouble = 0,   /* double[] */
+    DBFColInt64  = 1,   /* int64_t[] */
+    DBFColString = 2,   /* char[nCount * nStride], trimmed, '\0' terminated */
+    DBFColDate   = 3    /* int32_t[] as YYYYMMDD */
+} DBFColumnType;
+
+typedef struct {
+    int           iField;
+    DBFColumnType eType;
+    void         *pValues;      /* nCount values, null cells decode to 0 or "" */
+    int           nStride;      /* bytes per value of DBFColString */
+    uint8_t      *pabyNulls;    /* optional: nCount flags, 1 for null cells */
+} DBFColumn;
+
 #define XBASE_FLDHDR_SZ       32
 
 
@@ -350,9 +369,22 @@ typedef struct {
 
 typedef struct shape_tree_node * SHPTreeNodeHandle;
 typedef struct shape_tree_root * SHPTreeHandle;
+typedef struct shape_tree_disk * SHPTreeDiskHandle;
 
 typedef struct _SHPInfoRTree   * SHPMBRTree;
 
+typedef struct _SHPRTreeFile   * SHPRTreeFile;
+
+typedef struct SBNSearchInfo   * SBNSearchHandle;
+
+/* SHPMBRTreeBulkLoad() methods */
+#define SHP_MBRTREE_STR       0    /* Sort-Tile-Recursive packing */
+#define SHP_MBRTREE_HILBERT   1    /* Hilbert curve packing */
+
+/* shapeData of trees loaded from a layer: shape id + 1 (never NULL) */
+#define SHPMBRTreeShapeIdToData(id)    ((void *) (intptr_t) ((id) + 1))
+#define SHPMBRTreeDataToShapeId(data)  ((int) ((intptr_t) (data) - 1))
+
 
 #define SHAPEFILE_RECORDS_MAX   256000000
 
@@ -388,6 +420,68 @@ typedef struct _SHPInfoRTree   * SHPMBRTree;
 /************************************************************************/
 typedef struct _SHPInfo*  SHPHandle;
 
+typedef struct SHPWriterInfo * SHPWriterHandle;
+
+typedef struct SHPPgCopyInfo * SHPPgCopyHandle;
+
+typedef struct SHPGeoJSONInfo * SHPGeoJSONHandle;
+
+typedef struct SHPArenaInfo * SHPArenaHandle;
+
+typedef struct SHPPreparedPolygonInfo * SHPPreparedPolygonHandle;
+
+/* receives the stream of SHPPgCopy*() and SHPGeoJSON*(): returns SHAPEFILE_TRUE to go on */
+typedef int (*SHPStreamSink) (void *pvSink, const void *pvData, int cbData);
+
+/* receives batches of SHPSpatialJoin*(): point panPoints[k] lies in polygon
+ *  panPolygons[k] (-1 for none). returns SHAPEFILE_TRUE to go on */
+typedef int (*SHPJoinSink) (void *pvSink, const int *panPoints, const int *panPolygons, int nCount);
+
+/* -------------------------------------------------------------------- */
+/*      SHPOpenMapped() flags                                           */
+/* -------------------------------------------------------------------- */
+#define SHP_MAP_DEFAULT     0
+#define SHP_MAP_RANDOM      1    /* advise random access (tile serving) */
+#define SHP_MAP_SEQUENTIAL  2    /* advise sequential scan of the layer */
+#define SHP_MAP_POPULATE    4    /* prefault all pages when opening */
+
+/* -------------------------------------------------------------------- */
+/*      SHPFormatDouble() and *2WKT nDecimals                           */
+/* -------------------------------------------------------------------- */
+#define SHP_DECIMALS_SHORTEST  (-1)   /* shortest text reading back exactly */
+#define SHP_DECIMALS_MAX       40
+#define SHP_DOUBLE_BUFSIZE     352    /* sign, 309 digits, point, decimals */
+
+/* -------------------------------------------------------------------- */
+/*      SHPObject2WKBFormat() nWkbFlags                                 */
+/* -------------------------------------------------------------------- */
+#define SHP_WKB_XDR     0x00    /* big endian, as SHPObject2WKB() */
+#define SHP_WKB_NDR     0x01    /* little endian: no swapping on x86 */
+#define SHP_WKB_EWKB    0x02    /* PostGIS EWKB: Z/M/SRID type flags */
+
+/* -------------------------------------------------------------------- */
+/*      SHPObject2GeoJSON() and SHPGeoJSONOpen() nFlags                 */
+/* -------------------------------------------------------------------- */
+#define SHP_GEOJSON_RFC7946   0x01    /* exterior rings CCW, holes CW */
+
+/* -------------------------------------------------------------------- */
+/*      SHPComputeLayerMetrics() nFlags: arrays of SHPLayerMetrics      */
+/*      to fill                                                         */
+/* -------------------------------------------------------------------- */
+#define SHP_METRIC_AREA       0x01
+#define SHP_METRIC_LENGTH     0x02
+#define SHP_METRIC_VERTICES   0x04
+#define SHP_METRIC_PARTS      0x08
+#define SHP_METRIC_ENVELOPE   0x10
+#define SHP_METRIC_ALL        0x1f
+
+/* -------------------------------------------------------------------- */
+/*      SHPObjectSimplify() nFlags: a method and options                */
+/* -------------------------------------------------------------------- */
+#define SHP_SIMPLIFY_DP         0x00    /* Douglas-Peucker, tolerance is a distance */
+#define SHP_SIMPLIFY_VW         0x01    /* Visvalingam-Whyatt, tolerance is an area */
+#define SHP_SIMPLIFY_TOPOLOGY   0x10    /* no new crossings, rings never collapse */
+
 #define SHAPE_TYPE_MASK     7    /* 111 = Type mask */
 
 #define SHAPE_TYPE_NIL      0    /* Null  type */
@@ -570,6 +664,61 @@ typedef struct _SHPObjectEx
     };
 } SHPObjectEx, *SHPObjectExHandle;
 
+
+/* -------------------------------------------------------------------- */
+/*      SHPReadBuffer - caller owned record buffer for the *R readers.  */
+/*      Give each thread its own buffer (zero initialized) to read one  */
+/*      shared SHPHandle concurrently. Free with SHPReadBufferFree().   */
+/* -------------------------------------------------------------------- */
+typedef struct _SHPReadBuffer
+{
+    unsigned char *pabyRec;
+    int         nBufSize;
+} SHPReadBuffer;
+
+
+/* -------------------------------------------------------------------- */
+/*      SHPObjectView - read-only view into the raw record bytes.       */
+/*      All arrays are little-endian as stored in the .shp file and     */
+/*      stay valid until the next read into the same buffer (or until   */
+/*      SHPClose() for handles opened by SHPOpenMapped).                */
+/* -------------------------------------------------------------------- */
+typedef struct _SHPObjectView
+{
+    int         nSHPType;
+    int         nShapeId;
+
+    int         nParts;
+    int         nVertices;
+
+    const void  *pPartStart;    /* int32[nParts], NULL for points */
+    const void  *pPartType;     /* int32[nParts], SHPT_MULTIPATCH only */
+    const void  *pXY;           /* double[nVertices*2], interleaved x,y */
+    const void  *pZ;            /* double[nVertices], NULL if absent */
+    const void  *pM;            /* double[nVertices], NULL if absent */
+
+    /* pXY as typed array when usable on this host (little-endian and
+     *  aligned), NULL otherwise: use SHPObjectViewGetPoint() then */
+    const SHPPointType *pPoints;
+
+    SHPBounds   bounds;
+} SHPObjectView;
+
+
+/* -------------------------------------------------------------------- */
+/*      SHPLayerMetrics - caller arrays of SHPComputeLayerMetrics(),    */
+/*      element i for shape first + i. arrays not asked for by nFlags   */
+/*      may be NULL.                                                    */
+/* -------------------------------------------------------------------- */
+typedef struct _SHPLayerMetrics
+{
+    double      *padfArea;      /* signed as SHPObjectGetArea() */
+    double      *padfLength;    /* as SHPObjectGetLength() */
+    int         *panVertices;
+    int         *panParts;
+    SHPEnvelope *pEnvelopes;    /* from record bbox, inverted for null */
+} SHPLayerMetrics;
+
 #if defined(__cplusplus)
 }
 #endif
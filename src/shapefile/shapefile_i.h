@@ -62,6 +62,7 @@ static const char LIBVERSION[] = "1.2.1";
 #include "shapefile_api.h"
 #include "shp2wkb.h"
 #include "shp2wkt.h"
+#include "shpcoords.h"
 
 
 #ifdef _MSC_VER
@@ -90,8 +91,49 @@ static const char LIBVERSION[] = "1.2.1";
  #define SGNOF(a)  ((a) > 0 ? 1 : ((a) < 0 ? (-1) : 0))
 #endif
 
+/* uses the macros above */
+#include "shpstream.h"
+
 #define  MEM_BLKSIZE  128
 
+/* leading bytes of a record holding type, bbox and part/point counts */
+#define  SHP_RECORD_HEAD_SIZE  52
+
+/* read window used by SHPReadEnvelopes on stdio handles */
+#define  SHP_ENVELOPE_WINDOW   65536
+
+/* bytes of records DBFReadColumns() reads at once */
+#define  DBF_BATCH_WINDOW      65536
+
+/* bytes of rows DBFAppendRow() buffers per write */
+#define  DBF_APPEND_WINDOW     (1 << 20)
+
+/* default record buffer and .shx entries per write of SHPWriterOpen() */
+#define  SHP_WRITER_BUFSIZE    (4 << 20)
+#define  SHP_WRITER_SHX_BLOCK  8192
+
+/* stream buffer and records per attribute batch of SHPPgCopyWriteRecords() */
+#define  SHP_PGCOPY_BUFSIZE    (1 << 20)
+#define  SHP_PGCOPY_BATCH      512
+
+/* stream buffer and records per attribute batch of SHPGeoJSONWriteRecords() */
+#define  SHP_GEOJSON_BUFSIZE   (1 << 20)
+#define  SHP_GEOJSON_BATCH     512
+
+/* default block of SHPArenaCreate() */
+#define  SHP_ARENA_BLOCKSIZE   (256 << 10)
+
+/* y bands of SHPPreparePolygon(): one per so many edges, at most max */
+#define  SHP_PREPARED_BAND_EDGES  2
+#define  SHP_PREPARED_MAX_BANDS   (1 << 20)
+
+/* points per batch and polygons per prepare job of SHPSpatialJoin*() */
+#define  SHP_JOIN_POINT_BATCH     4096
+#define  SHP_JOIN_POLYGON_BATCH   64
+
+/* vertices of a shape from which SHP_SIMPLIFY_TOPOLOGY indexes them */
+#define  SHP_SIMPLIFY_TREE_MIN    64
+
 typedef struct _SHPInfoRTree
 {
     RTREE_ROOT   rtRoot;
@@ -117,6 +159,10 @@ typedef struct  _SHPInfo
     unsigned char *pabyRec;
     int         nBufSize;
 
+    /* read-only mapping of .shp (SHPOpenMapped) */
+    ub1        *pabySHPMap;
+    size_t      nSHPMapSize;
+
     /* RTree */
     SHPInfoRTree MBRTree;
 } SHPInfo;
@@ -149,6 +195,19 @@ typedef struct _DBFInfo
     char        szStringField[257];    /* max is 256 chars */
     char        *pReturnTuple;
     int         nTupleLen;
+
+    /* records read at once by DBFReadColumns() */
+    char        *pszBatchRecords;
+    int         nBatchSize;
+
+    /* whole file mapped by DBFOpenMapped(), read-only */
+    char        *pszMap;
+    size_t      nMapSize;
+
+    /* rows added by DBFAppendRow() and not written yet */
+    char        *pszAppendRecords;
+    int         nAppendSize;
+    int         nAppendRows;
 } DBFInfo;
 
 
@@ -159,6 +218,18 @@ typedef struct _SHPRectTree
 
 void * SfRealloc (void * pMem, int nNewSize);
 
+void * SfMapFile (FILE *fp, size_t *pnSize, int nFlags);
+
+void SfUnmapFile (void *pMap, size_t nSize);
+
+SHPReadBuffer * SHPArenaReadBuffer (SHPArenaHandle hArena);
+
+char * SHPFormatDigits (char *pchEnd, uint64_t nValue, int nDecimals);
+
+int DBFBatchColumnInit (DBFHandle hDBF, int iField, DBFColumn *pColumn, int nBatch);
+
+void DBFBatchColumnsFree (DBFColumn *pColumns, int nColumns);
+
 #ifdef    __cplusplus
 }
 #endif
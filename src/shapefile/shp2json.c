@@ -0,0 +1,765 @@
+/******************************************************************************
+ * shp2json.c
+ *
+ * v 1.0 2026/10/18
+ *
+ * Project:  Shapelib
+ * Purpose:  GeoJSON geometry and FeatureCollection output
+ * Author:   cheungmine@gmail.com
+ *
+ * Copyright (c) 2026, cheungmine
+ *
+ * This software is available under the following "MIT Style" license,
+ * or at the option of the licensee under the LGPL (see LICENSE.LGPL).  This
+ * option is discussed in more detail in shapelib.html.
+ *
+ * --
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include "shp2json.h"
+
+
+static void JSONWriterInit (JSONWriter *w, char *pszBuf, int cbBuffer, const SHPCoordSeq *psSeq, int nFlags, int dig)
+{
+    SHPTextInit(&w->t, pszBuf, cbBuffer);
+    w->psSeq = psSeq;
+    w->dig = dig;
+    w->bRFC7946 = (nFlags & SHP_GEOJSON_RFC7946) ? 1 : 0;
+}
+
+
+/**
+ * JSON has no NaN nor infinity: they go out as null.
+ */
+static void JSONPutDouble (JSONWriter *w, double dValue, int dig)
+{
+    if (!isfinite(dValue)) {
+        SHPTextPutChars(&w->t, "null", 4);
+    } else {
+        SHPTextPutDouble(&w->t, dValue, dig);
+    }
+}
+
+
+static void JSONPutInt64 (JSONWriter *w, int64_t nValue)
+{
+    char szBuf[24];
+    char *pch = SHPFormatDigits(szBuf + sizeof(szBuf), nValue < 0 ? 0 - (uint64_t) nValue : (uint64_t) nValue, 0);
+
+    if (nValue < 0) {
+        *--pch = '-';
+    }
+    SHPTextPutChars(&w->t, pch, (int) (szBuf + sizeof(szBuf) - pch));
+}
+
+
+/**
+ * Length of the well-formed UTF-8 sequence of a code point at pch, 0 if
+ *  there is none there.
+ */
+static int JSONUtf8Length (const unsigned char *pch, int len)
+{
+    unsigned int cp;
+    int i, n;
+
+    if (pch[0] < 0xC2 || pch[0] > 0xF4) {
+        /* ASCII, continuation, overlong lead or beyond U+10FFFF */
+        return 0;
+    }
+    n = (pch[0] < 0xE0) ? 2 : (pch[0] < 0xF0) ? 3 : 4;
+    if (n > len) {
+        return 0;
+    }
+
+    cp = pch[0] & (0x7F >> n);
+    for (i = 1; i < n; i++) {
+        if ((pch[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        cp = (cp << 6) | (pch[i] & 0x3F);
+    }
+
+    if ((n == 3 && (cp < 0x800 || (cp >= 0xD800 && cp <= 0xDFFF))) || (n == 4 && (cp < 0x10000 || cp > 0x10FFFF))) {
+        return 0;
+    }
+    return n;
+}
+
+
+/**
+ * Quoted string of len bytes, escaped. Well-formed UTF-8 passes as it
+ *  is; any other byte from 0x80 is read as Latin-1 and escaped, so the
+ *  text stays valid JSON whatever the code page of the dbf.
+ */
+static void JSONPutString (JSONWriter *w, const char *psz, int len)
+{
+    static const char achHex[] = "0123456789abcdef";
+    const unsigned char *pch = (const unsigned char *) psz;
+    int i, run = 0;
+
+    SHPTextPutChars(&w->t, "\"", 1);
+
+    for (i = 0; i < len; i++) {
+        unsigned char ch = pch[i];
+
+        if (ch >= 0x80) {
+            int n = JSONUtf8Length(pch + i, len - i);
+            if (n > 0) {
+                i += n - 1;
+                continue;
+            }
+        } else if (ch >= 0x20 && ch != '"' && ch != '\\') {
+            continue;
+        }
+
+        SHPTextPutChars(&w->t, psz + run, i - run);
+        run = i + 1;
+
+        if (ch == '"' || ch == '\\') {
+            char sz[2] = {'\\', (char) ch};
+            SHPTextPutChars(&w->t, sz, 2);
+        } else {
+            char sz[6] = {'\\', 'u', '0', '0', achHex[ch >> 4], achHex[ch & 15]};
+            SHPTextPutChars(&w->t, sz, 6);
+        }
+    }
+
+    SHPTextPutChars(&w->t, psz + run, len - run);
+    SHPTextPutChars(&w->t, "\"", 1);
+}
+
+
+static void JSONPutPosition (JSONWriter *w, int i)
+{
+    const SHPCoordSeq *psSeq = w->psSeq;
+
+    SHPTextPutChars(&w->t, "[", 1);
+    JSONPutDouble(w, SHPCoordX(psSeq, psSeq->nStride, i), w->dig);
+    SHPTextPutChars(&w->t, ",", 1);
+    JSONPutDouble(w, SHPCoordY(psSeq, psSeq->nStride, i), w->dig);
+
+    if (psSeq->padfZ) {
+        SHPTextPutChars(&w->t, ",", 1);
+        JSONPutDouble(w, psSeq->padfZ[i], w->dig);
+    }
+    SHPTextPutChars(&w->t, "]", 1);
+}
+
+
+/**
+ * [[x,y],...] of vertices [start, end), backwards if bReverse.
+ */
+static void JSONPutPositions (JSONWriter *w, int start, int end, int bReverse)
+{
+    int at;
+
+    SHPTextPutChars(&w->t, "[", 1);
+    for (at = start; at < end; at++) {
+        if (at > start) {
+            SHPTextPutChars(&w->t, ",", 1);
+        }
+        JSONPutPosition(w, bReverse ? start + end - 1 - at : at);
+    }
+    SHPTextPutChars(&w->t, "]", 1);
+}
+
+
+static void JSONPutType (JSONWriter *w, const char *pszType)
+{
+    SHPTextPutText(&w->t, "{\"type\":\"");
+    SHPTextPutText(&w->t, pszType);
+    SHPTextPutText(&w->t, "\",\"coordinates\":");
+}
+
+
+static int JSONWritePoint (JSONWriter *w)
+{
+    JSONPutType(w, "Point");
+
+    if (w->psSeq->nVertices == 0) {
+        SHPTextPutText(&w->t, "[]}");
+    } else {
+        JSONPutPosition(w, 0);
+        SHPTextPutChars(&w->t, "}", 1);
+    }
+    return SHPTextEnd(&w->t);
+}
+
+
+static int JSONWriteMultiPoint (JSONWriter *w)
+{
+    JSONPutType(w, "MultiPoint");
+    JSONPutPositions(w, 0, w->psSeq->nVertices, 0);
+    SHPTextPutChars(&w->t, "}", 1);
+    return SHPTextEnd(&w->t);
+}
+
+
+static int JSONWriteLines (JSONWriter *w)
+{
+    int iPart, start, end, nParts = w->psSeq->nParts;
+
+    if (nParts > 1) {
+        JSONPutType(w, "MultiLineString");
+        SHPTextPutChars(&w->t, "[", 1);
+
+        for (iPart = 0; iPart < nParts; iPart++) {
+            if (iPart > 0) {
+                SHPTextPutChars(&w->t, ",", 1);
+            }
+            SHPCoordsPartRange(w->psSeq, iPart, &start, &end);
+            JSONPutPositions(w, start, end, 0);
+        }
+        SHPTextPutChars(&w->t, "]", 1);
+    } else {
+        JSONPutType(w, "LineString");
+        SHPCoordsPartRange(w->psSeq, 0, &start, &end);
+        JSONPutPositions(w, start, end, 0);
+    }
+
+    SHPTextPutChars(&w->t, "}", 1);
+    return SHPTextEnd(&w->t);
+}
+
+
+/**
+ * Ring with RFC 7946 winding if asked: exterior CCW, holes CW.
+ */
+static void JSONPutRing (JSONWriter *w, const JSONRing *pRing)
+{
+    int bReverse = w->bRFC7946 && (pRing->bOuter ? pRing->area < 0 : pRing->area > 0);
+    JSONPutPositions(w, pRing->start, pRing->end, bReverse);
+}
+
+
+/**
+ * [outer, holes...] of polygon iOuter.
+ */
+static void JSONPutPolygonRings (JSONWriter *w, const JSONRing *pRings, int nRings, int iOuter)
+{
+    int i;
+
+    SHPTextPutChars(&w->t, "[", 1);
+    JSONPutRing(w, pRings + iOuter);
+
+    for (i = 0; i < nRings; i++) {
+        if (!pRings[i].bOuter && pRings[i].iOuter == iOuter) {
+            SHPTextPutChars(&w->t, ",", 1);
+            JSONPutRing(w, pRings + i);
+        }
+    }
+    SHPTextPutChars(&w->t, "]", 1);
+}
+
+
+/**
+ * Rings stored CW are exteriors, CCW ones holes of the smallest exterior
+ *  around them (the shapefile rule). A hole inside no exterior is one.
+ *  One exterior gives a Polygon, more a MultiPolygon.
+ */
+static int JSONWritePolygon (JSONWriter *w)
+{
+    const SHPCoordSeq *psSeq = w->psSeq;
+    JSONRing  asRings[JSON_STACK_RINGS], *pRings = asRings;
+    int       nRings = (psSeq->nVertices == 0) ? 0 : MAX_V2(psSeq->nParts, 1);
+    int       i, j, nOuters = 0, iFirstOuter = 0;
+
+    if (nRings > JSON_STACK_RINGS) {
+        pRings = (JSONRing *) malloc(sizeof(JSONRing) * nRings);
+        if (!pRings) {
+            return -1;
+        }
+    }
+
+    for (i = 0; i < nRings; i++) {
+        SHPCoordsPartRange(psSeq, i, &pRings[i].start, &pRings[i].end);
+        pRings[i].area = SHPCOORDS_CALL(psSeq, SHPCoordsAreaOf, psSeq, pRings[i].start, pRings[i].end);
+        pRings[i].bOuter = (nRings == 1 || pRings[i].area <= 0);
+        pRings[i].iOuter = -1;
+    }
+
+    for (i = 0; i < nRings; i++) {
+        if (!pRings[i].bOuter) {
+            double x = SHPCoordX(psSeq, psSeq->nStride, pRings[i].start);
+            double y = SHPCoordY(psSeq, psSeq->nStride, pRings[i].start);
+
+            for (j = 0; j < nRings; j++) {
+                if (pRings[j].bOuter && (pRings[i].iOuter < 0 || fabs(pRings[j].area) < fabs(pRings[pRings[i].iOuter].area)) &&
+                    SHPCOORDS_CALL(psSeq, SHPCoordsRingContains, psSeq, pRings[j].start, pRings[j].end, x, y)) {
+                    pRings[i].iOuter = j;
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < nRings; i++) {
+        if (pRings[i].iOuter < 0) {
+            pRings[i].bOuter = 1;
+        }
+        if (pRings[i].bOuter && nOuters++ == 0) {
+            iFirstOuter = i;
+        }
+    }
+
+    if (nOuters <= 1) {
+        JSONPutType(w, "Polygon");
+        if (nOuters == 0) {
+            SHPTextPutText(&w->t, "[]");
+        } else {
+            JSONPutPolygonRings(w, pRings, nRings, iFirstOuter);
+        }
+    } else {
+        JSONPutType(w, "MultiPolygon");
+        SHPTextPutChars(&w->t, "[", 1);
+
+        for (i = 0; i < nRings; i++) {
+            if (pRings[i].bOuter) {
+                if (i > iFirstOuter) {
+                    SHPTextPutChars(&w->t, ",", 1);
+                }
+                JSONPutPolygonRings(w, pRings, nRings, i);
+            }
+        }
+        SHPTextPutChars(&w->t, "]", 1);
+    }
+    SHPTextPutChars(&w->t, "}", 1);
+
+    if (pRings != asRings) {
+        free(pRings);
+    }
+    return SHPTextEnd(&w->t);
+}
+
+
+/**
+ * Geometry object of any shape type, null for null shapes. M is dropped.
+ */
+static int JSONWriteShape (JSONWriter *w)
+{
+    switch (w->psSeq->nSHPType) {
+    case SHPT_POINT:
+    case SHPT_POINTZ:
+    case SHPT_POINTM:
+        return JSONWritePoint(w);
+    case SHPT_ARC:
+    case SHPT_ARCZ:
+    case SHPT_ARCM:
+        return JSONWriteLines(w);
+    case SHPT_POLYGON:
+    case SHPT_POLYGONZ:
+    case SHPT_POLYGONM:
+        return JSONWritePolygon(w);
+    case SHPT_MULTIPOINT:
+    case SHPT_MULTIPOINTZ:
+    case SHPT_MULTIPOINTM:
+        return JSONWriteMultiPoint(w);
+    }
+
+    /* SHPT_NULL, SHPT_MULTIPATCH: TODO */
+    SHPTextPutChars(&w->t, "null", 4);
+    return SHPTextEnd(&w->t);
+}
+
+
+int SHPCoordSeq2GeoJSON (const SHPCoordSeq *psSeq, char *jsonBuffer, int cbBuffer, int nFlags, int nDecimals)
+{
+    JSONWriter w;
+    SHPCoordSeq seq = *psSeq;
+    double *padfCopy = NULL;
+    int i, cb, n = psSeq->nVertices;
+
+    if ((nFlags & SHP_GEOJSON_RFC7946) && n > 0 &&
+        (seq.nSHPType == SHPT_POLYGON || seq.nSHPType == SHPT_POLYGONZ || seq.nSHPType == SHPT_POLYGONM)) {
+        padfCopy = (double *) malloc(sizeof(double) * n * (psSeq->padfZ ? 3 : 2));
+        if (!padfCopy) {
+            return -1;
+        }
+
+        for (i = 0; i < n; i++) {
+            padfCopy[i * SHPCOORDS_AOS] = SHPCoordX(psSeq, psSeq->nStride, i);
+            padfCopy[i * SHPCOORDS_AOS + 1] = SHPCoordY(psSeq, psSeq->nStride, i);
+        }
+        seq.padfX = padfCopy;
+        seq.padfY = padfCopy + 1;
+        seq.nStride = SHPCOORDS_AOS;
+
+        if (psSeq->padfZ) {
+            seq.padfZ = padfCopy + (size_t) n * SHPCOORDS_AOS;
+            memcpy(seq.padfZ, psSeq->padfZ, sizeof(double) * n);
+        }
+
+        /* M is not written */
+        seq.padfM = NULL;
+
+        SHPCoordSeqValidatePolygon(&seq, 0);
+    }
+
+    JSONWriterInit(&w, jsonBuffer, cbBuffer, &seq, nFlags, nDecimals);
+    cb = JSONWriteShape(&w);
+
+    SafeFree(padfCopy);
+    return cb;
+}
+
+
+int SHPObject2GeoJSON (const SHPObject *psObject, char *jsonBuffer, int cbBuffer, int nFlags, int nDecimals)
+{
+    SHPCoordSeq seq;
+
+    SHPCoordSeqOfObject(&seq, psObject);
+    return SHPCoordSeq2GeoJSON(&seq, jsonBuffer, cbBuffer, nFlags, nDecimals);
+}
+
+
+int SHPObjectEx2GeoJSON (const SHPObjectEx *psObject, char *jsonBuffer, int cbBuffer, int nFlags, int nDecimals)
+{
+    SHPCoordSeq seq;
+
+    SHPCoordSeqOfObjectEx(&seq, psObject);
+    return SHPCoordSeq2GeoJSON(&seq, jsonBuffer, cbBuffer, nFlags, nDecimals);
+}
+
+
+/* -------------------------------------------------------------------- */
+/*      FeatureCollection stream                                        */
+/* -------------------------------------------------------------------- */
+typedef enum {
+    JSONPropInt     = 0,
+    JSONPropDouble  = 1,
+    JSONPropBool    = 2,
+    JSONPropDate    = 3,
+    JSONPropString  = 4
+} JSONPropType;
+
+
+typedef struct
+{
+    JSONPropType  eType;
+    int           iField;
+    int           iColumn;      /* into pColumns */
+    char          szKey[80];    /* "name": with the 11 chars escaped */
+} JSONProperty;
+
+
+struct SHPGeoJSONInfo
+{
+    SHPHandle       hSHP;
+    DBFHandle       hDBF;
+    int             nFlags;
+    int             nDecimals;
+    int             nRecords;
+    int             nFeatures;
+
+    SHPStreamBuffer sStream;
+
+    JSONProperty   *pProperties;
+    int             nProperties;
+
+    /* attributes of one batch, decoded by DBFReadColumns() */
+    DBFColumn      *pColumns;
+    int             nColumns;
+
+    SHPObjectEx    *psShape;
+    SHPReadBuffer   sReadBuf;
+};
+
+
+static void GeoJSONPutText (SHPGeoJSONHandle hJSON, const char *psz)
+{
+    SHPStreamWrite(&hJSON->sStream, psz, (int) strlen(psz));
+}
+
+
+/**
+ * Property type of a dbf field from its batch column.
+ */
+static JSONPropType GeoJSONFieldType (DBFHandle hDBF, const DBFColumn *pColumn)
+{
+    switch (pColumn->eType) {
+    case DBFColInt64:
+        return JSONPropInt;
+    case DBFColDouble:
+        return JSONPropDouble;
+    case DBFColDate:
+        return JSONPropDate;
+    default:
+        break;
+    }
+    return (DBFGetNativeFieldType(hDBF, pColumn->iField) == 'L') ? JSONPropBool : JSONPropString;
+}
+
+
+static void GeoJSONPutProperty (SHPGeoJSONHandle hJSON, JSONWriter *w, const JSONProperty *pProp, int r)
+{
+    const DBFColumn *pColumn = hJSON->pColumns + pProp->iColumn;
+
+    SHPTextPutText(&w->t, pProp->szKey);
+
+    if (pColumn->pabyNulls[r]) {
+        SHPTextPutChars(&w->t, "null", 4);
+        return;
+    }
+
+    switch (pProp->eType) {
+    case JSONPropInt:
+        JSONPutInt64(w, ((const int64_t *) pColumn->pValues)[r]);
+        break;
+
+    case JSONPropDouble:
+        JSONPutDouble(w, ((const double *) pColumn->pValues)[r], SHP_DECIMALS_SHORTEST);
+        break;
+
+    case JSONPropBool:
+        {
+            /* first non-blank char, '?' is already a null */
+            char ch = ((const char *) pColumn->pValues)[(size_t) r * pColumn->nStride];
+
+            if (ch && strchr("TtYy", ch)) {
+                SHPTextPutChars(&w->t, "true", 4);
+            } else if (ch && strchr("FfNn", ch)) {
+                SHPTextPutChars(&w->t, "false", 5);
+            } else {
+                SHPTextPutChars(&w->t, "null", 4);
+            }
+        }
+        break;
+
+    case JSONPropDate:
+        {
+            /* YYYYMMDD, validated by DBFReadColumns() */
+            int32_t n = ((const int32_t *) pColumn->pValues)[r];
+            char sz[12] = {'"', 0, 0, 0, 0, '-', 0, 0, '-', 0, 0, '"'};
+            int at;
+
+            for (at = 10; at > 0; at--) {
+                if (at != 5 && at != 8) {
+                    sz[at] = (char) ('0' + n % 10);
+                    n /= 10;
+                }
+            }
+            SHPTextPutChars(&w->t, sz, 12);
+        }
+        break;
+
+    default:
+        {
+            const char *psz = (const char *) pColumn->pValues + (size_t) r * pColumn->nStride;
+            JSONPutString(w, psz, (int) strlen(psz));
+        }
+        break;
+    }
+}
+
+
+/**
+ * One Feature into what is left of the stream buffer.
+ * Returns its length, which does not fit if not less than cbBuffer.
+ */
+static int GeoJSONWriteFeature (SHPGeoJSONHandle hJSON, char *pszBuf, int cbBuffer, int iRecord, int r, int bShape)
+{
+    SHPCoordSeq seq;
+    JSONWriter w;
+    int i;
+
+    JSONWriterInit(&w, pszBuf, cbBuffer, NULL, hJSON->nFlags, hJSON->nDecimals);
+
+    SHPTextPutText(&w.t, hJSON->nFeatures > 0 ? ",{\"type\":\"Feature\",\"id\":" : "{\"type\":\"Feature\",\"id\":");
+    JSONPutInt64(&w, iRecord);
+    SHPTextPutText(&w.t, ",\"geometry\":");
+
+    if (bShape) {
+        SHPCoordSeqOfObjectEx(&seq, hJSON->psShape);
+        w.psSeq = &seq;
+        JSONWriteShape(&w);
+    } else {
+        SHPTextPutChars(&w.t, "null", 4);
+    }
+
+    SHPTextPutText(&w.t, ",\"properties\":{");
+    for (i = 0; i < hJSON->nProperties; i++) {
+        if (i > 0) {
+            SHPTextPutChars(&w.t, ",", 1);
+        }
+        GeoJSONPutProperty(hJSON, &w, hJSON->pProperties + i, r);
+    }
+    SHPTextPutText(&w.t, "}}");
+
+    return SHPTextEnd(&w.t);
+}
+
+
+SHPGeoJSONHandle SHPGeoJSONOpen (SHPHandle hSHP, DBFHandle hDBF, int nFlags, int nDecimals,
+    SHPStreamSink pfnSink, void *pvSink)
+{
+    SHPGeoJSONHandle hJSON;
+    int i, nFields = hDBF ? DBFGetFieldCount(hDBF) : 0;
+
+    if ((!hSHP && !hDBF) || !pfnSink) {
+        return NULL;
+    }
+
+    hJSON = (SHPGeoJSONHandle) calloc(1, sizeof(struct SHPGeoJSONInfo));
+    if (!hJSON) {
+        return NULL;
+    }
+
+    hJSON->hSHP = hSHP;
+    hJSON->hDBF = hDBF;
+    hJSON->nFlags = nFlags;
+    hJSON->nDecimals = nDecimals;
+
+    if (hSHP) {
+        SHPGetInfo(hSHP, &hJSON->nRecords, NULL, NULL, NULL);
+        if (hDBF) {
+            hJSON->nRecords = MIN_V2(hJSON->nRecords, DBFGetRecordCount(hDBF));
+        }
+    } else {
+        hJSON->nRecords = DBFGetRecordCount(hDBF);
+    }
+
+    hJSON->pProperties = (JSONProperty *) calloc(nFields + 1, sizeof(JSONProperty));
+    hJSON->pColumns = (DBFColumn *) calloc(nFields + 1, sizeof(DBFColumn));
+
+    if (!SHPStreamInit(&hJSON->sStream, pfnSink, pvSink, SHP_GEOJSON_BUFSIZE) ||
+        !hJSON->pProperties || !hJSON->pColumns || (hSHP && !SHPCreateObjectEx(&hJSON->psShape))) {
+        hJSON->sStream.bError = SHAPEFILE_TRUE;
+        SHPGeoJSONClose(hJSON);
+        return NULL;
+    }
+
+    for (i = 0; i < nFields; i++) {
+        JSONProperty *pProp = hJSON->pProperties + hJSON->nProperties++;
+        DBFColumn *pColumn = hJSON->pColumns + hJSON->nColumns;
+        char szName[12];
+        JSONWriter w;
+
+        if (!DBFBatchColumnInit(hDBF, i, pColumn, SHP_GEOJSON_BATCH)) {
+            hJSON->sStream.bError = SHAPEFILE_TRUE;
+            SHPGeoJSONClose(hJSON);
+            return NULL;
+        }
+
+        DBFGetFieldInfo(hDBF, i, szName, NULL, NULL);
+
+        JSONWriterInit(&w, pProp->szKey, sizeof(pProp->szKey), NULL, 0, 0);
+        JSONPutString(&w, szName, (int) strlen(szName));
+        SHPTextPutChars(&w.t, ":", 1);
+        SHPTextEnd(&w.t);
+
+        pProp->eType = GeoJSONFieldType(hDBF, pColumn);
+        pProp->iField = i;
+        pProp->iColumn = hJSON->nColumns++;
+    }
+
+    GeoJSONPutText(hJSON, "{\"type\":\"FeatureCollection\",\"features\":[");
+    return hJSON;
+}
+
+
+int SHPGeoJSONWriteRecords (SHPGeoJSONHandle hJSON, int iFirst, int nCount)
+{
+    SHPStreamBuffer *pStream = &hJSON->sStream;
+    int nDone = 0;
+
+    if (hJSON->sStream.bError || iFirst < 0) {
+        return -1;
+    }
+
+    nCount = MIN_V2(nCount, hJSON->nRecords - iFirst);
+
+    while (nDone < nCount) {
+        int nBatch = MIN_V2(nCount - nDone, SHP_GEOJSON_BATCH);
+        int iRecord = iFirst + nDone;
+        int r;
+
+        if (hJSON->nColumns > 0 &&
+            DBFReadColumns(hJSON->hDBF, iRecord, nBatch, hJSON->pColumns, hJSON->nColumns) != nBatch) {
+            return -1;
+        }
+
+        for (r = 0; r < nBatch; r++, iRecord++) {
+            int bShape = SHAPEFILE_FALSE, cb;
+
+            if (hJSON->hSHP && SHPReadObjectExR(hJSON->hSHP, iRecord, hJSON->psShape, &hJSON->sReadBuf)) {
+                bShape = SHAPEFILE_TRUE;
+
+                /* fix rings wound the wrong way before they are told apart by winding */
+                if (hJSON->nFlags & SHP_GEOJSON_RFC7946) {
+                    SHPObjectExValidatePolygon(hJSON->psShape, 0);
+                }
+            }
+
+            cb = GeoJSONWriteFeature(hJSON, (char *) pStream->pabyBuf + pStream->cbBuf,
+                pStream->nBufSize - pStream->cbBuf, iRecord, r, bShape);
+
+            if (cb < 0) {
+                pStream->bError = SHAPEFILE_TRUE;
+                return -1;
+            }
+
+            if (pStream->cbBuf + cb >= pStream->nBufSize) {
+                /* did not fit: write it again into an empty (or larger) buffer */
+                char *pszBuf = (char *) SHPStreamReserve(pStream, cb + 1);
+                if (!pszBuf) {
+                    return -1;
+                }
+                GeoJSONWriteFeature(hJSON, pszBuf, cb + 1, iRecord, r, bShape);
+            }
+
+            pStream->cbBuf += cb;
+            hJSON->nFeatures++;
+        }
+
+        if (pStream->bError) {
+            return -1;
+        }
+        nDone += nBatch;
+    }
+
+    return nDone;
+}
+
+
+int SHPGeoJSONClose (SHPGeoJSONHandle hJSON)
+{
+    int bOk = SHAPEFILE_FALSE;
+
+    if (!hJSON->sStream.bError) {
+        GeoJSONPutText(hJSON, "]}");
+        bOk = SHPStreamFlush(&hJSON->sStream);
+    }
+
+    if (hJSON->pColumns) {
+        DBFBatchColumnsFree(hJSON->pColumns, hJSON->nColumns);
+    }
+
+    if (hJSON->psShape) {
+        SHPDestroyObjectEx(hJSON->psShape);
+    }
+    SHPReadBufferFree(&hJSON->sReadBuf);
+
+    SafeFree(hJSON->pProperties);
+    SafeFree(hJSON->pColumns);
+    SHPStreamFree(&hJSON->sStream);
+    free(hJSON);
+
+    return bOk;
+}
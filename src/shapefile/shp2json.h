@@ -46,6 +46,14 @@
  * reference:
  *   https://datatracker.ietf.org/doc/html/rfc7946
  *
+ * {"type":"Point","coordinates":[6,10]}
+ * {"type":"LineString","coordinates":[[3,4],[10,50],[20,25]]}
+ * {"type":"Polygon","coordinates":[[[1,1],[1,5],[5,5],[5,1],[1,1]],[[2,2],[3,2],[3,3],[2,3],[2,2]]]}
+ * {"type":"MultiPoint","coordinates":[[3.5,5.6],[4.8,10.5]]}
+ * {"type":"MultiLineString","coordinates":[[[3,4],[10,50]],[[-5,-8],[-10,-8]]]}
+ * {"type":"Point","coordinates":[1,1,5]}
+ * {"type":"Point","coordinates":[]}
+ * null
  */
 
 #ifndef _SHP2JSON_H_INCLUDED
@@ -54,4 +62,39 @@
 #include "shapefile_i.h"
 
 
+/* -------------------------------------------------------------------- */
+/*      GeoJSON writer. With no output buffer only the length is        */
+/*      computed, with a short one the text is cut as by snprintf().    */
+/* -------------------------------------------------------------------- */
+typedef struct
+{
+    SHPTextWriter t;
+
+    const SHPCoordSeq *psSeq;   /* Z written if psSeq->padfZ */
+
+    int           dig;
+    int           bRFC7946;
+} JSONWriter;
+
+
+/* a polygon ring and the outer ring it is a hole of */
+typedef struct
+{
+    int     start, end;
+    double  area;               /* > 0: CCW */
+    int     bOuter;
+    int     iOuter;
+} JSONRing;
+
+/* rings of a polygon not needing an allocation */
+#define JSON_STACK_RINGS  16
+
+
+/**
+ * geometry of psSeq as SHPObject2GeoJSON() writes it. with
+ *   SHP_GEOJSON_RFC7946 a polygon is validated on a copy first, as
+ *   SHPGeoJSONWriteRecords() does on the shapes it reads.
+ */
+int SHPCoordSeq2GeoJSON (const SHPCoordSeq *psSeq, char *jsonBuffer, int cbBuffer, int nFlags, int nDecimals);
+
 #endif /* _SHP2JSON_H_INCLUDED */
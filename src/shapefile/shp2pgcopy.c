@@ -0,0 +1,472 @@
+/******************************************************************************
+ * shp2pgcopy.c
+ *
+ * v 1.0 2026/10/18
+ *
+ * Project:  Shapelib
+ * Purpose:  PostgreSQL binary COPY stream of shapes and attributes
+ * Author:   cheungmine@gmail.com
+ *
+ * Copyright (c) 2026, cheungmine
+ *
+ * This software is available under the following "MIT Style" license,
+ * or at the option of the licensee under the LGPL (see LICENSE.LGPL).  This
+ * option is discussed in more detail in shapelib.html.
+ *
+ * --
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+ * COPY ... FROM STDIN (FORMAT binary) stream, all integers big-endian:
+ *
+ *   header     "PGCOPY\n\377\r\n\0", int32 flags (0), int32 extension (0)
+ *   tuple      int16 column count, then per column:
+ *                int32 length (-1 for NULL), length bytes of value
+ *   trailer    int16 -1
+ *
+ * column values are the binary send formats of their types:
+ *
+ *   geometry   EWKB (NDR, with SRID if given)
+ *   int4/int8  big-endian integer
+ *   float8     big-endian IEEE double
+ *   bool       1 byte
+ *   date       int32 days since 2000-01-01
+ *   text       bytes as stored in the dbf, leading and trailing blanks
+ *              dropped
+ */
+#include "shapefile_i.h"
+
+
+typedef enum {
+    PGCopyGeometry = 0,
+    PGCopyInt4     = 1,
+    PGCopyInt8     = 2,
+    PGCopyFloat8   = 3,
+    PGCopyBool     = 4,
+    PGCopyDate     = 5,
+    PGCopyText     = 6
+} PGCopyType;
+
+static const char * const PGCopyTypeNames[] = {
+    "geometry", "int4", "int8", "float8", "bool", "date", "text"
+};
+
+/* days from 1970-01-01 to 2000-01-01, the PostgreSQL date epoch */
+#define PGCOPY_EPOCH_DAYS   10957
+
+
+typedef struct
+{
+    PGCopyType  eType;
+    int         iField;         /* dbf field, -1 for geometry */
+    int         iColumn;        /* into pColumns, -1 if not batched */
+} PGCopyColumn;
+
+
+struct SHPPgCopyInfo
+{
+    SHPHandle       hSHP;
+    DBFHandle       hDBF;
+    int             nSRID;
+    int             nRecords;
+
+    SHPStreamBuffer sStream;
+
+    PGCopyColumn   *pCopyColumns;
+    int             nCopyColumns;
+
+    /* attributes of one batch, decoded by DBFReadColumns() */
+    DBFColumn      *pColumns;
+    int             nColumns;
+
+    SHPObjectEx    *psShape;
+    SHPReadBuffer   sReadBuf;
+};
+
+
+static void PGCopyPutInt16 (ub1 *pb, int v)
+{
+    uint16_t v2 = BO_htobe16((uint16_t) v);
+    memcpy(pb, &v2, 2);
+}
+
+
+static void PGCopyPutInt32 (ub1 *pb, int32_t v)
+{
+    uint32_t v4 = BO_htobe32((uint32_t) v);
+    memcpy(pb, &v4, 4);
+}
+
+
+static void PGCopyPutInt64 (ub1 *pb, int64_t v)
+{
+    uint64_t v8 = BO_htobe64((uint64_t) v);
+    memcpy(pb, &v8, 8);
+}
+
+
+/**
+ * One column value: int32 length then the bytes. NULL if pv is NULL.
+ */
+static void PGCopyPutValue (SHPPgCopyHandle hCopy, const void *pv, int cb)
+{
+    ub1 *pb = SHPStreamReserve(&hCopy->sStream, 4 + (pv ? cb : 0));
+
+    if (pb) {
+        if (pv) {
+            PGCopyPutInt32(pb, cb);
+            memcpy(pb + 4, pv, cb);
+            hCopy->sStream.cbBuf += 4 + cb;
+        } else {
+            PGCopyPutInt32(pb, -1);
+            hCopy->sStream.cbBuf += 4;
+        }
+    }
+}
+
+
+static void PGCopyPutGeometry (SHPPgCopyHandle hCopy, int iShape)
+{
+    int cb = -1;
+    ub1 *pb;
+
+    if (SHPReadObjectExR(hCopy->hSHP, iShape, hCopy->psShape, &hCopy->sReadBuf)) {
+        cb = SHPObjectEx2WKBFormat(hCopy->psShape, NULL, SHP_WKB_NDR | SHP_WKB_EWKB, hCopy->nSRID, 0, 0, 0, 0);
+    }
+
+    if (cb <= 0) {
+        PGCopyPutValue(hCopy, NULL, 0);
+        return;
+    }
+
+    pb = SHPStreamReserve(&hCopy->sStream, 4 + cb);
+    if (pb) {
+        PGCopyPutInt32(pb, cb);
+        SHPObjectEx2WKBFormat(hCopy->psShape, pb + 4, SHP_WKB_NDR | SHP_WKB_EWKB, hCopy->nSRID, 0, 0, 0, 0);
+        hCopy->sStream.cbBuf += 4 + cb;
+    }
+}
+
+
+/**
+ * YYYYMMDD to days since 2000-01-01, FALSE if not a date.
+ */
+static int PGCopyDateDays (int32_t nYMD, int32_t *pnDays)
+{
+    static const int anMonthDays[12] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int y = nYMD / 10000, m = (nYMD / 100) % 100, d = nYMD % 100;
+    int era, yoe, doy;
+
+    if (nYMD <= 0 || m < 1 || m > 12 || d < 1 || d > anMonthDays[m - 1] ||
+        (m == 2 && d == 29 && (y % 4 != 0 || (y % 100 == 0 && y % 400 != 0)))) {
+        return SHAPEFILE_FALSE;
+    }
+
+    /* days from civil, proleptic Gregorian */
+    y -= (m <= 2);
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = y - era * 400;
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+
+    *pnDays = era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468 - PGCOPY_EPOCH_DAYS;
+    return SHAPEFILE_TRUE;
+}
+
+
+/**
+ * bool of a logical field, read as its first non-blank char.
+ */
+static void PGCopyPutLogical (SHPPgCopyHandle hCopy, char chValue)
+{
+    ub1 b;
+
+    switch (chValue) {
+    case 'T': case 't': case 'Y': case 'y':
+        b = 1;
+        break;
+    case 'F': case 'f': case 'N': case 'n':
+        b = 0;
+        break;
+    default:
+        /* blank or unknown; '?' is already a null */
+        PGCopyPutValue(hCopy, NULL, 0);
+        return;
+    }
+    PGCopyPutValue(hCopy, &b, 1);
+}
+
+
+/**
+ * Value of row r of the batch in column pCol.
+ */
+static void PGCopyPutAttribute (SHPPgCopyHandle hCopy, const PGCopyColumn *pCol, int r)
+{
+    const DBFColumn *pColumn = hCopy->pColumns + pCol->iColumn;
+    ub1 ab[8];
+
+    if (pColumn->pabyNulls[r]) {
+        PGCopyPutValue(hCopy, NULL, 0);
+        return;
+    }
+
+    switch (pCol->eType) {
+    case PGCopyInt4:
+        PGCopyPutInt32(ab, (int32_t) ((const int64_t *) pColumn->pValues)[r]);
+        PGCopyPutValue(hCopy, ab, 4);
+        break;
+
+    case PGCopyInt8:
+        PGCopyPutInt64(ab, ((const int64_t *) pColumn->pValues)[r]);
+        PGCopyPutValue(hCopy, ab, 8);
+        break;
+
+    case PGCopyFloat8:
+        {
+            double v8 = ((const double *) pColumn->pValues)[r];
+            uint64_t u8;
+
+            memcpy(&u8, &v8, 8);
+            PGCopyPutInt64(ab, (int64_t) u8);
+            PGCopyPutValue(hCopy, ab, 8);
+        }
+        break;
+
+    case PGCopyBool:
+        PGCopyPutLogical(hCopy, ((const char *) pColumn->pValues)[(size_t) r * pColumn->nStride]);
+        break;
+
+    case PGCopyDate:
+        {
+            int32_t nDays;
+
+            if (PGCopyDateDays(((const int32_t *) pColumn->pValues)[r], &nDays)) {
+                PGCopyPutInt32(ab, nDays);
+                PGCopyPutValue(hCopy, ab, 4);
+            } else {
+                PGCopyPutValue(hCopy, NULL, 0);
+            }
+        }
+        break;
+
+    default:
+        {
+            const char *psz = (const char *) pColumn->pValues + (size_t) r * pColumn->nStride;
+            PGCopyPutValue(hCopy, psz, (int) strlen(psz));
+        }
+        break;
+    }
+}
+
+
+/**
+ * Column type of a dbf field from its batch column. Integers which may
+ *  not fit in int4 go to int8, unknown field types to text.
+ */
+static PGCopyType PGCopyFieldType (DBFHandle hDBF, const DBFColumn *pColumn)
+{
+    int nWidth = 0;
+
+    switch (pColumn->eType) {
+    case DBFColInt64:
+        DBFGetFieldInfo(hDBF, pColumn->iField, NULL, &nWidth, NULL);
+        return (nWidth <= 9) ? PGCopyInt4 : PGCopyInt8;
+    case DBFColDouble:
+        return PGCopyFloat8;
+    case DBFColDate:
+        return PGCopyDate;
+    default:
+        break;
+    }
+    return (DBFGetNativeFieldType(hDBF, pColumn->iField) == 'L') ? PGCopyBool : PGCopyText;
+}
+
+
+SHPPgCopyHandle SHPPgCopyOpen (SHPHandle hSHP, DBFHandle hDBF, int nSRID, SHPStreamSink pfnSink, void *pvSink)
+{
+    SHPPgCopyHandle hCopy;
+    int i, nFields = hDBF ? DBFGetFieldCount(hDBF) : 0;
+    ub1 *pb;
+
+    if ((!hSHP && !hDBF) || !pfnSink) {
+        return NULL;
+    }
+
+    hCopy = (SHPPgCopyHandle) calloc(1, sizeof(struct SHPPgCopyInfo));
+    if (!hCopy) {
+        return NULL;
+    }
+
+    hCopy->hSHP = hSHP;
+    hCopy->hDBF = hDBF;
+    hCopy->nSRID = nSRID;
+
+    if (hSHP) {
+        SHPGetInfo(hSHP, &hCopy->nRecords, NULL, NULL, NULL);
+        if (hDBF) {
+            hCopy->nRecords = MIN_V2(hCopy->nRecords, DBFGetRecordCount(hDBF));
+        }
+    } else {
+        hCopy->nRecords = DBFGetRecordCount(hDBF);
+    }
+
+    hCopy->pCopyColumns = (PGCopyColumn *) calloc(nFields + 1, sizeof(PGCopyColumn));
+    hCopy->pColumns = (DBFColumn *) calloc(nFields + 1, sizeof(DBFColumn));
+
+    if (!SHPStreamInit(&hCopy->sStream, pfnSink, pvSink, SHP_PGCOPY_BUFSIZE) ||
+        !hCopy->pCopyColumns || !hCopy->pColumns) {
+        hCopy->sStream.bError = SHAPEFILE_TRUE;
+        SHPPgCopyClose(hCopy);
+        return NULL;
+    }
+
+    if (hSHP) {
+        PGCopyColumn *pCol = hCopy->pCopyColumns + hCopy->nCopyColumns++;
+        pCol->eType = PGCopyGeometry;
+        pCol->iField = -1;
+        pCol->iColumn = -1;
+
+        if (!SHPCreateObjectEx(&hCopy->psShape)) {
+            hCopy->sStream.bError = SHAPEFILE_TRUE;
+            SHPPgCopyClose(hCopy);
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < nFields; i++) {
+        PGCopyColumn *pCol = hCopy->pCopyColumns + hCopy->nCopyColumns++;
+        DBFColumn *pColumn = hCopy->pColumns + hCopy->nColumns;
+
+        if (!DBFBatchColumnInit(hDBF, i, pColumn, SHP_PGCOPY_BATCH)) {
+            hCopy->sStream.bError = SHAPEFILE_TRUE;
+            SHPPgCopyClose(hCopy);
+            return NULL;
+        }
+
+        pCol->eType = PGCopyFieldType(hDBF, pColumn);
+        pCol->iField = i;
+        pCol->iColumn = hCopy->nColumns++;
+    }
+
+    pb = SHPStreamReserve(&hCopy->sStream, 19);
+    memcpy(pb, "PGCOPY\n\377\r\n\0", 11);
+    PGCopyPutInt32(pb + 11, 0);
+    PGCopyPutInt32(pb + 15, 0);
+    hCopy->sStream.cbBuf += 19;
+
+    return hCopy;
+}
+
+
+int SHPPgCopyGetColumnCount (SHPPgCopyHandle hCopy)
+{
+    return hCopy->nCopyColumns;
+}
+
+
+const char * SHPPgCopyGetColumnType (SHPPgCopyHandle hCopy, int iColumn)
+{
+    if (iColumn < 0 || iColumn >= hCopy->nCopyColumns) {
+        return NULL;
+    }
+    return PGCopyTypeNames[hCopy->pCopyColumns[iColumn].eType];
+}
+
+
+int SHPPgCopyWriteRecords (SHPPgCopyHandle hCopy, int iFirst, int nCount)
+{
+    int nDone = 0;
+
+    if (hCopy->sStream.bError || iFirst < 0) {
+        return -1;
+    }
+
+    nCount = MIN_V2(nCount, hCopy->nRecords - iFirst);
+
+    while (nDone < nCount) {
+        int nBatch = MIN_V2(nCount - nDone, SHP_PGCOPY_BATCH);
+        int iRecord = iFirst + nDone;
+        int r, c;
+
+        if (hCopy->nColumns > 0 &&
+            DBFReadColumns(hCopy->hDBF, iRecord, nBatch, hCopy->pColumns, hCopy->nColumns) != nBatch) {
+            return -1;
+        }
+
+        for (r = 0; r < nBatch; r++, iRecord++) {
+            ub1 *pb = SHPStreamReserve(&hCopy->sStream, 2);
+
+            if (!pb) {
+                return -1;
+            }
+            PGCopyPutInt16(pb, hCopy->nCopyColumns);
+            hCopy->sStream.cbBuf += 2;
+
+            for (c = 0; c < hCopy->nCopyColumns; c++) {
+                const PGCopyColumn *pCol = hCopy->pCopyColumns + c;
+
+                if (pCol->eType == PGCopyGeometry) {
+                    PGCopyPutGeometry(hCopy, iRecord);
+                } else {
+                    PGCopyPutAttribute(hCopy, pCol, r);
+                }
+            }
+        }
+
+        if (hCopy->sStream.bError) {
+            return -1;
+        }
+        nDone += nBatch;
+    }
+
+    return nDone;
+}
+
+
+int SHPPgCopyClose (SHPPgCopyHandle hCopy)
+{
+    int bOk = SHAPEFILE_FALSE;
+
+    if (!hCopy->sStream.bError) {
+        ub1 *pb = SHPStreamReserve(&hCopy->sStream, 2);
+
+        if (pb) {
+            PGCopyPutInt16(pb, -1);
+            hCopy->sStream.cbBuf += 2;
+        }
+        bOk = SHPStreamFlush(&hCopy->sStream);
+    }
+
+    if (hCopy->pColumns) {
+        DBFBatchColumnsFree(hCopy->pColumns, hCopy->nColumns);
+    }
+
+    if (hCopy->psShape) {
+        SHPDestroyObjectEx(hCopy->psShape);
+    }
+    SHPReadBufferFree(&hCopy->sReadBuf);
+
+    SafeFree(hCopy->pCopyColumns);
+    SafeFree(hCopy->pColumns);
+    SHPStreamFree(&hCopy->sStream);
+    free(hCopy);
+
+    return bOk;
+}
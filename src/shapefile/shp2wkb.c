@@ -1,1004 +1,546 @@
 #include "shp2wkb.h"
 
-int Point2WKB(const SHPObject *pObj, void *pv, double offX, double offY)
+
+/* -------------------------------------------------------------------- */
+/*      WKB writer: every *2WKB function goes through these. With no    */
+/*      output buffer only the size is computed.                        */
+/* -------------------------------------------------------------------- */
+#if BO_LITTLE_ENDIAN
+  #define WKB_BYTEORDER_HOST  WKB_BYTEORDER_NDR
+#else
+  #define WKB_BYTEORDER_HOST  WKB_BYTEORDER_XDR
+#endif
+
+/* PostGIS EWKB type flags */
+#define EWKB_ZFLAG     0x80000000
+#define EWKB_MFLAG     0x40000000
+#define EWKB_SRIDFLAG  0x20000000
+
+typedef struct
 {
-    ub4 v4;
-    double v8;
-    int cb = 0;
+    ub1          *pbOut;        /* NULL to compute size only */
+    int           cb;
 
-    if (pv) {
-        WriteWkbBoXdr(pv, cb);
+    ub1           byteOrder;    /* WKB_BYTEORDER_* */
+    int           bSwap;        /* byteOrder is not the host order */
+    int           bEWKB;
+    int           nSRID;        /* written with the outer type if > 0 */
 
-        v4 = BO_htobe32(WKB_Point2D);
-        ValBufCopy(pv, cb, v4);
+    SHPCoordSeq   seq;          /* x, y and parts */
+    const double *padfZM;       /* third ordinate, NULL if none */
+    int           bM;           /* padfZM is M rather than Z */
 
-        v8 = BO_float64_htobe(*pObj->padfX + offX);
-        ValBufCopy(pv, cb, v8);
+    double        offX, offY, offZM;
+} WKBWriter;
 
-        v8 = BO_float64_htobe(*pObj->padfY + offY);
-        ValBufCopy(pv, cb, v8);
-    } else {
-        cb = WKBPointSize(1);
-    }
 
-    return cb;
+static void WKBWriterInit (WKBWriter *w, void *pv, int nWkbFlags, int nSRID, const SHPCoordSeq *psSeq,
+    const double *padfZM, int bM, double offX, double offY, double offZM)
+{
+    w->pbOut = (ub1 *) pv;
+    w->cb = 0;
+    w->byteOrder = (nWkbFlags & SHP_WKB_NDR) ? WKB_BYTEORDER_NDR : WKB_BYTEORDER_XDR;
+    w->bSwap = (w->byteOrder != WKB_BYTEORDER_HOST);
+    w->bEWKB = (nWkbFlags & SHP_WKB_EWKB) ? 1 : 0;
+    w->nSRID = w->bEWKB ? nSRID : 0;
+    w->seq = *psSeq;
+    w->padfZM = padfZM;
+    w->bM = bM;
+    w->offX = offX;
+    w->offY = offY;
+    w->offZM = offZM;
 }
 
 
-int Arc2WKB(const SHPObject *pObj, void *pv, double offX, double offY)
+static void WKBPutInt (WKBWriter *w, ub4 v4)
 {
-    ub4 v4;
-    double   v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPoint = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
-
-        /* wkb type */
-        v4 = BO_htobe32(WKB_LineString2D);
-        ValBufCopy(pv, cb, v4);
-
-        /* num of points */
-        v4 = BO_htobe32(pObj->nVertices);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPoint < pObj->nVertices; iPoint++) {
-            v8 = BO_float64_htobe(pObj->padfX[iPoint] + offX);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->padfY[iPoint] + offY);
-            ValBufCopy(pv, cb, v8);
+    if (w->pbOut) {
+        if (w->bSwap) {
+            v4 = BO_bswap32(v4);
         }
-    } else {
-        cb = WKBLineStringSize(pObj->nVertices);
+        memcpy(w->pbOut + w->cb, &v4, sizeof(v4));
     }
-
-    return cb;
+    w->cb += sizeof(v4);
 }
 
 
-int Polygon2WKB(const SHPObject *pObj, void *pv, double offX, double offY)
+static void WKBPutDouble (ub1 *pb, double v8, int bSwap)
 {
-    ub4 v4;
-    double   v8;
-    int cb = 0;
+    if (bSwap) {
+        uint64_t u8;
+        memcpy(&u8, &v8, sizeof(u8));
+        u8 = BO_bswap64(u8);
+        memcpy(pb, &u8, sizeof(u8));
+    } else {
+        memcpy(pb, &v8, sizeof(v8));
+    }
+}
 
-    if (pv) {
-        int iPart = 0;
 
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
+/**
+ * Byte order and type of a geometry. Only the outermost one carries
+ *  the SRID in EWKB.
+ */
+static void WKBPutHeader (WKBWriter *w, ub4 wkbType, int bOuter)
+{
+    int bSRID = (bOuter && w->nSRID > 0);
 
-        /* wkb type */
-        v4 = BO_htobe32(WKB_Polygon2D);
-        ValBufCopy(pv, cb, v4);
+    if (w->bEWKB) {
+        /* wkbType is 2D here: Z and M are flags */
+        if (w->padfZM) {
+            wkbType |= (w->bM ? EWKB_MFLAG : EWKB_ZFLAG);
+        }
+        if (bSRID) {
+            wkbType |= EWKB_SRIDFLAG;
+        }
+    } else if (w->padfZM) {
+        wkbType += (w->bM ? WKB_GeometryM : WKB_GeometryZ);
+    }
 
-        /* num of rings */
-        v4 = BO_htobe32(pObj->nParts);
-        ValBufCopy(pv, cb, v4);
+    if (w->pbOut) {
+        w->pbOut[w->cb] = w->byteOrder;
+    }
+    w->cb++;
 
-        for (; iPart < pObj->nParts; iPart++) {
-            int p = pObj->panPartStart[iPart];
-            int p1 = pObj->panPartStart[iPart+1];
+    WKBPutInt(w, wkbType);
 
-            /* num of points */
-            v4 = BO_htobe32(p1 - p);
-            ValBufCopy(pv, cb, v4);
+    if (bSRID) {
+        WKBPutInt(w, (ub4) w->nSRID);
+    }
+}
 
-            for (; p < p1; p++) {
-                v8 = BO_float64_htobe(pObj->padfX[p] + offX);
-                ValBufCopy(pv, cb, v8);
 
-                v8 = BO_float64_htobe(pObj->padfY[p] + offY);
-                ValBufCopy(pv, cb, v8);
+/**
+ * Coordinates of vertices [start, end). In host order without offsets
+ *  packed x,y points go out with a single memcpy.
+ */
+static void WKBPutPoints (WKBWriter *w, int start, int end)
+{
+    int    nDims = w->padfZM ? 3 : 2;
+    size_t cbPoints = (size_t) (end - start) * nDims * sizeof(double);
+
+    if (w->pbOut) {
+        ub1 *pb = w->pbOut + w->cb;
+        int  at;
+
+        if (!w->bSwap && nDims == 2 && w->seq.nStride == SHPCOORDS_AOS && w->seq.padfY == w->seq.padfX + 1 &&
+            w->offX == 0 && w->offY == 0) {
+            memcpy(pb, w->seq.padfX + (size_t) start * 2, cbPoints);
+        } else {
+            for (at = start; at < end; at++) {
+                WKBPutDouble(pb, SHPCoordX(&w->seq, w->seq.nStride, at) + w->offX, w->bSwap);
+                WKBPutDouble(pb + 8, SHPCoordY(&w->seq, w->seq.nStride, at) + w->offY, w->bSwap);
+                pb += 16;
+
+                if (w->padfZM) {
+                    WKBPutDouble(pb, w->padfZM[at] + w->offZM, w->bSwap);
+                    pb += 8;
+                }
             }
         }
-    } else {
-        int iPart = 0;
-
-        cb = WKBHeaderSize;
-
-        /* num of rings */
-        ValBufOffset(pv, cb, v4);
+    }
+    w->cb += (int) cbPoints;
+}
 
-        for (; iPart < pObj->nParts; iPart++) {
-            int np = pObj->panPartStart[iPart+1] - pObj->panPartStart[iPart];
 
-            /* num of points */
-            ValBufOffset(pv, cb, v4);
+static int WKBWritePoint (WKBWriter *w)
+{
+    WKBPutHeader(w, WKB_Point, 1);
 
-            ValBufOffsetN(pv, cb, v8, np);
-            ValBufOffsetN(pv, cb, v8, np);
+    if (w->seq.nVertices > 0) {
+        WKBPutPoints(w, 0, 1);
+    } else {
+        /* no empty point in WKB: NaN coordinates as PostGIS and GEOS do */
+        static const double adfNaN[3] = {NAN, NAN, NAN};
+        WKBWriter wNaN = *w;
+
+        wNaN.seq.padfX = (double *) adfNaN;
+        wNaN.seq.padfY = (double *) adfNaN + 1;
+        wNaN.seq.nStride = 0;
+        if (w->padfZM) {
+            wNaN.padfZM = adfNaN + 2;
         }
+        WKBPutPoints(&wNaN, 0, 1);
+        w->cb = wNaN.cb;
     }
-
-    return cb;
+    return w->cb;
 }
 
 
-int MultiPoint2WKB(const SHPObject *pObj, void *pv, double offX, double offY)
+static int WKBWriteMultiPoint (WKBWriter *w)
 {
-    ub4 v4;
-    double v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPoint = 0;
-        WriteWkbBoXdr(pv, cb);
+    int i, nVertices = w->seq.nVertices;
 
-        v4 = BO_htobe32(WKB_MultiPoint2D);
-        ValBufCopy(pv, cb, v4);
+    WKBPutHeader(w, WKB_MultiPoint, 1);
+    WKBPutInt(w, (ub4) nVertices);
 
-        v4 = BO_htobe32(pObj->nVertices);
-        ValBufCopy(pv, cb, v4);
+    for (i = 0; i < nVertices; i++) {
+        WKBPutHeader(w, WKB_Point, 0);
+        WKBPutPoints(w, i, i + 1);
+    }
+    return w->cb;
+}
 
-        for (; iPoint < pObj->nVertices; iPoint++) {
-            WriteWkbBoXdr(pv, cb);
 
-            v4 = BO_htobe32(WKB_Point2D);
-            ValBufCopy(pv, cb, v4);
+static int WKBWriteLines (WKBWriter *w)
+{
+    int iPart, start, end, nParts = w->seq.nParts;
 
-            v8 = BO_float64_htobe(pObj->padfX[iPoint] + offX);
-            ValBufCopy(pv, cb, v8);
+    if (nParts > 1) {
+        WKBPutHeader(w, WKB_MultiLineString, 1);
+        WKBPutInt(w, (ub4) nParts);
 
-            v8 = BO_float64_htobe(pObj->padfY[iPoint] + offY);
-            ValBufCopy(pv, cb, v8);
+        for (iPart = 0; iPart < nParts; iPart++) {
+            SHPCoordsPartRange(&w->seq, iPart, &start, &end);
+            WKBPutHeader(w, WKB_LineString, 0);
+            WKBPutInt(w, (ub4) (end - start));
+            WKBPutPoints(w, start, end);
         }
     } else {
-        cb = WKBHeaderSize + sizeof(v4) + WKBPointSize(pObj->nVertices);
+        SHPCoordsPartRange(&w->seq, 0, &start, &end);
+        WKBPutHeader(w, WKB_LineString, 1);
+        WKBPutInt(w, (ub4) (end - start));
+        WKBPutPoints(w, start, end);
     }
-
-    return cb;
+    return w->cb;
 }
 
 
-int PointZ2WKB(const SHPObject *pObj, void *pv, double offX, double offY, double offZ)
+static int WKBWritePolygon (WKBWriter *w)
 {
-    ub4 v4;
-    double v8;
-    int cb = 0;
-
-    if (pv) {
-        WriteWkbBoXdr(pv, cb);
-
-        v4 = BO_htobe32(WKB_PointZ);
-        ValBufCopy(pv, cb, v4);
+    int iPart, start, end;
+    int nRings = (w->seq.nVertices == 0) ? 0 : MAX_V2(w->seq.nParts, 1);
 
-        v8 = BO_float64_htobe(*pObj->padfX + offX);
-        ValBufCopy(pv, cb, v8);
+    WKBPutHeader(w, WKB_Polygon, 1);
+    WKBPutInt(w, (ub4) nRings);
 
-        v8 = BO_float64_htobe(*pObj->padfY + offY);
-        ValBufCopy(pv, cb, v8);
-
-        v8 = BO_float64_htobe(*pObj->padfZ + offZ);
-        ValBufCopy(pv, cb, v8);
-    } else {
-        cb = WKBPointZSize(1);
+    for (iPart = 0; iPart < nRings; iPart++) {
+        SHPCoordsPartRange(&w->seq, iPart, &start, &end);
+        WKBPutInt(w, (ub4) (end - start));
+        WKBPutPoints(w, start, end);
     }
-
-    return cb;
+    return w->cb;
 }
 
 
-int ArcZ2WKB(const SHPObject *pObj, void *pv, double offX, double offY, double offZ)
+static int WKBWriteShape (WKBWriter *w, double offZ, double offM)
 {
-    ub4 v4;
-    double   v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPoint = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
-
-        /* wkb type */
-        v4 = BO_htobe32(WKB_LineStringZ);
-        ValBufCopy(pv, cb, v4);
-
-        /* num of points */
-        v4 = BO_htobe32(pObj->nVertices);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPoint < pObj->nVertices; iPoint++) {
-            v8 = BO_float64_htobe(pObj->padfX[iPoint] + offX);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->padfY[iPoint] + offY);
-            ValBufCopy(pv, cb, v8);
+    switch (w->seq.nSHPType) {
+    case SHPT_POINTZ:
+    case SHPT_ARCZ:
+    case SHPT_POLYGONZ:
+    case SHPT_MULTIPOINTZ:
+        w->padfZM = w->seq.padfZ;
+        w->offZM = offZ;
+        w->bM = 0;
+        break;
+    case SHPT_POINTM:
+    case SHPT_ARCM:
+    case SHPT_POLYGONM:
+    case SHPT_MULTIPOINTM:
+        w->padfZM = w->seq.padfM;
+        w->offZM = offM;
+        w->bM = 1;
+        break;
+    }
 
-            v8 = BO_float64_htobe(pObj->padfZ[iPoint] + offZ);
-            ValBufCopy(pv, cb, v8);
-        }
-    } else {
-        cb = WKBLineStringZSize(pObj->nVertices);
+    switch (w->seq.nSHPType) {
+    case SHPT_NULL:
+        return -1;
+    case SHPT_POINT:
+    case SHPT_POINTZ:
+    case SHPT_POINTM:
+        return WKBWritePoint(w);
+    case SHPT_ARC:
+    case SHPT_ARCZ:
+    case SHPT_ARCM:
+        return WKBWriteLines(w);
+    case SHPT_POLYGON:
+    case SHPT_POLYGONZ:
+    case SHPT_POLYGONM:
+        return WKBWritePolygon(w);
+    case SHPT_MULTIPOINT:
+    case SHPT_MULTIPOINTZ:
+    case SHPT_MULTIPOINTM:
+        return WKBWriteMultiPoint(w);
     }
 
-    return cb;
+    /* SHPT_MULTIPATCH: TODO */
+    return 0;
 }
 
 
-int PolygonZ2WKB(const SHPObject *pObj, void *pv, double offX, double offY, double offZ)
+int SHPObject2WKBFormat (const SHPObject *psObject, void *wkbBuffer, int nWkbFlags, int nSRID,
+    double offsetX, double offsetY, double offsetZ, double offsetM)
 {
-    ub4 v4;
-    double   v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPart = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
+    WKBWriter w;
+    SHPCoordSeq seq;
 
-        /* wkb type */
-        v4 = BO_htobe32(WKB_PolygonZ);
-        ValBufCopy(pv, cb, v4);
+    SHPCoordSeqOfObject(&seq, psObject);
+    WKBWriterInit(&w, wkbBuffer, nWkbFlags, nSRID, &seq, NULL, 0, offsetX, offsetY, 0);
 
-        /* num of rings */
-        v4 = BO_htobe32(pObj->nParts);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPart < pObj->nParts; iPart++) {
-            int p = pObj->panPartStart[iPart];
-            int p1 = pObj->panPartStart[iPart+1];
+    return WKBWriteShape(&w, offsetZ, offsetM);
+}
 
-            /* num of points */
-            v4 = BO_htobe32(p1 - p);
-            ValBufCopy(pv, cb, v4);
 
-            for (; p < p1; p++) {
-                v8 = BO_float64_htobe(pObj->padfX[p] + offX);
-                ValBufCopy(pv, cb, v8);
+int SHPObjectEx2WKBFormat (const SHPObjectEx *psObject, void *wkbBuffer, int nWkbFlags, int nSRID,
+    double offsetX, double offsetY, double offsetZ, double offsetM)
+{
+    WKBWriter w;
+    SHPCoordSeq seq;
 
-                v8 = BO_float64_htobe(pObj->padfY[p] + offY);
-                ValBufCopy(pv, cb, v8);
+    SHPCoordSeqOfObjectEx(&seq, psObject);
+    WKBWriterInit(&w, wkbBuffer, nWkbFlags, nSRID, &seq, NULL, 0, offsetX, offsetY, 0);
 
-                v8 = BO_float64_htobe(pObj->padfZ[p] + offZ);
-                ValBufCopy(pv, cb, v8);
-            }
-        }
-    } else {
-        int iPart = 0;
+    return WKBWriteShape(&w, offsetZ, offsetM);
+}
 
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
 
-        /* wkb type */
-        ValBufOffset(pv, cb, v4);
+/* -------------------------------------------------------------------- */
+/*      SHPObject (XDR)                                                 */
+/* -------------------------------------------------------------------- */
 
-        /* num of rings */
-        ValBufOffset(pv, cb, v4);
+int Point2WKB(const SHPObject *pObj, void *pv, double offX, double offY)
+{
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, NULL, 0, offX, offY, 0);
+    return WKBWritePoint(&w);
+}
 
-        for (; iPart < pObj->nParts; iPart++) {
-            int np = pObj->panPartStart[iPart+1] - pObj->panPartStart[iPart];
 
-            /* num of points */
-            ValBufOffset(pv, cb, v4);
+int Arc2WKB(const SHPObject *pObj, void *pv, double offX, double offY)
+{
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, NULL, 0, offX, offY, 0);
+    return WKBWriteLines(&w);
+}
 
-            ValBufOffsetN(pv, cb, v8, np);
-            ValBufOffsetN(pv, cb, v8, np);
-            ValBufOffsetN(pv, cb, v8, np);
-        }
-    }
 
-    return cb;
+int Polygon2WKB(const SHPObject *pObj, void *pv, double offX, double offY)
+{
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, NULL, 0, offX, offY, 0);
+    return WKBWritePolygon(&w);
 }
 
 
-int MultiPointZ2WKB(const SHPObject *pObj, void *pv, double offX, double offY, double offZ)
+int MultiPoint2WKB(const SHPObject *pObj, void *pv, double offX, double offY)
 {
-    ub4 v4;
-    double v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPoint = 0;
-        WriteWkbBoXdr(pv, cb);
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, NULL, 0, offX, offY, 0);
+    return WKBWriteMultiPoint(&w);
+}
 
-        v4 = BO_htobe32(WKB_MultiPointZ);
-        ValBufCopy(pv, cb, v4);
 
-        v4 = BO_htobe32(pObj->nVertices);
-        ValBufCopy(pv, cb, v4);
+int PointZ2WKB(const SHPObject *pObj, void *pv, double offX, double offY, double offZ)
+{
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfZ, 0, offX, offY, offZ);
+    return WKBWritePoint(&w);
+}
 
-        for (; iPoint < pObj->nVertices; iPoint++) {
-            WriteWkbBoXdr(pv, cb);
 
-            v4 = BO_htobe32(WKB_PointZ);
-            ValBufCopy(pv, cb, v4);
+int ArcZ2WKB(const SHPObject *pObj, void *pv, double offX, double offY, double offZ)
+{
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfZ, 0, offX, offY, offZ);
+    return WKBWriteLines(&w);
+}
 
-            v8 = BO_float64_htobe(pObj->padfX[iPoint] + offX);
-            ValBufCopy(pv, cb, v8);
 
-            v8 = BO_float64_htobe(pObj->padfY[iPoint] + offY);
-            ValBufCopy(pv, cb, v8);
+int PolygonZ2WKB(const SHPObject *pObj, void *pv, double offX, double offY, double offZ)
+{
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfZ, 0, offX, offY, offZ);
+    return WKBWritePolygon(&w);
+}
 
-            v8 = BO_float64_htobe(pObj->padfZ[iPoint] + offZ);
-            ValBufCopy(pv, cb, v8);
-        }
-    } else {
-        cb = WKBHeaderSize + sizeof(v4) + WKBPointZSize(pObj->nVertices);
-    }
 
-    return cb;
+int MultiPointZ2WKB(const SHPObject *pObj, void *pv, double offX, double offY, double offZ)
+{
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfZ, 0, offX, offY, offZ);
+    return WKBWriteMultiPoint(&w);
 }
 
 
 int PointM2WKB(const SHPObject *pObj, void *pv, double offX, double offY, double offM)
 {
-    ub4 v4;
-    double v8;
-    int cb = 0;
-
-    if (pv) {
-        WriteWkbBoXdr(pv, cb);
-
-        v4 = BO_htobe32(WKB_PointM);
-        ValBufCopy(pv, cb, v4);
-
-        v8 = BO_float64_htobe(*pObj->padfX + offX);
-        ValBufCopy(pv, cb, v8);
-
-        v8 = BO_float64_htobe(*pObj->padfY + offY);
-        ValBufCopy(pv, cb, v8);
-
-        v8 = BO_float64_htobe(*pObj->padfM + offM);
-        ValBufCopy(pv, cb, v8);
-    } else {
-        cb = WKBPointMSize(1);
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfM, 1, offX, offY, offM);
+    return WKBWritePoint(&w);
 }
 
 
 int ArcM2WKB(const SHPObject *pObj, void *pv, double offX, double offY, double offM)
 {
-    ub4 v4;
-    double   v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPoint = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
-
-        /* wkb type */
-        v4 = BO_htobe32(WKB_LineStringM);
-        ValBufCopy(pv, cb, v4);
-
-        /* num of points */
-        v4 = BO_htobe32(pObj->nVertices);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPoint < pObj->nVertices; iPoint++) {
-            v8 = BO_float64_htobe(pObj->padfX[iPoint] + offX);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->padfY[iPoint] + offY);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->padfM[iPoint] + offM);
-            ValBufCopy(pv, cb, v8);
-        }
-    } else {
-        cb = WKBLineStringMSize(pObj->nVertices);
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfM, 1, offX, offY, offM);
+    return WKBWriteLines(&w);
 }
 
 
 int PolygonM2WKB(const SHPObject *pObj, void *pv, double offX, double offY, double offM)
 {
-    ub4 v4;
-    double   v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPart = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
-
-        /* wkb type */
-        v4 = BO_htobe32(WKB_PolygonM);
-        ValBufCopy(pv, cb, v4);
-
-        /* num of rings */
-        v4 = BO_htobe32(pObj->nParts);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPart < pObj->nParts; iPart++) {
-            int p = pObj->panPartStart[iPart];
-            int p1 = pObj->panPartStart[iPart+1];
-
-            /* num of points */
-            v4 = BO_htobe32(p1 - p);
-            ValBufCopy(pv, cb, v4);
-
-            for (; p < p1; p++) {
-                v8 = BO_float64_htobe(pObj->padfX[p] + offX);
-                ValBufCopy(pv, cb, v8);
-
-                v8 = BO_float64_htobe(pObj->padfY[p] + offY);
-                ValBufCopy(pv, cb, v8);
-
-                v8 = BO_float64_htobe(pObj->padfM[p] + offM);
-                ValBufCopy(pv, cb, v8);
-            }
-        }
-    } else {
-        int iPart = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
-
-        /* wkb type */
-        ValBufOffset(pv, cb, v4);
-
-        /* num of rings */
-        ValBufOffset(pv, cb, v4);
-
-        for (; iPart < pObj->nParts; iPart++) {
-            int np = pObj->panPartStart[iPart+1] - pObj->panPartStart[iPart];
-
-            /* num of points */
-            ValBufOffset(pv, cb, v4);
-
-            ValBufOffsetN(pv, cb, v8, np);
-            ValBufOffsetN(pv, cb, v8, np);
-            ValBufOffsetN(pv, cb, v8, np);
-        }
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfM, 1, offX, offY, offM);
+    return WKBWritePolygon(&w);
 }
 
 
 int MultiPointM2WKB(const SHPObject *pObj, void *pv, double offX, double offY, double offM)
 {
-    ub4 v4;
-    double v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPoint = 0;
-        WriteWkbBoXdr(pv, cb);
-
-        v4 = BO_htobe32(WKB_MultiPointM);
-        ValBufCopy(pv, cb, v4);
-
-        v4 = BO_htobe32(pObj->nVertices);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPoint < pObj->nVertices; iPoint++) {
-            WriteWkbBoXdr(pv, cb);
-
-            v4 = BO_htobe32(WKB_PointM);
-            ValBufCopy(pv, cb, v4);
-
-            v8 = BO_float64_htobe(pObj->padfX[iPoint] + offX);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->padfY[iPoint] + offY);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->padfM[iPoint] + offM);
-            ValBufCopy(pv, cb, v8);
-        }
-    } else {
-        cb = WKBHeaderSize + sizeof(v4) + WKBPointMSize(pObj->nVertices);
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfM, 1, offX, offY, offM);
+    return WKBWriteMultiPoint(&w);
 }
 
 
+/* -------------------------------------------------------------------- */
+/*      SHPObjectEx (XDR)                                               */
+/* -------------------------------------------------------------------- */
+
 int exPoint2WKB(const SHPObjectEx *pObj, void *pv, double offX, double offY)
 {
-    ub4 v4;
-    double v8;
-    int cb = 0;
-
-    if (pv) {
-        WriteWkbBoXdr(pv, cb);
-
-        v4 = BO_htobe32(WKB_Point2D);
-        ValBufCopy(pv, cb, v4);
-
-        v8 = BO_float64_htobe(pObj->pPoints[0].x + offX);
-        ValBufCopy(pv, cb, v8);
-
-        v8 = BO_float64_htobe(pObj->pPoints[0].y + offY);
-        ValBufCopy(pv, cb, v8);
-    } else {
-        cb = WKBPointSize(1);
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, NULL, 0, offX, offY, 0);
+    return WKBWritePoint(&w);
 }
 
 
 int exArc2WKB(const SHPObjectEx *pObj, void *pv, double offX, double offY)
 {
-    ub4 v4;
-    double   v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPoint = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
-
-        /* wkb type */
-        v4 = BO_htobe32(WKB_LineString2D);
-        ValBufCopy(pv, cb, v4);
-
-        /* num of points */
-        v4 = BO_htobe32(pObj->nVertices);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPoint < pObj->nVertices; iPoint++) {
-            v8 = BO_float64_htobe(pObj->pPoints[iPoint].x + offX);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->pPoints[iPoint].y + offY);
-            ValBufCopy(pv, cb, v8);
-        }
-    } else {
-        cb = WKBLineStringSize(pObj->nVertices);
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, NULL, 0, offX, offY, 0);
+    return WKBWriteLines(&w);
 }
 
 
 int exPolygon2WKB(const SHPObjectEx *pObj, void *pv, double offX, double offY)
 {
-    ub4 v4;
-    double   v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPart = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
-
-        /* wkb type */
-        v4 = BO_htobe32(WKB_Polygon2D);
-        ValBufCopy(pv, cb, v4);
-
-        /* num of rings */
-        v4 = BO_htobe32(pObj->nParts);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPart < pObj->nParts; iPart++) {
-            int p = pObj->panPartStart[iPart];
-            int p1 = pObj->panPartStart[iPart+1];
-
-            /* num of points */
-            v4 = BO_htobe32(p1 - p);
-            ValBufCopy(pv, cb, v4);
-
-            for (; p < p1; p++) {
-                v8 = BO_float64_htobe(pObj->pPoints[p].x + offX);
-                ValBufCopy(pv, cb, v8);
-
-                v8 = BO_float64_htobe(pObj->pPoints[p].y + offY);
-                ValBufCopy(pv, cb, v8);
-            }
-        }
-    } else {
-        int iPart = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
-
-        /* wkb type */
-        ValBufOffset(pv, cb, v4);
-
-        /* num of rings */
-        ValBufOffset(pv, cb, v4);
-
-        for (; iPart < pObj->nParts; iPart++) {
-            int np = pObj->panPartStart[iPart+1] - pObj->panPartStart[iPart];
-
-            /* num of points */
-            ValBufOffset(pv, cb, v4);
-
-            ValBufOffsetN(pv, cb, v8, np);
-            ValBufOffsetN(pv, cb, v8, np);
-        }
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, NULL, 0, offX, offY, 0);
+    return WKBWritePolygon(&w);
 }
 
 
 int exMultiPoint2WKB(const SHPObjectEx *pObj, void *pv, double offX, double offY)
 {
-    ub4 v4;
-    double v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPoint = 0;
-        WriteWkbBoXdr(pv, cb);
-
-        v4 = BO_htobe32(WKB_MultiPoint2D);
-        ValBufCopy(pv, cb, v4);
-
-        v4 = BO_htobe32(pObj->nVertices);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPoint < pObj->nVertices; iPoint++) {
-            WriteWkbBoXdr(pv, cb);
-
-            v4 = BO_htobe32(WKB_Point2D);
-            ValBufCopy(pv, cb, v4);
-
-            v8 = BO_float64_htobe(pObj->pPoints[iPoint].x + offX);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->pPoints[iPoint].y + offY);
-            ValBufCopy(pv, cb, v8);
-        }
-    } else {
-        cb = WKBHeaderSize + sizeof(v4) + WKBPointSize(pObj->nVertices);
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, NULL, 0, offX, offY, 0);
+    return WKBWriteMultiPoint(&w);
 }
 
 
 int exPointZ2WKB(const SHPObjectEx *pObj, void *pv, double offX, double offY, double offZ)
 {
-    ub4 v4;
-    double v8;
-    int cb = 0;
-
-    if (pv) {
-        WriteWkbBoXdr(pv, cb);
-
-        v4 = BO_htobe32(WKB_PointZ);
-        ValBufCopy(pv, cb, v4);
-
-        v8 = BO_float64_htobe(pObj->pPoints[0].x + offX);
-        ValBufCopy(pv, cb, v8);
-
-        v8 = BO_float64_htobe(pObj->pPoints[0].y + offY);
-        ValBufCopy(pv, cb, v8);
-
-        v8 = BO_float64_htobe(*pObj->padfZ + offZ);
-        ValBufCopy(pv, cb, v8);
-    } else {
-        cb = WKBPointZSize(1);
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfZ, 0, offX, offY, offZ);
+    return WKBWritePoint(&w);
 }
 
 
 int exArcZ2WKB(const SHPObjectEx *pObj, void *pv, double offX, double offY, double offZ)
 {
-    ub4 v4;
-    double   v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPoint = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
-
-        /* wkb type */
-        v4 = BO_htobe32(WKB_LineStringZ);
-        ValBufCopy(pv, cb, v4);
-
-        /* num of points */
-        v4 = BO_htobe32(pObj->nVertices);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPoint < pObj->nVertices; iPoint++) {
-            v8 = BO_float64_htobe(pObj->pPoints[iPoint].x + offX);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->pPoints[iPoint].y + offY);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->padfZ[iPoint] + offZ);
-            ValBufCopy(pv, cb, v8);
-        }
-    } else {
-        cb = WKBLineStringZSize(pObj->nVertices);
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfZ, 0, offX, offY, offZ);
+    return WKBWriteLines(&w);
 }
 
 
 int exPolygonZ2WKB(const SHPObjectEx *pObj, void *pv, double offX, double offY, double offZ)
 {
-    ub4 v4;
-    double   v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPart = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
-
-        /* wkb type */
-        v4 = BO_htobe32(WKB_PolygonZ);
-        ValBufCopy(pv, cb, v4);
-
-        /* num of rings */
-        v4 = BO_htobe32(pObj->nParts);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPart < pObj->nParts; iPart++) {
-            int p = pObj->panPartStart[iPart];
-            int p1 = pObj->panPartStart[iPart+1];
-
-            /* num of points */
-            v4 = BO_htobe32(p1 - p);
-            ValBufCopy(pv, cb, v4);
-
-            for (; p < p1; p++) {
-                v8 = BO_float64_htobe(pObj->pPoints[p].x + offX);
-                ValBufCopy(pv, cb, v8);
-
-                v8 = BO_float64_htobe(pObj->pPoints[p].y + offY);
-                ValBufCopy(pv, cb, v8);
-
-                v8 = BO_float64_htobe(pObj->padfZ[p] + offZ);
-                ValBufCopy(pv, cb, v8);
-            }
-        }
-    } else {
-        int iPart = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
-
-        /* wkb type */
-        ValBufOffset(pv, cb, v4);
-
-        /* num of rings */
-        ValBufOffset(pv, cb, v4);
-
-        for (; iPart < pObj->nParts; iPart++) {
-            int np = pObj->panPartStart[iPart+1] - pObj->panPartStart[iPart];
-
-            /* num of points */
-            ValBufOffset(pv, cb, v4);
-
-            ValBufOffsetN(pv, cb, v8, np);
-            ValBufOffsetN(pv, cb, v8, np);
-            ValBufOffsetN(pv, cb, v8, np);
-        }
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfZ, 0, offX, offY, offZ);
+    return WKBWritePolygon(&w);
 }
 
 
 int exMultiPointZ2WKB(const SHPObjectEx *pObj, void *pv, double offX, double offY, double offZ)
 {
-    ub4 v4;
-    double v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPoint = 0;
-        WriteWkbBoXdr(pv, cb);
-
-        v4 = BO_htobe32(WKB_MultiPointZ);
-        ValBufCopy(pv, cb, v4);
-
-        v4 = BO_htobe32(pObj->nVertices);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPoint < pObj->nVertices; iPoint++) {
-            WriteWkbBoXdr(pv, cb);
-
-            v4 = BO_htobe32(WKB_PointZ);
-            ValBufCopy(pv, cb, v4);
-
-            v8 = BO_float64_htobe(pObj->pPoints[iPoint].x + offX);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->pPoints[iPoint].y + offY);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->padfZ[iPoint] + offZ);
-            ValBufCopy(pv, cb, v8);
-        }
-    } else {
-        cb = WKBHeaderSize + sizeof(v4) + WKBPointZSize(pObj->nVertices);
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfZ, 0, offX, offY, offZ);
+    return WKBWriteMultiPoint(&w);
 }
 
 
 int exPointM2WKB(const SHPObjectEx *pObj, void *pv, double offX, double offY, double offM)
 {
-    ub4 v4;
-    double v8;
-    int cb = 0;
-
-    if (pv) {
-        WriteWkbBoXdr(pv, cb);
-
-        v4 = BO_htobe32(WKB_PointM);
-        ValBufCopy(pv, cb, v4);
-
-        v8 = BO_float64_htobe(pObj->pPoints[0].x + offX);
-        ValBufCopy(pv, cb, v8);
-
-        v8 = BO_float64_htobe(pObj->pPoints[0].y + offY);
-        ValBufCopy(pv, cb, v8);
-
-        v8 = BO_float64_htobe(*pObj->padfM + offM);
-        ValBufCopy(pv, cb, v8);
-    } else {
-        cb = WKBPointMSize(1);
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfM, 1, offX, offY, offM);
+    return WKBWritePoint(&w);
 }
 
 
 int exArcM2WKB(const SHPObjectEx *pObj, void *pv, double offX, double offY, double offM)
 {
-    ub4 v4;
-    double   v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPoint = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
-
-        /* wkb type */
-        v4 = BO_htobe32(WKB_LineStringM);
-        ValBufCopy(pv, cb, v4);
-
-        /* num of points */
-        v4 = BO_htobe32(pObj->nVertices);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPoint < pObj->nVertices; iPoint++) {
-            v8 = BO_float64_htobe(pObj->pPoints[iPoint].x + offX);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->pPoints[iPoint].y + offY);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->padfM[iPoint] + offM);
-            ValBufCopy(pv, cb, v8);
-        }
-    } else {
-        cb = WKBLineStringMSize(pObj->nVertices);
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfM, 1, offX, offY, offM);
+    return WKBWriteLines(&w);
 }
 
 
 int exPolygonM2WKB(const SHPObjectEx *pObj, void *pv, double offX, double offY, double offM)
 {
-    ub4 v4;
-    double   v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPart = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
-
-        /* wkb type */
-        v4 = BO_htobe32(WKB_PolygonM);
-        ValBufCopy(pv, cb, v4);
-
-        /* num of rings */
-        v4 = BO_htobe32(pObj->nParts);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPart < pObj->nParts; iPart++) {
-            int p = pObj->panPartStart[iPart];
-            int p1 = pObj->panPartStart[iPart+1];
-
-            /* num of points */
-            v4 = BO_htobe32(p1 - p);
-            ValBufCopy(pv, cb, v4);
-
-            for (; p < p1; p++) {
-                v8 = BO_float64_htobe(pObj->pPoints[p].x + offX);
-                ValBufCopy(pv, cb, v8);
-
-                v8 = BO_float64_htobe(pObj->pPoints[p].y + offY);
-                ValBufCopy(pv, cb, v8);
-
-                v8 = BO_float64_htobe(pObj->padfM[p] + offM);
-                ValBufCopy(pv, cb, v8);
-            }
-        }
-    } else {
-        int iPart = 0;
-
-        /* byte order flag */
-        WriteWkbBoXdr(pv, cb);
-
-        /* wkb type */
-        ValBufOffset(pv, cb, v4);
-
-        /* num of rings */
-        ValBufOffset(pv, cb, v4);
-
-        for (; iPart < pObj->nParts; iPart++) {
-            int np = pObj->panPartStart[iPart+1] - pObj->panPartStart[iPart];
-
-            /* num of points */
-            ValBufOffset(pv, cb, v4);
-
-            ValBufOffsetN(pv, cb, v8, np);
-            ValBufOffsetN(pv, cb, v8, np);
-            ValBufOffsetN(pv, cb, v8, np);
-        }
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfM, 1, offX, offY, offM);
+    return WKBWritePolygon(&w);
 }
 
 
 int exMultiPointM2WKB(const SHPObjectEx *pObj, void *pv, double offX, double offY, double offM)
 {
-    ub4 v4;
-    double v8;
-    int cb = 0;
-
-    if (pv) {
-        int iPoint = 0;
-        WriteWkbBoXdr(pv, cb);
-
-        v4 = BO_htobe32(WKB_MultiPointM);
-        ValBufCopy(pv, cb, v4);
-
-        v4 = BO_htobe32(pObj->nVertices);
-        ValBufCopy(pv, cb, v4);
-
-        for (; iPoint < pObj->nVertices; iPoint++) {
-            WriteWkbBoXdr(pv, cb);
-
-            v4 = BO_htobe32(WKB_PointM);
-            ValBufCopy(pv, cb, v4);
-
-            v8 = BO_float64_htobe(pObj->pPoints[iPoint].x + offX);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->pPoints[iPoint].y + offY);
-            ValBufCopy(pv, cb, v8);
-
-            v8 = BO_float64_htobe(pObj->padfM[iPoint] + offM);
-            ValBufCopy(pv, cb, v8);
-        }
-    } else {
-        cb = WKBHeaderSize + sizeof(v4) + WKBPointMSize(pObj->nVertices);
-    }
-
-    return cb;
+    WKBWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKBWriterInit(&w, pv, SHP_WKB_XDR, 0, &seq, pObj->padfM, 1, offX, offY, offM);
+    return WKBWriteMultiPoint(&w);
 }
 
 
@@ -1,1378 +1,1106 @@
 #include "shp2wkt.h"
 
-int Point2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, int dig)
+#include <locale.h>
+#include <float.h>
+
+/* -------------------------------------------------------------------- */
+/*      Double to text: fixed decimals like "%.*f" and the shortest     */
+/*      text that reads back to the same double (Grisu2), both always   */
+/*      with '.' whatever the locale.                                   */
+/* -------------------------------------------------------------------- */
+
+/* normalized 64 bits significands and binary exponents of 10^(8*i - 348) */
+static const uint64_t WKTCachedPowersF[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const int16_t WKTCachedPowersE[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066
+};
+
+static const uint32_t WKTPow10U32[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static const double WKTPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define WKT_EXACT_INTEGER  4503599627370496.0      /* 2^52 */
+
+#define WKT_DP_HIDDEN_BIT  ((uint64_t) 1 << 52)
+
+/* units of the scaled m+ that its cached power and products may be off */
+#define WKT_GRISU_MARGIN   8
+
+typedef struct
 {
-    int cb = 0;
+    uint64_t f;
+    int      e;
+} WKTDiyFp;
 
-    if (pbBuf) {
-        cb = sprintf(pbBuf, "POINT (%.*lf %.*lf)",
-            dig, *pObj->padfX + offX,
-            dig, *pObj->padfY + offY);
-    } else {
-        static char tmpbuf[128];
-        cb = sprintf(tmpbuf, "POINT (%.*lf %.*lf)",
-            dig, *pObj->padfX + offX,
-            dig, *pObj->padfY + offY);
+
+static WKTDiyFp WKTDiyFpNormalize (WKTDiyFp x)
+{
+    while (!(x.f & ((uint64_t) 1 << 63))) {
+        x.f <<= 1;
+        x.e--;
     }
+    return x;
+}
 
-    return cb;
+
+/**
+ * Upper 64 bits of the 128 bits product, rounded
+ */
+static WKTDiyFp WKTDiyFpMultiply (WKTDiyFp x, WKTDiyFp y)
+{
+    const uint64_t M32 = 0xFFFFFFFFu;
+    uint64_t a = x.f >> 32, b = x.f & M32, c = y.f >> 32, d = y.f & M32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+    WKTDiyFp r;
+
+    tmp += (uint64_t) 1 << 31;
+    r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+    r.e = x.e + y.e + 64;
+    return r;
 }
 
 
-int Arc2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, int dig)
+/**
+ * Round the last digit toward the value as long as it stays inside delta
+ */
+static void WKTGrisuRound (char *buffer, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
 {
-    int cb = 0;
-    int start, end, at;
-    int iPart = 0;
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+        (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buffer[len - 1]--;
+        rest += ten_kappa;
+    }
+}
 
-    if (pbBuf) {
-        if (pObj->nParts > 1) {
-            cb += sprintf(pbBuf, "MULTILINESTRING (");
-        } else {
-            cb += sprintf(pbBuf, "LINESTRING ");
-        }
 
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(pbBuf + cb, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf,",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY);
-                } else {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY);
-                }
-            }
+/**
+ * Shortest digits of positive finite dValue: dValue = digits * 10^K.
+ *  *pbNear is set when fewer digits were refused by no more than the
+ *  rounding error of the cached power, so they may read back after all.
+ */
+static int WKTGrisu2 (double dValue, char *buffer, int *K, int *pbNear)
+{
+    uint64_t u, one_f, p2, delta, wp_w, rest, ten_kappa, margin = WKT_GRISU_MARGIN;
+    uint32_t p1;
+    int      kappa, len = 0, one_e, k, index;
+    double   dk;
+    WKTDiyFp v, pl, mi, c, W, Wp, Wm;
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(pbBuf + cb, "),");
-            } else {
-                cb += sprintf(pbBuf + cb, ")");
-            }
+    memcpy(&u, &dValue, 8);
+
+    if (u & 0x7FF0000000000000ULL) {
+        v.f = (u & 0x000FFFFFFFFFFFFFULL) + WKT_DP_HIDDEN_BIT;
+        v.e = (int) ((u >> 52) & 0x7FF) - 1075;
+    } else {
+        v.f = u & 0x000FFFFFFFFFFFFFULL;
+        v.e = -1074;
+    }
+
+    /* boundaries m+ and m- halfway to the neighbours, on the same exponent */
+    pl.f = (v.f << 1) + 1;
+    pl.e = v.e - 1;
+    while (!(pl.f & (WKT_DP_HIDDEN_BIT << 1))) {
+        pl.f <<= 1;
+        pl.e--;
+    }
+    pl.f <<= 64 - 52 - 2;
+    pl.e -= 64 - 52 - 2;
+
+    if (v.f == WKT_DP_HIDDEN_BIT) {
+        mi.f = (v.f << 2) - 1;
+        mi.e = v.e - 2;
+    } else {
+        mi.f = (v.f << 1) - 1;
+        mi.e = v.e - 1;
+    }
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+
+    /* cached power of ten bringing m+ exponent into [-60, -32] */
+    dk = (-61 - pl.e) * 0.30102999566398114 + 347;
+    k = (int) dk;
+    if (dk - k > 0.0) {
+        k++;
+    }
+    index = (k >> 3) + 1;
+    *K = -(-348 + index * 8);
+
+    c.f = WKTCachedPowersF[index];
+    c.e = WKTCachedPowersE[index];
+
+    W = WKTDiyFpMultiply(WKTDiyFpNormalize(v), c);
+    Wp = WKTDiyFpMultiply(pl, c);
+    Wm = WKTDiyFpMultiply(mi, c);
+    Wm.f++;
+    Wp.f--;
+
+    /* generate digits of Wp until inside the uncertainty interval */
+    delta = Wp.f - Wm.f;
+    one_e = Wp.e;
+    one_f = (uint64_t) 1 << -one_e;
+    wp_w = Wp.f - W.f;
+    p1 = (uint32_t) (Wp.f >> -one_e);
+    p2 = Wp.f & (one_f - 1);
+
+    for (kappa = 10; kappa > 1 && p1 < WKTPow10U32[kappa - 1]; kappa--) {
+        /* count the digits of p1 */
+    }
+
+    *pbNear = SHAPEFILE_FALSE;
+
+    while (kappa > 0) {
+        uint32_t d = p1 / WKTPow10U32[kappa - 1];
+        p1 %= WKTPow10U32[kappa - 1];
+
+        if (d || len) {
+            buffer[len++] = (char) ('0' + d);
         }
+        kappa--;
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(pbBuf, ")");
+        rest = (((uint64_t) p1) << -one_e) + p2;
+        ten_kappa = ((uint64_t) WKTPow10U32[kappa]) << -one_e;
+
+        if (rest <= delta) {
+            *K += kappa;
+            WKTGrisuRound(buffer, len, delta, rest, ten_kappa, wp_w);
+            return len;
         }
-    } else {
-        static char tmpbuf[128];
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(tmpbuf, "MULTILINESTRING (");
-        } else {
-            cb += sprintf(tmpbuf, "LINESTRING ");
+        if (rest - delta <= margin || ten_kappa - rest <= margin) {
+            *pbNear = SHAPEFILE_TRUE;
         }
+    }
 
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(tmpbuf, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf,",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY);
-                } else {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY);
-                }
-            }
+    for (;;) {
+        char d;
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(tmpbuf, "),");
-            } else {
-                cb += sprintf(tmpbuf, ")");
-            }
+        p2 *= 10;
+        delta *= 10;
+        margin *= 10;
+        d = (char) (p2 >> -one_e);
+        if (d || len) {
+            buffer[len++] = (char) ('0' + d);
+        }
+        p2 &= one_f - 1;
+        kappa--;
+
+        if (p2 < delta) {
+            *K += kappa;
+            WKTGrisuRound(buffer, len, delta, p2, one_f, -kappa < 10 ? wp_w * WKTPow10U32[-kappa] : 0);
+            return len;
         }
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(tmpbuf, ")");
+        if (p2 - delta <= margin || one_f - p2 <= margin) {
+            *pbNear = SHAPEFILE_TRUE;
         }
     }
+}
 
-    return cb;
+
+/**
+ * Does D * 10^K read back as dValue? One exact multiply or divide when
+ *  both fit a double (Clinger fast path), else strtod() on "De+K", which
+ *  has no decimal point for the locale to change.
+ */
+static int WKTReadsBack (uint64_t D, int K, double dValue)
+{
+    char szNumber[48];
+
+    if (D < ((uint64_t) 1 << 53) && K >= -22 && K <= 22) {
+        return ((K >= 0) ? (double) D * WKTPow10[K] : (double) D / WKTPow10[-K]) == dValue;
+    }
+
+    snprintf(szNumber, sizeof(szNumber), "%llue%d", (unsigned long long) D, K);
+    return strtod(szNumber, 0) == dValue;
 }
 
 
-int Polygon2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, int dig)
+/**
+ * Grisu2 can miss the shortest digits when they lie close to the bounds
+ *  of its rounding interval, and then returns all 17. Try the digits
+ *  rounded to fewer places, shortest first, keeping those that read back.
+ *  Only roundings within about one ulp of the digits are read back.
+ */
+static int WKTShorten (double dValue, char *buffer, int len, int *K)
 {
-    int cb = 0;
-    int start, end, at;
-    int iPart = 0;
-
-    if (pbBuf) {
-        cb += sprintf(pbBuf, "POLYGON (");
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(pbBuf + cb, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf,",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY);
-                } else {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY);
-                }
-            }
+    int      p, i;
+    double   dDigits = 0, dUlp;
+    uint64_t nTen = 1;
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(pbBuf + cb, "),");
-            } else {
-                cb += sprintf(pbBuf + cb, ")");
-            }
+    for (i = 0; i < len; i++) {
+        dDigits = dDigits * 10 + (buffer[i] - '0');
+    }
+
+    /* one ulp of dValue counted in units of the last digit, with slack */
+    dUlp = dDigits * (1.0 / 4503599627370496.0) + 2;
+
+    for (p = len - 1; p > 0; p--) {
+        nTen *= 10;
+    }
+
+    for (p = 1; p < len; p++, nTen /= 10) {
+        uint64_t D = 0, nTail = 0;
+        int      Kp = *K + len - p, j;
+
+        for (i = 0; i < p; i++) {
+            D = D * 10 + (buffer[i] - '0');
+        }
+        for (; i < len; i++) {
+            nTail = nTail * 10 + (buffer[i] - '0');
         }
 
-        cb += sprintf(pbBuf + cb, ")");
-    } else {
-        static char tmpbuf[128];
-
-        cb += sprintf(tmpbuf, "POLYGON (");
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(tmpbuf, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf,",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY);
-                } else {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY);
-                }
-            }
+        /* the digits are not exact either: try both neighbours, nearest first */
+        for (j = 0; j < 2; j++) {
+            int      bUp = ((buffer[p] >= '5') != j);
+            uint64_t Dj = D + bUp;
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(tmpbuf, "),");
-            } else {
-                cb += sprintf(tmpbuf, ")");
+            if ((double) (bUp ? nTen - nTail : nTail) <= dUlp && WKTReadsBack(Dj, Kp, dValue)) {
+                char szD[24], *pch = szD + sizeof(szD);
+
+                while (Dj % 10 == 0) {
+                    Dj /= 10;
+                    Kp++;
+                }
+                do {
+                    *--pch = (char) ('0' + Dj % 10);
+                    Dj /= 10;
+                } while (Dj);
+
+                len = (int) (szD + sizeof(szD) - pch);
+                memcpy(buffer, pch, len);
+                *K = Kp;
+                return len;
             }
         }
-
-        cb += sprintf(tmpbuf, ")");
     }
 
-    return cb;
+    return len;
 }
 
 
-int MultiPoint2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, int dig)
+/**
+ * Digits of nValue with nDecimals of them after the point, ending at pchEnd,
+ *  as "%.*f" prints them. Returns the first char. Shared with dbfopen.c.
+ */
+char * SHPFormatDigits (char *pchEnd, uint64_t nValue, int nDecimals)
 {
-    int cb = 0;
-    int i = 0;
-
-    if (pbBuf) {
-        cb += sprintf(pbBuf, "MULTIPOINT (");
-
-        for (; i < pObj->nVertices; i++) {
-            if (i < pObj->nVertices -1) {
-                cb += sprintf(pbBuf + cb, "(%.*lf %.*lf),",
-                    dig, pObj->padfX[i] + offX,
-                    dig, pObj->padfY[i] + offY);
-            } else {
-                cb += sprintf(pbBuf + cb, "(%.*lf %.*lf)",
-                    dig, pObj->padfX[i] + offX,
-                    dig, pObj->padfY[i] + offY);
-            }
+    char *pch = pchEnd;
+    int   nDigits = 0;
+
+    do {
+        *--pch = (char) ('0' + nValue % 10);
+        nValue /= 10;
+        if (++nDigits == nDecimals) {
+            *--pch = '.';
         }
+    } while (nValue || nDigits <= nDecimals);
 
-        cb += sprintf(pbBuf + cb, ")");
-    } else {
-        static char tmpbuf[128];
-
-        cb += sprintf(tmpbuf, "MULTIPOINT (");
-
-        for (; i < pObj->nVertices; i++) {
-            if (i < pObj->nVertices -1) {
-                cb += sprintf(tmpbuf + cb, "(%.*lf %.*lf),",
-                    dig, pObj->padfX[i] + offX,
-                    dig, pObj->padfY[i] + offY);
-            } else {
-                cb += sprintf(tmpbuf + cb, "(%.*lf %.*lf)",
-                    dig, pObj->padfX[i] + offX,
-                    dig, pObj->padfY[i] + offY);
+    return pch;
+}
+
+
+/**
+ * "%.*f" through the C library, with '.' as decimal point
+ */
+static int WKTFormatPrintf (char *pszBuf, double dValue, int nDecimals)
+{
+    const char *pszPoint = localeconv()->decimal_point;
+    int cb = snprintf(pszBuf, SHP_DOUBLE_BUFSIZE, "%.*f", nDecimals, dValue);
+
+    if (cb < 0) {
+        cb = 0;
+    }
+    pszBuf[cb] = '\0';
+
+    if (pszPoint[0] != '.' && pszPoint[0] != '\0') {
+        char *pch = strchr(pszBuf, pszPoint[0]);
+        if (pch) {
+            *pch = '.';
+            if (pszPoint[1] != '\0') {
+                int cbPoint = (int) strlen(pszPoint);
+                memmove(pch + 1, pch + cbPoint, strlen(pch + cbPoint) + 1);
+                cb -= cbPoint - 1;
             }
         }
-
-        cb += sprintf(tmpbuf + cb, ")");
     }
 
     return cb;
 }
 
 
-int PointZ2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
+/**
+ * Write dValue to pszBuf (SHP_DOUBLE_BUFSIZE chars) with nDecimals
+ *  decimals, or shortest if nDecimals is SHP_DECIMALS_SHORTEST.
+ */
+int SHPFormatDouble (char *pszBuf, double dValue, int nDecimals)
 {
-    int cb = 0;
+    char  szDigits[32], *pch = pszBuf;
+    int   len, K, kk, i, bNear;
 
-    if (pbBuf) {
-        cb = sprintf(pbBuf, "POINT Z (%.*lf %.*lf %.*lf)",
-            dig, *pObj->padfX + offX,
-            dig, *pObj->padfY + offY,
-            digZ, *pObj->padfZ + offZ);
-    } else {
-        static char tmpbuf[128];
-        cb = sprintf(tmpbuf, "POINT Z (%.*lf %.*lf %.*lf)",
-            dig, *pObj->padfX + offX,
-            dig, *pObj->padfY + offY,
-            digZ, *pObj->padfZ + offZ);
+    if (!isfinite(dValue)) {
+        return WKTFormatPrintf(pszBuf, dValue, 0);
     }
 
-    return cb;
-}
+    if (nDecimals >= 0) {
+        double dScaled;
 
+        nDecimals = MIN_V2(nDecimals, SHP_DECIMALS_MAX);
 
-int ArcZ2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
-{
-    int cb = 0;
-    int start, end, at;
-    int iPart = 0;
+        if (nDecimals < (int) (sizeof(WKTPow10) / sizeof(WKTPow10[0])) &&
+            (dScaled = fabs(dValue) * WKTPow10[nDecimals]) < WKT_EXACT_INTEGER) {
+            double dFloor = floor(dScaled);
+            double dFrac = dScaled - dFloor;
 
-    if (pbBuf) {
-        if (pObj->nParts > 1) {
-            cb += sprintf(pbBuf, "MULTILINESTRING Z (");
-        } else {
-            cb += sprintf(pbBuf, "LINESTRING Z ");
-        }
+            /* the product is off by half an ulp at most: exact unless that close to a tie */
+            if (fabs(dFrac - 0.5) > dScaled * (1.0 / 2251799813685248.0)) {
+                char *pchEnd = szDigits + sizeof(szDigits);
+                char *pchFirst = SHPFormatDigits(pchEnd, (uint64_t) dFloor + (dFrac > 0.5), nDecimals);
 
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(pbBuf + cb, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                } else {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digZ, pObj->padfZ[at] + offZ);
+                if (signbit(dValue)) {
+                    *pch++ = '-';
                 }
-            }
-
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(pbBuf + cb, "),");
-            } else {
-                cb += sprintf(pbBuf + cb, ")");
+                memcpy(pch, pchFirst, pchEnd - pchFirst);
+                pch += pchEnd - pchFirst;
+                *pch = '\0';
+                return (int) (pch - pszBuf);
             }
         }
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(pbBuf, ")");
-        }
-    } else {
-        static char tmpbuf[128];
+        return WKTFormatPrintf(pszBuf, dValue, nDecimals);
+    }
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(tmpbuf, "MULTILINESTRING Z (");
-        } else {
-            cb += sprintf(tmpbuf, "LINESTRING Z ");
-        }
+    if (signbit(dValue)) {
+        *pch++ = '-';
+        dValue = -dValue;
+    }
 
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(tmpbuf, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                } else {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                }
-            }
+    if (dValue == 0) {
+        *pch++ = '0';
+        *pch = '\0';
+        return (int) (pch - pszBuf);
+    }
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(tmpbuf, "),");
-            } else {
-                cb += sprintf(tmpbuf, ")");
-            }
+    len = WKTGrisu2(dValue, szDigits, &K, &bNear);
+    if (bNear) {
+        len = WKTShorten(dValue, szDigits, len, &K);
+    }
+    kk = len + K;       /* value is 0.digits * 10^kk */
+
+    if (K >= 0 && kk <= 21) {
+        /* integer: 1234e7 -> 12340000000 */
+        memcpy(pch, szDigits, len);
+        memset(pch + len, '0', K);
+        pch += kk;
+    } else if (kk > 0 && kk <= 21) {
+        /* 1234e-2 -> 12.34 */
+        memcpy(pch, szDigits, kk);
+        pch[kk] = '.';
+        memcpy(pch + kk + 1, szDigits + kk, len - kk);
+        pch += len + 1;
+    } else if (kk > -6 && kk <= 0) {
+        /* 1234e-6 -> 0.001234 */
+        *pch++ = '0';
+        *pch++ = '.';
+        for (i = kk; i < 0; i++) {
+            *pch++ = '0';
         }
-
-        if (pObj->nParts > 1) {
-            cb += sprintf(tmpbuf, ")");
+        memcpy(pch, szDigits, len);
+        pch += len;
+    } else {
+        /* 1234e30 -> 1.234e+33 */
+        *pch++ = szDigits[0];
+        if (len > 1) {
+            *pch++ = '.';
+            memcpy(pch, szDigits + 1, len - 1);
+            pch += len - 1;
         }
+        pch += sprintf(pch, "e%+d", kk - 1);
     }
 
-    return cb;
+    *pch = '\0';
+    return (int) (pch - pszBuf);
 }
 
 
-int PolygonZ2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
+/* -------------------------------------------------------------------- */
+/*      WKT writer: every *2WKT function goes through these. With no    */
+/*      output buffer only the length is computed.                      */
+/* -------------------------------------------------------------------- */
+typedef struct
 {
-    int cb = 0;
-    int start, end, at;
-    int iPart = 0;
-
-    if (pbBuf) {
-        cb += sprintf(pbBuf, "POLYGON Z (");
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(pbBuf + cb, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                } else {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                }
-            }
+    SHPTextWriter t;
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(pbBuf + cb, "),");
-            } else {
-                cb += sprintf(pbBuf + cb, ")");
-            }
-        }
+    int           bBound;       /* count an upper bound, no formatting */
+    int           cbVertex;     /* bound of one vertex text */
 
-        cb += sprintf(pbBuf + cb, ")");
-    } else {
-        static char tmpbuf[128];
-
-        cb += sprintf(tmpbuf, "POLYGON Z (");
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(tmpbuf, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                } else {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                }
-            }
+    SHPCoordSeq   seq;          /* x, y and parts */
+    const double *padfZM;       /* third ordinate, NULL if none */
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(tmpbuf, "),");
-            } else {
-                cb += sprintf(tmpbuf, ")");
-            }
-        }
+    double        offX, offY, offZM;
+    int           dig, digZM;
+} WKTWriter;
 
-        cb += sprintf(tmpbuf, ")");
-    }
 
-    return cb;
+static void WKTWriterInit (WKTWriter *w, char *pbBuf, const SHPCoordSeq *psSeq,
+    const double *padfZM, double offX, double offY, double offZM, int dig, int digZM)
+{
+    SHPTextInit(&w->t, pbBuf, INT_MAX);
+    w->bBound = 0;
+    w->cbVertex = 0;
+    w->seq = *psSeq;
+    w->padfZM = padfZM;
+    w->offX = offX;
+    w->offY = offY;
+    w->offZM = offZM;
+    w->dig = dig;
+    w->digZM = digZM;
 }
 
 
-int MultiPointZ2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
+static void WKTPutVertex (WKTWriter *w, int i)
 {
-    int cb = 0;
-    int i = 0;
-
-    if (pbBuf) {
-        cb += sprintf(pbBuf, "MULTIPOINT Z (");
-
-        for (; i < pObj->nVertices; i++) {
-            if (i < pObj->nVertices -1) {
-                cb += sprintf(pbBuf + cb, "(%.*lf %.*lf %.*lf),",
-                    dig, pObj->padfX[i] + offX,
-                    dig, pObj->padfY[i] + offY,
-                    digZ, pObj->padfZ[i] + offZ);
-            } else {
-                cb += sprintf(pbBuf + cb, "(%.*lf %.*lf %.*lf)",
-                    dig, pObj->padfX[i] + offX,
-                    dig, pObj->padfY[i] + offY,
-                    digZ, pObj->padfZ[i] + offZ);
-            }
-        }
+    SHPTextPutDouble(&w->t, SHPCoordX(&w->seq, w->seq.nStride, i) + w->offX, w->dig);
+    SHPTextPutText(&w->t, " ");
+    SHPTextPutDouble(&w->t, SHPCoordY(&w->seq, w->seq.nStride, i) + w->offY, w->dig);
 
-        cb += sprintf(pbBuf + cb, ")");
-    } else {
-        static char tmpbuf[128];
-
-        cb += sprintf(tmpbuf, "MULTIPOINT Z (");
-
-        for (; i < pObj->nVertices; i++) {
-            if (i < pObj->nVertices -1) {
-                cb += sprintf(tmpbuf + cb, "(%.*lf %.*lf %.*lf),",
-                    dig, pObj->padfX[i] + offX,
-                    dig, pObj->padfY[i] + offY,
-                    digZ, pObj->padfZ[i] + offZ);
-            } else {
-                cb += sprintf(tmpbuf + cb, "(%.*lf %.*lf %.*lf)",
-                    dig, pObj->padfX[i] + offX,
-                    dig, pObj->padfY[i] + offY,
-                    digZ, pObj->padfZ[i] + offZ);
-            }
-        }
-
-        cb += sprintf(tmpbuf + cb, ")");
+    if (w->padfZM) {
+        SHPTextPutText(&w->t, " ");
+        SHPTextPutDouble(&w->t, w->padfZM[i] + w->offZM, w->digZM);
     }
-
-    return cb;
 }
 
 
-int PointM2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
+/**
+ * (x y,x y,...) of vertices [start, end)
+ */
+static void WKTPutVertexList (WKTWriter *w, int start, int end)
 {
-    int cb = 0;
+    int at;
 
-    if (pbBuf) {
-        cb = sprintf(pbBuf, "POINT M (%.*lf %.*lf %.*lf)",
-            dig, *pObj->padfX + offX,
-            dig, *pObj->padfY + offY,
-            digM, *pObj->padfM + offM);
-    } else {
-        static char tmpbuf[128];
-        cb = sprintf(tmpbuf, "POINT M (%.*lf %.*lf %.*lf)",
-            dig, *pObj->padfX + offX,
-            dig, *pObj->padfY + offY,
-            digM, *pObj->padfM + offM);
+    if (w->bBound) {
+        w->t.cb += 2 + (int64_t) (end - start) * (w->cbVertex + 1) - (end > start);
+        return;
     }
 
-    return cb;
+    SHPTextPutText(&w->t, "(");
+    for (at = start; at < end; at++) {
+        if (at > start) {
+            SHPTextPutText(&w->t, ",");
+        }
+        WKTPutVertex(w, at);
+    }
+    SHPTextPutText(&w->t, ")");
 }
 
 
-int ArcM2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
+static int WKTWritePoint (WKTWriter *w, const char *pszDim)
 {
-    int cb = 0;
-    int start, end, at;
-    int iPart = 0;
-
-    if (pbBuf) {
-        if (pObj->nParts > 1) {
-            cb += sprintf(pbBuf, "MULTILINESTRING M (");
-        } else {
-            cb += sprintf(pbBuf, "LINESTRING M ");
-        }
-
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(pbBuf + cb, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digM, pObj->padfM[at] + offM);
-                } else {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digM, pObj->padfM[at] + offM);
-                }
-            }
+    SHPTextPutText(&w->t, "POINT");
+    SHPTextPutText(&w->t, pszDim);
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(pbBuf + cb, "),");
-            } else {
-                cb += sprintf(pbBuf + cb, ")");
-            }
-        }
-
-        if (pObj->nParts > 1) {
-            cb += sprintf(pbBuf, ")");
-        }
+    if (w->seq.nVertices == 0) {
+        SHPTextPutText(&w->t, " EMPTY");
     } else {
-        static char tmpbuf[128];
+        SHPTextPutText(&w->t, " ");
+        WKTPutVertexList(w, 0, 1);
+    }
+    return SHPTextEnd(&w->t);
+}
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(tmpbuf, "MULTILINESTRING M (");
-        } else {
-            cb += sprintf(tmpbuf, "LINESTRING M ");
-        }
 
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(tmpbuf, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digM, pObj->padfM[at] + offM);
-                } else {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digM, pObj->padfM[at] + offM);
-                }
-            }
+static int WKTWriteMultiPoint (WKTWriter *w, const char *pszDim)
+{
+    int i, nVertices = w->seq.nVertices;
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(tmpbuf, "),");
-            } else {
-                cb += sprintf(tmpbuf, ")");
-            }
-        }
+    SHPTextPutText(&w->t, "MULTIPOINT");
+    SHPTextPutText(&w->t, pszDim);
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(tmpbuf, ")");
-        }
+    if (nVertices == 0) {
+        SHPTextPutText(&w->t, " EMPTY");
+        return SHPTextEnd(&w->t);
     }
 
-    return cb;
+    SHPTextPutText(&w->t, " (");
+    for (i = 0; i < nVertices; i++) {
+        if (i > 0) {
+            SHPTextPutText(&w->t, ",");
+        }
+        WKTPutVertexList(w, i, i + 1);
+    }
+    SHPTextPutText(&w->t, ")");
+    return SHPTextEnd(&w->t);
 }
 
 
-int PolygonM2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
+static int WKTWriteLines (WKTWriter *w, const char *pszDim)
 {
-    int cb = 0;
-    int start, end, at;
-    int iPart = 0;
-
-    if (pbBuf) {
-        cb += sprintf(pbBuf, "POLYGON M (");
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(pbBuf + cb, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digM, pObj->padfM[at] + offM);
-                } else {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digM, pObj->padfM[at] + offM);
-                }
-            }
+    int iPart, start, end, nParts = w->seq.nParts;
+
+    if (nParts > 1) {
+        SHPTextPutText(&w->t, "MULTILINESTRING");
+        SHPTextPutText(&w->t, pszDim);
+        SHPTextPutText(&w->t, " (");
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(pbBuf + cb, "),");
-            } else {
-                cb += sprintf(pbBuf + cb, ")");
+        for (iPart = 0; iPart < nParts; iPart++) {
+            if (iPart > 0) {
+                SHPTextPutText(&w->t, ",");
             }
+            SHPCoordsPartRange(&w->seq, iPart, &start, &end);
+            WKTPutVertexList(w, start, end);
         }
 
-        cb += sprintf(pbBuf + cb, ")");
+        SHPTextPutText(&w->t, ")");
     } else {
-        static char tmpbuf[128];
-
-        cb += sprintf(tmpbuf, "POLYGON M (");
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(tmpbuf, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digM, pObj->padfM[at] + offM);
-                } else {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf",
-                        dig, pObj->padfX[at] + offX,
-                        dig, pObj->padfY[at] + offY,
-                        digM, pObj->padfM[at] + offM);
-                }
-            }
+        SHPTextPutText(&w->t, "LINESTRING");
+        SHPTextPutText(&w->t, pszDim);
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(tmpbuf, "),");
-            } else {
-                cb += sprintf(tmpbuf, ")");
-            }
+        if (w->seq.nVertices == 0) {
+            SHPTextPutText(&w->t, " EMPTY");
+        } else {
+            SHPTextPutText(&w->t, " ");
+            SHPCoordsPartRange(&w->seq, 0, &start, &end);
+            WKTPutVertexList(w, start, end);
         }
-
-        cb += sprintf(tmpbuf, ")");
     }
-
-    return cb;
+    return SHPTextEnd(&w->t);
 }
 
 
-int MultiPointM2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
+static int WKTWritePolygon (WKTWriter *w, const char *pszDim)
 {
-    int cb = 0;
-    int i = 0;
-
-    if (pbBuf) {
-        cb += sprintf(pbBuf, "MULTIPOINT M (");
-
-        for (; i < pObj->nVertices; i++) {
-            if (i < pObj->nVertices -1) {
-                cb += sprintf(pbBuf + cb, "(%.*lf %.*lf %.*lf),",
-                    dig, pObj->padfX[i] + offX,
-                    dig, pObj->padfY[i] + offY,
-                    digM, pObj->padfM[i] + offM);
-            } else {
-                cb += sprintf(pbBuf + cb, "(%.*lf %.*lf %.*lf)",
-                    dig, pObj->padfX[i] + offX,
-                    dig, pObj->padfY[i] + offY,
-                    digM, pObj->padfM[i] + offM);
-            }
-        }
+    int iPart, start, end;
 
-        cb += sprintf(pbBuf + cb, ")");
-    } else {
-        static char tmpbuf[128];
-
-        cb += sprintf(tmpbuf, "MULTIPOINT M (");
-
-        for (; i < pObj->nVertices; i++) {
-            if (i < pObj->nVertices -1) {
-                cb += sprintf(tmpbuf + cb, "(%.*lf %.*lf %.*lf),",
-                    dig, pObj->padfX[i] + offX,
-                    dig, pObj->padfY[i] + offY,
-                    digM, pObj->padfM[i] + offM);
-            } else {
-                cb += sprintf(tmpbuf + cb, "(%.*lf %.*lf %.*lf)",
-                    dig, pObj->padfX[i] + offX,
-                    dig, pObj->padfY[i] + offY,
-                    digM, pObj->padfM[i] + offM);
-            }
-        }
+    SHPTextPutText(&w->t, "POLYGON");
+    SHPTextPutText(&w->t, pszDim);
 
-        cb += sprintf(tmpbuf + cb, ")");
+    if (w->seq.nVertices == 0) {
+        SHPTextPutText(&w->t, " EMPTY");
+        return SHPTextEnd(&w->t);
     }
 
-    return cb;
+    SHPTextPutText(&w->t, " (");
+    for (iPart = 0; iPart < MAX_V2(w->seq.nParts, 1); iPart++) {
+        if (iPart > 0) {
+            SHPTextPutText(&w->t, ",");
+        }
+        SHPCoordsPartRange(&w->seq, iPart, &start, &end);
+        WKTPutVertexList(w, start, end);
+    }
+    SHPTextPutText(&w->t, ")");
+    return SHPTextEnd(&w->t);
 }
 
 
-int exPoint2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, int dig)
+/* -------------------------------------------------------------------- */
+/*      SHPObject                                                       */
+/* -------------------------------------------------------------------- */
+
+int Point2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, int dig)
 {
-    int cb = 0;
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, NULL, offX, offY, 0, dig, 0);
+    return WKTWritePoint(&w, "");
+}
 
-    if (pbBuf) {
-        cb = sprintf(pbBuf, "POINT (%.*lf %.*lf)",
-            dig, pObj->pPoints->x + offX,
-            dig, pObj->pPoints->y + offY);
-    } else {
-        static char tmpbuf[128];
-        cb = sprintf(tmpbuf, "POINT (%.*lf %.*lf)",
-            dig, pObj->pPoints->x + offX,
-            dig, pObj->pPoints->y + offY);
-    }
 
-    return cb;
+int Arc2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, int dig)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, NULL, offX, offY, 0, dig, 0);
+    return WKTWriteLines(&w, "");
 }
 
 
-int exPointZ2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
+int Polygon2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, int dig)
 {
-    int cb = 0;
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, NULL, offX, offY, 0, dig, 0);
+    return WKTWritePolygon(&w, "");
+}
 
-    if (pbBuf) {
-        cb = sprintf(pbBuf, "POINT Z (%.*lf %.*lf %.*lf)",
-            dig, pObj->pPoints->x + offX,
-            dig, pObj->pPoints->y + offY,
-            digZ, *pObj->padfZ + offZ);
-    } else {
-        static char tmpbuf[128];
-        cb = sprintf(tmpbuf, "POINT Z (%.*lf %.*lf %.*lf)",
-            dig, pObj->pPoints->x + offX,
-            dig, pObj->pPoints->y + offY,
-            digZ, *pObj->padfZ + offZ);
-    }
 
-    return cb;
+int MultiPoint2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, int dig)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, NULL, offX, offY, 0, dig, 0);
+    return WKTWriteMultiPoint(&w, "");
 }
 
 
-int exPointM2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
+int PointZ2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
 {
-    int cb = 0;
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfZ, offX, offY, offZ, dig, digZ);
+    return WKTWritePoint(&w, " Z");
+}
 
-    if (pbBuf) {
-        cb = sprintf(pbBuf, "POINT M (%.*lf %.*lf %.*lf)",
-            dig, pObj->pPoints->x + offX,
-            dig, pObj->pPoints->y + offY,
-            digM, *pObj->padfM + offM);
-    } else {
-        static char tmpbuf[128];
-        cb = sprintf(tmpbuf, "POINT M (%.*lf %.*lf %.*lf)",
-            dig, pObj->pPoints->x + offX,
-            dig, pObj->pPoints->y + offY,
-            digM, *pObj->padfM + offM);
-    }
 
-    return cb;
+int ArcZ2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfZ, offX, offY, offZ, dig, digZ);
+    return WKTWriteLines(&w, " Z");
 }
 
 
-int exMultiPoint2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, int dig)
+int PolygonZ2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
 {
-    int cb = 0;
-    int i = 0;
-
-    if (pbBuf) {
-        cb += sprintf(pbBuf, "MULTIPOINT (");
-
-        for (; i < pObj->nVertices; i++) {
-            if (i < pObj->nVertices -1) {
-                cb += sprintf(pbBuf + cb, "(%.*lf %.*lf),",
-                    dig, pObj->pPoints[i].x + offX,
-                    dig, pObj->pPoints[i].y + offY);
-            } else {
-                cb += sprintf(pbBuf + cb, "(%.*lf %.*lf)",
-                    dig, pObj->pPoints[i].x + offX,
-                    dig, pObj->pPoints[i].y + offY);
-            }
-        }
-
-        cb += sprintf(pbBuf + cb, ")");
-    } else {
-        static char tmpbuf[128];
-
-        cb += sprintf(tmpbuf, "MULTIPOINT (");
-
-        for (; i < pObj->nVertices; i++) {
-            if (i < pObj->nVertices -1) {
-                cb += sprintf(tmpbuf + cb, "(%.*lf %.*lf),",
-                    dig, pObj->pPoints[i].x + offX,
-                    dig, pObj->pPoints[i].y + offY);
-            } else {
-                cb += sprintf(tmpbuf + cb, "(%.*lf %.*lf)",
-                    dig, pObj->pPoints[i].x + offX,
-                    dig, pObj->pPoints[i].y + offY);
-            }
-        }
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfZ, offX, offY, offZ, dig, digZ);
+    return WKTWritePolygon(&w, " Z");
+}
 
-        cb += sprintf(tmpbuf + cb, ")");
-    }
 
-    return cb;
+int MultiPointZ2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfZ, offX, offY, offZ, dig, digZ);
+    return WKTWriteMultiPoint(&w, " Z");
 }
 
 
-int exMultiPointZ2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
+int PointM2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
 {
-    int cb = 0;
-    int i = 0;
-
-    if (pbBuf) {
-        cb += sprintf(pbBuf, "MULTIPOINT Z (");
-
-        for (; i < pObj->nVertices; i++) {
-            if (i < pObj->nVertices -1) {
-                cb += sprintf(pbBuf + cb, "(%.*lf %.*lf %.*lf),",
-                    dig, pObj->pPoints[i].x + offX,
-                    dig, pObj->pPoints[i].y + offY,
-                    digZ, pObj->padfZ[i] + offZ);
-            } else {
-                cb += sprintf(pbBuf + cb, "(%.*lf %.*lf %.*lf)",
-                    dig, pObj->pPoints[i].x + offX,
-                    dig, pObj->pPoints[i].y + offY,
-                    digZ, pObj->padfZ[i] + offZ);
-            }
-        }
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfM, offX, offY, offM, dig, digM);
+    return WKTWritePoint(&w, " M");
+}
 
-        cb += sprintf(pbBuf + cb, ")");
-    } else {
-        static char tmpbuf[128];
-
-        cb += sprintf(tmpbuf, "MULTIPOINT Z (");
-
-        for (; i < pObj->nVertices; i++) {
-            if (i < pObj->nVertices -1) {
-                cb += sprintf(tmpbuf + cb, "(%.*lf %.*lf %.*lf),",
-                    dig, pObj->pPoints[i].x + offX,
-                    dig, pObj->pPoints[i].y + offY,
-                    digZ, pObj->padfZ[i] + offZ);
-            } else {
-                cb += sprintf(tmpbuf + cb, "(%.*lf %.*lf %.*lf)",
-                    dig, pObj->pPoints[i].x + offX,
-                    dig, pObj->pPoints[i].y + offY,
-                    digZ, pObj->padfZ[i] + offZ);
-            }
-        }
 
-        cb += sprintf(tmpbuf + cb, ")");
-    }
+int ArcM2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfM, offX, offY, offM, dig, digM);
+    return WKTWriteLines(&w, " M");
+}
 
-    return cb;
+
+int PolygonM2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfM, offX, offY, offM, dig, digM);
+    return WKTWritePolygon(&w, " M");
 }
 
 
-int exMultiPointM2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
+int MultiPointM2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
 {
-    int cb = 0;
-    int i = 0;
-
-    if (pbBuf) {
-        cb += sprintf(pbBuf, "MULTIPOINT M (");
-
-        for (; i < pObj->nVertices; i++) {
-            if (i < pObj->nVertices -1) {
-                cb += sprintf(pbBuf + cb, "(%.*lf %.*lf %.*lf),",
-                    dig, pObj->pPoints[i].x + offX,
-                    dig, pObj->pPoints[i].y + offY,
-                    digM, pObj->padfM[i] + offM);
-            } else {
-                cb += sprintf(pbBuf + cb, "(%.*lf %.*lf %.*lf)",
-                    dig, pObj->pPoints[i].x + offX,
-                    dig, pObj->pPoints[i].y + offY,
-                    digM, pObj->padfM[i] + offM);
-            }
-        }
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfM, offX, offY, offM, dig, digM);
+    return WKTWriteMultiPoint(&w, " M");
+}
 
-        cb += sprintf(pbBuf + cb, ")");
-    } else {
-        static char tmpbuf[128];
-
-        cb += sprintf(tmpbuf, "MULTIPOINT M (");
-
-        for (; i < pObj->nVertices; i++) {
-            if (i < pObj->nVertices -1) {
-                cb += sprintf(tmpbuf + cb, "(%.*lf %.*lf %.*lf),",
-                    dig, pObj->pPoints[i].x + offX,
-                    dig, pObj->pPoints[i].y + offY,
-                    digM, pObj->padfM[i] + offM);
-            } else {
-                cb += sprintf(tmpbuf + cb, "(%.*lf %.*lf %.*lf)",
-                    dig, pObj->pPoints[i].x + offX,
-                    dig, pObj->pPoints[i].y + offY,
-                    digM, pObj->padfM[i] + offM);
-            }
-        }
 
-        cb += sprintf(tmpbuf + cb, ")");
-    }
+/* -------------------------------------------------------------------- */
+/*      SHPObjectEx: x, y interleaved in pPoints                        */
+/* -------------------------------------------------------------------- */
 
-    return cb;
+int exPoint2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, int dig)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, NULL, offX, offY, 0, dig, 0);
+    return WKTWritePoint(&w, "");
 }
 
 
-int exArc2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, int dig)
+int exPointZ2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
 {
-    int cb = 0;
-    int start, end, at;
-    int iPart = 0;
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfZ, offX, offY, offZ, dig, digZ);
+    return WKTWritePoint(&w, " Z");
+}
 
-    if (pbBuf) {
-        if (pObj->nParts > 1) {
-            cb += sprintf(pbBuf, "MULTILINESTRING (");
-        } else {
-            cb += sprintf(pbBuf, "LINESTRING ");
-        }
 
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(pbBuf + cb, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf,",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY);
-                } else {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY);
-                }
-            }
+int exPointM2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfM, offX, offY, offM, dig, digM);
+    return WKTWritePoint(&w, " M");
+}
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(pbBuf + cb, "),");
-            } else {
-                cb += sprintf(pbBuf + cb, ")");
-            }
-        }
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(pbBuf, ")");
-        }
-    } else {
-        static char tmpbuf[128];
+int exMultiPoint2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, int dig)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, NULL, offX, offY, 0, dig, 0);
+    return WKTWriteMultiPoint(&w, "");
+}
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(tmpbuf, "MULTILINESTRING (");
-        } else {
-            cb += sprintf(tmpbuf, "LINESTRING ");
-        }
 
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(tmpbuf, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf,",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY);
-                } else {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY);
-                }
-            }
+int exMultiPointZ2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfZ, offX, offY, offZ, dig, digZ);
+    return WKTWriteMultiPoint(&w, " Z");
+}
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(tmpbuf, "),");
-            } else {
-                cb += sprintf(tmpbuf, ")");
-            }
-        }
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(tmpbuf, ")");
-        }
-    }
+int exMultiPointM2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfM, offX, offY, offM, dig, digM);
+    return WKTWriteMultiPoint(&w, " M");
+}
 
-    return cb;
+
+int exArc2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, int dig)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, NULL, offX, offY, 0, dig, 0);
+    return WKTWriteLines(&w, "");
 }
 
 
 int exArcZ2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
 {
-    int cb = 0;
-    int start, end, at;
-    int iPart = 0;
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfZ, offX, offY, offZ, dig, digZ);
+    return WKTWriteLines(&w, " Z");
+}
 
-    if (pbBuf) {
-        if (pObj->nParts > 1) {
-            cb += sprintf(pbBuf, "MULTILINESTRING Z (");
-        } else {
-            cb += sprintf(pbBuf, "LINESTRING Z ");
-        }
 
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(pbBuf + cb, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                } else {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                }
-            }
+int exArcM2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfM, offX, offY, offM, dig, digM);
+    return WKTWriteLines(&w, " M");
+}
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(pbBuf + cb, "),");
-            } else {
-                cb += sprintf(pbBuf + cb, ")");
-            }
-        }
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(pbBuf, ")");
-        }
-    } else {
-        static char tmpbuf[128];
+int exPolygon2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, int dig)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, NULL, offX, offY, 0, dig, 0);
+    return WKTWritePolygon(&w, "");
+}
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(tmpbuf, "MULTILINESTRING Z (");
-        } else {
-            cb += sprintf(tmpbuf, "LINESTRING Z ");
-        }
 
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(tmpbuf, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                } else {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                }
-            }
+int exPolygonZ2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfZ, offX, offY, offZ, dig, digZ);
+    return WKTWritePolygon(&w, " Z");
+}
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(tmpbuf, "),");
-            } else {
-                cb += sprintf(tmpbuf, ")");
-            }
-        }
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(tmpbuf, ")");
-        }
-    }
+int exPolygonM2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, pObj);
+    WKTWriterInit(&w, pbBuf, &seq, pObj->padfM, offX, offY, offM, dig, digM);
+    return WKTWritePolygon(&w, " M");
+}
 
-    return cb;
+
+int MultiPatch2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, int dig)
+{
+    /* TODO */
+    return 0;
 }
 
 
-int exArcM2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
+int exMultiPatch2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, int dig)
 {
-    int cb = 0;
-    int start, end, at;
-    int iPart = 0;
+    /* TODO */
+    return 0;
+}
 
-    if (pbBuf) {
-        if (pObj->nParts > 1) {
-            cb += sprintf(pbBuf, "MULTILINESTRING M (");
-        } else {
-            cb += sprintf(pbBuf, "LINESTRING M ");
-        }
 
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(pbBuf + cb, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digM, pObj->padfM[at] + offM);
-                } else {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digM, pObj->padfM[at] + offM);
-                }
-            }
+/* -------------------------------------------------------------------- */
+/*      Bounded output and size estimate for any shape type             */
+/* -------------------------------------------------------------------- */
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(pbBuf + cb, "),");
-            } else {
-                cb += sprintf(pbBuf + cb, ")");
-            }
-        }
+/**
+ * Magnitude range of the values padf[i] + off one ordinate prints.
+ */
+typedef struct
+{
+    double  dMaxAbs;        /* infinity included, NaN skipped */
+    double  dMinAbs;        /* smallest non-zero */
+    int     bNegative;
+} WKTRange;
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(pbBuf, ")");
-        }
-    } else {
-        static char tmpbuf[128];
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(tmpbuf, "MULTILINESTRING M (");
-        } else {
-            cb += sprintf(tmpbuf, "LINESTRING M ");
-        }
+static void WKTScanRange (WKTRange *r, const double *padf, int nStride, int n, double off)
+{
+    int i;
 
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(tmpbuf, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digM, pObj->padfM[at] + offM);
-                } else {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digM, pObj->padfM[at] + offM);
-                }
-            }
+    r->dMaxAbs = 0;
+    r->dMinAbs = HUGE_VAL;
+    r->bNegative = 0;
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(tmpbuf, "),");
-            } else {
-                cb += sprintf(tmpbuf, ")");
-            }
-        }
+    for (i = 0; i < n; i++) {
+        double v = padf[i * nStride] + off;
 
-        if (pObj->nParts > 1) {
-            cb += sprintf(tmpbuf, ")");
+        r->bNegative |= signbit(v) != 0;
+        v = fabs(v);
+        if (v > r->dMaxAbs) {
+            r->dMaxAbs = v;
+        }
+        if (v < r->dMinAbs && v > 0) {
+            r->dMinAbs = v;
         }
     }
-
-    return cb;
 }
 
 
-int exPolygon2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, int dig)
+/**
+ * Upper bound of the text SHPFormatDouble() writes for values in range r.
+ */
+static int WKTDoubleWidth (const WKTRange *r, int nDecimals)
 {
-    int cb = 0;
-    int start, end, at;
-    int iPart = 0;
-
-    if (pbBuf) {
-        cb += sprintf(pbBuf, "POLYGON (");
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(pbBuf + cb, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf,",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY);
-                } else {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY);
-                }
-            }
-
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(pbBuf + cb, "),");
-            } else {
-                cb += sprintf(pbBuf + cb, ")");
-            }
+    int    cb = 1;
+    double p = 10.0;
+
+    if (nDecimals < 0) {
+        /* at most 17 digits: 12345.678901234567, 0.0000012345678901234567,
+         *  123456789012345678900, 1.2345678901234567e+300 */
+        if (r->dMinAbs < 1) {
+            cb = 24;
+        } else if (r->dMaxAbs >= 1e21) {
+            cb = 23;
+        } else {
+            cb = (r->dMaxAbs >= 1e17) ? 21 : 18;
         }
-
-        cb += sprintf(pbBuf + cb, ")");
     } else {
-        static char tmpbuf[128];
-
-        cb += sprintf(tmpbuf, "POLYGON (");
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(tmpbuf, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf,",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY);
-                } else {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY);
-                }
-            }
-
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(tmpbuf, "),");
-            } else {
-                cb += sprintf(tmpbuf, ")");
+        nDecimals = MIN_V2(nDecimals, SHP_DECIMALS_MAX);
+
+        if (r->dMaxAbs <= DBL_MAX) {
+            /* rounding to nDecimals may carry into a new integer digit */
+            double dMaxAbs = (r->dMaxAbs + 0.5 * pow(10.0, -nDecimals)) * (1 + 1e-12);
+            while (cb < 309 && dMaxAbs >= p) {
+                cb++;
+                p *= 10;
             }
+        } else {
+            cb = 309;
         }
-
-        cb += sprintf(tmpbuf, ")");
+        cb += (nDecimals > 0 ? nDecimals + 1 : 0);
     }
 
-    return cb;
+    return MAX_V2(cb + r->bNegative, 4);   /* "-nan" */
 }
 
 
-int exPolygonZ2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offZ, int dig, int digZ)
+static int WKTWriteShape (WKTWriter *w, double offZ, double offM, int digZ, int digM)
 {
-    int cb = 0;
-    int start, end, at;
-    int iPart = 0;
-
-    if (pbBuf) {
-        cb += sprintf(pbBuf, "POLYGON Z (");
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(pbBuf + cb, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                } else {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                }
-            }
+    const char *pszDim = "";
+    int nVertices = w->seq.nVertices;
+
+    switch (w->seq.nSHPType) {
+    case SHPT_POINTZ:
+    case SHPT_ARCZ:
+    case SHPT_POLYGONZ:
+    case SHPT_MULTIPOINTZ:
+        pszDim = " Z";
+        w->padfZM = w->seq.padfZ;
+        w->offZM = offZ;
+        w->digZM = digZ;
+        break;
+    case SHPT_POINTM:
+    case SHPT_ARCM:
+    case SHPT_POLYGONM:
+    case SHPT_MULTIPOINTM:
+        pszDim = " M";
+        w->padfZM = w->seq.padfM;
+        w->offZM = offM;
+        w->digZM = digM;
+        break;
+    }
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(pbBuf + cb, "),");
-            } else {
-                cb += sprintf(pbBuf + cb, ")");
-            }
-        }
+    if (w->bBound) {
+        WKTRange r;
 
-        cb += sprintf(pbBuf + cb, ")");
-    } else {
-        static char tmpbuf[128];
-
-        cb += sprintf(tmpbuf, "POLYGON Z (");
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(tmpbuf, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                } else {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digZ, pObj->padfZ[at] + offZ);
-                }
-            }
+        WKTScanRange(&r, w->seq.padfX, w->seq.nStride, nVertices, w->offX);
+        w->cbVertex = WKTDoubleWidth(&r, w->dig) + 1;
+        WKTScanRange(&r, w->seq.padfY, w->seq.nStride, nVertices, w->offY);
+        w->cbVertex += WKTDoubleWidth(&r, w->dig);
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(tmpbuf, "),");
-            } else {
-                cb += sprintf(tmpbuf, ")");
-            }
+        if (w->padfZM) {
+            WKTScanRange(&r, w->padfZM, 1, nVertices, w->offZM);
+            w->cbVertex += 1 + WKTDoubleWidth(&r, w->digZM);
         }
+    }
 
-        cb += sprintf(tmpbuf, ")");
+    switch (w->seq.nSHPType) {
+    case SHPT_NULL:
+        SHPTextEnd(&w->t);
+        return -1;
+    case SHPT_POINT:
+    case SHPT_POINTZ:
+    case SHPT_POINTM:
+        return WKTWritePoint(w, pszDim);
+    case SHPT_ARC:
+    case SHPT_ARCZ:
+    case SHPT_ARCM:
+        return WKTWriteLines(w, pszDim);
+    case SHPT_POLYGON:
+    case SHPT_POLYGONZ:
+    case SHPT_POLYGONM:
+        return WKTWritePolygon(w, pszDim);
+    case SHPT_MULTIPOINT:
+    case SHPT_MULTIPOINTZ:
+    case SHPT_MULTIPOINTM:
+        return WKTWriteMultiPoint(w, pszDim);
     }
 
-    return cb;
+    /* SHPT_MULTIPATCH: TODO */
+    return SHPTextEnd(&w->t);
 }
 
 
-int exPolygonM2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, double offM, int dig, int digM)
+int SHPObject2WKTn (const SHPObject *psObject, char *wktBuffer, int cbBuffer,
+    double offsetX, double offsetY, double offsetZ, double offsetM,
+    int nDecimalsXY, int nDecimalsZ, int nDecimalsM)
 {
-    int cb = 0;
-    int start, end, at;
-    int iPart = 0;
-
-    if (pbBuf) {
-        cb += sprintf(pbBuf, "POLYGON M (");
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(pbBuf + cb, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digM, pObj->padfM[at] + offM);
-                } else {
-                    cb += sprintf(pbBuf + cb, "%.*lf %.*lf %.*lf",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digM, pObj->padfM[at] + offM);
-                }
-            }
+    WKTWriter w;
+    SHPCoordSeq seq;
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(pbBuf + cb, "),");
-            } else {
-                cb += sprintf(pbBuf + cb, ")");
-            }
-        }
+    SHPCoordSeqOfObject(&seq, psObject);
+    WKTWriterInit(&w, NULL, &seq, NULL, offsetX, offsetY, 0, nDecimalsXY, 0);
+    SHPTextInit(&w.t, wktBuffer, cbBuffer);
 
-        cb += sprintf(pbBuf + cb, ")");
-    } else {
-        static char tmpbuf[128];
-
-        cb += sprintf(tmpbuf, "POLYGON M (");
-        for (; iPart < pObj->nParts; iPart++) {
-            start = pObj->panPartStart[iPart];
-            end = pObj->panPartStart[iPart+1];
-
-            cb += sprintf(tmpbuf, "(");
-
-            for (at = start; at < end; at++) {
-                if (at < end -1) {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf,",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digM, pObj->padfM[at] + offM);
-                } else {
-                    cb += sprintf(tmpbuf, "%.*lf %.*lf %.*lf",
-                        dig, pObj->pPoints[at].x + offX,
-                        dig, pObj->pPoints[at].y + offY,
-                        digM, pObj->padfM[at] + offM);
-                }
-            }
+    return WKTWriteShape(&w, offsetZ, offsetM, nDecimalsZ, nDecimalsM);
+}
 
-            if (iPart < pObj->nParts -1) {
-                cb += sprintf(tmpbuf, "),");
-            } else {
-                cb += sprintf(tmpbuf, ")");
-            }
-        }
 
-        cb += sprintf(tmpbuf, ")");
-    }
+int SHPObjectEx2WKTn (const SHPObjectEx *psObject, char *wktBuffer, int cbBuffer,
+    double offsetX, double offsetY, double offsetZ, double offsetM,
+    int nDecimalsXY, int nDecimalsZ, int nDecimalsM)
+{
+    WKTWriter w;
+    SHPCoordSeq seq;
 
-    return cb;
+    SHPCoordSeqOfObjectEx(&seq, psObject);
+    WKTWriterInit(&w, NULL, &seq, NULL, offsetX, offsetY, 0, nDecimalsXY, 0);
+    SHPTextInit(&w.t, wktBuffer, cbBuffer);
+
+    return WKTWriteShape(&w, offsetZ, offsetM, nDecimalsZ, nDecimalsM);
 }
 
 
-int MultiPatch2WKT(const SHPObject *pObj, char *pbBuf, double offX, double offY, int dig)
+int SHPObject2WKTSize (const SHPObject *psObject,
+    double offsetX, double offsetY, double offsetZ, double offsetM,
+    int nDecimalsXY, int nDecimalsZ, int nDecimalsM)
 {
-    /* TODO */
-    return 0;
+    WKTWriter w;
+    SHPCoordSeq seq;
+
+    SHPCoordSeqOfObject(&seq, psObject);
+    WKTWriterInit(&w, NULL, &seq, NULL, offsetX, offsetY, 0, nDecimalsXY, 0);
+    w.bBound = 1;
+
+    if (WKTWriteShape(&w, offsetZ, offsetM, nDecimalsZ, nDecimalsM) < 0) {
+        return -1;
+    }
+    return (int) w.t.cb + 1;
 }
 
 
-int exMultiPatch2WKT(const SHPObjectEx *pObj, char *pbBuf, double offX, double offY, int dig)
+int SHPObjectEx2WKTSize (const SHPObjectEx *psObject,
+    double offsetX, double offsetY, double offsetZ, double offsetM,
+    int nDecimalsXY, int nDecimalsZ, int nDecimalsM)
 {
-    /* TODO */
-    return 0;
+    WKTWriter w;
+    SHPCoordSeq seq;
+
+    SHPCoordSeqOfObjectEx(&seq, psObject);
+    WKTWriterInit(&w, NULL, &seq, NULL, offsetX, offsetY, 0, nDecimalsXY, 0);
+    w.bBound = 1;
+
+    if (WKTWriteShape(&w, offsetZ, offsetM, nDecimalsZ, nDecimalsM) < 0) {
+        return -1;
+    }
+    return (int) w.t.cb + 1;
 }
@@ -0,0 +1,156 @@
+/******************************************************************************
+ * shparena.c
+ *
+ * v 1.0 2026/10/18
+ *
+ * Project:  Shapelib
+ * Purpose:  Bump allocator for shapes read and dropped in batches
+ * Author:   cheungmine@gmail.com
+ *
+ * Copyright (c) 2026, cheungmine
+ *
+ * This software is available under the following "MIT Style" license,
+ * or at the option of the licensee under the LGPL (see LICENSE.LGPL).  This
+ * option is discussed in more detail in shapelib.html.
+ *
+ * --
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+ * An arena hands out memory from large blocks by moving a cursor and
+ * frees nothing until SHPArenaReset(), which makes all of it reusable
+ * at once. Blocks added while filling are merged into one on reset, so
+ * a steady workload ends up with a single block and no malloc at all.
+ */
+
+#include "shapefile_i.h"
+
+#include <common/memapi.h>
+
+/* all allocations are aligned for doubles and pointers */
+#define SHP_ARENA_ALIGN  16
+
+
+typedef struct _SHPArenaBlock
+{
+    struct _SHPArenaBlock *pNext;
+    size_t      nSize;          /* usable bytes after the header */
+    size_t      nUsed;
+} SHPArenaBlock;
+
+#define SHP_ARENA_HEADER  memapi_align_bsize(sizeof(SHPArenaBlock), SHP_ARENA_ALIGN)
+
+
+struct SHPArenaInfo
+{
+    SHPArenaBlock  *pBlocks;    /* block being filled first */
+    size_t          nBlockSize;
+    size_t          nTotalSize; /* of all blocks */
+
+    /* record bytes of SHPReadObjectArena() */
+    SHPReadBuffer   sReadBuf;
+};
+
+
+static SHPArenaBlock * SHPArenaNewBlock(SHPArenaHandle hArena, size_t nSize)
+{
+    SHPArenaBlock *pBlock = (SHPArenaBlock *) malloc(SHP_ARENA_HEADER + nSize);
+    if (pBlock) {
+        pBlock->pNext = hArena->pBlocks;
+        pBlock->nSize = nSize;
+        pBlock->nUsed = 0;
+
+        hArena->pBlocks = pBlock;
+        hArena->nTotalSize += nSize;
+    }
+    return pBlock;
+}
+
+
+static void SHPArenaFreeBlocks(SHPArenaHandle hArena)
+{
+    while (hArena->pBlocks) {
+        SHPArenaBlock *pNext = hArena->pBlocks->pNext;
+        free(hArena->pBlocks);
+        hArena->pBlocks = pNext;
+    }
+    hArena->nTotalSize = 0;
+}
+
+
+SHPArenaHandle SHPArenaCreate(size_t nBlockSize)
+{
+    SHPArenaHandle hArena = (SHPArenaHandle) calloc(1, sizeof(struct SHPArenaInfo));
+    if (hArena) {
+        hArena->nBlockSize = nBlockSize ? memapi_align_bsize(nBlockSize, SHP_ARENA_ALIGN) : SHP_ARENA_BLOCKSIZE;
+    }
+    return hArena;
+}
+
+
+void * SHPArenaAlloc(SHPArenaHandle hArena, size_t nBytes)
+{
+    SHPArenaBlock *pBlock = hArena->pBlocks;
+    void *pv;
+
+    nBytes = memapi_align_bsize(nBytes ? nBytes : 1, SHP_ARENA_ALIGN);
+
+    if (!pBlock || pBlock->nSize - pBlock->nUsed < nBytes) {
+        pBlock = SHPArenaNewBlock(hArena, MAX_V2(hArena->nBlockSize, nBytes));
+        if (!pBlock) {
+            return NULL;
+        }
+    }
+
+    pv = (char *) pBlock + SHP_ARENA_HEADER + pBlock->nUsed;
+    pBlock->nUsed += nBytes;
+    return pv;
+}
+
+
+void SHPArenaReset(SHPArenaHandle hArena)
+{
+    if (hArena->pBlocks && hArena->pBlocks->pNext) {
+        /* merge into one block that holds what all of them did */
+        size_t nTotalSize = hArena->nTotalSize;
+
+        SHPArenaFreeBlocks(hArena);
+        SHPArenaNewBlock(hArena, nTotalSize);
+    } else if (hArena->pBlocks) {
+        hArena->pBlocks->nUsed = 0;
+    }
+}
+
+
+void SHPArenaDestroy(SHPArenaHandle hArena)
+{
+    if (hArena) {
+        SHPArenaFreeBlocks(hArena);
+        SHPReadBufferFree(&hArena->sReadBuf);
+        free(hArena);
+    }
+}
+
+
+SHPReadBuffer * SHPArenaReadBuffer(SHPArenaHandle hArena)
+{
+    return &hArena->sReadBuf;
+}
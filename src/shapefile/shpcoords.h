@@ -0,0 +1,265 @@
+/******************************************************************************
+ * shpcoords.h
+ *
+ * v 1.0 2026/10/18
+ *
+ * Project:  Shapelib
+ * Purpose:  Coordinate sequence view over SHPObject and SHPObjectEx
+ * Author:   cheungmine@gmail.com
+ *
+ * Copyright (c) 2026, cheungmine
+ *
+ * This software is available under the following "MIT Style" license,
+ * or at the option of the licensee under the LGPL (see LICENSE.LGPL).  This
+ * option is discussed in more detail in shapelib.html.
+ *
+ * --
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+ * SHPObject keeps x and y in separate arrays (structure of arrays) and
+ * SHPObjectEx interleaves them in pPoints (array of structures). both
+ * are seen through one SHPCoordSeq, vertex i being
+ *
+ *   x = padfX[i * nStride], y = padfY[i * nStride]
+ *
+ * with nStride SHPCOORDS_SOA or SHPCOORDS_AOS, so a view of either
+ * object needs no copy. kernels are STATIC_INLINE with the stride as
+ * first argument and called through SHPCOORDS_CALL(), which passes it
+ * as a constant: each layout gets its own code with the multiply
+ * folded away.
+ */
+
+#ifndef _SHPCOORDS_H_INCLUDED
+#define _SHPCOORDS_H_INCLUDED
+
+#include "shapefile_i.h"
+
+
+#define SHPCOORDS_SOA  1
+#define SHPCOORDS_AOS  ((int) (sizeof(SHPPointType) / sizeof(double)))
+
+/* x, y arrays of an SHPObjectEx */
+#define SHPPointsX(pObj)  ((pObj)->pPoints ? &(pObj)->pPoints->x : NULL)
+#define SHPPointsY(pObj)  ((pObj)->pPoints ? &(pObj)->pPoints->y : NULL)
+
+
+typedef struct
+{
+    int       nSHPType;
+    int       nParts;           /* 0: one part of all vertices */
+    int      *panPartStart;
+    int       nVertices;
+
+    double   *padfX;            /* x, y of vertex i at [i * nStride] */
+    double   *padfY;
+    int       nStride;
+
+    double   *padfZ;            /* vertex i at [i], NULL if the type has none */
+    double   *padfM;
+} SHPCoordSeq;
+
+
+/**
+ * no-copy views. the object stays the owner of the arrays.
+ */
+void SHPCoordSeqOfObject (SHPCoordSeq *psSeq, const SHPObject *psObject);
+
+void SHPCoordSeqOfObjectEx (SHPCoordSeq *psSeq, const SHPObjectEx *psObject);
+
+
+/**
+ * length of lines and polygon rings and signed area of polygons as
+ *   SHPObjectGetLength() and SHPObjectGetArea(), 0 for other types.
+ */
+double SHPCoordSeqGetLength (const SHPCoordSeq *psSeq);
+
+double SHPCoordSeqGetArea (const SHPCoordSeq *psSeq);
+
+
+/**
+ * rings of a polygon wound as SHPObjectValidatePolygon() winds them.
+ */
+int SHPCoordSeqValidatePolygon (SHPCoordSeq *psSeq, int isCCW);
+
+
+/**
+ * kernel(nStride, args...) for the stride of psSeq as a constant.
+ */
+#define SHPCOORDS_CALL(psSeq, kernel, ...) \
+    ((psSeq)->nStride == SHPCOORDS_AOS ? kernel(SHPCOORDS_AOS, __VA_ARGS__) : kernel(SHPCOORDS_SOA, __VA_ARGS__))
+
+
+#define SHPCoordX(psSeq, nStride, i)  ((psSeq)->padfX[(i) * (nStride)])
+#define SHPCoordY(psSeq, nStride, i)  ((psSeq)->padfY[(i) * (nStride)])
+
+
+/**
+ * vertex range [*start, *end) of part iPart. does not need the
+ *   panPartStart[nParts] sentinel the library objects have.
+ */
+STATIC_INLINE void SHPCoordsPartRange (const SHPCoordSeq *psSeq, int iPart, int *start, int *end)
+{
+    if (psSeq->nParts == 0) {
+        *start = 0;
+        *end = psSeq->nVertices;
+    } else {
+        *start = psSeq->panPartStart[iPart];
+        *end = (iPart + 1 < psSeq->nParts) ? psSeq->panPartStart[iPart + 1] : psSeq->nVertices;
+    }
+}
+
+
+/**
+ * length and area are sums of one term per segment or vertex. term k
+ *   goes to partial sum k % SHPCOORDS_LANES and the partial sums are
+ *   added as (s0 + s2) + (s1 + s3): the SIMD kernels of shpsimd.c keep
+ *   this order and give the same bits as the plain loops below.
+ */
+#define SHPCOORDS_LANES  4
+
+STATIC_INLINE double SHPCoordsLanesSum (const double s[SHPCOORDS_LANES])
+{
+    return (s[0] + s[2]) + (s[1] + s[3]);
+}
+
+
+/**
+ * add the segment lengths of vertices [start, end) to s, the first to
+ *   s[0]. SIMD kernels finish their tail with it.
+ */
+STATIC_INLINE void SHPCoordsLengthSums (int nStride, const SHPCoordSeq *psSeq, int start, int end, double s[SHPCOORDS_LANES])
+{
+    int i, k;
+
+    for (i = start, k = 0; i < end - 1; i++, k++) {
+        double dx = SHPCoordX(psSeq, nStride, i + 1) - SHPCoordX(psSeq, nStride, i);
+        double dy = SHPCoordY(psSeq, nStride, i + 1) - SHPCoordY(psSeq, nStride, i);
+        s[k % SHPCOORDS_LANES] += sqrt(dx*dx + dy*dy);
+    }
+}
+
+
+/**
+ * add the area terms of vertices [first, end - 1) of a ring starting at
+ *   x0 to s, the first to s[0].
+ */
+STATIC_INLINE void SHPCoordsAreaSums (int nStride, const SHPCoordSeq *psSeq, int first, int end, double x0, double s[SHPCOORDS_LANES])
+{
+    int i, k;
+
+    for (i = first, k = 0; i < end - 1; i++, k++) {
+        s[k % SHPCOORDS_LANES] += (SHPCoordX(psSeq, nStride, i) - x0) * (SHPCoordY(psSeq, nStride, i + 1) - SHPCoordY(psSeq, nStride, i - 1));
+    }
+}
+
+
+/**
+ * length of the line through vertices [start, end).
+ */
+STATIC_INLINE double SHPCoordsLengthOf (int nStride, const SHPCoordSeq *psSeq, int start, int end)
+{
+    double s[SHPCOORDS_LANES] = {0, 0, 0, 0};
+
+    SHPCoordsLengthSums(nStride, psSeq, start, end, s);
+    return SHPCoordsLanesSum(s);
+}
+
+
+/**
+ * signed area of the closed ring [start, end): > 0 if CCW.
+ */
+STATIC_INLINE double SHPCoordsAreaOf (int nStride, const SHPCoordSeq *psSeq, int start, int end)
+{
+    double s[SHPCOORDS_LANES] = {0, 0, 0, 0};
+
+    if (end - start < 3) {
+        return 0;
+    }
+
+    SHPCoordsAreaSums(nStride, psSeq, start + 1, end, SHPCoordX(psSeq, nStride, start), s);
+    return SHPCoordsLanesSum(s)/2;
+}
+
+
+/**
+ * SHAPEFILE_TRUE if (x, y) is inside ring [start, end) by crossings.
+ */
+STATIC_INLINE int SHPCoordsRingContains (int nStride, const SHPCoordSeq *psSeq, int start, int end, double x, double y)
+{
+    int i, j, bInside = SHAPEFILE_FALSE;
+
+    for (i = start, j = end - 1; i < end; j = i++) {
+        double xi = SHPCoordX(psSeq, nStride, i), yi = SHPCoordY(psSeq, nStride, i);
+        double xj = SHPCoordX(psSeq, nStride, j), yj = SHPCoordY(psSeq, nStride, j);
+
+        if (((yj < y && yi >= y) || (yi < y && yj >= y)) && xj + (y - yj) / (yi - yj) * (xi - xj) < x) {
+            bInside = !bInside;
+        }
+    }
+    return bInside;
+}
+
+
+/**
+ * reverse the vertex order of [start, end) with its Z and M.
+ */
+STATIC_INLINE void SHPCoordsReverse (int nStride, SHPCoordSeq *psSeq, int start, int end)
+{
+    int i = start, j = end - 1;
+    double t;
+
+    for (; i < j; i++, j--) {
+        t = SHPCoordX(psSeq, nStride, i);
+        SHPCoordX(psSeq, nStride, i) = SHPCoordX(psSeq, nStride, j);
+        SHPCoordX(psSeq, nStride, j) = t;
+
+        t = SHPCoordY(psSeq, nStride, i);
+        SHPCoordY(psSeq, nStride, i) = SHPCoordY(psSeq, nStride, j);
+        SHPCoordY(psSeq, nStride, j) = t;
+
+        if (psSeq->padfZ) {
+            t = psSeq->padfZ[i];
+            psSeq->padfZ[i] = psSeq->padfZ[j];
+            psSeq->padfZ[j] = t;
+        }
+        if (psSeq->padfM) {
+            t = psSeq->padfM[i];
+            psSeq->padfM[i] = psSeq->padfM[j];
+            psSeq->padfM[j] = t;
+        }
+    }
+}
+
+
+/**
+ * the same sums and bounds run on the widest SIMD the CPU has, picked
+ *   once at first call (shpsimd.c). bounds are of x and y in [0], [1].
+ */
+double SHPSimdLengthOf (const SHPCoordSeq *psSeq, int start, int end);
+
+double SHPSimdAreaOf (const SHPCoordSeq *psSeq, int start, int end);
+
+void SHPSimdBoundsOf (const SHPCoordSeq *psSeq, int start, int end, double *padfMin, double *padfMax);
+
+void SHPSimdRangeOf (const double *padfV, int nCount, double *pdfMin, double *pdfMax);
+
+#endif /* _SHPCOORDS_H_INCLUDED */
@@ -0,0 +1,536 @@
+/******************************************************************************
+ * shpjoin.c
+ *
+ * v 1.0 2026/10/18
+ *
+ * Project:  Shapelib
+ * Purpose:  Multithreaded point to polygon spatial join.
+ * Author:   cheungmine@gmail.com
+ *
+ * Copyright (c) 2026, cheungmine
+ *
+ * This software is available under the following "MIT Style" license,
+ * or at the option of the licensee under the LGPL (see LICENSE.LGPL).  This
+ * option is discussed in more detail in shapelib.html.
+ *
+ * --
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+ * Point to polygon join in two parallel passes over one read-only
+ * polygon handle:
+ *
+ *   1. every polygon is read into a per-thread arena and prepared
+ *      (shpprepared.c), 64 shapes per job.
+ *   2. points, sorted along a Hilbert curve so neighbours in a job hit
+ *      the same tree nodes and edge bands, are located 4096 per job:
+ *      MBR tree candidates, lowest id first, then the prepared test.
+ *
+ * Jobs are handed out by a shared cursor. The caller thread works too,
+ * so a join with one thread starts none.
+ */
+
+#include "shapefile_i.h"
+
+#if defined(PLATFORM_WINDOWS)
+# include <process.h>
+typedef HANDLE            SHPJoinThread;
+typedef CRITICAL_SECTION  SHPJoinMutex;
+# define SHPJoinMutexInit(m)  InitializeCriticalSection(m)
+# define SHPJoinMutexFree(m)  DeleteCriticalSection(m)
+# define SHPJoinLock(m)       EnterCriticalSection(m)
+# define SHPJoinUnlock(m)     LeaveCriticalSection(m)
+#else
+# include <pthread.h>
+typedef pthread_t         SHPJoinThread;
+typedef pthread_mutex_t   SHPJoinMutex;
+# define SHPJoinMutexInit(m)  pthread_mutex_init((m), NULL)
+# define SHPJoinMutexFree(m)  pthread_mutex_destroy(m)
+# define SHPJoinLock(m)       pthread_mutex_lock(m)
+# define SHPJoinUnlock(m)     pthread_mutex_unlock(m)
+#endif
+
+
+typedef struct _SHPJoinInfo
+{
+    SHPHandle        hPolygons;
+    SHPMBRTree       hTree;
+    int              nPolygons;
+    SHPPreparedPolygonHandle *pahPrepared;  /* [nPolygons], NULL if none */
+
+    const double    *padfXY;        /* x, y of the points in Hilbert order */
+    const int       *panOrder;      /* their indices */
+    const int       *panIds;        /* reported ids, NULL for index */
+    int              nPoints;
+
+    SHPJoinSink      onJoin;
+    void            *pvSink;
+
+    /* next job of the running pass and stop flag */
+    void           (*pfnWork) (struct _SHPJoinInfo *);
+    SHPJoinMutex     lock;
+    int              nNext;
+    int              bStop;
+
+    /* held while calling onJoin, bStop is set under both */
+    SHPJoinMutex     sinkLock;
+    int              nJoined;
+    int              bError;        /* a worker ran out of memory */
+} SHPJoinInfo;
+
+
+typedef struct
+{
+    int             *panIds;
+    int              nCount;
+    int              nSize;
+    int              bNoMemory;
+} SHPJoinCandidates;
+
+
+/* -------------------------------------------------------------------- */
+/*      threads                                                         */
+/* -------------------------------------------------------------------- */
+#if defined(PLATFORM_WINDOWS)
+
+static unsigned __stdcall SHPJoinThreadMain(void *pv)
+{
+    SHPJoinInfo *psJoin = (SHPJoinInfo *) pv;
+    psJoin->pfnWork(psJoin);
+    return 0;
+}
+
+static int SHPJoinThreadStart(SHPJoinThread *pThread, SHPJoinInfo *psJoin)
+{
+    *pThread = (HANDLE) _beginthreadex(NULL, 0, SHPJoinThreadMain, psJoin, 0, NULL);
+    return *pThread != 0;
+}
+
+static void SHPJoinThreadWait(SHPJoinThread thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+#else
+
+static void * SHPJoinThreadMain(void *pv)
+{
+    SHPJoinInfo *psJoin = (SHPJoinInfo *) pv;
+    psJoin->pfnWork(psJoin);
+    return NULL;
+}
+
+static int SHPJoinThreadStart(SHPJoinThread *pThread, SHPJoinInfo *psJoin)
+{
+    return pthread_create(pThread, NULL, SHPJoinThreadMain, psJoin) == 0;
+}
+
+static void SHPJoinThreadWait(SHPJoinThread thread)
+{
+    pthread_join(thread, NULL);
+}
+
+#endif
+
+
+/**
+ * run pfnWork on nThreads threads, the caller being one of them. fewer
+ *   threads if they cannot be started: the work gets done anyway.
+ */
+static void SHPJoinRun(SHPJoinInfo *psJoin, void (*pfnWork) (SHPJoinInfo *), int nThreads)
+{
+    SHPJoinThread *pThreads = NULL;
+    int i, nStarted = 0;
+
+    psJoin->pfnWork = pfnWork;
+    psJoin->nNext = 0;
+
+    if (nThreads > 1) {
+        pThreads = (SHPJoinThread *) malloc(sizeof(SHPJoinThread) * (nThreads - 1));
+    }
+    while (pThreads && nStarted < nThreads - 1 && SHPJoinThreadStart(&pThreads[nStarted], psJoin)) {
+        nStarted++;
+    }
+
+    pfnWork(psJoin);
+
+    for (i = 0; i < nStarted; i++) {
+        SHPJoinThreadWait(pThreads[i]);
+    }
+    free(pThreads);
+}
+
+
+/**
+ * take the next job of at most nBatch items out of nTotal.
+ *   returns its size, 0 when all are taken or the join stopped.
+ */
+static int SHPJoinClaim(SHPJoinInfo *psJoin, int nTotal, int nBatch, int *piFirst)
+{
+    int nCount = 0;
+
+    SHPJoinLock(&psJoin->lock);
+    if (!psJoin->bStop && psJoin->nNext < nTotal) {
+        *piFirst = psJoin->nNext;
+        nCount = MIN_V2(nBatch, nTotal - psJoin->nNext);
+        psJoin->nNext += nCount;
+    }
+    SHPJoinUnlock(&psJoin->lock);
+
+    return nCount;
+}
+
+
+/* -------------------------------------------------------------------- */
+/*      pass 1: prepare polygons                                        */
+/* -------------------------------------------------------------------- */
+static void SHPJoinPrepareWork(SHPJoinInfo *psJoin)
+{
+    SHPArenaHandle hArena = SHPArenaCreate(0);
+    int i, iFirst, nCount;
+
+    if (!hArena) {
+        /* the other threads take the jobs */
+        return;
+    }
+
+    while ((nCount = SHPJoinClaim(psJoin, psJoin->nPolygons, SHP_JOIN_POLYGON_BATCH, &iFirst)) > 0) {
+        for (i = iFirst; i < iFirst + nCount; i++) {
+            SHPObject *psObject = SHPReadObjectArena(psJoin->hPolygons, i, hArena);
+            if (psObject) {
+                psJoin->pahPrepared[i] = SHPPreparePolygon(psObject);
+            }
+        }
+        SHPArenaReset(hArena);
+    }
+
+    SHPArenaDestroy(hArena);
+}
+
+
+/* -------------------------------------------------------------------- */
+/*      pass 2: locate points                                           */
+/* -------------------------------------------------------------------- */
+static int SHPJoinOnCandidate(void *shapeData, void *userParam)
+{
+    SHPJoinCandidates *psCands = (SHPJoinCandidates *) userParam;
+
+    if (psCands->nCount == psCands->nSize) {
+        int nSize = psCands->nSize ? psCands->nSize * 2 : 16;
+        int *panIds = (int *) realloc(psCands->panIds, sizeof(int) * (size_t) nSize);
+        if (!panIds) {
+            /* stop the search */
+            psCands->bNoMemory = SHAPEFILE_TRUE;
+            return 0;
+        }
+        psCands->panIds = panIds;
+        psCands->nSize = nSize;
+    }
+    psCands->panIds[psCands->nCount++] = SHPMBRTreeDataToShapeId(shapeData);
+    return 1;
+}
+
+
+/* polygon containing (x, y) with the lowest id, -1 if none, -2 out of
+ *  memory */
+static int SHPJoinLocate(const SHPJoinInfo *psJoin, SHPJoinCandidates *psCands, double x, double y)
+{
+    SHPEnvelope env;
+    int i, j, id;
+
+    env.XMin = env.XMax = x;
+    env.YMin = env.YMax = y;
+
+    psCands->nCount = 0;
+    SHPMBRTreeSearch(psJoin->hTree, &env, SHPJoinOnCandidate, psCands);
+    if (psCands->bNoMemory) {
+        return (-2);
+    }
+
+    /* a handful of candidates: insertion sort */
+    for (i = 1; i < psCands->nCount; i++) {
+        id = psCands->panIds[i];
+        for (j = i; j > 0 && psCands->panIds[j - 1] > id; j--) {
+            psCands->panIds[j] = psCands->panIds[j - 1];
+        }
+        psCands->panIds[j] = id;
+    }
+
+    for (i = 0; i < psCands->nCount; i++) {
+        id = psCands->panIds[i];
+        if (id >= 0 && id < psJoin->nPolygons && psJoin->pahPrepared[id] &&
+            SHPPreparedPolygonContains(psJoin->pahPrepared[id], x, y)) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+
+static void SHPJoinPointWork(SHPJoinInfo *psJoin)
+{
+    int panPoints[SHP_JOIN_POINT_BATCH], panPolygons[SHP_JOIN_POINT_BATCH];
+    SHPJoinCandidates cands;
+    int k, iFirst, nCount;
+
+    memset(&cands, 0, sizeof(cands));
+
+    while ((nCount = SHPJoinClaim(psJoin, psJoin->nPoints, SHP_JOIN_POINT_BATCH, &iFirst)) > 0) {
+        int nJoined = 0;
+
+        for (k = 0; k < nCount && !cands.bNoMemory; k++) {
+            int iPoint = psJoin->panOrder[iFirst + k];
+            const double *pXY = psJoin->padfXY + 2 * (iFirst + k);
+
+            panPoints[k] = psJoin->panIds ? psJoin->panIds[iPoint] : iPoint;
+            panPolygons[k] = SHPJoinLocate(psJoin, &cands, pXY[0], pXY[1]);
+            if (panPolygons[k] >= 0) {
+                nJoined++;
+            }
+        }
+
+        SHPJoinLock(&psJoin->sinkLock);
+        if (cands.bNoMemory) {
+            SHPJoinLock(&psJoin->lock);
+            psJoin->bStop = SHAPEFILE_TRUE;
+            psJoin->bError = SHAPEFILE_TRUE;
+            SHPJoinUnlock(&psJoin->lock);
+        } else if (!psJoin->bStop) {
+            psJoin->nJoined += nJoined;
+
+            if (!psJoin->onJoin(psJoin->pvSink, panPoints, panPolygons, nCount)) {
+                SHPJoinLock(&psJoin->lock);
+                psJoin->bStop = SHAPEFILE_TRUE;
+                SHPJoinUnlock(&psJoin->lock);
+            }
+        }
+        SHPJoinUnlock(&psJoin->sinkLock);
+    }
+
+    SafeFree(cands.panIds);
+}
+
+
+/**
+ * sort the points by the Hilbert index of their cell on a 65536 x 65536
+ *   grid over their extent: two 16-bit radix passes over key << 32 | index.
+ *   the coordinates are gathered once here into padfXY in that order, the
+ *   workers then read them in sequence.
+ */
+static int * SHPJoinHilbertOrder(const double *padfX, const double *padfY, int nPoints, double *padfXY)
+{
+    uint64_t *panKeys, *panSorted;
+    int *panCounts, *panOrder;
+    double minx = DBL_MAX, miny = DBL_MAX, maxx = -DBL_MAX, maxy = -DBL_MAX, sx, sy;
+    int i, nPass;
+
+    for (i = 0; i < nPoints; i++) {
+        /* NaN fails all of these */
+        if (padfX[i] >= -DBL_MAX && padfX[i] <= DBL_MAX && padfY[i] >= -DBL_MAX && padfY[i] <= DBL_MAX) {
+            minx = MIN_V2(minx, padfX[i]);
+            maxx = MAX_V2(maxx, padfX[i]);
+            miny = MIN_V2(miny, padfY[i]);
+            maxy = MAX_V2(maxy, padfY[i]);
+        }
+    }
+
+    sx = (maxx > minx) ? 65535.0 / (maxx - minx) : 0;
+    sy = (maxy > miny) ? 65535.0 / (maxy - miny) : 0;
+
+    panKeys = (uint64_t *) malloc(sizeof(uint64_t) * MAX_V2(nPoints, 1));
+    panSorted = (uint64_t *) malloc(sizeof(uint64_t) * MAX_V2(nPoints, 1));
+    panCounts = (int *) malloc(sizeof(int) * 65536);
+    panOrder = (int *) malloc(sizeof(int) * MAX_V2(nPoints, 1));
+
+    if (!panKeys || !panSorted || !panCounts || !panOrder) {
+        free(panKeys);
+        free(panSorted);
+        free(panCounts);
+        free(panOrder);
+        return NULL;
+    }
+
+    for (i = 0; i < nPoints; i++) {
+        uint32_t hx = 0, hy = 0;
+        double gx = (padfX[i] - minx) * sx, gy = (padfY[i] - miny) * sy;
+
+        if (gx > 0) {
+            hx = (uint32_t) MIN_V2(gx, 65535.0);
+        }
+        if (gy > 0) {
+            hy = (uint32_t) MIN_V2(gy, 65535.0);
+        }
+        panKeys[i] = ((uint64_t) RTreeHilbertXY2D(hx, hy) << 32) | (uint32_t) i;
+    }
+
+    for (nPass = 0; nPass < 2; nPass++) {
+        int nShift = 32 + 16 * nPass, nSum = 0;
+
+        memset(panCounts, 0, sizeof(int) * 65536);
+        for (i = 0; i < nPoints; i++) {
+            panCounts[(panKeys[i] >> nShift) & 0xffff]++;
+        }
+        for (i = 0; i < 65536; i++) {
+            int n = panCounts[i];
+            panCounts[i] = nSum;
+            nSum += n;
+        }
+        for (i = 0; i < nPoints; i++) {
+            panSorted[panCounts[(panKeys[i] >> nShift) & 0xffff]++] = panKeys[i];
+        }
+        memcpy(panKeys, panSorted, sizeof(uint64_t) * nPoints);
+    }
+
+    for (i = 0; i < nPoints; i++) {
+        int k = (int) (panKeys[i] & 0xffffffff);
+        panOrder[i] = k;
+        padfXY[2 * i] = padfX[k];
+        padfXY[2 * i + 1] = padfY[k];
+    }
+
+    free(panKeys);
+    free(panSorted);
+    free(panCounts);
+    return panOrder;
+}
+
+
+static int SHPJoinOnFirst(void *shapeData, void *userParam)
+{
+    (void) shapeData;
+    (void) userParam;
+    return 0;
+}
+
+
+static int SHPSpatialJoinIds(SHPHandle hPolygons, const double *padfX, const double *padfY, const int *panIds, int nPoints,
+    int nThreads, SHPJoinSink onJoin, void *pvSink)
+{
+    SHPJoinInfo join;
+    SHPEnvelope world;
+    double *padfXY;
+    int *panOrder, i, nShapeType;
+
+    SHPGetInfo(hPolygons, NULL, &nShapeType, NULL, NULL);
+    if (nPoints < 0 || !onJoin ||
+        (nShapeType != SHPT_POLYGON && nShapeType != SHPT_POLYGONZ && nShapeType != SHPT_POLYGONM)) {
+        return (-1);
+    }
+
+    memset(&join, 0, sizeof(join));
+    join.hPolygons = hPolygons;
+    join.hTree = SHPGetMBRTree(hPolygons);
+    join.nPolygons = (int) hPolygons->nRecords;
+    join.panIds = panIds;
+    join.nPoints = nPoints;
+    join.onJoin = onJoin;
+    join.pvSink = pvSink;
+
+    if (nThreads <= 0) {
+        nThreads = MAX_V2(getcpucount(), 1);
+    }
+
+    /* an empty tree finds nothing: pack one over the layer */
+    world.XMin = world.YMin = -DBL_MAX;
+    world.XMax = world.YMax = DBL_MAX;
+    if (!join.hTree->rtRoot || SHPMBRTreeSearch(join.hTree, &world, SHPJoinOnFirst, NULL) == 0) {
+        if (SHPMBRTreeBulkLoad(hPolygons, SHP_MBRTREE_HILBERT) < 0) {
+            return (-1);
+        }
+    }
+
+    join.pahPrepared = (SHPPreparedPolygonHandle *) calloc(MAX_V2(join.nPolygons, 1), sizeof(SHPPreparedPolygonHandle));
+    padfXY = (double *) malloc(sizeof(double) * 2 * MAX_V2(nPoints, 1));
+    panOrder = padfXY ? SHPJoinHilbertOrder(padfX, padfY, nPoints, padfXY) : NULL;
+    if (!join.pahPrepared || !panOrder) {
+        free(join.pahPrepared);
+        free(padfXY);
+        return (-1);
+    }
+    join.padfXY = padfXY;
+    join.panOrder = panOrder;
+
+    SHPJoinMutexInit(&join.lock);
+    SHPJoinMutexInit(&join.sinkLock);
+
+    SHPJoinRun(&join, SHPJoinPrepareWork, nThreads);
+    SHPJoinRun(&join, SHPJoinPointWork, nThreads);
+
+    SHPJoinMutexFree(&join.lock);
+    SHPJoinMutexFree(&join.sinkLock);
+
+    for (i = 0; i < join.nPolygons; i++) {
+        SHPPreparedPolygonDestroy(join.pahPrepared[i]);
+    }
+    free(join.pahPrepared);
+    free(padfXY);
+    free(panOrder);
+
+    return join.bError ? (-1) : join.nJoined;
+}
+
+
+int SHPSpatialJoinXYs(SHPHandle hPolygons, const double *padfX, const double *padfY, int nPoints,
+    int nThreads, SHPJoinSink onJoin, void *pvSink)
+{
+    return SHPSpatialJoinIds(hPolygons, padfX, padfY, NULL, nPoints, nThreads, onJoin, pvSink);
+}
+
+
+int SHPSpatialJoinLayer(SHPHandle hPolygons, SHPHandle hPoints,
+    int nThreads, SHPJoinSink onJoin, void *pvSink)
+{
+    SHPEnvelope *pEnvs;
+    double *padfX, *padfY;
+    int *panIds;
+    int i, nShapes, nShapeType, nPoints = 0, nJoined;
+
+    SHPGetInfo(hPoints, &nShapes, &nShapeType, NULL, NULL);
+    if (nShapeType != SHPT_POINT && nShapeType != SHPT_POINTZ && nShapeType != SHPT_POINTM) {
+        return (-1);
+    }
+
+    pEnvs = (SHPEnvelope *) malloc(sizeof(SHPEnvelope) * MAX_V2(nShapes, 1));
+    padfX = (double *) malloc(sizeof(double) * MAX_V2(nShapes, 1));
+    padfY = (double *) malloc(sizeof(double) * MAX_V2(nShapes, 1));
+    panIds = (int *) malloc(sizeof(int) * MAX_V2(nShapes, 1));
+
+    if (!pEnvs || !padfX || !padfY || !panIds || SHPReadEnvelopes(hPoints, 0, nShapes, pEnvs) < 0) {
+        nJoined = -1;
+    } else {
+        /* the envelope of a point is the point, inverted for null */
+        for (i = 0; i < nShapes; i++) {
+            if (pEnvs[i].XMin <= pEnvs[i].XMax) {
+                padfX[nPoints] = pEnvs[i].XMin;
+                padfY[nPoints] = pEnvs[i].YMin;
+                panIds[nPoints++] = i;
+            }
+        }
+        nJoined = SHPSpatialJoinIds(hPolygons, padfX, padfY, panIds, nPoints, nThreads, onJoin, pvSink);
+    }
+
+    free(pEnvs);
+    free(padfX);
+    free(padfY);
+    free(panIds);
+    return nJoined;
+}
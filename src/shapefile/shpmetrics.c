@@ -0,0 +1,210 @@
+/******************************************************************************
+ * shpmetrics.c
+ *
+ * v 1.0 2026/10/18
+ *
+ * Project:  Shapelib
+ * Purpose:  Area, length, counts and envelopes of a range of shapes.
+ * Author:   cheungmine@gmail.com
+ *
+ * Copyright (c) 2026, cheungmine
+ *
+ * This software is available under the following "MIT Style" license,
+ * or at the option of the licensee under the LGPL (see LICENSE.LGPL).  This
+ * option is discussed in more detail in shapelib.html.
+ *
+ * --
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+ * Measures of a range of shapes straight from the record bytes. Each
+ * record is seen through SHPReadObjectViewR() into a read buffer of the
+ * call, so calls on one handle do not share any state. x, y are used in
+ * place when the view has them aligned and little-endian and decoded
+ * into scratch otherwise; part starts are always decoded, as they are
+ * checked against the vertex count before any kernel walks them.
+ */
+
+#include "shapefile_i.h"
+
+
+typedef struct
+{
+    SHPReadBuffer  sReadBuf;
+
+    SHPPointType  *pPoints;     /* x, y of views without pPoints */
+    int            nPointsSize;
+
+    int           *panPartStart;
+    int            nPartsSize;
+} SHPMetricsScratch;
+
+
+/**
+ * decode the part starts of psView into psScratch.
+ *   SHAPEFILE_FALSE if they go back or past the last vertex, -1 out of
+ *   memory.
+ */
+static int SHPMetricsPartStarts(const SHPObjectView *psView, SHPMetricsScratch *psScratch)
+{
+    int i, nStart, nPrev = 0;
+
+    if (psView->nParts > psScratch->nPartsSize) {
+        int *panPartStart = (int *) realloc(psScratch->panPartStart, sizeof(int) * (size_t) psView->nParts);
+        if (!panPartStart) {
+            return (-1);
+        }
+        psScratch->panPartStart = panPartStart;
+        psScratch->nPartsSize = psView->nParts;
+    }
+
+    for (i = 0; i < psView->nParts; i++) {
+        nStart = SHPObjectViewGetPartStart(psView, i);
+        if (nStart < nPrev || nStart > psView->nVertices) {
+            return SHAPEFILE_FALSE;
+        }
+        psScratch->panPartStart[i] = nPrev = nStart;
+    }
+    return SHAPEFILE_TRUE;
+}
+
+
+/**
+ * psView as an interleaved SHPCoordSeq, after SHPMetricsPartStarts().
+ *   SHAPEFILE_FALSE out of memory.
+ */
+static int SHPMetricsCoordSeq(const SHPObjectView *psView, SHPMetricsScratch *psScratch, SHPCoordSeq *psSeq)
+{
+    const SHPPointType *pPoints = psView->pPoints;
+    int i;
+
+    if (!pPoints) {
+        if (psView->nVertices > psScratch->nPointsSize) {
+            SHPPointType *pScratch = (SHPPointType *) realloc(psScratch->pPoints, sizeof(SHPPointType) * (size_t) psView->nVertices);
+            if (!pScratch) {
+                return SHAPEFILE_FALSE;
+            }
+            psScratch->pPoints = pScratch;
+            psScratch->nPointsSize = psView->nVertices;
+        }
+        for (i = 0; i < psView->nVertices; i++) {
+            SHPObjectViewGetPoint(psView, i, &psScratch->pPoints[i]);
+        }
+        pPoints = psScratch->pPoints;
+    }
+
+    memset(psSeq, 0, sizeof(*psSeq));
+    psSeq->nSHPType = psView->nSHPType;
+    psSeq->nParts = psView->nParts;
+    psSeq->panPartStart = psScratch->panPartStart;
+    psSeq->nVertices = psView->nVertices;
+    psSeq->padfX = (double *) &pPoints->x;
+    psSeq->padfY = (double *) &pPoints->y;
+    psSeq->nStride = SHPCOORDS_AOS;
+    return SHAPEFILE_TRUE;
+}
+
+
+int SHPComputeLayerMetrics(SHPHandle psSHP, int iFirst, int nCount, int nFlags, SHPLayerMetrics *psOut)
+{
+    SHPMetricsScratch scratch;
+    SHPObjectView view;
+    SHPCoordSeq seq;
+    int i, nValid = 0;
+
+    if (iFirst < 0 || nCount < 0 || (uint64_t) iFirst + nCount > (uint64_t) psSHP->nRecords) {
+        return (-1);
+    }
+
+    if (((nFlags & SHP_METRIC_AREA) && !psOut->padfArea) ||
+        ((nFlags & SHP_METRIC_LENGTH) && !psOut->padfLength) ||
+        ((nFlags & SHP_METRIC_VERTICES) && !psOut->panVertices) ||
+        ((nFlags & SHP_METRIC_PARTS) && !psOut->panParts) ||
+        ((nFlags & SHP_METRIC_ENVELOPE) && !psOut->pEnvelopes)) {
+        return (-1);
+    }
+
+    memset(&scratch, 0, sizeof(scratch));
+
+    for (i = 0; i < nCount; i++) {
+        double dfArea = 0, dfLength = 0;
+        int bValid;
+
+        bValid = SHPReadObjectViewR(psSHP, iFirst + i, &view, &scratch.sReadBuf);
+        if (bValid && view.nParts > 0) {
+            bValid = SHPMetricsPartStarts(&view, &scratch);
+            if (bValid < 0) {
+                nValid = -1;
+                break;
+            }
+        }
+
+        if (bValid) {
+            nValid++;
+
+            if ((nFlags & (SHP_METRIC_AREA | SHP_METRIC_LENGTH)) && view.nParts > 0) {
+                if (!SHPMetricsCoordSeq(&view, &scratch, &seq)) {
+                    nValid = -1;
+                    break;
+                }
+
+                if (nFlags & SHP_METRIC_AREA) {
+                    dfArea = SHPCoordSeqGetArea(&seq);
+                }
+                if (nFlags & SHP_METRIC_LENGTH) {
+                    dfLength = SHPCoordSeqGetLength(&seq);
+                }
+            }
+        }
+
+        if (nFlags & SHP_METRIC_AREA) {
+            psOut->padfArea[i] = dfArea;
+        }
+        if (nFlags & SHP_METRIC_LENGTH) {
+            psOut->padfLength[i] = dfLength;
+        }
+        if (nFlags & SHP_METRIC_VERTICES) {
+            psOut->panVertices[i] = bValid ? view.nVertices : 0;
+        }
+        if (nFlags & SHP_METRIC_PARTS) {
+            psOut->panParts[i] = bValid ? view.nParts : 0;
+        }
+        if (nFlags & SHP_METRIC_ENVELOPE) {
+            SHPEnvelope *env = &psOut->pEnvelopes[i];
+
+            if (bValid) {
+                env->XMin = view.bounds.XMin;
+                env->YMin = view.bounds.YMin;
+                env->XMax = view.bounds.XMax;
+                env->YMax = view.bounds.YMax;
+            } else {
+                env->XMin = env->YMin = DBL_MAX;
+                env->XMax = env->YMax = -DBL_MAX;
+            }
+        }
+    }
+
+    SHPReadBufferFree(&scratch.sReadBuf);
+    SafeFree(scratch.pPoints);
+    SafeFree(scratch.panPartStart);
+
+    return nValid;
+}
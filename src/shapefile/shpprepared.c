@@ -0,0 +1,289 @@
+/******************************************************************************
+ * shpprepared.c
+ *
+ * v 1.0 2026/10/18
+ *
+ * Project:  Shapelib
+ * Purpose:  Prepared polygons for fast point in polygon tests.
+ * Author:   cheungmine@gmail.com
+ *
+ * Copyright (c) 2026, cheungmine
+ *
+ * This software is available under the following "MIT Style" license,
+ * or at the option of the licensee under the LGPL (see LICENSE.LGPL).  This
+ * option is discussed in more detail in shapelib.html.
+ *
+ * --
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+ * A prepared polygon cuts its y range into bands of equal height and
+ * lists in each band the ring edges whose y span overlaps it. A point
+ * is tested against the edges of its own band only, with the crossing
+ * rule of SHPCoordsRingContains(). Bands and edge lists are two flat
+ * arrays: band b owns pEdges[panBandStart[b] .. panBandStart[b + 1]).
+ * Horizontal edges never cross a ray and are left out.
+ */
+
+#include "shapefile_i.h"
+
+
+typedef struct
+{
+    double      xi, yi;
+    double      xj, yj;
+} SHPPreparedEdge;
+
+
+struct SHPPreparedPolygonInfo
+{
+    SHPEnvelope      env;
+
+    /* band of y is (y - dfBandY0) * dfBandScale, clamped */
+    double           dfBandY0;
+    double           dfBandScale;
+    int              nBands;
+
+    int             *panBandStart;  /* [nBands + 1] */
+    SHPPreparedEdge *pEdges;
+};
+
+
+/* walk the edges (i, j) of all rings of psSeq, j before i. no parts
+ *  is one ring of all vertices, as for SHPCreateSimpleObject() */
+#define SHPPREPARED_FOR_EDGES(psSeq, iPart, start, end, i, j) \
+    for (iPart = 0; iPart < MAX_V2((psSeq)->nParts, 1); iPart++) \
+        if (SHPCoordsPartRange((psSeq), iPart, &start, &end), start >= 0 && end <= (psSeq)->nVertices) \
+            for (i = start, j = end - 1; i < end; j = i++)
+
+
+STATIC_INLINE int SHPPreparedBand (const struct SHPPreparedPolygonInfo *psPrepared, double y)
+{
+    double b = (y - psPrepared->dfBandY0) * psPrepared->dfBandScale;
+
+    /* NaN to band 0: (int) of it is undefined */
+    if (!(b > 0)) {
+        return 0;
+    }
+    if (b >= psPrepared->nBands - 1) {
+        return psPrepared->nBands - 1;
+    }
+    return (int) b;
+}
+
+
+STATIC_INLINE int SHPPreparedContains (const struct SHPPreparedPolygonInfo *psPrepared, double x, double y)
+{
+    const SHPPreparedEdge *e, *eEnd;
+    int b, bInside = SHAPEFILE_FALSE;
+
+    /* also rejects NaN */
+    if (!(x >= psPrepared->env.XMin && x <= psPrepared->env.XMax &&
+          y >= psPrepared->env.YMin && y <= psPrepared->env.YMax)) {
+        return SHAPEFILE_FALSE;
+    }
+
+    b = SHPPreparedBand(psPrepared, y);
+    e = psPrepared->pEdges + psPrepared->panBandStart[b];
+    eEnd = psPrepared->pEdges + psPrepared->panBandStart[b + 1];
+
+    for (; e < eEnd; e++) {
+        if (((e->yj < y && e->yi >= y) || (e->yi < y && e->yj >= y)) && e->xj + (y - e->yj) / (e->yi - e->yj) * (e->xi - e->xj) < x) {
+            bInside = !bInside;
+        }
+    }
+    return bInside;
+}
+
+
+static SHPPreparedPolygonHandle SHPPrepareCoordSeq(const SHPCoordSeq *psSeq)
+{
+    SHPPreparedPolygonHandle psPrepared;
+    double adfMin[2], adfMax[2];
+    int *panFill;
+    int64_t nEntries = 0;
+    int iPart, start, end, i, j, b, nEdges = 0, bFinite = SHAPEFILE_TRUE;
+
+    if (psSeq->nSHPType != SHPT_POLYGON &&
+        psSeq->nSHPType != SHPT_POLYGONZ &&
+        psSeq->nSHPType != SHPT_POLYGONM) {
+        return NULL;
+    }
+
+    if (psSeq->nVertices < 3 || !psSeq->padfX) {
+        return NULL;
+    }
+
+    psPrepared = (SHPPreparedPolygonHandle) calloc(1, sizeof(struct SHPPreparedPolygonInfo));
+    if (!psPrepared) {
+        return NULL;
+    }
+
+    SHPSimdBoundsOf(psSeq, 0, psSeq->nVertices, adfMin, adfMax);
+    psPrepared->env.XMin = adfMin[0];
+    psPrepared->env.YMin = adfMin[1];
+    psPrepared->env.XMax = adfMax[0];
+    psPrepared->env.YMax = adfMax[1];
+
+    SHPPREPARED_FOR_EDGES(psSeq, iPart, start, end, i, j) {
+        if (SHPCoordY(psSeq, psSeq->nStride, i) != SHPCoordY(psSeq, psSeq->nStride, j)) {
+            nEdges++;
+        }
+        bFinite &= isfinite(SHPCoordX(psSeq, psSeq->nStride, i)) && isfinite(SHPCoordY(psSeq, psSeq->nStride, i));
+    }
+
+    /* bands and crossings need finite coordinates */
+    if (!bFinite || !isfinite(adfMin[0]) || !isfinite(adfMin[1]) || !isfinite(adfMax[0]) || !isfinite(adfMax[1])) {
+        SHPPreparedPolygonDestroy(psPrepared);
+        return NULL;
+    }
+
+    psPrepared->nBands = MAX_V2(1, MIN_V2(nEdges / SHP_PREPARED_BAND_EDGES, SHP_PREPARED_MAX_BANDS));
+    psPrepared->dfBandY0 = psPrepared->env.YMin;
+    if (psPrepared->env.YMax > psPrepared->env.YMin) {
+        psPrepared->dfBandScale = psPrepared->nBands / (psPrepared->env.YMax - psPrepared->env.YMin);
+    }
+
+    psPrepared->panBandStart = (int *) calloc(psPrepared->nBands + 1, sizeof(int));
+    panFill = (int *) malloc(sizeof(int) * psPrepared->nBands);
+    if (!psPrepared->panBandStart || !panFill) {
+        free(panFill);
+        SHPPreparedPolygonDestroy(psPrepared);
+        return NULL;
+    }
+
+    /* count edges per band into panBandStart[b + 1] */
+    SHPPREPARED_FOR_EDGES(psSeq, iPart, start, end, i, j) {
+        double yi = SHPCoordY(psSeq, psSeq->nStride, i), yj = SHPCoordY(psSeq, psSeq->nStride, j);
+
+        if (yi != yj) {
+            int b0 = SHPPreparedBand(psPrepared, MIN_V2(yi, yj));
+            int b1 = SHPPreparedBand(psPrepared, MAX_V2(yi, yj));
+
+            for (b = b0; b <= b1; b++) {
+                psPrepared->panBandStart[b + 1]++;
+            }
+            nEntries += b1 - b0 + 1;
+        }
+    }
+
+    if (nEntries > INT_MAX) {
+        free(panFill);
+        SHPPreparedPolygonDestroy(psPrepared);
+        return NULL;
+    }
+
+    for (b = 0; b < psPrepared->nBands; b++) {
+        psPrepared->panBandStart[b + 1] += psPrepared->panBandStart[b];
+        panFill[b] = psPrepared->panBandStart[b];
+    }
+
+    psPrepared->pEdges = (SHPPreparedEdge *) malloc(sizeof(SHPPreparedEdge) * (size_t) MAX_V2(nEntries, 1));
+    if (!psPrepared->pEdges) {
+        free(panFill);
+        SHPPreparedPolygonDestroy(psPrepared);
+        return NULL;
+    }
+
+    SHPPREPARED_FOR_EDGES(psSeq, iPart, start, end, i, j) {
+        SHPPreparedEdge edge;
+        int b1;
+
+        edge.xi = SHPCoordX(psSeq, psSeq->nStride, i);
+        edge.yi = SHPCoordY(psSeq, psSeq->nStride, i);
+        edge.xj = SHPCoordX(psSeq, psSeq->nStride, j);
+        edge.yj = SHPCoordY(psSeq, psSeq->nStride, j);
+
+        if (edge.yi != edge.yj) {
+            b1 = SHPPreparedBand(psPrepared, MAX_V2(edge.yi, edge.yj));
+            for (b = SHPPreparedBand(psPrepared, MIN_V2(edge.yi, edge.yj)); b <= b1; b++) {
+                psPrepared->pEdges[panFill[b]++] = edge;
+            }
+        }
+    }
+
+    free(panFill);
+    return psPrepared;
+}
+
+
+SHPPreparedPolygonHandle SHPPreparePolygon(const SHPObject *psObject)
+{
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObject(&seq, psObject);
+    return SHPPrepareCoordSeq(&seq);
+}
+
+
+SHPPreparedPolygonHandle SHPPreparePolygonEx(const SHPObjectEx *psObject)
+{
+    SHPCoordSeq seq;
+    SHPCoordSeqOfObjectEx(&seq, psObject);
+    return SHPPrepareCoordSeq(&seq);
+}
+
+
+void SHPPreparedPolygonDestroy(SHPPreparedPolygonHandle hPrepared)
+{
+    if (hPrepared) {
+        SafeFree(hPrepared->panBandStart);
+        SafeFree(hPrepared->pEdges);
+        free(hPrepared);
+    }
+}
+
+
+void SHPPreparedPolygonGetEnvelope(SHPPreparedPolygonHandle hPrepared, SHPEnvelope *env)
+{
+    *env = hPrepared->env;
+}
+
+
+int SHPPreparedPolygonContains(SHPPreparedPolygonHandle hPrepared, double x, double y)
+{
+    return SHPPreparedContains(hPrepared, x, y);
+}
+
+
+int SHPPreparedPolygonClassifyXYs(SHPPreparedPolygonHandle hPrepared,
+    const double *padfX, const double *padfY, int nPoints, unsigned char *pabyInside)
+{
+    int i, nInside = 0;
+
+    for (i = 0; i < nPoints; i++) {
+        pabyInside[i] = (unsigned char) SHPPreparedContains(hPrepared, padfX[i], padfY[i]);
+        nInside += pabyInside[i];
+    }
+    return nInside;
+}
+
+
+int SHPPreparedPolygonClassifyPoints(SHPPreparedPolygonHandle hPrepared,
+    const SHPPointType *pPoints, int nPoints, unsigned char *pabyInside)
+{
+    int i, nInside = 0;
+
+    for (i = 0; i < nPoints; i++) {
+        pabyInside[i] = (unsigned char) SHPPreparedContains(hPrepared, pPoints[i].x, pPoints[i].y);
+        nInside += pabyInside[i];
+    }
+    return nInside;
+}
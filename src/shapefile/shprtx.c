@@ -0,0 +1,475 @@
+/******************************************************************************
+ * shprtx.c
+ *
+ * v 1.0 2025/12/20
+ *
+ * Project:  Shapelib
+ * Purpose:  Packed rtree index file (.rtx) stored beside the shapefile
+ * Author:   cheungmine@gmail.com
+ *
+ * Copyright (c) 2025, cheungmine
+ *
+ * This software is available under the following "MIT Style" license,
+ * or at the option of the licensee under the LGPL (see LICENSE.LGPL).  This
+ * option is discussed in more detail in shapelib.html.
+ *
+ * --
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+ * .rtx file layout, all values little-endian:
+ *
+ *   header (80 bytes)
+ *     0   char[8]   magic "SHPRTX\r\n"
+ *     8   uint32    version
+ *    12   uint32    flags (0)
+ *    16   uint32    node count
+ *    20   uint32    entry count
+ *    24   uint32    height (root level + 1)
+ *    28   uint32    shape count of the layer when written
+ *    32   uint64    offset of node table
+ *    40   uint64    offset of entry table
+ *    48   double[4] bounds: xmin, ymin, xmax, ymax
+ *
+ *   node table, breadth first from the root (16 bytes per node)
+ *     uint32 first entry, uint32 entry count, uint32 level, uint32 reserved
+ *
+ *   entry table (40 bytes per entry)
+ *     double[4] mbr, uint32 child, uint32 reserved
+ *     child is a shape id on leaves (level 0), else a node index.
+ */
+#include "shapefile_i.h"
+
+#define SHPRTX_MAGIC        "SHPRTX\r\n"
+#define SHPRTX_VERSION      1
+
+#define SHPRTX_HEADER_SIZE  80
+#define SHPRTX_NODE_SIZE    16
+#define SHPRTX_ENTRY_SIZE   40
+
+
+typedef struct _SHPRTreeFile
+{
+    FILE        *fp;
+
+    ub1         *pabyData;      /* whole file */
+    size_t      nDataSize;
+    int         bMapped;
+
+    uint32_t    nNodes;
+    uint32_t    nEntries;
+    uint32_t    nHeight;
+    uint32_t    nShapes;
+
+    const ub1   *pabyNodes;
+    const ub1   *pabyEntries;
+
+    double      adfBounds[4];
+} SHPRTreeFileInfo;
+
+
+typedef struct
+{
+    ub1         *pabyNodes;
+    uint32_t    nNodes;
+    uint32_t    nNodesSize;
+
+    ub1         *pabyEntries;
+    uint32_t    nEntries;
+    uint32_t    nEntriesSize;
+
+    uint32_t    nHeight;
+} SHPRtxWriter;
+
+
+static void SHPRtxPut32(ub1 *p, uint32_t v)
+{
+    BO_htole32_buf(&v);
+    memcpy(p, &v, 4);
+}
+
+static void SHPRtxPut64(ub1 *p, uint64_t v)
+{
+    BO_htole64_buf(&v);
+    memcpy(p, &v, 8);
+}
+
+static void SHPRtxPutDouble(ub1 *p, double v)
+{
+    BO_htole64_buf(&v);
+    memcpy(p, &v, 8);
+}
+
+static uint32_t SHPRtxGet32(const ub1 *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    BO_letoh32_buf(&v);
+    return v;
+}
+
+static uint64_t SHPRtxGet64(const ub1 *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    BO_letoh64_buf(&v);
+    return v;
+}
+
+static double SHPRtxGetDouble(const ub1 *p)
+{
+    double v;
+    memcpy(&v, p, 8);
+    BO_letoh64_buf(&v);
+    return v;
+}
+
+
+/**
+ * Return "<layer basename>.rtx", free with free()
+ */
+static char * SHPRtxFilename(const char *pszLayer)
+{
+    int i;
+    char *pszFullname = (char *) malloc(strlen(pszLayer) + 5);
+    if (!pszFullname) {
+        return NULL;
+    }
+
+    strcpy(pszFullname, pszLayer);
+    for (i = (int) strlen(pszFullname)-1; i > 0 &&
+        pszFullname[i] != '.' && pszFullname[i] != '/' &&
+        pszFullname[i] != '\\'; i--) {
+        /* do nothing */
+    }
+
+    if (pszFullname[i] == '.') {
+        pszFullname[i] = '\0';
+    }
+
+    strcat(pszFullname, ".rtx");
+    return pszFullname;
+}
+
+
+/**
+ * RTreeFlatten callback: append one node and its entries
+ */
+static int SHPRtxWriteNode(void *arg, int level, int count, const RTREE_BRANCH *branches, int firstChild)
+{
+    int i;
+    ub1 *p;
+    SHPRtxWriter *w = (SHPRtxWriter *) arg;
+
+    if (w->nNodes == w->nNodesSize) {
+        w->nNodesSize = w->nNodesSize * 2 + 64;
+        w->pabyNodes = (ub1 *) SfRealloc(w->pabyNodes, w->nNodesSize * SHPRTX_NODE_SIZE);
+    }
+
+    if (w->nEntries + count > w->nEntriesSize) {
+        w->nEntriesSize = (w->nEntries + count) * 2;
+        w->pabyEntries = (ub1 *) SfRealloc(w->pabyEntries, w->nEntriesSize * SHPRTX_ENTRY_SIZE);
+    }
+
+    p = w->pabyNodes + (size_t) w->nNodes * SHPRTX_NODE_SIZE;
+    SHPRtxPut32(p, w->nEntries);
+    SHPRtxPut32(p + 4, (uint32_t) count);
+    SHPRtxPut32(p + 8, (uint32_t) level);
+    SHPRtxPut32(p + 12, 0);
+
+    for (i = 0; i < count; i++) {
+        uint32_t child = (level > 0) ? (uint32_t) (firstChild + i) : (uint32_t) SHPMBRTreeDataToShapeId(branches[i].child);
+
+        p = w->pabyEntries + (size_t) (w->nEntries + i) * SHPRTX_ENTRY_SIZE;
+        SHPRtxPutDouble(p, branches[i].mbr.bound[0]);
+        SHPRtxPutDouble(p + 8, branches[i].mbr.bound[1]);
+        SHPRtxPutDouble(p + 16, branches[i].mbr.bound[2]);
+        SHPRtxPutDouble(p + 24, branches[i].mbr.bound[3]);
+        SHPRtxPut32(p + 32, child);
+        SHPRtxPut32(p + 36, 0);
+    }
+
+    if (w->nNodes == 0) {
+        w->nHeight = (uint32_t) level + 1;
+    }
+
+    w->nNodes++;
+    w->nEntries += count;
+    return 1;
+}
+
+
+/**
+ * Build a packed rtree over the layer and write it to "<layer>.rtx"
+ */
+int SHPWriteRTreeFile(SHPHandle hSHP, const char *pszLayer, int nMethod)
+{
+    int i, ret = SHAPEFILE_ERROR;
+    char *pszFullname;
+    FILE *fp;
+    ub1 abyHeader[SHPRTX_HEADER_SIZE];
+    SHPEnvelope *shapeEnvs;
+    SHPInfoRTree tree;
+    SHPRtxWriter w;
+    uint64_t nNodeOffset, nEntryOffset;
+    double adfBounds[4] = {0, 0, 0, 0};
+
+    shapeEnvs = (SHPEnvelope *) malloc(sizeof(SHPEnvelope) * MAX_V2(1, hSHP->nRecords));
+    if (!shapeEnvs) {
+        exit(EXIT_OUTMEMORY);
+    }
+
+    if (SHPReadEnvelopes(hSHP, 0, (int) hSHP->nRecords, shapeEnvs) < 0) {
+        free(shapeEnvs);
+        return SHAPEFILE_ERROR;
+    }
+
+    tree.rtRoot = NULL;
+    SHPMBRTreeBulkLoadEnvelopes(&tree, shapeEnvs, NULL, (int) hSHP->nRecords, nMethod);
+    free(shapeEnvs);
+
+    memset(&w, 0, sizeof(w));
+    RTreeFlatten(tree.rtRoot, SHPRtxWriteNode, &w);
+    RTreeDestroy(tree.rtRoot);
+
+    /* bounds of the whole tree: cover of the root entries */
+    for (i = 0; i < (int) SHPRtxGet32(w.pabyNodes + 4); i++) {
+        const ub1 *p = w.pabyEntries + (size_t) i * SHPRTX_ENTRY_SIZE;
+        if (i == 0) {
+            adfBounds[0] = SHPRtxGetDouble(p);
+            adfBounds[1] = SHPRtxGetDouble(p + 8);
+            adfBounds[2] = SHPRtxGetDouble(p + 16);
+            adfBounds[3] = SHPRtxGetDouble(p + 24);
+        } else {
+            adfBounds[0] = MIN_V2(adfBounds[0], SHPRtxGetDouble(p));
+            adfBounds[1] = MIN_V2(adfBounds[1], SHPRtxGetDouble(p + 8));
+            adfBounds[2] = MAX_V2(adfBounds[2], SHPRtxGetDouble(p + 16));
+            adfBounds[3] = MAX_V2(adfBounds[3], SHPRtxGetDouble(p + 24));
+        }
+    }
+
+    nNodeOffset = SHPRTX_HEADER_SIZE;
+    nEntryOffset = nNodeOffset + (uint64_t) w.nNodes * SHPRTX_NODE_SIZE;
+
+    memset(abyHeader, 0, sizeof(abyHeader));
+    memcpy(abyHeader, SHPRTX_MAGIC, 8);
+    SHPRtxPut32(abyHeader + 8, SHPRTX_VERSION);
+    SHPRtxPut32(abyHeader + 12, 0);
+    SHPRtxPut32(abyHeader + 16, w.nNodes);
+    SHPRtxPut32(abyHeader + 20, w.nEntries);
+    SHPRtxPut32(abyHeader + 24, w.nHeight);
+    SHPRtxPut32(abyHeader + 28, hSHP->nRecords);
+    SHPRtxPut64(abyHeader + 32, nNodeOffset);
+    SHPRtxPut64(abyHeader + 40, nEntryOffset);
+    for (i = 0; i < 4; i++) {
+        SHPRtxPutDouble(abyHeader + 48 + 8 * i, adfBounds[i]);
+    }
+
+    pszFullname = SHPRtxFilename(pszLayer);
+    fp = pszFullname ? fopen(pszFullname, "wb") : NULL;
+    SafeFree(pszFullname);
+
+    if (fp) {
+        if (fwrite(abyHeader, SHPRTX_HEADER_SIZE, 1, fp) == 1 &&
+            fwrite(w.pabyNodes, SHPRTX_NODE_SIZE, w.nNodes, fp) == w.nNodes &&
+            fwrite(w.pabyEntries, SHPRTX_ENTRY_SIZE, w.nEntries, fp) == w.nEntries) {
+            ret = SHAPEFILE_SUCCESS;
+        }
+        if (fclose(fp) != 0) {
+            ret = SHAPEFILE_ERROR;
+        }
+    }
+
+    SafeFree(w.pabyNodes);
+    SafeFree(w.pabyEntries);
+    return ret;
+}
+
+
+/**
+ * Open "<layer>.rtx" by mapping it. Nothing is decoded but the header.
+ */
+SHPRTreeFile SHPOpenRTreeFile(const char *pszLayer, SHPHandle hSHP)
+{
+    char *pszFullname;
+    SHPRTreeFile psTree;
+    uint64_t nNodeOffset, nEntryOffset;
+    int i;
+
+    psTree = (SHPRTreeFile) calloc(1, sizeof(SHPRTreeFileInfo));
+    if (!psTree) {
+        return NULL;
+    }
+
+    pszFullname = SHPRtxFilename(pszLayer);
+    if (!pszFullname) {
+        free(psTree);
+        return NULL;
+    }
+
+    psTree->fp = fopen(pszFullname, "rb");
+    if (!psTree->fp) {
+        /* files pulled from a PC may have upper case extension */
+        strcpy(pszFullname + strlen(pszFullname) - 4, ".RTX");
+        psTree->fp = fopen(pszFullname, "rb");
+    }
+    SafeFree(pszFullname);
+
+    if (!psTree->fp) {
+        SafeFree(psTree);
+        return NULL;
+    }
+
+    psTree->pabyData = (ub1 *) SfMapFile(psTree->fp, &psTree->nDataSize, SHP_MAP_RANDOM);
+    if (psTree->pabyData) {
+        psTree->bMapped = SHAPEFILE_TRUE;
+    } else {
+        /* no mapping support here: load it whole */
+        fseek(psTree->fp, 0, SEEK_END);
+        psTree->nDataSize = (size_t) ftell(psTree->fp);
+        fseek(psTree->fp, 0, SEEK_SET);
+
+        if (psTree->nDataSize >= SHPRTX_HEADER_SIZE && psTree->nDataSize <= (size_t) INT_MAX) {
+            psTree->pabyData = (ub1 *) SfRealloc(NULL, (int) psTree->nDataSize);
+            if (psTree->pabyData && fread(psTree->pabyData, psTree->nDataSize, 1, psTree->fp) != 1) {
+                SafeFree(psTree->pabyData);
+            }
+        }
+    }
+
+    if (!psTree->pabyData || psTree->nDataSize < SHPRTX_HEADER_SIZE ||
+        memcmp(psTree->pabyData, SHPRTX_MAGIC, 8) != 0 ||
+        SHPRtxGet32(psTree->pabyData + 8) != SHPRTX_VERSION) {
+        SHPCloseRTreeFile(psTree);
+        return NULL;
+    }
+
+    psTree->nNodes = SHPRtxGet32(psTree->pabyData + 16);
+    psTree->nEntries = SHPRtxGet32(psTree->pabyData + 20);
+    psTree->nHeight = SHPRtxGet32(psTree->pabyData + 24);
+    psTree->nShapes = SHPRtxGet32(psTree->pabyData + 28);
+    nNodeOffset = SHPRtxGet64(psTree->pabyData + 32);
+    nEntryOffset = SHPRtxGet64(psTree->pabyData + 40);
+
+    for (i = 0; i < 4; i++) {
+        psTree->adfBounds[i] = SHPRtxGetDouble(psTree->pabyData + 48 + 8 * i);
+    }
+
+    if (psTree->nNodes == 0 ||
+        nNodeOffset + (uint64_t) psTree->nNodes * SHPRTX_NODE_SIZE > psTree->nDataSize ||
+        nEntryOffset + (uint64_t) psTree->nEntries * SHPRTX_ENTRY_SIZE > psTree->nDataSize ||
+        (hSHP && psTree->nShapes != hSHP->nRecords)) {
+        /* truncated, or stale against the layer */
+        SHPCloseRTreeFile(psTree);
+        return NULL;
+    }
+
+    psTree->pabyNodes = psTree->pabyData + nNodeOffset;
+    psTree->pabyEntries = psTree->pabyData + nEntryOffset;
+
+    return psTree;
+}
+
+
+void SHPCloseRTreeFile(SHPRTreeFile psTree)
+{
+    if (psTree) {
+        if (psTree->bMapped) {
+            SfUnmapFile(psTree->pabyData, psTree->nDataSize);
+        } else {
+            SafeFree(psTree->pabyData);
+        }
+        if (psTree->fp) {
+            fclose(psTree->fp);
+        }
+        free(psTree);
+    }
+}
+
+
+void SHPRTreeFileGetInfo(SHPRTreeFile psTree, int *pnShapes, int *pnNodes, int *pnHeight, SHPEnvelope *bounds)
+{
+    if (pnShapes) {
+        *pnShapes = (int) psTree->nShapes;
+    }
+    if (pnNodes) {
+        *pnNodes = (int) psTree->nNodes;
+    }
+    if (pnHeight) {
+        *pnHeight = (int) psTree->nHeight;
+    }
+    if (bounds) {
+        bounds->XMin = psTree->adfBounds[0];
+        bounds->YMin = psTree->adfBounds[1];
+        bounds->XMax = psTree->adfBounds[2];
+        bounds->YMax = psTree->adfBounds[3];
+    }
+}
+
+
+static int SHPRtxSearchNode(SHPRTreeFile psTree, uint32_t iNode, const SHPEnvelope *env,
+    int(* onSearchShape)(void *, void *), void *userParam, int *pbStop)
+{
+    int hitCount = 0;
+    uint32_t i, nFirst, nCount, nLevel;
+    const ub1 *pNode = psTree->pabyNodes + (size_t) iNode * SHPRTX_NODE_SIZE;
+
+    nFirst = SHPRtxGet32(pNode);
+    nCount = SHPRtxGet32(pNode + 4);
+    nLevel = SHPRtxGet32(pNode + 8);
+
+    if ((uint64_t) nFirst + nCount > psTree->nEntries) {
+        return 0;
+    }
+
+    for (i = 0; i < nCount && !*pbStop; i++) {
+        const ub1 *p = psTree->pabyEntries + (size_t) (nFirst + i) * SHPRTX_ENTRY_SIZE;
+        uint32_t child;
+
+        if (SHPRtxGetDouble(p) > env->XMax || SHPRtxGetDouble(p + 8) > env->YMax ||
+            SHPRtxGetDouble(p + 16) < env->XMin || SHPRtxGetDouble(p + 24) < env->YMin) {
+            continue;
+        }
+
+        child = SHPRtxGet32(p + 32);
+
+        if (nLevel > 0) {
+            /* children are always stored after their parent */
+            if (child > iNode && child < psTree->nNodes) {
+                hitCount += SHPRtxSearchNode(psTree, child, env, onSearchShape, userParam, pbStop);
+            }
+        } else {
+            hitCount++;
+            if (onSearchShape && ! onSearchShape(SHPMBRTreeShapeIdToData(child), userParam)) {
+                *pbStop = SHAPEFILE_TRUE;
+            }
+        }
+    }
+
+    return hitCount;
+}
+
+
+int SHPRTreeFileSearch(SHPRTreeFile psTree, const SHPEnvelope *searchEnv, int(* onSearchShape)(void * shapeData,  void *userParam), void *userParam)
+{
+    int bStop = SHAPEFILE_FALSE;
+    return SHPRtxSearchNode(psTree, 0, searchEnv, onSearchShape, userParam, &bStop);
+}
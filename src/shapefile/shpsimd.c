@@ -0,0 +1,617 @@
+/******************************************************************************
+ * shpsimd.c
+ *
+ * v 1.0 2026/10/18
+ *
+ * Project:  Shapelib
+ * Purpose:  SIMD kernels of length, area and bounds with runtime dispatch.
+ * Author:   cheungmine@gmail.com
+ *
+ * Copyright (c) 2026, cheungmine
+ *
+ * This software is available under the following "MIT Style" license,
+ * or at the option of the licensee under the LGPL (see LICENSE.LGPL).  This
+ * option is discussed in more detail in shapelib.html.
+ *
+ * --
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+ * Length, area and bounds kernels over an SHPCoordSeq of either layout.
+ *
+ *   scalar   the loops of shpcoords.h, everywhere.
+ *   vec2     two doubles per vector: SSE2 on x86-64, NEON on aarch64.
+ *            both are baseline there and need no check.
+ *   avx2     four doubles per vector, x86-64 built with gcc, clang or
+ *            msvc. compiled for avx2 whatever the build flags are, and
+ *            used only if the CPU and OS support it.
+ *
+ * Sums keep the lane order of shpcoords.h and use no fused multiply-add,
+ * so every path gives the bits of the scalar one. Bounds agree as long as
+ * no coordinate is NaN. Compilers that fuse a*b+c in plain C by default
+ * (gcc on aarch64) may differ in the last bit between scalar and NEON.
+ *
+ * Define SHP_NO_SIMD to build the scalar kernels only.
+ */
+
+#include "shapefile_i.h"
+
+#if !defined(SHP_NO_SIMD)
+# if defined(__x86_64__) || defined(_M_X64)
+#   include <emmintrin.h>
+#   define SHP_SIMD_SSE2  1
+#   if defined(__GNUC__) || defined(_MSC_VER)
+#     include <immintrin.h>
+#     define SHP_SIMD_AVX2  1
+#   endif
+# elif defined(__aarch64__) || defined(_M_ARM64)
+#   include <arm_neon.h>
+#   define SHP_SIMD_NEON  1
+# endif
+#endif
+
+#if defined(SHP_SIMD_AVX2) && defined(_MSC_VER)
+# include <intrin.h>
+#endif
+
+
+typedef struct
+{
+    const char *pszName;
+
+    double (*pfnLengthOf) (const SHPCoordSeq *, int, int);
+    double (*pfnAreaOf) (const SHPCoordSeq *, int, int);
+    void (*pfnBoundsOf) (const SHPCoordSeq *, int, int, double *, double *);
+    void (*pfnRangeOf) (const double *, int, double *, double *);
+} SHPSimdKernels;
+
+
+/* -------------------------------------------------------------------- */
+/*      scalar                                                          */
+/* -------------------------------------------------------------------- */
+
+/* fold vertices [start, end) into bounds already holding some of them */
+STATIC_INLINE void SHPScalarBoundsSums (int nStride, const SHPCoordSeq *psSeq, int start, int end, double *padfMin, double *padfMax)
+{
+    int i;
+
+    for (i = start; i < end; i++) {
+        padfMin[0] = MIN_V2(padfMin[0], SHPCoordX(psSeq, nStride, i));
+        padfMin[1] = MIN_V2(padfMin[1], SHPCoordY(psSeq, nStride, i));
+        padfMax[0] = MAX_V2(padfMax[0], SHPCoordX(psSeq, nStride, i));
+        padfMax[1] = MAX_V2(padfMax[1], SHPCoordY(psSeq, nStride, i));
+    }
+}
+
+STATIC_INLINE void SHPScalarRangeSums (const double *padfV, int start, int end, double *pdfMin, double *pdfMax)
+{
+    int i;
+
+    for (i = start; i < end; i++) {
+        *pdfMin = MIN_V2(*pdfMin, padfV[i]);
+        *pdfMax = MAX_V2(*pdfMax, padfV[i]);
+    }
+}
+
+static double SHPScalarLengthOf(const SHPCoordSeq *psSeq, int start, int end)
+{
+    return SHPCOORDS_CALL(psSeq, SHPCoordsLengthOf, psSeq, start, end);
+}
+
+static double SHPScalarAreaOf(const SHPCoordSeq *psSeq, int start, int end)
+{
+    return SHPCOORDS_CALL(psSeq, SHPCoordsAreaOf, psSeq, start, end);
+}
+
+static void SHPScalarBoundsOf(const SHPCoordSeq *psSeq, int start, int end, double *padfMin, double *padfMax)
+{
+    padfMin[0] = padfMax[0] = psSeq->padfX[start * psSeq->nStride];
+    padfMin[1] = padfMax[1] = psSeq->padfY[start * psSeq->nStride];
+
+    SHPCOORDS_CALL(psSeq, SHPScalarBoundsSums, psSeq, start + 1, end, padfMin, padfMax);
+}
+
+static void SHPScalarRangeOf(const double *padfV, int nCount, double *pdfMin, double *pdfMax)
+{
+    *pdfMin = *pdfMax = padfV[0];
+
+    SHPScalarRangeSums(padfV, 1, nCount, pdfMin, pdfMax);
+}
+
+static const SHPSimdKernels SHPScalarKernels = {
+    "scalar",
+    SHPScalarLengthOf,
+    SHPScalarAreaOf,
+    SHPScalarBoundsOf,
+    SHPScalarRangeOf
+};
+
+
+/* -------------------------------------------------------------------- */
+/*      vec2: SSE2 or NEON, written once over these few operations      */
+/* -------------------------------------------------------------------- */
+#if defined(SHP_SIMD_SSE2) || defined(SHP_SIMD_NEON)
+
+#if defined(SHP_SIMD_SSE2)
+typedef __m128d SHPVec2;
+# define SHPVec2Load(p)       _mm_loadu_pd(p)
+# define SHPVec2Store(p, a)   _mm_storeu_pd((p), (a))
+# define SHPVec2Set1(v)       _mm_set1_pd(v)
+# define SHPVec2ZipLo(a, b)   _mm_unpacklo_pd((a), (b))
+# define SHPVec2ZipHi(a, b)   _mm_unpackhi_pd((a), (b))
+# define SHPVec2Add(a, b)     _mm_add_pd((a), (b))
+# define SHPVec2Sub(a, b)     _mm_sub_pd((a), (b))
+# define SHPVec2Mul(a, b)     _mm_mul_pd((a), (b))
+# define SHPVec2Sqrt(a)       _mm_sqrt_pd(a)
+# define SHPVec2Min(a, b)     _mm_min_pd((a), (b))
+# define SHPVec2Max(a, b)     _mm_max_pd((a), (b))
+# define SHPVEC2_NAME         "sse2"
+#else
+typedef float64x2_t SHPVec2;
+# define SHPVec2Load(p)       vld1q_f64(p)
+# define SHPVec2Store(p, a)   vst1q_f64((p), (a))
+# define SHPVec2Set1(v)       vdupq_n_f64(v)
+# define SHPVec2ZipLo(a, b)   vzip1q_f64((a), (b))
+# define SHPVec2ZipHi(a, b)   vzip2q_f64((a), (b))
+# define SHPVec2Add(a, b)     vaddq_f64((a), (b))
+# define SHPVec2Sub(a, b)     vsubq_f64((a), (b))
+# define SHPVec2Mul(a, b)     vmulq_f64((a), (b))
+# define SHPVec2Sqrt(a)       vsqrtq_f64(a)
+# define SHPVec2Min(a, b)     vminq_f64((a), (b))
+# define SHPVec2Max(a, b)     vmaxq_f64((a), (b))
+# define SHPVEC2_NAME         "neon"
+#endif
+
+/* x, y of vertices i, i + 1 */
+STATIC_INLINE void SHPVec2LoadXY (int nStride, const SHPCoordSeq *psSeq, int i, SHPVec2 *x, SHPVec2 *y)
+{
+    if (nStride == SHPCOORDS_SOA) {
+        *x = SHPVec2Load(psSeq->padfX + i);
+        *y = SHPVec2Load(psSeq->padfY + i);
+    } else {
+        SHPVec2 a = SHPVec2Load(psSeq->padfX + i * nStride);
+        SHPVec2 b = SHPVec2Load(psSeq->padfX + (i + 1) * nStride);
+        *x = SHPVec2ZipLo(a, b);
+        *y = SHPVec2ZipHi(a, b);
+    }
+}
+
+/* lengths of the segments from vertices i, i + 1 */
+STATIC_INLINE SHPVec2 SHPVec2Segments (int nStride, const SHPCoordSeq *psSeq, int i)
+{
+    SHPVec2 x0, y0, x1, y1, dx, dy;
+
+    SHPVec2LoadXY(nStride, psSeq, i, &x0, &y0);
+    SHPVec2LoadXY(nStride, psSeq, i + 1, &x1, &y1);
+
+    dx = SHPVec2Sub(x1, x0);
+    dy = SHPVec2Sub(y1, y0);
+    return SHPVec2Sqrt(SHPVec2Add(SHPVec2Mul(dx, dx), SHPVec2Mul(dy, dy)));
+}
+
+/* area terms of vertices i, i + 1 */
+STATIC_INLINE SHPVec2 SHPVec2AreaTerms (int nStride, const SHPCoordSeq *psSeq, int i, SHPVec2 x0)
+{
+    SHPVec2 xi, yi, yp, yn;
+
+    SHPVec2LoadXY(nStride, psSeq, i - 1, &xi, &yp);
+    SHPVec2LoadXY(nStride, psSeq, i + 1, &xi, &yn);
+    SHPVec2LoadXY(nStride, psSeq, i, &xi, &yi);
+
+    return SHPVec2Mul(SHPVec2Sub(xi, x0), SHPVec2Sub(yn, yp));
+}
+
+STATIC_INLINE double SHPVec2LengthKernel (int nStride, const SHPCoordSeq *psSeq, int start, int end)
+{
+    SHPVec2 s01 = SHPVec2Set1(0), s23 = SHPVec2Set1(0);
+    double s[SHPCOORDS_LANES];
+    int i;
+
+    for (i = start; i + SHPCOORDS_LANES < end; i += SHPCOORDS_LANES) {
+        s01 = SHPVec2Add(s01, SHPVec2Segments(nStride, psSeq, i));
+        s23 = SHPVec2Add(s23, SHPVec2Segments(nStride, psSeq, i + 2));
+    }
+    SHPVec2Store(s, s01);
+    SHPVec2Store(s + 2, s23);
+
+    SHPCoordsLengthSums(nStride, psSeq, i, end, s);
+    return SHPCoordsLanesSum(s);
+}
+
+STATIC_INLINE double SHPVec2AreaKernel (int nStride, const SHPCoordSeq *psSeq, int start, int end)
+{
+    SHPVec2 s01 = SHPVec2Set1(0), s23 = SHPVec2Set1(0), x0;
+    double s[SHPCOORDS_LANES];
+    int i;
+
+    if (end - start < 3) {
+        return 0;
+    }
+
+    x0 = SHPVec2Set1(SHPCoordX(psSeq, nStride, start));
+    for (i = start + 1; i + SHPCOORDS_LANES < end; i += SHPCOORDS_LANES) {
+        s01 = SHPVec2Add(s01, SHPVec2AreaTerms(nStride, psSeq, i, x0));
+        s23 = SHPVec2Add(s23, SHPVec2AreaTerms(nStride, psSeq, i + 2, x0));
+    }
+    SHPVec2Store(s, s01);
+    SHPVec2Store(s + 2, s23);
+
+    SHPCoordsAreaSums(nStride, psSeq, i, end, SHPCoordX(psSeq, nStride, start), s);
+    return SHPCoordsLanesSum(s)/2;
+}
+
+STATIC_INLINE void SHPVec2BoundsKernel (int nStride, const SHPCoordSeq *psSeq, int start, int end, double *padfMin, double *padfMax)
+{
+    SHPVec2 minx, miny, maxx, maxy, x, y;
+    double lo[2], hi[2];
+    int i;
+
+    minx = maxx = SHPVec2Set1(SHPCoordX(psSeq, nStride, start));
+    miny = maxy = SHPVec2Set1(SHPCoordY(psSeq, nStride, start));
+
+    for (i = start; i + 2 <= end; i += 2) {
+        SHPVec2LoadXY(nStride, psSeq, i, &x, &y);
+        minx = SHPVec2Min(minx, x);
+        maxx = SHPVec2Max(maxx, x);
+        miny = SHPVec2Min(miny, y);
+        maxy = SHPVec2Max(maxy, y);
+    }
+
+    SHPVec2Store(lo, minx);
+    SHPVec2Store(hi, maxx);
+    padfMin[0] = MIN_V2(lo[0], lo[1]);
+    padfMax[0] = MAX_V2(hi[0], hi[1]);
+
+    SHPVec2Store(lo, miny);
+    SHPVec2Store(hi, maxy);
+    padfMin[1] = MIN_V2(lo[0], lo[1]);
+    padfMax[1] = MAX_V2(hi[0], hi[1]);
+
+    SHPScalarBoundsSums(nStride, psSeq, i, end, padfMin, padfMax);
+}
+
+static double SHPVec2LengthOf(const SHPCoordSeq *psSeq, int start, int end)
+{
+    return SHPCOORDS_CALL(psSeq, SHPVec2LengthKernel, psSeq, start, end);
+}
+
+static double SHPVec2AreaOf(const SHPCoordSeq *psSeq, int start, int end)
+{
+    return SHPCOORDS_CALL(psSeq, SHPVec2AreaKernel, psSeq, start, end);
+}
+
+static void SHPVec2BoundsOf(const SHPCoordSeq *psSeq, int start, int end, double *padfMin, double *padfMax)
+{
+    SHPCOORDS_CALL(psSeq, SHPVec2BoundsKernel, psSeq, start, end, padfMin, padfMax);
+}
+
+static void SHPVec2RangeOf(const double *padfV, int nCount, double *pdfMin, double *pdfMax)
+{
+    SHPVec2 vmin, vmax;
+    double lo[2], hi[2];
+    int i;
+
+    vmin = vmax = SHPVec2Set1(padfV[0]);
+
+    for (i = 0; i + 2 <= nCount; i += 2) {
+        SHPVec2 v = SHPVec2Load(padfV + i);
+        vmin = SHPVec2Min(vmin, v);
+        vmax = SHPVec2Max(vmax, v);
+    }
+
+    SHPVec2Store(lo, vmin);
+    SHPVec2Store(hi, vmax);
+    *pdfMin = MIN_V2(lo[0], lo[1]);
+    *pdfMax = MAX_V2(hi[0], hi[1]);
+
+    SHPScalarRangeSums(padfV, i, nCount, pdfMin, pdfMax);
+}
+
+static const SHPSimdKernels SHPVec2Kernels = {
+    SHPVEC2_NAME,
+    SHPVec2LengthOf,
+    SHPVec2AreaOf,
+    SHPVec2BoundsOf,
+    SHPVec2RangeOf
+};
+
+#endif /* vec2 */
+
+
+/* -------------------------------------------------------------------- */
+/*      avx2                                                            */
+/* -------------------------------------------------------------------- */
+#if defined(SHP_SIMD_AVX2)
+
+#if defined(__GNUC__)
+# define SHP_TARGET_AVX2  __attribute__((target("avx2")))
+#else
+# define SHP_TARGET_AVX2
+#endif
+
+/**
+ * x, y of vertices i .. i + 3. SoA lanes are in vertex order, AoS lanes
+ *   come out of the unpack as i, i + 2, i + 1, i + 3 and sums built from
+ *   them are put back in order by SHPAvx2Unshuffle().
+ */
+SHP_TARGET_AVX2
+STATIC_INLINE void SHPAvx2LoadXY (int nStride, const SHPCoordSeq *psSeq, int i, __m256d *x, __m256d *y)
+{
+    if (nStride == SHPCOORDS_SOA) {
+        *x = _mm256_loadu_pd(psSeq->padfX + i);
+        *y = _mm256_loadu_pd(psSeq->padfY + i);
+    } else {
+        __m256d a = _mm256_loadu_pd(psSeq->padfX + i * nStride);
+        __m256d b = _mm256_loadu_pd(psSeq->padfX + (i + 2) * nStride);
+        *x = _mm256_unpacklo_pd(a, b);
+        *y = _mm256_unpackhi_pd(a, b);
+    }
+}
+
+SHP_TARGET_AVX2
+STATIC_INLINE void SHPAvx2Unshuffle (int nStride, __m256d acc, double s[SHPCOORDS_LANES])
+{
+    if (nStride != SHPCOORDS_SOA) {
+        acc = _mm256_permute4x64_pd(acc, _MM_SHUFFLE(3, 1, 2, 0));
+    }
+    _mm256_storeu_pd(s, acc);
+}
+
+SHP_TARGET_AVX2
+STATIC_INLINE double SHPAvx2LengthKernel (int nStride, const SHPCoordSeq *psSeq, int start, int end)
+{
+    __m256d acc = _mm256_setzero_pd(), x0, y0, x1, y1, dx, dy;
+    double s[SHPCOORDS_LANES];
+    int i;
+
+    for (i = start; i + SHPCOORDS_LANES < end; i += SHPCOORDS_LANES) {
+        SHPAvx2LoadXY(nStride, psSeq, i, &x0, &y0);
+        SHPAvx2LoadXY(nStride, psSeq, i + 1, &x1, &y1);
+
+        dx = _mm256_sub_pd(x1, x0);
+        dy = _mm256_sub_pd(y1, y0);
+        acc = _mm256_add_pd(acc, _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy))));
+    }
+    SHPAvx2Unshuffle(nStride, acc, s);
+
+    SHPCoordsLengthSums(nStride, psSeq, i, end, s);
+    return SHPCoordsLanesSum(s);
+}
+
+SHP_TARGET_AVX2
+STATIC_INLINE double SHPAvx2AreaKernel (int nStride, const SHPCoordSeq *psSeq, int start, int end)
+{
+    __m256d acc = _mm256_setzero_pd(), x0, xi, yi, yp, yn;
+    double s[SHPCOORDS_LANES];
+    int i;
+
+    if (end - start < 3) {
+        return 0;
+    }
+
+    x0 = _mm256_set1_pd(SHPCoordX(psSeq, nStride, start));
+    for (i = start + 1; i + SHPCOORDS_LANES < end; i += SHPCOORDS_LANES) {
+        SHPAvx2LoadXY(nStride, psSeq, i - 1, &xi, &yp);
+        SHPAvx2LoadXY(nStride, psSeq, i + 1, &xi, &yn);
+        SHPAvx2LoadXY(nStride, psSeq, i, &xi, &yi);
+
+        acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_sub_pd(xi, x0), _mm256_sub_pd(yn, yp)));
+    }
+    SHPAvx2Unshuffle(nStride, acc, s);
+
+    SHPCoordsAreaSums(nStride, psSeq, i, end, SHPCoordX(psSeq, nStride, start), s);
+    return SHPCoordsLanesSum(s)/2;
+}
+
+/* min and max of the 4 lanes */
+SHP_TARGET_AVX2
+STATIC_INLINE void SHPAvx2MinMax (__m256d vmin, __m256d vmax, double *pdfMin, double *pdfMax)
+{
+    __m128d lo = _mm_min_pd(_mm256_castpd256_pd128(vmin), _mm256_extractf128_pd(vmin, 1));
+    __m128d hi = _mm_max_pd(_mm256_castpd256_pd128(vmax), _mm256_extractf128_pd(vmax, 1));
+
+    *pdfMin = _mm_cvtsd_f64(_mm_min_sd(lo, _mm_unpackhi_pd(lo, lo)));
+    *pdfMax = _mm_cvtsd_f64(_mm_max_sd(hi, _mm_unpackhi_pd(hi, hi)));
+}
+
+SHP_TARGET_AVX2
+STATIC_INLINE void SHPAvx2BoundsKernel (int nStride, const SHPCoordSeq *psSeq, int start, int end, double *padfMin, double *padfMax)
+{
+    __m256d minx, miny, maxx, maxy, x, y;
+    int i;
+
+    minx = maxx = _mm256_set1_pd(SHPCoordX(psSeq, nStride, start));
+    miny = maxy = _mm256_set1_pd(SHPCoordY(psSeq, nStride, start));
+
+    for (i = start; i + SHPCOORDS_LANES <= end; i += SHPCOORDS_LANES) {
+        SHPAvx2LoadXY(nStride, psSeq, i, &x, &y);
+        minx = _mm256_min_pd(minx, x);
+        maxx = _mm256_max_pd(maxx, x);
+        miny = _mm256_min_pd(miny, y);
+        maxy = _mm256_max_pd(maxy, y);
+    }
+
+    SHPAvx2MinMax(minx, maxx, &padfMin[0], &padfMax[0]);
+    SHPAvx2MinMax(miny, maxy, &padfMin[1], &padfMax[1]);
+
+    SHPScalarBoundsSums(nStride, psSeq, i, end, padfMin, padfMax);
+}
+
+SHP_TARGET_AVX2
+static double SHPAvx2LengthOf(const SHPCoordSeq *psSeq, int start, int end)
+{
+    return SHPCOORDS_CALL(psSeq, SHPAvx2LengthKernel, psSeq, start, end);
+}
+
+SHP_TARGET_AVX2
+static double SHPAvx2AreaOf(const SHPCoordSeq *psSeq, int start, int end)
+{
+    return SHPCOORDS_CALL(psSeq, SHPAvx2AreaKernel, psSeq, start, end);
+}
+
+SHP_TARGET_AVX2
+static void SHPAvx2BoundsOf(const SHPCoordSeq *psSeq, int start, int end, double *padfMin, double *padfMax)
+{
+    SHPCOORDS_CALL(psSeq, SHPAvx2BoundsKernel, psSeq, start, end, padfMin, padfMax);
+}
+
+SHP_TARGET_AVX2
+static void SHPAvx2RangeOf(const double *padfV, int nCount, double *pdfMin, double *pdfMax)
+{
+    __m256d vmin, vmax;
+    int i;
+
+    vmin = vmax = _mm256_set1_pd(padfV[0]);
+
+    for (i = 0; i + 4 <= nCount; i += 4) {
+        __m256d v = _mm256_loadu_pd(padfV + i);
+        vmin = _mm256_min_pd(vmin, v);
+        vmax = _mm256_max_pd(vmax, v);
+    }
+
+    SHPAvx2MinMax(vmin, vmax, pdfMin, pdfMax);
+
+    SHPScalarRangeSums(padfV, i, nCount, pdfMin, pdfMax);
+}
+
+static const SHPSimdKernels SHPAvx2Kernels = {
+    "avx2",
+    SHPAvx2LengthOf,
+    SHPAvx2AreaOf,
+    SHPAvx2BoundsOf,
+    SHPAvx2RangeOf
+};
+
+static int SHPCpuHasAvx2(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 1);
+    /* OSXSAVE and AVX, and the OS saves the ymm state */
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6) {
+        return 0;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif /* avx2 */
+
+
+/* -------------------------------------------------------------------- */
+/*      dispatch                                                        */
+/* -------------------------------------------------------------------- */
+
+/* usable kernels, widest first */
+static const SHPSimdKernels * SHPSimdAvailable(int index)
+{
+    const SHPSimdKernels *apKernels[3];
+    int n = 0;
+
+#if defined(SHP_SIMD_AVX2)
+    if (SHPCpuHasAvx2()) {
+        apKernels[n++] = &SHPAvx2Kernels;
+    }
+#endif
+#if defined(SHP_SIMD_SSE2) || defined(SHP_SIMD_NEON)
+    apKernels[n++] = &SHPVec2Kernels;
+#endif
+    apKernels[n++] = &SHPScalarKernels;
+
+    return index < n ? apKernels[index] : NULL;
+}
+
+/* set once on first use. threads racing here all store the same value */
+static const SHPSimdKernels * volatile SHPSimdActive = NULL;
+
+#if defined(__GNUC__)
+# define SHPSimdLoadActive()    __atomic_load_n(&SHPSimdActive, __ATOMIC_ACQUIRE)
+# define SHPSimdStoreActive(p)  __atomic_store_n(&SHPSimdActive, (p), __ATOMIC_RELEASE)
+#else
+/* msvc volatile reads acquire and writes release */
+# define SHPSimdLoadActive()    (SHPSimdActive)
+# define SHPSimdStoreActive(p)  (SHPSimdActive = (p))
+#endif
+
+STATIC_INLINE const SHPSimdKernels * SHPSimd(void)
+{
+    const SHPSimdKernels *pKernels = SHPSimdLoadActive();
+    if (!pKernels) {
+        pKernels = SHPSimdAvailable(0);
+        SHPSimdStoreActive(pKernels);
+    }
+    return pKernels;
+}
+
+
+double SHPSimdLengthOf(const SHPCoordSeq *psSeq, int start, int end)
+{
+    return SHPSimd()->pfnLengthOf(psSeq, start, end);
+}
+
+double SHPSimdAreaOf(const SHPCoordSeq *psSeq, int start, int end)
+{
+    return SHPSimd()->pfnAreaOf(psSeq, start, end);
+}
+
+void SHPSimdBoundsOf(const SHPCoordSeq *psSeq, int start, int end, double *padfMin, double *padfMax)
+{
+    if (end > start) {
+        SHPSimd()->pfnBoundsOf(psSeq, start, end, padfMin, padfMax);
+    }
+}
+
+void SHPSimdRangeOf(const double *padfV, int nCount, double *pdfMin, double *pdfMax)
+{
+    if (nCount > 0) {
+        SHPSimd()->pfnRangeOf(padfV, nCount, pdfMin, pdfMax);
+    }
+}
+
+
+const char * SHPGetSimdName(void)
+{
+    return SHPSimd()->pszName;
+}
+
+
+int SHPSetSimdName(const char *pszName)
+{
+    const SHPSimdKernels *pKernels;
+    int i;
+
+    if (!pszName) {
+        SHPSimdStoreActive(SHPSimdAvailable(0));
+        return SHAPEFILE_TRUE;
+    }
+
+    for (i = 0; (pKernels = SHPSimdAvailable(i)) != NULL; i++) {
+        if (!strcmp(pKernels->pszName, pszName)) {
+            SHPSimdStoreActive(pKernels);
+            return SHAPEFILE_TRUE;
+        }
+    }
+    return SHAPEFILE_FALSE;
+}
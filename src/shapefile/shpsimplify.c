@@ -0,0 +1,909 @@
+/******************************************************************************
+ * shpsimplify.c
+ *
+ * v 1.0 2026/10/18
+ *
+ * Project:  Shapelib
+ * Purpose:  Line and polygon simplification and simplified layer pyramids.
+ * Author:   cheungmine@gmail.com
+ *
+ * Copyright (c) 2026, cheungmine
+ *
+ * This software is available under the following "MIT Style" license,
+ * or at the option of the licensee under the LGPL (see LICENSE.LGPL).  This
+ * option is discussed in more detail in shapelib.html.
+ *
+ * --
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+ * Every part of a line or polygon is simplified on its own, end points
+ * (the first vertex of a ring) always kept, by one of
+ *
+ *   Douglas-Peucker: a span is replaced by its chord when no vertex is
+ *     farther than the tolerance from it, else split at the farthest.
+ *   Visvalingam-Whyatt: the vertex making the smallest triangle with
+ *     its neighbours is dropped while that area is under the tolerance.
+ *
+ * Both only relink panNext, the kept vertices being those still linked.
+ * With SHP_SIMPLIFY_TOPOLOGY a chord is refused if the region between it
+ * and the chain it replaces holds a vertex still linked, the chord
+ * included. As no segment crosses the chain, one crossing the chord
+ * would have to end in there: starting from a shape without crossings
+ * none is ever made. Vertices do not move, so one MBR tree packed over
+ * them serves the whole run, removed ones being skipped.
+ */
+
+#include "shapefile_i.h"
+
+/* panNext of removed vertices, -1 ending a part */
+#define SHP_SIMPLIFY_REMOVED  (-2)
+
+#define SHPSimplifyX(psSeq, i)  SHPCoordX(psSeq, (psSeq)->nStride, i)
+#define SHPSimplifyY(psSeq, i)  SHPCoordY(psSeq, (psSeq)->nStride, i)
+
+
+typedef struct
+{
+    const SHPCoordSeq *psSeq;
+    double      dfTolerance;
+    int         bTopology;
+
+    int        *panNext;        /* [nVertices] */
+    int        *panPrev;
+    int         nVertexSize;
+
+    /* Douglas-Peucker spans to do */
+    int        *panStack;
+    int         nStackSize;
+
+    /* Visvalingam-Whyatt min-heap of vertices by area */
+    int        *panHeap;
+    int        *panHeapPos;
+    double     *padfArea;
+    int         nHeapSize;
+
+    /* topology: vertex tree, rtRoot NULL for small shapes */
+    SHPEnvelope *pEnvs;
+    int         nEnvSize;
+    SHPInfoRTree tree;
+} SHPSimplifier;
+
+
+typedef struct
+{
+    SHPSimplifier *psSimp;
+    int         a, c;           /* chord replacing the chain a -> c */
+    double      ax, ay, cx, cy;
+    double      dfBand;         /* no vertex of the chain farther from it */
+    int         bBlocked;       /* a vertex is in the way */
+} SHPSimplifyChord;
+
+
+/* -------------------------------------------------------------------- */
+/*      geometry                                                        */
+/* -------------------------------------------------------------------- */
+static double SHPSimplifyDist2(double px, double py, double ax, double ay, double cx, double cy)
+{
+    double dx = cx - ax, dy = cy - ay, l2 = dx * dx + dy * dy;
+
+    if (l2 > 0) {
+        double t = ((px - ax) * dx + (py - ay) * dy) / l2;
+        t = (t < 0 ? 0 : (t > 1 ? 1 : t));
+        ax += t * dx;
+        ay += t * dy;
+    }
+    return (px - ax) * (px - ax) + (py - ay) * (py - ay);
+}
+
+
+static double SHPSimplifyCross(double ax, double ay, double bx, double by, double px, double py)
+{
+    return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+
+/* -------------------------------------------------------------------- */
+/*      topology                                                        */
+/* -------------------------------------------------------------------- */
+static int SHPSimplifyIndexVertices(SHPSimplifier *psSimp)
+{
+    const SHPCoordSeq *psSeq = psSimp->psSeq;
+    int v;
+
+    if (psSeq->nVertices < SHP_SIMPLIFY_TREE_MIN) {
+        return SHAPEFILE_TRUE;
+    }
+
+    if (psSimp->nEnvSize < psSeq->nVertices) {
+        SHPEnvelope *pEnvs = (SHPEnvelope *) realloc(psSimp->pEnvs, sizeof(SHPEnvelope) * (size_t) psSeq->nVertices);
+        if (!pEnvs) {
+            return SHAPEFILE_FALSE;
+        }
+        psSimp->pEnvs = pEnvs;
+        psSimp->nEnvSize = psSeq->nVertices;
+    }
+    for (v = 0; v < psSeq->nVertices; v++) {
+        psSimp->pEnvs[v].XMin = psSimp->pEnvs[v].XMax = SHPSimplifyX(psSeq, v);
+        psSimp->pEnvs[v].YMin = psSimp->pEnvs[v].YMax = SHPSimplifyY(psSeq, v);
+    }
+    SHPMBRTreeBulkLoadEnvelopes(&psSimp->tree, psSimp->pEnvs, NULL, psSeq->nVertices, SHP_MBRTREE_STR);
+    return SHAPEFILE_TRUE;
+}
+
+
+/* (x, y) on the chord or inside the region between it and the chain */
+static int SHPSimplifyInChain(const SHPSimplifyChord *psChord, double x, double y)
+{
+    const SHPSimplifier *psSimp = psChord->psSimp;
+    const SHPCoordSeq *psSeq = psSimp->psSeq;
+    double dfCross;
+    int v, w, bInside = SHAPEFILE_FALSE;
+
+    /* a vertex shared with another part at the chord ends is no crossing */
+    if ((x == psChord->ax && y == psChord->ay) || (x == psChord->cx && y == psChord->cy) ||
+        SHPSimplifyDist2(x, y, psChord->ax, psChord->ay, psChord->cx, psChord->cy) > psChord->dfBand * psChord->dfBand) {
+        return SHAPEFILE_FALSE;
+    }
+
+    dfCross = SHPSimplifyCross(psChord->ax, psChord->ay, psChord->cx, psChord->cy, x, y);
+    if (dfCross == 0 &&
+        MIN_V2(psChord->ax, psChord->cx) <= x && x <= MAX_V2(psChord->ax, psChord->cx) &&
+        MIN_V2(psChord->ay, psChord->cy) <= y && y <= MAX_V2(psChord->ay, psChord->cy)) {
+        return SHAPEFILE_TRUE;
+    }
+
+    for (v = psChord->a; v != psChord->c; v = w) {
+        double x1 = SHPSimplifyX(psSeq, v), y1 = SHPSimplifyY(psSeq, v);
+        double x2, y2;
+
+        w = psSimp->panNext[v];
+        x2 = SHPSimplifyX(psSeq, w);
+        y2 = SHPSimplifyY(psSeq, w);
+
+        if ((y1 > y) != (y2 > y) && x < (x2 - x1) * (y - y1) / (y2 - y1) + x1) {
+            bInside = !bInside;
+        }
+    }
+
+    /* closing chord c -> a */
+    if ((psChord->cy > y) != (psChord->ay > y) &&
+        x < (psChord->ax - psChord->cx) * (y - psChord->cy) / (psChord->ay - psChord->cy) + psChord->cx) {
+        bInside = !bInside;
+    }
+    return bInside;
+}
+
+
+/* blocks the chord if vertex v is in its way */
+static int SHPSimplifyOnVertex(void *shapeData, void *userParam)
+{
+    SHPSimplifyChord *psChord = (SHPSimplifyChord *) userParam;
+    const SHPSimplifier *psSimp = psChord->psSimp;
+    int v = SHPMBRTreeDataToShapeId(shapeData);
+
+    /* already blocked: a stop only ends the current tree node */
+    if (psChord->bBlocked) {
+        return SHAPEFILE_FALSE;
+    }
+
+    /* removed, or on the chain itself */
+    if (psSimp->panNext[v] == SHP_SIMPLIFY_REMOVED || (v >= psChord->a && v <= psChord->c)) {
+        return SHAPEFILE_TRUE;
+    }
+
+    if (SHPSimplifyInChain(psChord, SHPSimplifyX(psSimp->psSeq, v), SHPSimplifyY(psSimp->psSeq, v))) {
+        psChord->bBlocked = SHAPEFILE_TRUE;
+        return SHAPEFILE_FALSE;
+    }
+    return SHAPEFILE_TRUE;
+}
+
+
+/**
+ * whether the chain a -> c may be replaced by its chord, no vertex of
+ *   the chain being farther than dfBand from it.
+ */
+static int SHPSimplifyChordOK(SHPSimplifier *psSimp, int a, int c, double dfBand)
+{
+    const SHPCoordSeq *psSeq = psSimp->psSeq;
+    SHPSimplifyChord chord;
+    int v;
+
+    chord.psSimp = psSimp;
+    chord.a = a;
+    chord.c = c;
+    chord.ax = SHPSimplifyX(psSeq, a);
+    chord.ay = SHPSimplifyY(psSeq, a);
+    chord.cx = SHPSimplifyX(psSeq, c);
+    chord.cy = SHPSimplifyY(psSeq, c);
+    chord.dfBand = dfBand;
+    chord.bBlocked = SHAPEFILE_FALSE;
+
+    if (psSimp->tree.rtRoot) {
+        SHPEnvelope env;
+        env.XMin = MIN_V2(chord.ax, chord.cx) - dfBand;
+        env.YMin = MIN_V2(chord.ay, chord.cy) - dfBand;
+        env.XMax = MAX_V2(chord.ax, chord.cx) + dfBand;
+        env.YMax = MAX_V2(chord.ay, chord.cy) + dfBand;
+        SHPMBRTreeSearch(&psSimp->tree, &env, SHPSimplifyOnVertex, &chord);
+    } else {
+        for (v = 0; v < psSeq->nVertices && !chord.bBlocked; v++) {
+            SHPSimplifyOnVertex(SHPMBRTreeShapeIdToData(v), &chord);
+        }
+    }
+
+    return !chord.bBlocked;
+}
+
+
+/* -------------------------------------------------------------------- */
+/*      Douglas-Peucker                                                 */
+/* -------------------------------------------------------------------- */
+static int SHPSimplifyPush(SHPSimplifier *psSimp, int *pnTop, int i, int j)
+{
+    if (*pnTop + 2 > psSimp->nStackSize) {
+        int nStackSize = MAX_V2(psSimp->nStackSize * 2, 64);
+        int *panStack = (int *) realloc(psSimp->panStack, sizeof(int) * (size_t) nStackSize);
+        if (!panStack) {
+            return SHAPEFILE_FALSE;
+        }
+        psSimp->panStack = panStack;
+        psSimp->nStackSize = nStackSize;
+    }
+    psSimp->panStack[(*pnTop)++] = i;
+    psSimp->panStack[(*pnTop)++] = j;
+    return SHAPEFILE_TRUE;
+}
+
+
+/* vertex of (i, j) farthest from segment a-c, its squared distance in *pd2 */
+static int SHPSimplifyFarthest(const SHPCoordSeq *psSeq, int i, int j, int a, int c, double *pd2)
+{
+    double ax = SHPSimplifyX(psSeq, a), ay = SHPSimplifyY(psSeq, a);
+    double cx = SHPSimplifyX(psSeq, c), cy = SHPSimplifyY(psSeq, c);
+    int v, f = i + 1;
+
+    *pd2 = -1;
+    for (v = i + 1; v < j; v++) {
+        double d2 = SHPSimplifyDist2(SHPSimplifyX(psSeq, v), SHPSimplifyY(psSeq, v), ax, ay, cx, cy);
+        if (d2 > *pd2) {
+            *pd2 = d2;
+            f = v;
+        }
+    }
+    return f;
+}
+
+
+/* SHAPEFILE_FALSE out of memory */
+static int SHPSimplifyDP(SHPSimplifier *psSimp, int start, int end, int bRing)
+{
+    const SHPCoordSeq *psSeq = psSimp->psSeq;
+    double dfTol2 = psSimp->dfTolerance * psSimp->dfTolerance, d2;
+    int anAnchors[4], nAnchors = 0, nTop = 0, last = end - 1, i, j, v;
+
+    anAnchors[nAnchors++] = start;
+
+    if (bRing) {
+        /* the chord of a ring is its first point: split at the vertex
+         *  farthest from it, with topology also at the farthest from that
+         *  diameter so 3 corners are left */
+        int k = SHPSimplifyFarthest(psSeq, start, last, start, last, &d2);
+
+        if (psSimp->bTopology) {
+            int m = SHPSimplifyFarthest(psSeq, start, last, start, k, &d2);
+            if (m == k) {
+                m = (k + 1 < last ? k + 1 : k - 1);
+            }
+            anAnchors[nAnchors++] = MIN_V2(k, m);
+            anAnchors[nAnchors++] = MAX_V2(k, m);
+        } else {
+            anAnchors[nAnchors++] = k;
+        }
+    }
+
+    anAnchors[nAnchors++] = last;
+
+    for (i = nAnchors - 1; i > 0; i--) {
+        if (!SHPSimplifyPush(psSimp, &nTop, anAnchors[i - 1], anAnchors[i])) {
+            return SHAPEFILE_FALSE;
+        }
+    }
+
+    while (nTop > 0) {
+        j = psSimp->panStack[--nTop];
+        i = psSimp->panStack[--nTop];
+
+        if (j - i < 2) {
+            continue;
+        }
+
+        v = SHPSimplifyFarthest(psSeq, i, j, i, j, &d2);
+
+        if (d2 <= dfTol2 && (!psSimp->bTopology || SHPSimplifyChordOK(psSimp, i, j, sqrt(d2)))) {
+            int w;
+            for (w = i + 1; w < j; w++) {
+                psSimp->panNext[w] = SHP_SIMPLIFY_REMOVED;
+            }
+            psSimp->panNext[i] = j;
+        } else {
+            /* left half on top */
+            if (!SHPSimplifyPush(psSimp, &nTop, v, j) || !SHPSimplifyPush(psSimp, &nTop, i, v)) {
+                return SHAPEFILE_FALSE;
+            }
+        }
+    }
+    return SHAPEFILE_TRUE;
+}
+
+
+/* -------------------------------------------------------------------- */
+/*      Visvalingam-Whyatt                                              */
+/* -------------------------------------------------------------------- */
+static void SHPSimplifyHeapSwap(SHPSimplifier *psSimp, int i, int j)
+{
+    int v = psSimp->panHeap[i];
+
+    psSimp->panHeap[i] = psSimp->panHeap[j];
+    psSimp->panHeap[j] = v;
+    psSimp->panHeapPos[psSimp->panHeap[i]] = i;
+    psSimp->panHeapPos[psSimp->panHeap[j]] = j;
+}
+
+
+static void SHPSimplifyHeapUp(SHPSimplifier *psSimp, int i)
+{
+    while (i > 0 && psSimp->padfArea[psSimp->panHeap[(i - 1) / 2]] > psSimp->padfArea[psSimp->panHeap[i]]) {
+        SHPSimplifyHeapSwap(psSimp, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+
+static void SHPSimplifyHeapDown(SHPSimplifier *psSimp, int i, int nHeap)
+{
+    for (;;) {
+        int k = 2 * i + 1;
+        if (k >= nHeap) {
+            break;
+        }
+        if (k + 1 < nHeap && psSimp->padfArea[psSimp->panHeap[k + 1]] < psSimp->padfArea[psSimp->panHeap[k]]) {
+            k++;
+        }
+        if (psSimp->padfArea[psSimp->panHeap[k]] >= psSimp->padfArea[psSimp->panHeap[i]]) {
+            break;
+        }
+        SHPSimplifyHeapSwap(psSimp, i, k);
+        i = k;
+    }
+}
+
+
+/* area of the triangle v makes with its neighbours */
+static double SHPSimplifyTriangle(const SHPSimplifier *psSimp, int v)
+{
+    const SHPCoordSeq *psSeq = psSimp->psSeq;
+    int a = psSimp->panPrev[v], c = psSimp->panNext[v];
+
+    return 0.5 * fabs(SHPSimplifyCross(SHPSimplifyX(psSeq, a), SHPSimplifyY(psSeq, a),
+        SHPSimplifyX(psSeq, c), SHPSimplifyY(psSeq, c), SHPSimplifyX(psSeq, v), SHPSimplifyY(psSeq, v)));
+}
+
+
+static void SHPSimplifyVW(SHPSimplifier *psSimp, int start, int end, int nMinKept)
+{
+    const SHPCoordSeq *psSeq = psSimp->psSeq;
+    int i, v, nHeap = 0, nKept = end - start, last = end - 1;
+
+    for (v = start + 1; v < last; v++) {
+        psSimp->padfArea[v] = SHPSimplifyTriangle(psSimp, v);
+        psSimp->panHeap[nHeap] = v;
+        psSimp->panHeapPos[v] = nHeap++;
+    }
+    for (i = nHeap / 2 - 1; i >= 0; i--) {
+        SHPSimplifyHeapDown(psSimp, i, nHeap);
+    }
+
+    while (nHeap > 0 && nKept > nMinKept) {
+        int a, c;
+
+        v = psSimp->panHeap[0];
+        if (!(psSimp->padfArea[v] < psSimp->dfTolerance)) {
+            break;
+        }
+
+        a = psSimp->panPrev[v];
+        c = psSimp->panNext[v];
+
+        if (psSimp->bTopology &&
+            !SHPSimplifyChordOK(psSimp, a, c, sqrt(SHPSimplifyDist2(SHPSimplifyX(psSeq, v), SHPSimplifyY(psSeq, v),
+                SHPSimplifyX(psSeq, a), SHPSimplifyY(psSeq, a), SHPSimplifyX(psSeq, c), SHPSimplifyY(psSeq, c))))) {
+            /* kept until a neighbour goes */
+            psSimp->padfArea[v] = DBL_MAX;
+            SHPSimplifyHeapDown(psSimp, 0, nHeap);
+            continue;
+        }
+
+        SHPSimplifyHeapSwap(psSimp, 0, --nHeap);
+        SHPSimplifyHeapDown(psSimp, 0, nHeap);
+
+        psSimp->panNext[a] = c;
+        psSimp->panPrev[c] = a;
+        psSimp->panNext[v] = SHP_SIMPLIFY_REMOVED;
+        nKept--;
+
+        if (a != start) {
+            psSimp->padfArea[a] = SHPSimplifyTriangle(psSimp, a);
+            SHPSimplifyHeapUp(psSimp, psSimp->panHeapPos[a]);
+            SHPSimplifyHeapDown(psSimp, psSimp->panHeapPos[a], nHeap);
+        }
+        if (c != last) {
+            psSimp->padfArea[c] = SHPSimplifyTriangle(psSimp, c);
+            SHPSimplifyHeapUp(psSimp, psSimp->panHeapPos[c]);
+            SHPSimplifyHeapDown(psSimp, psSimp->panHeapPos[c], nHeap);
+        }
+    }
+}
+
+
+/* -------------------------------------------------------------------- */
+/*      driver                                                          */
+/* -------------------------------------------------------------------- */
+static void SHPSimplifierFree(SHPSimplifier *psSimp)
+{
+    SafeFree(psSimp->panNext);
+    SafeFree(psSimp->panPrev);
+    SafeFree(psSimp->panStack);
+    SafeFree(psSimp->panHeap);
+    SafeFree(psSimp->panHeapPos);
+    SafeFree(psSimp->padfArea);
+    SafeFree(psSimp->pEnvs);
+    if (psSimp->tree.rtRoot) {
+        RTreeDestroy(psSimp->tree.rtRoot);
+        psSimp->tree.rtRoot = NULL;
+    }
+}
+
+
+/**
+ * simplify the lines or rings of psSeq: afterwards vertex v is kept if
+ *   panNext[v] != SHP_SIMPLIFY_REMOVED. other types keep every vertex.
+ *   returns the number of vertices kept, -1 out of memory.
+ */
+static int SHPSimplifierRun(SHPSimplifier *psSimp, const SHPCoordSeq *psSeq, double dfTolerance, int nFlags)
+{
+    int nType = psSeq->nSHPType, nVertices = psSeq->nVertices;
+    int nParts = MAX_V2(psSeq->nParts, 1), bPolygon, p, v, start, end, nKept = 0;
+
+    bPolygon = (nType == SHPT_POLYGON || nType == SHPT_POLYGONZ || nType == SHPT_POLYGONM);
+
+    psSimp->psSeq = psSeq;
+    psSimp->dfTolerance = dfTolerance;
+    psSimp->bTopology = (nFlags & SHP_SIMPLIFY_TOPOLOGY) != 0;
+
+    if (psSimp->nVertexSize < nVertices) {
+        int *panNext, *panPrev;
+
+        if (!(panNext = (int *) realloc(psSimp->panNext, sizeof(int) * (size_t) nVertices))) {
+            return (-1);
+        }
+        psSimp->panNext = panNext;
+        if (!(panPrev = (int *) realloc(psSimp->panPrev, sizeof(int) * (size_t) nVertices))) {
+            return (-1);
+        }
+        psSimp->panPrev = panPrev;
+        psSimp->nVertexSize = nVertices;
+    }
+
+    for (p = 0; p < nParts; p++) {
+        SHPCoordsPartRange(psSeq, p, &start, &end);
+        for (v = start; v < end; v++) {
+            psSimp->panNext[v] = (v + 1 < end ? v + 1 : -1);
+            psSimp->panPrev[v] = v - 1;
+        }
+    }
+
+    if (!(bPolygon || nType == SHPT_ARC || nType == SHPT_ARCZ || nType == SHPT_ARCM) ||
+        !(dfTolerance > 0 && dfTolerance < DBL_MAX)) {
+        return nVertices;
+    }
+
+    if ((nFlags & SHP_SIMPLIFY_VW) && psSimp->nHeapSize < nVertices) {
+        int *panHeap, *panHeapPos;
+        double *padfArea;
+
+        if (!(panHeap = (int *) realloc(psSimp->panHeap, sizeof(int) * (size_t) nVertices))) {
+            return (-1);
+        }
+        psSimp->panHeap = panHeap;
+        if (!(panHeapPos = (int *) realloc(psSimp->panHeapPos, sizeof(int) * (size_t) nVertices))) {
+            return (-1);
+        }
+        psSimp->panHeapPos = panHeapPos;
+        if (!(padfArea = (double *) realloc(psSimp->padfArea, sizeof(double) * (size_t) nVertices))) {
+            return (-1);
+        }
+        psSimp->padfArea = padfArea;
+        psSimp->nHeapSize = nVertices;
+    }
+
+    if (psSimp->bTopology && !SHPSimplifyIndexVertices(psSimp)) {
+        return (-1);
+    }
+
+    for (p = 0; p < nParts; p++) {
+        int bRing, nPartKept = 0;
+
+        SHPCoordsPartRange(psSeq, p, &start, &end);
+
+        /* an open ring is simplified as a line */
+        bRing = bPolygon && end - start > 1 &&
+            SHPSimplifyX(psSeq, start) == SHPSimplifyX(psSeq, end - 1) &&
+            SHPSimplifyY(psSeq, start) == SHPSimplifyY(psSeq, end - 1);
+
+        if (end - start <= (bRing ? 4 : 2)) {
+            nKept += MAX_V2(end - start, 0);
+            continue;
+        }
+
+        if (nFlags & SHP_SIMPLIFY_VW) {
+            SHPSimplifyVW(psSimp, start, end, bRing ? (psSimp->bTopology ? 4 : 3) : 2);
+        } else if (!SHPSimplifyDP(psSimp, start, end, bRing)) {
+            nKept = -1;
+            break;
+        }
+
+        for (v = start; v < end; v++) {
+            nPartKept += (psSimp->panNext[v] != SHP_SIMPLIFY_REMOVED);
+        }
+
+        /* a ring thinner than the tolerance is gone */
+        if (bRing && nPartKept < 4) {
+            for (v = start; v < end; v++) {
+                psSimp->panNext[v] = SHP_SIMPLIFY_REMOVED;
+            }
+            nPartKept = 0;
+        }
+        nKept += nPartKept;
+    }
+
+    if (psSimp->tree.rtRoot) {
+        RTreeDestroy(psSimp->tree.rtRoot);
+        psSimp->tree.rtRoot = NULL;
+    }
+    return nKept;
+}
+
+
+/**
+ * new object of the vertices of psObject kept by SHPSimplifierRun(),
+ *   parts left without any dropped. SHPT_NULL if none is left.
+ */
+static SHPObject * SHPSimplifierObject(const SHPSimplifier *psSimp, const SHPObject *psObject, int nKept)
+{
+    const SHPCoordSeq *psSeq = psSimp->psSeq;
+    SHPObject *psNew;
+    double *padfX, *padfY, *padfZ = NULL, *padfM = NULL;
+    int *panStart = NULL, *panType = NULL;
+    int p, v, j = 0, nParts = 0, start, end;
+
+    if (nKept == 0 && psObject->nVertices > 0) {
+        return SHPCreateObject(SHPT_NULL, psObject->nShapeId, 0, NULL, NULL, 0, NULL, NULL, NULL, NULL);
+    }
+
+    padfX = (double *) malloc(sizeof(double) * MAX_V2(nKept, 1));
+    padfY = (double *) malloc(sizeof(double) * MAX_V2(nKept, 1));
+    if (psObject->padfZ) {
+        padfZ = (double *) malloc(sizeof(double) * MAX_V2(nKept, 1));
+    }
+    if (psObject->padfM) {
+        padfM = (double *) malloc(sizeof(double) * MAX_V2(nKept, 1));
+    }
+    if (psObject->nParts > 0) {
+        panStart = (int *) malloc(sizeof(int) * psObject->nParts);
+        panType = (int *) malloc(sizeof(int) * psObject->nParts);
+    }
+
+    if (!padfX || !padfY || (psObject->padfZ && !padfZ) || (psObject->padfM && !padfM) ||
+        (psObject->nParts > 0 && (!panStart || !panType))) {
+        psNew = NULL;
+    } else {
+        for (p = 0; p < MAX_V2(psObject->nParts, 1); p++) {
+            int bFirst = SHAPEFILE_TRUE;
+
+            SHPCoordsPartRange(psSeq, p, &start, &end);
+
+            for (v = start; v < end; v++) {
+                if (psSimp->panNext[v] == SHP_SIMPLIFY_REMOVED) {
+                    continue;
+                }
+                if (bFirst && psObject->nParts > 0) {
+                    panStart[nParts] = j;
+                    panType[nParts++] = psObject->panPartType ? psObject->panPartType[p] : SHPP_RING;
+                }
+                bFirst = SHAPEFILE_FALSE;
+                padfX[j] = psObject->padfX[v];
+                padfY[j] = psObject->padfY[v];
+                if (padfZ) {
+                    padfZ[j] = psObject->padfZ[v];
+                }
+                if (padfM) {
+                    padfM[j] = psObject->padfM[v];
+                }
+                j++;
+            }
+        }
+
+        psNew = SHPCreateObject(psObject->nSHPType, psObject->nShapeId, nParts, panStart, panType,
+            j, padfX, padfY, padfZ, padfM);
+    }
+
+    free(padfX);
+    free(padfY);
+    free(padfZ);
+    free(padfM);
+    free(panStart);
+    free(panType);
+    return psNew;
+}
+
+
+/* -------------------------------------------------------------------- */
+/*      public                                                          */
+/* -------------------------------------------------------------------- */
+SHPObject * SHPObjectSimplify(const SHPObject *psObject, double dfTolerance, int nFlags)
+{
+    SHPSimplifier simp;
+    SHPCoordSeq seq;
+    SHPObject *psNew;
+    int nKept;
+
+    if (!psObject) {
+        return NULL;
+    }
+
+    memset(&simp, 0, sizeof(simp));
+    SHPCoordSeqOfObject(&seq, psObject);
+
+    nKept = SHPSimplifierRun(&simp, &seq, dfTolerance, nFlags);
+    psNew = (nKept < 0) ? NULL : SHPSimplifierObject(&simp, psObject, nKept);
+
+    SHPSimplifierFree(&simp);
+    return psNew;
+}
+
+
+int SHPObjectExSimplify(SHPObjectEx *psObject, double dfTolerance, int nFlags)
+{
+    SHPSimplifier simp;
+    SHPCoordSeq seq;
+    int p, v, j = 0, nParts = 0, start, end, nKept;
+
+    if (!psObject) {
+        return (-1);
+    }
+
+    memset(&simp, 0, sizeof(simp));
+    SHPCoordSeqOfObjectEx(&seq, psObject);
+
+    nKept = SHPSimplifierRun(&simp, &seq, dfTolerance, nFlags);
+    if (nKept < 0 || nKept == psObject->nVertices) {
+        SHPSimplifierFree(&simp);
+        return (nKept < 0) ? (-1) : psObject->nVertices;
+    }
+
+    /* compact in place: j <= v and nParts <= p */
+    for (p = 0; p < MAX_V2(psObject->nParts, 1); p++) {
+        int bFirst = SHAPEFILE_TRUE;
+
+        SHPCoordsPartRange(&seq, p, &start, &end);
+
+        for (v = start; v < end; v++) {
+            if (simp.panNext[v] == SHP_SIMPLIFY_REMOVED) {
+                continue;
+            }
+            if (bFirst && psObject->nParts > 0) {
+                psObject->panPartStart[nParts] = j;
+                if (psObject->panPartType) {
+                    psObject->panPartType[nParts] = psObject->panPartType[p];
+                }
+                nParts++;
+            }
+            bFirst = SHAPEFILE_FALSE;
+
+            psObject->pPoints[j] = psObject->pPoints[v];
+            if (psObject->padfZ) {
+                psObject->padfZ[j] = psObject->padfZ[v];
+            }
+            if (psObject->padfM) {
+                psObject->padfM[j] = psObject->padfM[v];
+            }
+            j++;
+        }
+    }
+
+    SHPSimplifierFree(&simp);
+
+    if (psObject->nParts > 0) {
+        psObject->nParts = nParts;
+        if (psObject->nPartsSize > nParts) {
+            psObject->panPartStart[nParts] = j;
+        }
+    }
+    psObject->nVertices = j;
+
+    if (j == 0) {
+        psObject->nSHPType = SHPT_NULL;
+        psObject->nParts = 0;
+    }
+    SHPComputeExtentsEx(psObject);
+
+    return j;
+}
+
+
+/* copy "<layer>.ext" (or .EXT) to "<level>.ext" if there is one */
+static int SHPSimplifyCopySidecar(const char *pszLayer, const char *pszLevel, const char *pszExt, const char *pszEXT)
+{
+    char *pszFrom = (char *) malloc(strlen(pszLayer) + 5);
+    char *pszTo = (char *) malloc(strlen(pszLevel) + 5);
+    char abyBuf[65536];
+    FILE *fpFrom, *fpTo = NULL;
+    size_t nRead;
+    int ret = SHAPEFILE_TRUE;
+
+    if (!pszFrom || !pszTo) {
+        free(pszFrom);
+        free(pszTo);
+        return SHAPEFILE_FALSE;
+    }
+
+    sprintf(pszFrom, "%s.%s", pszLayer, pszExt);
+    fpFrom = fopen(pszFrom, "rb");
+    if (!fpFrom) {
+        sprintf(pszFrom, "%s.%s", pszLayer, pszEXT);
+        fpFrom = fopen(pszFrom, "rb");
+    }
+
+    if (fpFrom) {
+        sprintf(pszTo, "%s.%s", pszLevel, pszExt);
+        fpTo = fopen(pszTo, "wb");
+        ret = (fpTo != NULL);
+
+        while (ret && (nRead = fread(abyBuf, 1, sizeof(abyBuf), fpFrom)) > 0) {
+            ret = (fwrite(abyBuf, 1, nRead, fpTo) == nRead);
+        }
+
+        fclose(fpFrom);
+        if (fpTo && fclose(fpTo) != 0) {
+            ret = SHAPEFILE_FALSE;
+        }
+    }
+
+    free(pszFrom);
+    free(pszTo);
+    return ret;
+}
+
+
+int SHPWriteSimplifiedLayers(SHPHandle hSHP, const char *pszLayer, const double *padfTolerances, int nLevels, int nFlags)
+{
+    SHPWriterHandle *pahWriters;
+    SHPSimplifier simp;
+    SHPCoordSeq seq;
+    char *pszBasename, *pszLevel;
+    int i, iShape, ret = SHAPEFILE_SUCCESS;
+
+    if (nLevels <= 0 || !padfTolerances || !pszLayer || !*pszLayer) {
+        return SHAPEFILE_ERROR;
+    }
+    for (i = 0; i < nLevels; i++) {
+        if (!(padfTolerances[i] > 0) || (i > 0 && padfTolerances[i] < padfTolerances[i - 1])) {
+            return SHAPEFILE_ERROR;
+        }
+    }
+
+    /* base (layer) name as SHPOpen() takes it */
+    pszBasename = (char *) malloc(strlen(pszLayer) + 1);
+    if (!pszBasename) {
+        return SHAPEFILE_ERROR;
+    }
+    strcpy(pszBasename, pszLayer);
+    for (i = (int) strlen(pszBasename) - 1;
+        i > 0 && pszBasename[i] != '.' && pszBasename[i] != '/' && pszBasename[i] != '\\';
+        i--) {
+        /* do nothing */
+    }
+    if (pszBasename[i] == '.') {
+        pszBasename[i] = '\0';
+    }
+
+    pszLevel = (char *) malloc(strlen(pszBasename) + 16);
+    pahWriters = (SHPWriterHandle *) calloc(nLevels, sizeof(SHPWriterHandle));
+    if (!pszLevel || !pahWriters) {
+        free(pahWriters);
+        free(pszLevel);
+        free(pszBasename);
+        return SHAPEFILE_ERROR;
+    }
+
+    for (i = 0; i < nLevels; i++) {
+        sprintf(pszLevel, "%s_L%d", pszBasename, i + 1);
+        pahWriters[i] = SHPWriterOpen(pszLevel, hSHP->nShapeType, 0);
+        if (!pahWriters[i]) {
+            ret = SHAPEFILE_ERROR;
+        }
+    }
+
+    memset(&simp, 0, sizeof(simp));
+
+    for (iShape = 0; ret == SHAPEFILE_SUCCESS && iShape < (int) hSHP->nRecords; iShape++) {
+        SHPObject *psObject = SHPReadObject(hSHP, iShape);
+
+        if (!psObject) {
+            psObject = SHPCreateObject(SHPT_NULL, iShape, 0, NULL, NULL, 0, NULL, NULL, NULL, NULL);
+        }
+
+        /* each level from the one before */
+        for (i = 0; psObject && i < nLevels; i++) {
+            SHPObject *psNext;
+            int nKept;
+
+            SHPCoordSeqOfObject(&seq, psObject);
+            nKept = SHPSimplifierRun(&simp, &seq, padfTolerances[i], nFlags);
+            psNext = (nKept < 0) ? NULL : SHPSimplifierObject(&simp, psObject, nKept);
+            SHPDestroyObject(psObject);
+            psObject = psNext;
+
+            if (!psObject || SHPWriterAppend(pahWriters[i], psObject) < 0) {
+                ret = SHAPEFILE_ERROR;
+            }
+        }
+
+        if (!psObject) {
+            ret = SHAPEFILE_ERROR;
+        }
+        SHPDestroyObject(psObject);
+    }
+
+    SHPSimplifierFree(&simp);
+
+    for (i = 0; i < nLevels; i++) {
+        if (pahWriters[i] && !SHPWriterClose(pahWriters[i])) {
+            ret = SHAPEFILE_ERROR;
+        }
+
+        /* same records, same attributes */
+        sprintf(pszLevel, "%s_L%d", pszBasename, i + 1);
+        if (ret == SHAPEFILE_SUCCESS &&
+            (!SHPSimplifyCopySidecar(pszBasename, pszLevel, "dbf", "DBF") ||
+             !SHPSimplifyCopySidecar(pszBasename, pszLevel, "prj", "PRJ") ||
+             !SHPSimplifyCopySidecar(pszBasename, pszLevel, "cpg", "CPG"))) {
+            ret = SHAPEFILE_ERROR;
+        }
+    }
+
+    free(pahWriters);
+    free(pszLevel);
+    free(pszBasename);
+    return ret;
+}
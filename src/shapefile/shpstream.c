@@ -0,0 +1,105 @@
+/******************************************************************************
+ * shpstream.c
+ *
+ * v 1.0 2026/10/18
+ *
+ * Project:  Shapelib
+ * Purpose:  Sink buffer of the GeoJSON and PostgreSQL COPY streams
+ * Author:   cheungmine@gmail.com
+ *
+ * Copyright (c) 2026, cheungmine
+ *
+ * This software is available under the following "MIT Style" license,
+ * or at the option of the licensee under the LGPL (see LICENSE.LGPL).  This
+ * option is discussed in more detail in shapelib.html.
+ *
+ * --
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include "shapefile_i.h"
+
+
+int SHPStreamInit (SHPStreamBuffer *psStream, SHPStreamSink pfnSink, void *pvSink, int nBufSize)
+{
+    psStream->pfnSink = pfnSink;
+    psStream->pvSink = pvSink;
+    psStream->bError = SHAPEFILE_FALSE;
+    psStream->cbBuf = 0;
+    psStream->nBufSize = nBufSize;
+    psStream->pabyBuf = (ub1 *) malloc(nBufSize);
+
+    if (!psStream->pabyBuf) {
+        psStream->nBufSize = 0;
+        psStream->bError = SHAPEFILE_TRUE;
+        return SHAPEFILE_FALSE;
+    }
+    return SHAPEFILE_TRUE;
+}
+
+
+int SHPStreamFlush (SHPStreamBuffer *psStream)
+{
+    if (psStream->cbBuf > 0 && !psStream->bError) {
+        if (!psStream->pfnSink(psStream->pvSink, psStream->pabyBuf, psStream->cbBuf)) {
+            psStream->bError = SHAPEFILE_TRUE;
+        }
+    }
+    psStream->cbBuf = 0;
+    return !psStream->bError;
+}
+
+
+ub1 * SHPStreamReserve (SHPStreamBuffer *psStream, int cbNeed)
+{
+    if (psStream->cbBuf + cbNeed > psStream->nBufSize) {
+        SHPStreamFlush(psStream);
+
+        if (cbNeed > psStream->nBufSize) {
+            ub1 *pabyBuf = (ub1 *) realloc(psStream->pabyBuf, (size_t) cbNeed);
+            if (!pabyBuf) {
+                psStream->bError = SHAPEFILE_TRUE;
+                return NULL;
+            }
+            psStream->pabyBuf = pabyBuf;
+            psStream->nBufSize = cbNeed;
+        }
+    }
+    return psStream->pabyBuf + psStream->cbBuf;
+}
+
+
+void SHPStreamWrite (SHPStreamBuffer *psStream, const void *pv, int cb)
+{
+    ub1 *pb = SHPStreamReserve(psStream, cb);
+
+    if (pb) {
+        memcpy(pb, pv, cb);
+        psStream->cbBuf += cb;
+    }
+}
+
+
+void SHPStreamFree (SHPStreamBuffer *psStream)
+{
+    SafeFree(psStream->pabyBuf);
+    psStream->nBufSize = 0;
+    psStream->cbBuf = 0;
+}
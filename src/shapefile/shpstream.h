@@ -0,0 +1,155 @@
+/******************************************************************************
+ * shpstream.h
+ *
+ * v 1.0 2026/10/18
+ *
+ * Project:  Shapelib
+ * Purpose:  Text writer and sink buffer of the WKT, GeoJSON and COPY output
+ * Author:   cheungmine@gmail.com
+ *
+ * Copyright (c) 2026, cheungmine
+ *
+ * This software is available under the following "MIT Style" license,
+ * or at the option of the licensee under the LGPL (see LICENSE.LGPL).  This
+ * option is discussed in more detail in shapelib.html.
+ *
+ * --
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+ * SHPTextWriter writes text into a caller buffer and counts it to the
+ * end, cutting what does not fit as snprintf() does. without a buffer
+ * it only counts. the WKT and GeoJSON writers are built on it.
+ *
+ * SHPStreamBuffer collects the bytes of a stream and hands them to an
+ * SHPStreamSink when full. the GeoJSON and PostgreSQL COPY streams use
+ * it, with their attributes read in batches into columns set up by
+ * DBFBatchColumnInit().
+ */
+
+#ifndef _SHPSTREAM_H_INCLUDED
+#define _SHPSTREAM_H_INCLUDED
+
+#include "shapefile_i.h"
+
+
+typedef struct
+{
+    char     *pszOut;       /* NULL to count only */
+    int64_t   cb;           /* length of the whole text so far */
+    int       cap;          /* chars pszOut takes before its NUL */
+} SHPTextWriter;
+
+
+/**
+ * cbBuffer chars of pszBuf with the NUL, none if cbBuffer <= 0.
+ */
+STATIC_INLINE void SHPTextInit (SHPTextWriter *t, char *pszBuf, int cbBuffer)
+{
+    t->pszOut = cbBuffer > 0 ? pszBuf : NULL;
+    t->cb = 0;
+    t->cap = cbBuffer - 1;
+}
+
+
+/**
+ * append len chars, dropping what does not fit in t->cap.
+ */
+STATIC_INLINE void SHPTextPutChars (SHPTextWriter *t, const char *pch, int len)
+{
+    if (t->pszOut && t->cb < t->cap) {
+        memcpy(t->pszOut + t->cb, pch, (size_t) MIN_V2(len, t->cap - t->cb));
+    }
+    t->cb += len;
+}
+
+
+STATIC_INLINE void SHPTextPutText (SHPTextWriter *t, const char *psz)
+{
+    SHPTextPutChars(t, psz, (int) strlen(psz));
+}
+
+
+/**
+ * dValue as SHPFormatDouble() writes it, straight into the buffer when
+ *   there is room for the longest number.
+ */
+STATIC_INLINE void SHPTextPutDouble (SHPTextWriter *t, double dValue, int nDecimals)
+{
+    if (t->pszOut && t->cb <= t->cap - SHP_DOUBLE_BUFSIZE) {
+        t->cb += SHPFormatDouble(t->pszOut + t->cb, dValue, nDecimals);
+    } else {
+        char szBuf[SHP_DOUBLE_BUFSIZE];
+        SHPTextPutChars(t, szBuf, SHPFormatDouble(szBuf, dValue, nDecimals));
+    }
+}
+
+
+/**
+ * NUL-terminate the (possibly cut) text and return its full length, -1
+ *   if that length plus its NUL does not fit in an int.
+ */
+STATIC_INLINE int SHPTextEnd (SHPTextWriter *t)
+{
+    if (t->pszOut) {
+        t->pszOut[MIN_V2(t->cb, t->cap)] = '\0';
+    }
+    if (t->cb >= INT_MAX) {
+        return -1;
+    }
+    return (int) t->cb;
+}
+
+
+typedef struct
+{
+    SHPStreamSink   pfnSink;
+    void           *pvSink;
+    int             bError;     /* the sink failed or out of memory */
+
+    ub1            *pabyBuf;
+    int             nBufSize;
+    int             cbBuf;
+} SHPStreamBuffer;
+
+
+/**
+ * buffer of nBufSize bytes for pfnSink. SHAPEFILE_FALSE on out of memory.
+ */
+int SHPStreamInit (SHPStreamBuffer *psStream, SHPStreamSink pfnSink, void *pvSink, int nBufSize);
+
+/**
+ * hand the buffered bytes to the sink. SHAPEFILE_FALSE once it failed.
+ */
+int SHPStreamFlush (SHPStreamBuffer *psStream);
+
+/**
+ * room for cbNeed more bytes at the returned address, flushing first
+ *   if they do not fit and growing the buffer for a larger value. the
+ *   caller adds what it wrote to cbBuf. NULL on out of memory.
+ */
+ub1 * SHPStreamReserve (SHPStreamBuffer *psStream, int cbNeed);
+
+void SHPStreamWrite (SHPStreamBuffer *psStream, const void *pv, int cb);
+
+void SHPStreamFree (SHPStreamBuffer *psStream);
+
+#endif /* _SHPSTREAM_H_INCLUDED */
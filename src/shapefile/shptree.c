@@ -75,6 +75,9 @@ typedef struct shape_tree_root
 
 #define SHP_SPLIT_RATIO  0.55
 
+/* upper limit of the depth SHPCreateTree() estimates when nMaxDepth is 0 */
+#define SHP_MAX_DEFAULT_TREE_DEPTH  12
+
 /**
  * Initialize a tree node
  */
@@ -117,6 +120,7 @@ SHPTreeHandle SHPCreateTree (SHPHandle hSHP, int nDimension, int nMaxDepth, doub
     psTree->hSHP = hSHP;
     psTree->nMaxDepth = nMaxDepth;
     psTree->nDimension = nDimension;
+    psTree->nTotalCount = 0;
 
     /* If no max depth was defined, try to select a reasonable one that implies approximately 8 shapes per node */
     if (psTree->nMaxDepth == 0 && hSHP != 0) {
@@ -127,6 +131,11 @@ SHPTreeHandle SHPCreateTree (SHPHandle hSHP, int nDimension, int nMaxDepth, doub
             psTree->nMaxDepth += 1;
             nMaxNodeCount = nMaxNodeCount * 2;
         }
+
+        /* deep trees use a lot of memory, so the estimate is limited */
+        if (psTree->nMaxDepth > SHP_MAX_DEFAULT_TREE_DEPTH) {
+            psTree->nMaxDepth = SHP_MAX_DEFAULT_TREE_DEPTH;
+        }
     }
 
     /* Allocate the root node */
@@ -147,10 +156,16 @@ SHPTreeHandle SHPCreateTree (SHPHandle hSHP, int nDimension, int nMaxDepth, doub
         int  iShape, nShapeCount;
         SHPGetInfo(hSHP, &nShapeCount, 0, 0, 0);
         for (iShape = 0; iShape < nShapeCount; iShape++) {
-            SHPObject  *psShape;
-            psShape = SHPReadObject(hSHP, iShape);
-            SHPTreeAddShapeId(psTree, psShape);
-            SHPDestroyObject(psShape);
+            SHPBounds  bounds;
+
+            /* only the record head and Z/M ranges are read, never the vertices.
+             *   null shapes go in with zero bounds, as shapelib does, so that
+             *   a .qix written from here matches its files
+             */
+            if (SHPReadObjectBounds(hSHP, iShape, &bounds, 0) == SHPT_NULL) {
+                memset(&bounds, 0, sizeof(bounds));
+            }
+            SHPTreeAddShapeBounds(psTree, iShape, &bounds);
         }
     }
     return psTree;
@@ -213,33 +228,21 @@ int SHPCheckBoundsOverlap (double *padfBox1Min, double *padfBox1Max, double *pad
 }
 
 /**
- * Does the given shape fit within the indicated extents?
+ * Does the given shape extent fit within the indicated extents?
  */
 static int SHPCheckObjectContained (
-    SHPObject * psObject,
+    const double *padfObjectMin,
+    const double *padfObjectMax,
     int nDimension,
-    double *padfBoundsMin,
-    double *padfBoundsMax)
+    const double *padfBoundsMin,
+    const double *padfBoundsMax)
 {
-    if (psObject->dfXMin < padfBoundsMin[0] || psObject->dfXMax > padfBoundsMax[0]) {
-        return SHAPEFILE_FALSE;
-    }
-    if (psObject->dfYMin < padfBoundsMin[1] || psObject->dfYMax > padfBoundsMax[1]) {
-        return SHAPEFILE_FALSE;
-    }
-    if (nDimension == 2) {
-        return SHAPEFILE_TRUE;
-    }
-    if (psObject->dfZMin < padfBoundsMin[2] || psObject->dfZMax < padfBoundsMax[2]) {
-        return SHAPEFILE_FALSE;
-    }
-    if (nDimension == 3) {
-        return SHAPEFILE_TRUE;
-    }
-    if (psObject->dfMMin < padfBoundsMin[3] || psObject->dfMMax < padfBoundsMax[3]) {
-        return SHAPEFILE_FALSE;
+    int iDim;
+    for (iDim = 0; iDim < nDimension; iDim++) {
+        if (padfObjectMin[iDim] < padfBoundsMin[iDim] || padfObjectMax[iDim] > padfBoundsMax[iDim]) {
+            return SHAPEFILE_FALSE;
+        }
     }
-
     return SHAPEFILE_TRUE;
 }
 
@@ -278,7 +281,9 @@ void SHPTreeSplitBounds (
  */
 static int SHPTreeNodeAddShapeId (
     SHPTreeNode *psTreeNode,
-    SHPObject *psObject,
+    int nShapeId,
+    const double *padfObjectMin,
+    const double *padfObjectMax,
     int nMaxDepth,
     int nDimension)
 {
@@ -287,10 +292,10 @@ static int SHPTreeNodeAddShapeId (
     /* If there are subnodes, then consider wiether this object will fit in them */
     if (nMaxDepth > 1 && psTreeNode->nSubNodes > 0) {
         for (i = 0; i < psTreeNode->nSubNodes; i++) {
-            if (SHPCheckObjectContained(psObject, nDimension,
+            if (SHPCheckObjectContained(padfObjectMin, padfObjectMax, nDimension,
                 psTreeNode->apsSubNode[i]->adfBoundsMin,
                 psTreeNode->apsSubNode[i]->adfBoundsMax)) {
-                return SHPTreeNodeAddShapeId(psTreeNode->apsSubNode[i], psObject, nMaxDepth-1, nDimension);
+                return SHPTreeNodeAddShapeId(psTreeNode->apsSubNode[i], nShapeId, padfObjectMin, padfObjectMax, nMaxDepth-1, nDimension);
             }
         }
     }
@@ -314,10 +319,10 @@ static int SHPTreeNodeAddShapeId (
         SHPTreeSplitBounds(adfBoundsMinH2, adfBoundsMaxH2,
             adfBoundsMin3, adfBoundsMax3, adfBoundsMin4, adfBoundsMax4);
 
-        if (SHPCheckObjectContained(psObject, nDimension, adfBoundsMin1, adfBoundsMax1) ||
-            SHPCheckObjectContained(psObject, nDimension, adfBoundsMin2, adfBoundsMax2) ||
-            SHPCheckObjectContained(psObject, nDimension, adfBoundsMin3, adfBoundsMax3) ||
-            SHPCheckObjectContained(psObject, nDimension, adfBoundsMin4, adfBoundsMax4)) {
+        if (SHPCheckObjectContained(padfObjectMin, padfObjectMax, nDimension, adfBoundsMin1, adfBoundsMax1) ||
+            SHPCheckObjectContained(padfObjectMin, padfObjectMax, nDimension, adfBoundsMin2, adfBoundsMax2) ||
+            SHPCheckObjectContained(padfObjectMin, padfObjectMax, nDimension, adfBoundsMin3, adfBoundsMax3) ||
+            SHPCheckObjectContained(padfObjectMin, padfObjectMax, nDimension, adfBoundsMin4, adfBoundsMax4)) {
             psTreeNode->nSubNodes = 4;
             psTreeNode->apsSubNode[0] = SHPTreeNodeCreate(adfBoundsMin1, adfBoundsMax1);
             psTreeNode->apsSubNode[1] = SHPTreeNodeCreate(adfBoundsMin2, adfBoundsMax2);
@@ -325,7 +330,7 @@ static int SHPTreeNodeAddShapeId (
             psTreeNode->apsSubNode[3] = SHPTreeNodeCreate(adfBoundsMin4, adfBoundsMax4);
 
             /* recurse back on this node now that it has subnodes */
-            return SHPTreeNodeAddShapeId(psTreeNode, psObject, nMaxDepth, nDimension);
+            return SHPTreeNodeAddShapeId(psTreeNode, nShapeId, padfObjectMin, padfObjectMax, nMaxDepth, nDimension);
         }
     }
 #endif /* MAX_SUBNODE == 4 */
@@ -340,17 +345,17 @@ static int SHPTreeNodeAddShapeId (
         SHPTreeSplitBounds(psTreeNode->adfBoundsMin, psTreeNode->adfBoundsMax,
             adfBoundsMin1, adfBoundsMax1, adfBoundsMin2, adfBoundsMax2);
 
-        if (SHPCheckObjectContained(psObject, nDimension, adfBoundsMin1, adfBoundsMax1)) {
+        if (SHPCheckObjectContained(padfObjectMin, padfObjectMax, nDimension, adfBoundsMin1, adfBoundsMax1)) {
             psTreeNode->nSubNodes = 2;
             psTreeNode->apsSubNode[0] = SHPTreeNodeCreate(adfBoundsMin1, adfBoundsMax1);
             psTreeNode->apsSubNode[1] = SHPTreeNodeCreate(adfBoundsMin2, adfBoundsMax2);
 
-            return SHPTreeNodeAddShapeId(psTreeNode->apsSubNode[0], psObject, nMaxDepth - 1, nDimension);
-        } else if (SHPCheckObjectContained(psObject, nDimension, adfBoundsMin2, adfBoundsMax2)) {
+            return SHPTreeNodeAddShapeId(psTreeNode->apsSubNode[0], nShapeId, padfObjectMin, padfObjectMax, nMaxDepth - 1, nDimension);
+        } else if (SHPCheckObjectContained(padfObjectMin, padfObjectMax, nDimension, adfBoundsMin2, adfBoundsMax2)) {
             psTreeNode->nSubNodes = 2;
             psTreeNode->apsSubNode[0] = SHPTreeNodeCreate(adfBoundsMin1, adfBoundsMax1);
             psTreeNode->apsSubNode[1] = SHPTreeNodeCreate(adfBoundsMin2, adfBoundsMax2);
-            return(SHPTreeNodeAddShapeId(psTreeNode->apsSubNode[1], psObject, nMaxDepth - 1, nDimension));
+            return(SHPTreeNodeAddShapeId(psTreeNode->apsSubNode[1], nShapeId, padfObjectMin, padfObjectMax, nMaxDepth - 1, nDimension));
         }
     }
 #endif /* MAX_SUBNODE == 2 */
@@ -359,7 +364,7 @@ static int SHPTreeNodeAddShapeId (
     psTreeNode->nShapeCount++;
 
     psTreeNode->panShapeIds = SfRealloc(psTreeNode->panShapeIds, sizeof(int) * psTreeNode->nShapeCount);
-    psTreeNode->panShapeIds[psTreeNode->nShapeCount-1] = psObject->nShapeId;
+    psTreeNode->panShapeIds[psTreeNode->nShapeCount-1] = nShapeId;
 
     if (psTreeNode->papsShapeObj != 0) {
         psTreeNode->papsShapeObj = SfRealloc(psTreeNode->papsShapeObj, sizeof(void *) * psTreeNode->nShapeCount);
@@ -375,7 +380,45 @@ static int SHPTreeNodeAddShapeId (
 int SHPTreeAddShapeId(SHPTreeHandle psTree, SHPObject * psObject)
 
 {
-    return(SHPTreeNodeAddShapeId(psTree->psRoot, psObject, psTree->nMaxDepth, psTree->nDimension));
+    double adfObjectMin[4], adfObjectMax[4];
+
+    adfObjectMin[0] = psObject->dfXMin;
+    adfObjectMin[1] = psObject->dfYMin;
+    adfObjectMin[2] = psObject->dfZMin;
+    adfObjectMin[3] = psObject->dfMMin;
+
+    adfObjectMax[0] = psObject->dfXMax;
+    adfObjectMax[1] = psObject->dfYMax;
+    adfObjectMax[2] = psObject->dfZMax;
+    adfObjectMax[3] = psObject->dfMMax;
+
+    psTree->nTotalCount++;
+
+    return(SHPTreeNodeAddShapeId(psTree->psRoot, psObject->nShapeId, adfObjectMin, adfObjectMax,
+        psTree->nMaxDepth, psTree->nDimension));
+}
+
+/**
+ * Same as SHPTreeAddShapeId() but from the bounds of SHPReadObjectBounds()
+ */
+int SHPTreeAddShapeBounds(SHPTreeHandle psTree, int nShapeId, const SHPBounds *psBounds)
+{
+    double adfObjectMin[4], adfObjectMax[4];
+
+    adfObjectMin[0] = psBounds->XMin;
+    adfObjectMin[1] = psBounds->YMin;
+    adfObjectMin[2] = psBounds->ZMin;
+    adfObjectMin[3] = psBounds->MMin;
+
+    adfObjectMax[0] = psBounds->XMax;
+    adfObjectMax[1] = psBounds->YMax;
+    adfObjectMax[2] = psBounds->ZMax;
+    adfObjectMax[3] = psBounds->MMax;
+
+    psTree->nTotalCount++;
+
+    return(SHPTreeNodeAddShapeId(psTree->psRoot, nShapeId, adfObjectMin, adfObjectMax,
+        psTree->nMaxDepth, psTree->nDimension));
 }
 
 /**
@@ -419,6 +462,14 @@ void SHPTreeCollectShapeIds (
     }
 }
 
+/**
+ * qsort() comparator for shapeids
+ */
+static int SHPTreeCompareInts(const void *a, const void *b)
+{
+    return (*(const int *) a) - (*(const int *) b);
+}
+
 /**
  * Find all shapes within tree nodes for which the tree node
  *  bounding box overlaps the search box.  The return value is
@@ -429,7 +480,6 @@ void SHPTreeCollectShapeIds (
 int* SHPTreeFindLikelyShapes(SHPTreeHandle hTree, double *padfBoundsMin, double *padfBoundsMax, int *pnShapeCount)
 {
     int  *panShapeList=0, nMaxShapes = 0;
-    int  i, j, tempId;
 
     /* Perform the search by recursive descent */
     *pnShapeCount = 0;
@@ -437,16 +487,9 @@ int* SHPTreeFindLikelyShapes(SHPTreeHandle hTree, double *padfBoundsMin, double
     SHPTreeCollectShapeIds(hTree, hTree->psRoot, padfBoundsMin, padfBoundsMax,
         pnShapeCount, &nMaxShapes, &panShapeList);
 
-    /*??TODO: For now I just use a bubble sort to order the shapeids,
-   * but this should really be a quicksort */
-    for (i = 0; i < *pnShapeCount-1; i++) {
-        for (j = 0; j < (*pnShapeCount) - i - 1; j++) {
-            if (panShapeList[j] > panShapeList[j+1]) {
-                tempId = panShapeList[j];
-                panShapeList[j] = panShapeList[j+1];
-                panShapeList[j+1] = tempId;
-            }
-        }
+    /* Sort the shapeids so reading back from the file is sequential */
+    if (*pnShapeCount > 1) {
+        qsort(panShapeList, *pnShapeCount, sizeof(int), SHPTreeCompareInts);
     }
     return panShapeList;
 }
@@ -470,6 +513,27 @@ static int SHPTreeNodeTrim(SHPTreeNode * psTreeNode)
         }
     }
 
+    /* If the current node has 1 subnode and no shapes, promote that subnode to the current node position */
+    if (psTreeNode->nSubNodes == 1 && psTreeNode->nShapeCount == 0) {
+        SHPTreeNode *psSubNode = psTreeNode->apsSubNode[0];
+
+        memcpy(psTreeNode->adfBoundsMin, psSubNode->adfBoundsMin, sizeof(psSubNode->adfBoundsMin));
+        memcpy(psTreeNode->adfBoundsMax, psSubNode->adfBoundsMax, sizeof(psSubNode->adfBoundsMax));
+
+        SafeFree(psTreeNode->panShapeIds);
+        SafeFree(psTreeNode->papsShapeObj);
+
+        psTreeNode->nShapeCount = psSubNode->nShapeCount;
+        psTreeNode->panShapeIds = psSubNode->panShapeIds;
+        psTreeNode->papsShapeObj = psSubNode->papsShapeObj;
+        psTreeNode->nSubNodes = psSubNode->nSubNodes;
+
+        for (i = 0; i < psSubNode->nSubNodes; i++) {
+            psTreeNode->apsSubNode[i] = psSubNode->apsSubNode[i];
+        }
+        free(psSubNode);
+    }
+
     /* We should be trimmed if we have no subnodes, and no shapes */
     return(psTreeNode->nSubNodes == 0 && psTreeNode->nShapeCount == 0);
 }
@@ -481,3 +545,361 @@ void SHPTreeTrimExtraNodes (SHPTreeHandle hTree)
 {
     SHPTreeNodeTrim(hTree->psRoot);
 }
+
+
+/*************************************************************************
+ * Quadtree disk format (.qix) compatible with shapelib, MapServer and GDAL:
+ *
+ *   header:  "SQT", byte order (1=LSB, 2=MSB), version 1, 3 reserved,
+ *            int32 total shape count, int32 max depth
+ *   node:    int32 size in bytes of all its subnodes,
+ *            double minx, miny, maxx, maxy,
+ *            int32 nShapeCount, int32 shapeids[nShapeCount],
+ *            int32 nSubNodes, then the subnodes in order
+ *
+ * Trees are always written LSB; both byte orders are read.
+ ************************************************************************/
+
+#define SHP_QIX_HEADER_SIZE   16
+#define SHP_QIX_NODE_HEAD     40
+#define SHP_QIX_MAX_LEVEL     32
+
+typedef struct shape_tree_disk
+{
+    FILE       *fpQIX;
+    int         bNeedSwap;
+    int         nShapeCount;
+    int         nMaxDepth;
+} SHPTreeDisk;
+
+
+/**
+ * Determine how big all the subnodes of this node (and their children) will be.
+ *  This allows disk based searchers to seek past them all efficiently.
+ */
+static int SHPGetSubNodeOffset (SHPTreeNode *psTreeNode)
+{
+    int i, offset = 0;
+
+    for (i = 0; i < psTreeNode->nSubNodes; i++) {
+        if (psTreeNode->apsSubNode[i]) {
+            offset += 4 * sizeof(double) + (psTreeNode->apsSubNode[i]->nShapeCount + 3) * sizeof(int);
+            offset += SHPGetSubNodeOffset(psTreeNode->apsSubNode[i]);
+        }
+    }
+    return offset;
+}
+
+/**
+ * Write one node and then its subnodes depth first
+ */
+static int SHPWriteTreeNode (FILE *fp, SHPTreeNode *psTreeNode)
+{
+    int i, n, nChunk;
+    ub1 abyRec[SHP_QIX_NODE_HEAD];
+    int32_t anIds[256];
+
+    n = SHPGetSubNodeOffset(psTreeNode);
+    memcpy(abyRec, &n, 4);
+
+    /* minx, miny, maxx, maxy */
+    memcpy(abyRec + 4, &psTreeNode->adfBoundsMin[0], 8);
+    memcpy(abyRec + 12, &psTreeNode->adfBoundsMin[1], 8);
+    memcpy(abyRec + 20, &psTreeNode->adfBoundsMax[0], 8);
+    memcpy(abyRec + 28, &psTreeNode->adfBoundsMax[1], 8);
+    memcpy(abyRec + 36, &psTreeNode->nShapeCount, 4);
+
+    BO_htole32_buf(abyRec);
+    for (i = 0; i < 4; i++) {
+        BO_htole64_buf(abyRec + 4 + i*8);
+    }
+    BO_htole32_buf(abyRec + 36);
+
+    if (fwrite(abyRec, SHP_QIX_NODE_HEAD, 1, fp) != 1) {
+        return SHAPEFILE_FALSE;
+    }
+
+    /* shapeids go out in chunks so big nodes need no extra allocation */
+    for (i = 0; i < psTreeNode->nShapeCount; i += nChunk) {
+        nChunk = MIN_V2(psTreeNode->nShapeCount - i, (int) (sizeof(anIds)/sizeof(anIds[0])));
+        for (n = 0; n < nChunk; n++) {
+            anIds[n] = psTreeNode->panShapeIds[i + n];
+            BO_htole32_buf(&anIds[n]);
+        }
+        if (fwrite(anIds, sizeof(int32_t), nChunk, fp) != (size_t) nChunk) {
+            return SHAPEFILE_FALSE;
+        }
+    }
+
+    n = psTreeNode->nSubNodes;
+    BO_htole32_buf(&n);
+    if (fwrite(&n, 4, 1, fp) != 1) {
+        return SHAPEFILE_FALSE;
+    }
+
+    for (i = 0; i < psTreeNode->nSubNodes; i++) {
+        if (psTreeNode->apsSubNode[i] && !SHPWriteTreeNode(fp, psTreeNode->apsSubNode[i])) {
+            return SHAPEFILE_FALSE;
+        }
+    }
+    return SHAPEFILE_TRUE;
+}
+
+/**
+ * Write the tree to a .qix file
+ */
+int SHPWriteTree (SHPTreeHandle hTree, const char *pszFilename)
+{
+    FILE *fp;
+    ub1 abyBuf[SHP_QIX_HEADER_SIZE];
+    int bOk;
+
+    fp = fopen(pszFilename, "wb");
+    if (!fp) {
+        return SHAPEFILE_FALSE;
+    }
+
+    memcpy(abyBuf, "SQT", 3);
+    abyBuf[3] = 1;    /* LSB */
+    abyBuf[4] = 1;    /* version */
+    abyBuf[5] = 0;
+    abyBuf[6] = 0;
+    abyBuf[7] = 0;
+
+    memcpy(abyBuf + 8, &hTree->nTotalCount, 4);
+    memcpy(abyBuf + 12, &hTree->nMaxDepth, 4);
+    BO_htole32_buf(abyBuf + 8);
+    BO_htole32_buf(abyBuf + 12);
+
+    bOk = (fwrite(abyBuf, SHP_QIX_HEADER_SIZE, 1, fp) == 1) && SHPWriteTreeNode(fp, hTree->psRoot);
+
+    if (fclose(fp) != 0) {
+        bOk = SHAPEFILE_FALSE;
+    }
+
+    if (!bOk) {
+        remove(pszFilename);
+    }
+    return bOk;
+}
+
+/**
+ * Read and check the .qix header. Leaves fp at the root node.
+ */
+static int SHPReadDiskTreeHeader (FILE *fp, SHPTreeDisk *psDiskTree)
+{
+    ub1 abyBuf[SHP_QIX_HEADER_SIZE];
+
+    if (fseek(fp, 0, SEEK_SET) != 0 || fread(abyBuf, SHP_QIX_HEADER_SIZE, 1, fp) != 1) {
+        return SHAPEFILE_FALSE;
+    }
+
+    if (memcmp(abyBuf, "SQT", 3) != 0 || (abyBuf[3] != 1 && abyBuf[3] != 2)) {
+        return SHAPEFILE_FALSE;
+    }
+
+    psDiskTree->fpQIX = fp;
+    psDiskTree->bNeedSwap = BO_LITTLE_ENDIAN ? (abyBuf[3] != 1) : (abyBuf[3] != 2);
+
+    memcpy(&psDiskTree->nShapeCount, abyBuf + 8, 4);
+    memcpy(&psDiskTree->nMaxDepth, abyBuf + 12, 4);
+
+    if (psDiskTree->bNeedSwap) {
+        BO_swap_ub4(&psDiskTree->nShapeCount);
+        BO_swap_ub4(&psDiskTree->nMaxDepth);
+    }
+    return SHAPEFILE_TRUE;
+}
+
+/**
+ * Open a .qix file for searching. The file stays open and every search
+ *  streams the nodes it needs from it.
+ */
+SHPTreeDiskHandle SHPOpenDiskTree (const char *pszQIXFilename)
+{
+    FILE *fp;
+    SHPTreeDisk diskTree, *psDiskTree;
+
+    fp = fopen(pszQIXFilename, "rb");
+    if (!fp) {
+        return 0;
+    }
+
+    if (!SHPReadDiskTreeHeader(fp, &diskTree)) {
+        fclose(fp);
+        return 0;
+    }
+
+    psDiskTree = (SHPTreeDisk *) malloc(sizeof(SHPTreeDisk));
+    if (!psDiskTree) {
+        fclose(fp);
+        return 0;
+    }
+    memcpy(psDiskTree, &diskTree, sizeof(diskTree));
+    return psDiskTree;
+}
+
+/**
+ * Close a tree opened by SHPOpenDiskTree()
+ */
+void SHPCloseDiskTree (SHPTreeDiskHandle hDiskTree)
+{
+    if (hDiskTree) {
+        fclose(hDiskTree->fpQIX);
+        free(hDiskTree);
+    }
+}
+
+/**
+ * Get shape count and max depth recorded in the .qix header
+ */
+void SHPDiskTreeGetInfo (SHPTreeDiskHandle hDiskTree, int *pnShapeCount, int *pnMaxDepth)
+{
+    if (pnShapeCount) {
+        *pnShapeCount = hDiskTree->nShapeCount;
+    }
+    if (pnMaxDepth) {
+        *pnMaxDepth = hDiskTree->nMaxDepth;
+    }
+}
+
+/**
+ * Read one node head; collect its shapeids if it overlaps the search box,
+ *  otherwise seek past it and all its subnodes without reading them.
+ */
+static int SHPSearchDiskTreeNode (
+    SHPTreeDisk *psDiskTree,
+    const double *padfBoundsMin,
+    const double *padfBoundsMax,
+    int **ppanResultBuffer,
+    int *pnBufferMax,
+    int *pnResultCount,
+    int nRecLevel)
+{
+    FILE *fp = psDiskTree->fpQIX;
+    ub1 abyRec[SHP_QIX_NODE_HEAD];
+    uint32_t i, offset, numshapes, numsubnodes;
+    double adfNodeBoundsMin[2], adfNodeBoundsMax[2];
+
+    if (fread(abyRec, SHP_QIX_NODE_HEAD, 1, fp) != 1) {
+        return SHAPEFILE_FALSE;
+    }
+
+    memcpy(&offset, abyRec, 4);
+    memcpy(&adfNodeBoundsMin[0], abyRec + 4, 8);
+    memcpy(&adfNodeBoundsMin[1], abyRec + 12, 8);
+    memcpy(&adfNodeBoundsMax[0], abyRec + 20, 8);
+    memcpy(&adfNodeBoundsMax[1], abyRec + 28, 8);
+    memcpy(&numshapes, abyRec + 36, 4);
+
+    if (psDiskTree->bNeedSwap) {
+        BO_swap_ub4(&offset);
+        BO_swap_ub8(&adfNodeBoundsMin[0]);
+        BO_swap_ub8(&adfNodeBoundsMin[1]);
+        BO_swap_ub8(&adfNodeBoundsMax[0]);
+        BO_swap_ub8(&adfNodeBoundsMax[1]);
+        BO_swap_ub4(&numshapes);
+    }
+
+    /* sanity checks to avoid int overflows in later computation */
+    if (offset > INT_MAX - sizeof(int) ||
+        numshapes > (INT_MAX - offset - sizeof(int)) / sizeof(int) ||
+        numshapes > INT_MAX / sizeof(int) - *pnResultCount) {
+        return SHAPEFILE_FALSE;
+    }
+
+    /* If we don't overlap this node at all, skip this node info and all subnodes */
+    if (!SHPCheckBoundsOverlap(adfNodeBoundsMin, adfNodeBoundsMax,
+        (double *) padfBoundsMin, (double *) padfBoundsMax, 2)) {
+        return (fseek(fp, (long) (offset + numshapes * sizeof(int) + sizeof(int)), SEEK_CUR) == 0);
+    }
+
+    /* Add all the shapeids at this node to our list */
+    if (numshapes > 0) {
+        if (*pnResultCount + numshapes > (uint32_t) *pnBufferMax) {
+            *pnBufferMax = (*pnResultCount + numshapes + 100) * 5 / 4;
+            if ((size_t) *pnBufferMax > INT_MAX / sizeof(int)) {
+                *pnBufferMax = *pnResultCount + numshapes;
+            }
+            *ppanResultBuffer = (int *) SfRealloc(*ppanResultBuffer, sizeof(int) * (*pnBufferMax));
+        }
+
+        if (fread(*ppanResultBuffer + *pnResultCount, sizeof(int), numshapes, fp) != numshapes) {
+            return SHAPEFILE_FALSE;
+        }
+
+        if (psDiskTree->bNeedSwap) {
+            for (i = 0; i < numshapes; i++) {
+                BO_swap_ub4(*ppanResultBuffer + *pnResultCount + i);
+            }
+        }
+        *pnResultCount += numshapes;
+    }
+
+    /* Process the subnodes */
+    if (fread(&numsubnodes, 4, 1, fp) != 1) {
+        return SHAPEFILE_FALSE;
+    }
+    if (psDiskTree->bNeedSwap) {
+        BO_swap_ub4(&numsubnodes);
+    }
+    if (numsubnodes > 0 && nRecLevel == SHP_QIX_MAX_LEVEL) {
+        /* Shape tree is too deep */
+        return SHAPEFILE_FALSE;
+    }
+
+    for (i = 0; i < numsubnodes; i++) {
+        if (!SHPSearchDiskTreeNode(psDiskTree, padfBoundsMin, padfBoundsMax,
+            ppanResultBuffer, pnBufferMax, pnResultCount, nRecLevel + 1)) {
+            return SHAPEFILE_FALSE;
+        }
+    }
+    return SHAPEFILE_TRUE;
+}
+
+/**
+ * Search an opened .qix file. Returns a sorted array of candidate shapeids
+ *  to be freed by the caller (possibly empty, never NULL on success),
+ *  or NULL on a corrupt or truncated file.
+ */
+int* SHPSearchDiskTreeEx (SHPTreeDiskHandle hDiskTree, double *padfBoundsMin, double *padfBoundsMax, int *pnShapeCount)
+{
+    int nBufferMax = 0;
+    int *panResultBuffer = 0;
+
+    *pnShapeCount = 0;
+
+    if (fseek(hDiskTree->fpQIX, SHP_QIX_HEADER_SIZE, SEEK_SET) != 0) {
+        return 0;
+    }
+
+    if (!SHPSearchDiskTreeNode(hDiskTree, padfBoundsMin, padfBoundsMax,
+        &panResultBuffer, &nBufferMax, pnShapeCount, 0)) {
+        SafeFree(panResultBuffer);
+        *pnShapeCount = 0;
+        return 0;
+    }
+
+    /* To distinguish between empty intersection from error case */
+    if (!panResultBuffer) {
+        panResultBuffer = (int *) calloc(1, sizeof(int));
+    } else {
+        qsort(panResultBuffer, *pnShapeCount, sizeof(int), SHPTreeCompareInts);
+    }
+    return panResultBuffer;
+}
+
+/**
+ * Search a .qix file already opened by the caller with fopen(..., "rb")
+ */
+int* SHPSearchDiskTree (FILE *fp, double *padfBoundsMin, double *padfBoundsMax, int *pnShapeCount)
+{
+    SHPTreeDisk diskTree;
+
+    *pnShapeCount = 0;
+
+    if (!SHPReadDiskTreeHeader(fp, &diskTree)) {
+        return 0;
+    }
+    return SHPSearchDiskTreeEx(&diskTree, padfBoundsMin, padfBoundsMax, pnShapeCount);
+}